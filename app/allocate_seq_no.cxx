@@ -5,11 +5,13 @@
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <vector>
 
 /// Standalone utility to issue local and global SEQNOs.
 
 /// Invocation:
 ///   seqno=`allocate_seq_no.exe <tableName> { <reqGlobal> <dbNo> } | tail -1`
+///   range=`allocate_seq_no.exe --count <n> <tableName> { <reqGlobal> <dbNo> } | tail -1`
 
 /// Where:-
 ///   tableName   in    The table for which the SEQNO is required.
@@ -21,7 +23,12 @@
 ///   dbNo        in    The entry in the cascade for which the SEQNO
 ///                        is required.
 ///
+///   n           in    Reserve a block of n consecutive SEQNOs with a single
+///                        update of the SEQNO table.
+///
 ///   seqno       out    The allocated SEQNO (or 0 if unable to allocate one)
+///   range       out    The first and last SEQNOs of the block separated by
+///                        a space (or 0 if unable to allocate them)
 ///
 ///   | tail -1       Is need to filter the output and keep only the last line.
 
@@ -29,21 +36,46 @@
 int main(int argc, char** argv) {
     CP::TDbiLog::SetDebugLevel(CP::TDbiLog::WarnLevel);
     CP::TDbiLog::SetLogLevel(CP::TDbiLog::QuietLevel);
-    if (argc < 2) {
+    Int_t count = 0;
+    std::vector<std::string> args;
+    for (int iarg = 1; iarg < argc; ++iarg) {
+        std::string arg(argv[iarg]);
+        if (arg == "--count" && iarg+1 < argc) {
+            count = atoi(argv[++iarg]);
+            if (count <= 0) {
+                CaptError("ERROR: --count must be positive.");
+                std::cout << "0" << std::endl;
+                return 1;
+            }
+        }
+        else {
+            args.push_back(arg);
+        }
+    }
+    if (args.empty()) {
         CaptError("ERROR: Insufficient arguments to allocate_seq_no.exe.");
         std::cout << "0" << std::endl;
         return 1;
     }
-    std::string table_name(argv[1]);
+    std::string table_name(args[0]);
     Int_t requireGlobal = 0;
     Int_t dbNo          = 0;
-    if (argc > 2) {
-        requireGlobal = atoi(argv[2]);
+    if (args.size() > 1) {
+        requireGlobal = atoi(args[1].c_str());
+    }
+    if (args.size() > 2) {
+        dbNo          = atoi(args[2].c_str());
     }
-    if (argc > 3) {
-        dbNo          = atoi(argv[3]);
+    CP::TSeqNoAllocator sna;
+    if (count > 0) {
+        Int_t first = sna.ReserveSeqNos(table_name,count,requireGlobal,dbNo);
+        if (first <= 0) {
+            std::cout << "0" << std::endl;
+            return 1;
+        }
+        std::cout << first << " " << first + count - 1 << std::endl;
+        return 0;
     }
-    CP::TSeqNoAllocator sna = CP::TSeqNoAllocator();
     Int_t seqno = sna.GetSeqNo(table_name,requireGlobal,dbNo);
     std::cout << seqno << std::endl;
     return 0;
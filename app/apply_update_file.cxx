@@ -0,0 +1,123 @@
+#include <TDbiLog.hxx>
+#include "TDbiCascader.hxx"
+#include "TDbiConnection.hxx"
+#include "TDbiDatabaseManager.hxx"
+#include "TDbiUpdateApplier.hxx"
+#include "Rtypes.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/// Standalone utility to apply an .update file, as written by
+/// TDbiWriter::Close(fileSpec), to a database.
+
+/// Invocation:
+///   apply_update_file.exe [options] <file> { <file> ... }
+
+/// Where:-
+///   file        in    An update file.  Files are applied in turn.
+///
+/// Options:-
+///   --global          Give packets new global SEQNOs (fails if the
+///                     cascade entry is not authorising).
+///   --local           Give packets new local SEQNOs.
+///                     (default: global if the entry is authorising and
+///                     the table isn't temporary, otherwise local)
+///   --keep-seqnos     Keep the SEQNOs in the file, replacing any packets
+///                     already stored with them.
+///   --dbno <n>        Apply to this cascade entry (default 0).
+///   --threads <n>     Apply up to n tables at the same time (default 4).
+///                     ConnectionPoolSize is raised to n+1 if smaller:
+///                     one connection per thread and one to reserve
+///                     SEQNOs.  An SQLite entry is applied with one
+///                     thread.
+///   --batch <n>       Packets per transaction (default 1000).
+///   --progress <s>    Report progress every s seconds (default 10).
+///   --quiet           Only report errors.
+///
+/// Returns 0 if every packet of every file was applied.
+
+int main(int argc, char** argv) {
+    CP::TDbiLog::SetDebugLevel(CP::TDbiLog::WarnLevel);
+    CP::TDbiLog::SetLogLevel(CP::TDbiLog::LogLevel);
+
+    std::vector<std::string> files;
+    Int_t    requireGlobal = 0;
+    bool     keepSeqNos    = false;
+    Int_t    dbNo          = 0;
+    Int_t    numThreads    = 4;
+    Int_t    batchSize     = 1000;
+    Double_t progress      = 10.;
+    for (int iarg = 1; iarg < argc; ++iarg) {
+        std::string arg(argv[iarg]);
+        if (arg.substr(0,2) != "--") {
+            files.push_back(arg);
+            continue;
+        }
+        if      (arg == "--global")      { requireGlobal = 1;  continue; }
+        else if (arg == "--local")       { requireGlobal = -1; continue; }
+        else if (arg == "--keep-seqnos") { keepSeqNos = true;  continue; }
+        else if (arg == "--quiet") {
+            CP::TDbiLog::SetLogLevel(CP::TDbiLog::QuietLevel);
+            continue;
+        }
+        if (iarg + 1 >= argc) {
+            CaptError("ERROR: Missing value for " << arg
+                      << " to apply_update_file.exe.");
+            return 1;
+        }
+        std::string value(argv[++iarg]);
+        if      (arg == "--dbno")     dbNo       = atoi(value.c_str());
+        else if (arg == "--threads")  numThreads = atoi(value.c_str());
+        else if (arg == "--batch")    batchSize  = atoi(value.c_str());
+        else if (arg == "--progress") progress   = atof(value.c_str());
+        else {
+            CaptError("ERROR: Unknown option " << arg
+                      << " to apply_update_file.exe.");
+            return 1;
+        }
+    }
+    if (files.empty()) {
+        CaptError("ERROR: Insufficient arguments to apply_update_file.exe.");
+        return 1;
+    }
+    if (dbNo < 0 || numThreads <= 0 || batchSize <= 0) {
+        CaptError("ERROR: Bad --dbno, --threads or --batch to apply_update_file.exe.");
+        return 1;
+    }
+
+    // Each storing thread holds a connection for its transaction.  SQLite
+    // files are written by a single thread.
+    CP::TDbiCascader& cascader = CP::TDbiDatabaseManager::Instance()
+                                 .GetCascader();
+    const CP::TDbiConnection* connection = cascader.GetConnection(dbNo);
+    if (connection && ! connection->IsSQLite()
+        && cascader.GetPoolSize(dbNo) < (UInt_t) numThreads + 1) {
+        cascader.SetPoolSize(numThreads + 1);
+    }
+
+    CP::TDbiUpdateApplier applier(dbNo);
+    applier.SetRequireGlobal(requireGlobal);
+    applier.SetKeepSeqNos(keepSeqNos);
+    applier.SetNumThreads(numThreads);
+    applier.SetBatchSize(batchSize);
+    applier.SetProgressInterval(progress);
+
+    for (UInt_t ifile = 0; ifile < files.size(); ++ifile) {
+        bool ok = applier.Apply(files[ifile]);
+        std::cout << "Applied " << applier.GetNumSets() << " validity sets ("
+                  << applier.GetNumRows() << " rows) of "
+                  << applier.GetNumTables() << " tables from " << files[ifile]
+                  << " at " << applier.GetRowsPerSec() << " rows/sec"
+                  << std::endl;
+        if (! ok) {
+            CaptError("ERROR: Update from " << files[ifile]
+                      << " incomplete; " << applier.GetNumErrors()
+                      << " validity sets not applied.");
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include <TDbiLog.hxx>
+#include "TDbi.hxx"
+#include "TDbiCascader.hxx"
+#include "TDbiConnection.hxx"
+#include "TDbiDatabaseManager.hxx"
+#include "TDbiSqlValPacket.hxx"
+#include "TDbiStatement.hxx"
+#include "Rtypes.h"
+#include "TStopwatch.h"
+#include "TSystem.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+/// Standalone benchmark of TDbiSqlValPacket::Store for large validity
+/// packets: the upload rate in rows per second, each packet stored in
+/// one transaction as TDbiUpdateApplier does.
+
+/// Invocation:
+///   benchmark_store.exe [options]
+
+/// Options:-
+///   --url <url>       Database to write to (default an SQLite file in the
+///                     system temporary directory).  For MySQL also set
+///                     ENV_TSQL_USER and ENV_TSQL_PSWD, e.g.
+///                     --url mysql://localhost/test
+///   --rows <n>        Data rows per packet (default 100000).
+///   --packets <n>     Number of packets stored (default 5).
+///
+/// The benchmark creates, and finally drops, the table BENCHSTORE (and
+/// BENCHSTOREVLD) so must not be pointed at a database holding one.
+/// Packets are read from an update file (see TDbiSqlValPacket::Fill) so
+/// their rows are stored as SQL, in bulk inserts as large as the server
+/// accepts.
+///
+/// Returns 0 if every packet was stored.
+
+int main(int argc, char** argv) {
+    CP::TDbiLog::SetDebugLevel(CP::TDbiLog::WarnLevel);
+    CP::TDbiLog::SetLogLevel(CP::TDbiLog::QuietLevel);
+
+    std::ostringstream scratch;
+    scratch << gSystem->TempDirectory() << "/benchmark_store_"
+            << gSystem->GetPid();
+    std::string sqliteFile = scratch.str() + ".db";
+    std::string url = "sqlite://" + sqliteFile;
+    Int_t numRows    = 100000;
+    Int_t numPackets = 5;
+    for (int iarg = 1; iarg < argc; ++iarg) {
+        std::string arg(argv[iarg]);
+        if (iarg + 1 >= argc) {
+            CaptError("ERROR: Missing value for " << arg
+                      << " to benchmark_store.exe.");
+            return 1;
+        }
+        std::string value(argv[++iarg]);
+        if      (arg == "--url")     url        = value;
+        else if (arg == "--rows")    numRows    = atoi(value.c_str());
+        else if (arg == "--packets") numPackets = atoi(value.c_str());
+        else {
+            CaptError("ERROR: Unknown option " << arg
+                      << " to benchmark_store.exe.");
+            return 1;
+        }
+    }
+    if (numRows <= 0 || numPackets <= 0) {
+        CaptError("ERROR: Bad --rows or --packets to benchmark_store.exe.");
+        return 1;
+    }
+
+    gSystem->Setenv("ENV_TSQL_URL",url.c_str());
+    if (! gSystem->Getenv("ENV_TSQL_USER")) {
+        gSystem->Setenv("ENV_TSQL_USER","benchmark");
+    }
+    if (! gSystem->Getenv("ENV_TSQL_PSWD")) {
+        gSystem->Setenv("ENV_TSQL_PSWD","\\0");
+    }
+    CP::TDbiCascader& cascader = CP::TDbiDatabaseManager::Instance()
+                                 .GetCascader();
+
+    // Make an empty table.
+    const std::string tableName = "BENCHSTORE";
+    std::unique_ptr<CP::TDbiStatement> stmtDb(cascader.CreateStatement(0));
+    if (! stmtDb.get()) {
+        CaptError("ERROR: Cannot connect to " << url);
+        return 1;
+    }
+    stmtDb->ExecuteUpdate(("drop table if exists " + tableName).c_str());
+    stmtDb->ExecuteUpdate(("drop table if exists " + tableName + "VLD").c_str());
+    stmtDb->ExecuteUpdate(("create table " + tableName + " ("
+                           "  SEQNO integer not null,"
+                           "  ROW_COUNTER integer not null,"
+                           "  E_CHAN_ID integer,"
+                           "  I_PARM1 integer,"
+                           "  F_PARM1 float,"
+                           "  F_PARM2 float,"
+                           "  primary key(SEQNO,ROW_COUNTER))").c_str());
+    stmtDb->ExecuteUpdate(TDbi::GetVldDescr(tableName.c_str()).c_str());
+    if (stmtDb->PrintExceptions()) {
+        CaptError("ERROR: Cannot create " << tableName << " in " << url);
+        return 1;
+    }
+    cascader.GetConnection(0)->SetTableExists(tableName);
+    cascader.GetConnection(0)->SetTableExists(tableName + "VLD");
+
+    // Write the packets to an update file.
+    std::string updateFile = scratch.str() + ".update";
+    {
+        std::ofstream os(updateFile.c_str());
+        for (Int_t packet = 1; packet <= numPackets; ++packet) {
+            os << ">>>>>" << tableName << "  " << packet << std::endl;
+            os << "INSERT INTO " << tableName << "VLD VALUES (" << packet
+               << ",'2009-01-01 00:00:00','2038-01-01 00:00:00',0,0,1,1,0,"
+               << packet << ",'2009-01-01 00:00:00','2009-01-01 00:00:00');"
+               << std::endl;
+            for (Int_t row = 1; row <= numRows; ++row) {
+                os << "INSERT INTO " << tableName << " VALUES (" << packet
+                   << "," << row << "," << 1000000 + row << "," << row % 64
+                   << "," << 0.001*row << "," << 1.5 << ");" << std::endl;
+            }
+            os << "<<<<<" << tableName << "  " << packet << std::endl;
+        }
+    }
+
+    // Store each packet in its own transaction, timing only the stores.
+    std::ifstream is(updateFile.c_str());
+    Double_t totalSecs = 0.;
+    Int_t numStored = 0;
+    ULong64_t rowsStored = 0;
+    CP::TDbiSqlValPacket packet;
+    while (packet.Fill(is)) {
+        TStopwatch timer;
+        stmtDb->StartTransaction();
+        Bool_t ok = ! stmtDb->PrintExceptions() && packet.Store(*stmtDb);
+        if (ok) {
+            stmtDb->Commit();
+            ok = ! stmtDb->PrintExceptions();
+        }
+        else {
+            stmtDb->Rollback();
+            stmtDb->PrintExceptions();
+        }
+        timer.Stop();
+        totalSecs += timer.RealTime();
+        if (! ok) {
+            CaptError("ERROR: Failed to store packet " << packet.GetSeqNo());
+            break;
+        }
+        ++numStored;
+        UInt_t rows = packet.GetNumSqlStmts() - 1;
+        rowsStored += rows;
+        std::cout << "Stored packet " << packet.GetSeqNo() << " of " << rows
+                  << " rows in " << timer.RealTime() << " secs ("
+                  << (timer.RealTime() > 0. ? rows/timer.RealTime() : 0.)
+                  << " rows/sec)" << std::endl;
+    }
+    is.close();
+
+    stmtDb->ExecuteUpdate(("drop table if exists " + tableName).c_str());
+    stmtDb->ExecuteUpdate(("drop table if exists " + tableName + "VLD").c_str());
+    stmtDb.reset();
+    gSystem->Unlink(updateFile.c_str());
+    if (url == "sqlite://" + sqliteFile) {
+        gSystem->Unlink(sqliteFile.c_str());
+    }
+
+    std::cout << "Stored " << numStored << " of " << numPackets
+              << " packets (" << rowsStored << " rows) to " << url
+              << " in " << totalSecs << " secs ("
+              << (totalSecs > 0. ? rowsStored/totalSecs : 0.) << " rows/sec)"
+              << std::endl;
+    return numStored == numPackets ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+#include <TDbiLog.hxx>
+#include "TDbiCascader.hxx"
+#include "TDbiConnection.hxx"
+#include "TDbiDatabaseManager.hxx"
+#include "Rtypes.h"
+#include "TSQLServer.h"
+#include "TSystem.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/// Standalone check of connection retry backoff, the circuit breaker and
+/// cascade failover (see TDbiConnection and TDbiCascader::GetTableDbNo).
+/// No database server is needed: one cascade entry points at a closed
+/// port on localhost and the others are SQLite files in a scratch
+/// directory.
+
+/// Invocation:
+///   check_connection_failover.exe [options]
+
+/// Options:-
+///   --port <n>        A localhost port nothing listens on (default 1).
+///   --dir <path>      Directory for the scratch SQLite files (default
+///                     the system temporary directory).
+///
+/// The circuit breaker's first cool-off is 30 secs so the check takes
+/// about 40 secs.
+///
+/// Returns 0 if every check passed.
+
+namespace {
+
+    int gNumFailed = 0;
+
+    /// Report a check and count it if it failed.
+    void Check(bool ok, const std::string& what) {
+        std::cout << (ok ? "PASS: " : "FAIL: ") << what << std::endl;
+        if (! ok) {
+            ++gNumFailed;
+        }
+    }
+
+    Double_t SecsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<Double_t>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+}
+
+int main(int argc, char** argv) {
+    CP::TDbiLog::SetDebugLevel(CP::TDbiLog::WarnLevel);
+    CP::TDbiLog::SetLogLevel(CP::TDbiLog::QuietLevel);
+
+    Int_t port = 1;
+    std::string dir = gSystem->TempDirectory();
+    for (int iarg = 1; iarg < argc; ++iarg) {
+        std::string arg(argv[iarg]);
+        if (iarg + 1 >= argc) {
+            CaptError("ERROR: Missing value for " << arg
+                      << " to check_connection_failover.exe.");
+            return 1;
+        }
+        std::string value(argv[++iarg]);
+        if      (arg == "--port") port = atoi(value.c_str());
+        else if (arg == "--dir")  dir  = value;
+        else {
+            CaptError("ERROR: Unknown option " << arg
+                      << " to check_connection_failover.exe.");
+            return 1;
+        }
+    }
+    if (port <= 0) {
+        CaptError("ERROR: Bad --port to check_connection_failover.exe.");
+        return 1;
+    }
+
+    std::ostringstream closedUrl;
+    closedUrl << "mysql://localhost:" << port << "/failover_check";
+    std::ostringstream scratch;
+    scratch << dir << "/check_connection_failover_" << gSystem->GetPid();
+    std::string scratchDir   = scratch.str();
+    std::string missingDir   = scratchDir + "/missing";
+    std::string resetFile    = missingDir + "/reset.db";
+    std::string failoverFile = scratchDir + "/failover.db";
+    if (gSystem->mkdir(scratchDir.c_str(),kTRUE) != 0) {
+        CaptError("ERROR: Cannot create " << scratchDir);
+        return 1;
+    }
+
+    // Cascade of the closed port then an SQLite file holding a table.
+    gSystem->Setenv("ENV_TSQL_URL",
+                    (closedUrl.str() + ";sqlite://" + failoverFile).c_str());
+    gSystem->Setenv("ENV_TSQL_USER","failover_check");
+    gSystem->Setenv("ENV_TSQL_PSWD","\\0");
+    TSQLServer* server = TSQLServer::Connect(("sqlite://"
+                                              + failoverFile).c_str(),"","");
+    if (! server || ! server->Exec("CREATE TABLE FAILOVERCHECK (SEQNO INT)")) {
+        CaptError("ERROR: Cannot create a table in " << failoverFile);
+        delete server;
+        return 1;
+    }
+    delete server;
+
+    CP::TDbiDatabaseManager& dbm = CP::TDbiDatabaseManager::Instance();
+    dbm.Set("ConnectionFailover=1");
+    dbm.Update();
+
+    // Backoff: three attempts wait 0.5-1 then 1-2 secs between them.
+    CP::TDbiConnection closed(closedUrl.str(),"failover_check","",3,true);
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+    Bool_t opened = closed.Open();
+    Double_t secs = SecsSince(start);
+    Check(! opened, "Connection to a closed port fails");
+    std::ostringstream backoff;
+    backoff << "Three attempts back off for 1.5 to 3 secs (took "
+            << secs << " secs)";
+    Check(secs >= 1.5 && secs < 5., backoff.str());
+
+    // Breaker trip: further opens fail at once and the entry fails over.
+    Check(closed.IsFailedOver(), "Circuit breaker trips after the attempts");
+    start = std::chrono::steady_clock::now();
+    opened = closed.Open();
+    secs = SecsSince(start);
+    std::ostringstream trip;
+    trip << "Open with the breaker tripped fails at once (took "
+         << secs << " secs)";
+    Check(! opened && secs < 0.5, trip.str());
+
+    // Failover: GetTableDbNo skips the closed entry, without waiting for
+    // it once its breaker has tripped.
+    CP::TDbiCascader& cascader = dbm.GetCascader();
+    Int_t dbNo = -1;
+    try {
+        dbNo = cascader.GetTableDbNo("FAILOVERCHECK");
+    }
+    catch (...) {
+        dbNo = -2;
+    }
+    Check(dbNo == 1, "GetTableDbNo finds the table on the next entry");
+    start = std::chrono::steady_clock::now();
+    try {
+        dbNo = cascader.GetTableDbNo("FAILOVERCHECK");
+    }
+    catch (...) {
+        dbNo = -2;
+    }
+    secs = SecsSince(start);
+    std::ostringstream skip;
+    skip << "GetTableDbNo skips the failed over entry at once (took "
+         << secs << " secs)";
+    Check(dbNo == 1 && secs < 0.5, skip.str());
+
+    // Breaker reset: an SQLite file in a missing directory cannot be
+    // opened until the directory is made; once the cool-off has passed a
+    // single attempt is made and, succeeding, resets the breaker.
+    CP::TDbiConnection resettable("sqlite://" + resetFile,"","",1,true);
+    Check(! resettable.Open() && resettable.IsFailedOver(),
+          "Circuit breaker trips for an SQLite file that cannot be made");
+    gSystem->mkdir(missingDir.c_str(),kTRUE);
+    Check(! resettable.Open(), "Breaker holds until its cool-off has passed");
+    start = std::chrono::steady_clock::now();
+    while (resettable.IsFailedOver() && SecsSince(start) < 60.) {
+        gSystem->Sleep(1000);
+    }
+    std::ostringstream coolOff;
+    coolOff << "Breaker cools off in about 30 secs (took "
+            << SecsSince(start) << " secs)";
+    Check(! resettable.IsFailedOver() && SecsSince(start) < 35., coolOff.str());
+    Check(resettable.Open() && ! resettable.IsFailedOver(),
+          "A successful open resets the breaker");
+    resettable.Close(true);
+
+    gSystem->Unlink(resetFile.c_str());
+    gSystem->Unlink(missingDir.c_str());
+    gSystem->Unlink(failoverFile.c_str());
+    gSystem->Unlink(scratchDir.c_str());
+
+    std::cout << (gNumFailed ? "FAILED " : "Passed ")
+              << "connection failover check";
+    if (gNumFailed) {
+        std::cout << " (" << gNumFailed << " failures)";
+    }
+    std::cout << std::endl;
+    return gNumFailed ? 1 : 0;
+}
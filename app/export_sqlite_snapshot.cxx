@@ -0,0 +1,116 @@
+#include <TDbiLog.hxx>
+#include "DbiSimFlag.hxx"
+#include "TDbi.hxx"
+#include "TDbiSQLiteExporter.hxx"
+#include "TVldTimeStamp.hxx"
+#include "Rtypes.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/// Standalone utility to export a snapshot of tables to an SQLite file.
+
+/// Invocation:
+///   export_sqlite_snapshot.exe [options] <file> <tableName> { <tableName> ... }
+
+/// Where:-
+///   file        in    The SQLite file to write.
+///   tableName   in    A main table to export together with its VLD table.
+///
+/// Options:-
+///   --start <datetime> --end <datetime>
+///                     Only export validities overlapping this range
+///                     e.g. --start "2010-01-01 00:00:00".
+///   --simflag <flag>  Only export validities for this SimFlag
+///                     e.g. --simflag Data.
+///   --dbno <n>        Read from this cascade entry (default: the first
+///                     holding each table).
+///   --batch <n>       Rows per SQLite transaction (default 10000).
+///   --sync            Only copy rows new or changed since the file was
+///                     last exported or synced (see TDbiSQLiteExporter).
+///
+/// Returns 0 if all tables were exported.  Jobs can then read locally
+/// by putting "sqlite://<file>" at the front of ENV_TSQL_URL.
+
+int main(int argc, char** argv) {
+    CP::TDbiLog::SetDebugLevel(CP::TDbiLog::WarnLevel);
+    CP::TDbiLog::SetLogLevel(CP::TDbiLog::QuietLevel);
+
+    std::vector<std::string> args;
+    std::string start;
+    std::string end;
+    std::string simFlag;
+    Int_t dbNo      = -1;
+    Int_t batchSize = 10000;
+    bool  sync      = false;
+    for (int iarg = 1; iarg < argc; ++iarg) {
+        std::string arg(argv[iarg]);
+        if (arg.substr(0,2) != "--") {
+            args.push_back(arg);
+            continue;
+        }
+        if (arg == "--sync") {
+            sync = true;
+            continue;
+        }
+        if (iarg + 1 >= argc) {
+            CaptError("ERROR: Missing value for " << arg
+                      << " to export_sqlite_snapshot.exe.");
+            return 1;
+        }
+        std::string value(argv[++iarg]);
+        if      (arg == "--start")   start     = value;
+        else if (arg == "--end")     end       = value;
+        else if (arg == "--simflag") simFlag   = value;
+        else if (arg == "--dbno")    dbNo      = atoi(value.c_str());
+        else if (arg == "--batch")   batchSize = atoi(value.c_str());
+        else {
+            CaptError("ERROR: Unknown option " << arg
+                      << " to export_sqlite_snapshot.exe.");
+            return 1;
+        }
+    }
+    if (args.size() < 2) {
+        CaptError("ERROR: Insufficient arguments to export_sqlite_snapshot.exe.");
+        return 1;
+    }
+
+    CP::TDbiSQLiteExporter exporter(args[0]);
+    exporter.SetDbNo(dbNo);
+    exporter.SetBatchSize(batchSize);
+    if (start != "" || end != "") {
+        Bool_t okStart = kTRUE;
+        Bool_t okEnd   = kTRUE;
+        CP::TVldTimeStamp tsStart = start == "" ? CP::TVldTimeStamp::GetBOT()
+            : TDbi::MakeTimeStamp(start,&okStart);
+        CP::TVldTimeStamp tsEnd = end == "" ? CP::TVldTimeStamp::GetEOT()
+            : TDbi::MakeTimeStamp(end,&okEnd);
+        if (! okStart || ! okEnd) {
+            CaptError("ERROR: Bad --start or --end to export_sqlite_snapshot.exe.");
+            return 1;
+        }
+        exporter.SetTimeRange(tsStart,tsEnd);
+    }
+    if (simFlag != "") {
+        CP::DbiSimFlag::SimFlag_t flag
+            = CP::DbiSimFlag::StringToEnum(simFlag.c_str());
+        if (flag == CP::DbiSimFlag::kUnknown) {
+            CaptError("ERROR: Unknown SimFlag " << simFlag
+                      << " to export_sqlite_snapshot.exe.");
+            return 1;
+        }
+        exporter.SetSimFlag(flag);
+    }
+
+    std::vector<std::string> tableNames(args.begin()+1,args.end());
+    if (sync ? ! exporter.Sync(tableNames) : ! exporter.Export(tableNames)) {
+        CaptError("ERROR: " << (sync ? "Sync of " : "Export to ") << args[0]
+                  << " incomplete.");
+        return 1;
+    }
+    std::cout << (sync ? "Synced " : "Exported ") << exporter.GetNumTables() << " tables ("
+              << exporter.GetNumRows() << " rows) to " << args[0] << std::endl;
+    return 0;
+}
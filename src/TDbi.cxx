@@ -26,15 +26,17 @@
 //
 //  Validate
 //  ConfigStream
-//  Writer
+//  AsyncResultSetHandle  UpdateApplier  ValidityIterator  Writer  WriterSession
 //  LogEntry
 //  ResultPtr
-//  SqlValPacket
+//  SqlValPacket  SQLiteExporter
 //  ValRecSet
 //  TableProxyTDbiRegistry
+//  QueryPlan
 //  TableProxy
 //  ResultAgg
 //  ValidityRecBuilder
+//  VldSnapshot
 //  ResultNonAgg
 //  Cache  DBProxy
 //  Result
@@ -44,14 +46,16 @@
 //  BinaryFile
 //  TableRow
 //  ResultSet OutRowStream
-//  RowStream
+//  RowStream  RowBuffer
 //  ConnectionMaintainer
 //  Cascader
 //  SimFlagAssociation
 //  Statement
+//  ConnectionPool
 //  Connection
+//  MetaDataCache
 //  TableMetaData
-//  RollbackDates FieldType
+//  RollbackDates FieldType TimeGateStats
 //  CP::TDbi String Services
 //  CP::TDbiAsciiDbImporter
 //  CP::TDbiAsciiTablePreparer
@@ -60,6 +64,7 @@
 //
 ///////////////////////////////////////////////////////////////////////
 
+#include <mutex>
 #include <stdio.h>
 #include <sstream>
 
@@ -79,6 +84,8 @@
 
 
 static std::map<std::string,Int_t> fgTimegateTable;
+// Guards fgTimegateTable against concurrent (asynchronous) queries.
+static std::recursive_mutex fgTimegateMutex;
 
 // Definition of member functions (alphabetical order)
 // ***************************************************
@@ -101,6 +108,8 @@ Int_t TDbi::GetTimeGate(const std::string& tableName) {
 //  The system provides a default for each table and CP::TDbiValidityRecBuilder
 //  updates it if grossly wrong.
 
+    std::lock_guard<std::recursive_mutex> lock(fgTimegateMutex);
+
     // Set default if looking up table for the first time.
     std::map<std::string,Int_t>::iterator
     tablePtr = fgTimegateTable.find(tableName);
@@ -309,6 +318,7 @@ void TDbi::SetTimeGate(const std::string& tableName, Int_t timeGate) {
 
 //  Program Notes:  See GetTimeGate.
 
+    std::lock_guard<std::recursive_mutex> lock(fgTimegateMutex);
     if (timeGate > 15 && timeGate <= 100*24*60*60) {
         fgTimegateTable[tableName] = timeGate;
         DbiDebug("Setting time gate " << timeGate
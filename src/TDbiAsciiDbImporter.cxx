@@ -10,8 +10,20 @@
 ////////////////////////////////////////////////////////////////////
 
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <TSQLServer.h>
 #include <TSQLStatement.h>
+#include "TStopwatch.h"
 #include "TSystem.h"
 #include <TUrl.h>
 
@@ -26,6 +38,151 @@ ClassImpQ(CP::TDbiAsciiDbImporter)
 //   Definition of static data members
 //   *********************************
 
+// Maximum number of parameters bound to one insert (SQLite's default
+// SQLITE_MAX_VARIABLE_NUMBER).
+static const Int_t kMaxBoundParams = 999;
+
+
+//   File static non-members functions
+//   *********************************
+
+//___________________________________________________________________
+static char Unescape(char c) {
+    // The character written as '\c' in a LOAD DATA file.
+
+    switch (c) {
+    case 'b':
+        return '\b';
+    case 'n':
+        return '\n';
+    case 'r':
+        return '\r';
+    case 't':
+        return '\t';
+    case 'Z':
+        return '\032';
+    default:
+        return c;
+    }
+}
+
+//___________________________________________________________________
+static const char* ParseField(const char* pos,
+                              const char* end,
+                              std::string& buf,
+                              Bool_t& isNull,
+                              Bool_t& endOfLine) {
+    // Parse the field starting at pos, as LOAD DATA would with
+    //   FIELDS TERMINATED BY ',' OPTIONALLY ENCLOSED BY '"'
+    // appending its value, NUL terminated, to buf.
+    //
+    // - Sets isNull if the field is an unquoted \N or NULL.
+    // - Sets endOfLine if the field is the last of its line.
+    // - Returns the position after the field's terminator.
+
+    std::string::size_type start = buf.size();
+    isNull = kFALSE;
+    if (pos < end && *pos == '"') {
+        for (++pos; pos < end; ++pos) {
+            if (*pos == '\\' && pos+1 < end) {
+                buf += Unescape(*++pos);
+            }
+            else if (*pos == '"') {
+                if (pos+1 < end && pos[1] == '"') {
+                    buf += *pos++;
+                }
+                else {
+                    ++pos;
+                    break;
+                }
+            }
+            else {
+                buf += *pos;
+            }
+        }
+        // Ignore anything between the closing quote and the terminator.
+        while (pos < end && *pos != ',' && *pos != '\n') {
+            ++pos;
+        }
+    }
+    else {
+        const char* first = pos;
+        while (pos < end && *pos != ',' && *pos != '\n') {
+            // Copy up to the next escape in one go.
+            const char* run = pos;
+            while (pos < end && *pos != ',' && *pos != '\n' && *pos != '\\') {
+                ++pos;
+            }
+            buf.append(run,pos-run);
+            if (pos < end && *pos == '\\') {
+                if (++pos < end) {
+                    buf += Unescape(*pos++);
+                }
+            }
+        }
+        // Accept DOS line ends.
+        if (pos < end && *pos == '\n' && buf.size() > start
+            && pos[-1] == '\r') {
+            buf.erase(buf.size()-1);
+        }
+        std::string::size_type len = pos - first;
+        isNull = (len == 2 && ! strncmp(first,"\\N",2))
+                 || (len == 4 && ! strncmp(first,"NULL",4));
+    }
+    endOfLine = (pos >= end || *pos == '\n');
+    if (pos < end) {
+        ++pos;
+    }
+    buf += '\0';
+    return pos;
+}
+
+//___________________________________________________________________
+static TSQLStatement* PrepareInsert(TSQLServer* server,
+                                    const TString& table,
+                                    Int_t numCols,
+                                    Int_t numRows) {
+    // Prepare an insert of numRows rows of numCols parameters.
+
+    std::string placeholders("(");
+    for (Int_t col = 0; col < numCols; ++col) {
+        placeholders += col ? ",?" : "?";
+    }
+    placeholders += ")";
+    std::string sql("INSERT INTO ");
+    sql += table.Data();
+    sql += " VALUES ";
+    for (Int_t row = 0; row < numRows; ++row) {
+        sql += row ? "," : "";
+        sql += placeholders;
+    }
+    TSQLStatement* stmt = server->Statement(sql.c_str());
+    if (stmt) {
+        stmt->EnableErrorOutput(false);
+    }
+    return stmt;
+}
+
+//___________________________________________________________________
+static Bool_t BindBlock(TSQLStatement& stmt,
+                        const std::string& block,
+                        const std::vector<Int_t>& fields) {
+    // Bind one iteration of stmt from the NUL terminated values in block
+    // at the offsets in fields (-1 for NULL).
+
+    Bool_t ok = stmt.NextIteration();
+    for (UInt_t param = 0; ok && param < fields.size(); ++param) {
+        if (fields[param] < 0) {
+            ok = stmt.SetNull(param);
+        }
+        else {
+            const char* value = block.data() + fields[param];
+            ok = stmt.SetString(param,value,strlen(value)+1);
+        }
+    }
+    return ok;
+}
+
 
 //    Definition of all member functions (static or otherwise)
 //    *******************************************************
@@ -64,6 +221,116 @@ CP::TDbiAsciiDbImporter::~TDbiAsciiDbImporter() {
     fTablePreparer = 0;
 }
 
+//___________________________________________________________________
+Bool_t CP::TDbiAsciiDbImporter::InsertRows(const TString& table,
+                                           const char* begin,
+                                           const char* end,
+                                           Int_t numCols,
+                                           Int_t skipLines,
+                                           ULong64_t& numRows) {
+    // Insert the CSV rows held in [begin,end) into table.
+    //
+    // - Skips the first skipLines lines and any empty lines.
+    // - Rows are parsed into a single buffer, reused for every block of
+    //   rows, and bound as one iteration of an insert of as many rows as
+    //   kMaxBoundParams allows.
+    // - Like LOAD DATA, missing trailing values are inserted as empty
+    //   strings and extra ones ignored, with a warning.
+    // - Returns kTRUE if all rows were inserted; the caller owns the
+    //   transaction.
+
+    numRows = 0;
+    if (numCols <= 0) {
+        fExceptionLog.AddEntry(std::string("No columns for table ")
+                               + table.Data());
+        return kFALSE;
+    }
+
+    const char* pos = begin;
+    for (Int_t line = 0; line < skipLines && pos < end; ++line) {
+        const char* eol = static_cast<const char*>(memchr(pos,'\n',end-pos));
+        pos = eol ? eol+1 : end;
+    }
+
+    Int_t rowsPerStmt = std::max(1,kMaxBoundParams/numCols);
+    std::string block;
+    std::vector<Int_t> fields;
+    fields.reserve(rowsPerStmt*numCols);
+    TSQLStatement* stmt = 0;
+    Int_t blockRows = 0;
+    UInt_t numBadRows = 0;
+    Bool_t ok = kTRUE;
+
+    while (ok && pos < end) {
+        if (*pos == '\n' || (*pos == '\r' && pos+1 < end && pos[1] == '\n')) {
+            pos += (*pos == '\n') ? 1 : 2;
+            continue;
+        }
+        Int_t col = 0;
+        Bool_t endOfLine = kFALSE;
+        while (! endOfLine) {
+            std::string::size_type offset = block.size();
+            Bool_t isNull = kFALSE;
+            pos = ParseField(pos,end,block,isNull,endOfLine);
+            if (col < numCols) {
+                fields.push_back(isNull ? -1 : static_cast<Int_t>(offset));
+            }
+            else {
+                block.resize(offset);
+            }
+            ++col;
+        }
+        if (col != numCols) {
+            ++numBadRows;
+        }
+        for (; col < numCols; ++col) {
+            fields.push_back(static_cast<Int_t>(block.size()));
+            block += '\0';
+        }
+        ++numRows;
+        if (++blockRows == rowsPerStmt) {
+            if (! stmt) {
+                stmt = PrepareInsert(fServer,table,numCols,rowsPerStmt);
+                if (! stmt) {
+                    fExceptionLog.AddEntry(*fServer);
+                    return kFALSE;
+                }
+            }
+            ok = BindBlock(*stmt,block,fields);
+            block.clear();
+            fields.clear();
+            blockRows = 0;
+        }
+    }
+
+    if (stmt) {
+        ok = ok && stmt->Process();
+        if (! ok) {
+            fExceptionLog.AddEntry(*stmt);
+        }
+        delete stmt;
+        stmt = 0;
+    }
+    if (ok && blockRows) {
+        stmt = PrepareInsert(fServer,table,numCols,blockRows);
+        if (! stmt) {
+            fExceptionLog.AddEntry(*fServer);
+            return kFALSE;
+        }
+        ok = BindBlock(*stmt,block,fields) && stmt->Process();
+        if (! ok) {
+            fExceptionLog.AddEntry(*stmt);
+        }
+        delete stmt;
+    }
+
+    if (numBadRows) {
+        DbiWarn(numBadRows << " rows of " << table << " did not have "
+                << numCols << " values" << "  ");
+    }
+    return ok;
+}
+
 //___________________________________________________________________
 void CP::TDbiAsciiDbImporter::LoadTable(const TString& url) {
     //
@@ -103,6 +370,22 @@ void CP::TDbiAsciiDbImporter::LoadTable(const TString& url) {
         return;
     }
 
+    // LOAD DATA is MySQL only; other servers, e.g. SQLite, are filled
+    // from the file here.
+    if (std::string(fServer->GetDBMS()) != "MySQL") {
+        if (! this->LoadTableNative(table,file,
+                                    fTablePreparer->GetNumColumns(),
+                                    fTablePreparer->GetSkipLines())) {
+            delete fTablePreparer;
+            fTablePreparer = 0;
+            fStatus = HTTP_NOT_ACCEPTABLE;
+            return;
+        }
+        fImportedTableNames.push_back(table.Data());
+        fStatus = HTTP_OK;
+        return;
+    }
+
     query =  "LOAD DATA ";
     query += fTablePreparer->GetLocal() + " INFILE '";
     query += file;
@@ -185,6 +468,81 @@ void CP::TDbiAsciiDbImporter::LoadCatalog(const TString& url) {
     return;
 }
 
+//___________________________________________________________________
+Bool_t CP::TDbiAsciiDbImporter::LoadTableNative(const TString& table,
+                                                const TString& file,
+                                                Int_t numCols,
+                                                Int_t skipLines) {
+    // Fill table from file in a single transaction, for servers without
+    // LOAD DATA.
+    //
+    // - The file is memory mapped, or read into memory if it cannot be,
+    //   and parsed in place by InsertRows.
+    // - Returns kTRUE if all rows were inserted, otherwise rolls back and
+    //   records the failure in the exception log.
+
+    DbiLog("Filling table " << table << " from " << file << "  ");
+
+    int fd = open(file.Data(),O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd,&st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        fExceptionLog.AddEntry(std::string("Unable to open ") + file.Data());
+        return kFALSE;
+    }
+    size_t size = st.st_size;
+    void* map = MAP_FAILED;
+    if (size > 0) {
+        map = mmap(0,size,PROT_READ,MAP_PRIVATE,fd,0);
+    }
+    close(fd);
+
+    std::string contents;
+    const char* data = 0;
+    if (map != MAP_FAILED) {
+        madvise(map,size,MADV_SEQUENTIAL);
+        data = static_cast<const char*>(map);
+    }
+    else if (size > 0) {
+        std::ifstream in(file.Data(),std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in),
+                        std::istreambuf_iterator<char>());
+        data = contents.data();
+        size = contents.size();
+    }
+
+    TStopwatch timer;
+    ULong64_t numRows = 0;
+    fServer->StartTransaction();
+    Bool_t ok = this->InsertRows(table,data,data+size,numCols,skipLines,
+                                 numRows);
+    if (ok) {
+        ok = fServer->Commit();
+        if (! ok) {
+            fExceptionLog.AddEntry(*fServer);
+        }
+    }
+    else {
+        fServer->Rollback();
+    }
+
+    if (map != MAP_FAILED) {
+        munmap(map,size);
+    }
+
+    if (! ok) {
+        DbiSevere("Failed to fill table " << table << " from " << file
+                  << "; rolled back" << "  ");
+        return kFALSE;
+    }
+    Double_t secs = timer.RealTime();
+    DbiLog("Filled table " << table << " with " << numRows << " rows in "
+           << secs << " secs" << "  ");
+    return kTRUE;
+}
+
 //___________________________________________________________________
 Int_t CP::TDbiAsciiDbImporter::Import(const TString& url,TSQLServer* server) {
     // import data from url to server
@@ -15,6 +15,14 @@
  * <b>Purpose</b> To prepare a temporary (process specific) ASCII database.
  *
  *
+ * <b>Usage Notes</b> Each table is created as a temporary table and filled
+ *  from the CSV file prepared by TDbiAsciiTablePreparer.  MySQL servers
+ *  load the file with LOAD DATA.  Other servers, e.g. SQLite, cannot, so
+ *  the file is memory mapped and parsed here, with the same quoting and
+ *  escape rules, and the rows inserted by prepared multi-row inserts, all
+ *  in a single transaction per table.
+ *
+ *
  * <b>Acknowledgments</b> The code is essentially a translation of
  *    RDBC/TSQLImporter by Valeriy Onuchin 21/03/2001
  *
@@ -54,8 +62,18 @@ namespace CP {
 
 
     private:
+        Bool_t InsertRows(const TString& table,
+                          const char* begin,
+                          const char* end,
+                          Int_t numCols,
+                          Int_t skipLines,
+                          ULong64_t& numRows);
         void  LoadCatalog(const TString& url);
         void  LoadTable(const TString& url);
+        Bool_t LoadTableNative(const TString& table,
+                               const TString& file,
+                               Int_t numCols,
+                               Int_t skipLines);
 
 
         /// Status of import procedure, fStatus < 400 status is OK
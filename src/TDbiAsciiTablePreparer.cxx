@@ -121,6 +121,7 @@ CP::TDbiAsciiTablePreparer::TDbiAsciiTablePreparer(const TString& url) {
     }
 
     fSkipLines = 1; // default , first line is a header describes the columns
+    fNumColumns = 0;
 
     this->Init();
 }
@@ -265,6 +266,7 @@ Int_t CP::TDbiAsciiTablePreparer::Init() {
     }
 
     ncols++;
+    fNumColumns = ncols;
     tmp = Validate(str(k+(ncols>1),str.Length())); // the rest of string
 
     wrongFormat = wrongFormat || (tmp=="wrong format");
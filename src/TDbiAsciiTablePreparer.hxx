@@ -54,6 +54,9 @@ namespace CP {
         TString GetLocalFile() const {
             return fLocalFile;
         }
+        Int_t GetNumColumns() const {
+            return fNumColumns;
+        }
         Int_t GetSkipLines() const {
             return fSkipLines;
         }
@@ -97,6 +100,9 @@ namespace CP {
 /// number of lines to skip
         Int_t    fSkipLines;
 
+/// number of columns
+        Int_t    fNumColumns;
+
         ClassDef(TDbiAsciiTablePreparer,0)// Class used to prepare a table for a temporary ASCII database
     };
 };
@@ -0,0 +1,131 @@
+#ifndef DBIASYNCRESULTSETHANDLE_H
+#define DBIASYNCRESULTSETHANDLE_H
+
+/**
+ *
+ * \class CP::TDbiAsyncResultSetHandle
+ *
+ *
+ * \brief
+ * <b>Concept</b>  Templated handle to a TDbiResultSetHandle whose query
+ *  runs on a separate thread.
+ *
+ * \brief
+ * <b>Purpose</b> To overlap the queries of several tables needed for
+ *  the same context, rather than paying their round trips one after
+ *  another.
+ *
+ * \brief
+ * <b>Usage Notes</b>
+ *
+ *  CP::TDbiAsyncResultSetHandle<CP::TDemo_DB_Table> rsA(vc);
+ *  CP::TDbiAsyncResultSetHandle<CP::TOther_DB_Table> rsB(vc);
+ *  // ... other work ...
+ *  const CP::TDbiResultSetHandle<CP::TDemo_DB_Table>& a = rsA.Wait();
+ *  for (UInt_t row = 0; row < a.GetNumRows(); ++row) ...
+ *
+ *  The query starts when the handle is constructed.  IsReady tests for
+ *  completion without blocking, Wait blocks until complete and returns
+ *  the underlying TDbiResultSetHandle.  If the abort test fails, or the
+ *  query throws, the exception is rethrown by Wait.
+ *
+ *  Queries on different tables run concurrently, each on its own pooled
+ *  connection, so TDbiDatabaseManager should be configured with
+ *  ConnectionPoolSize > 1; with a pool of 1 they are still correct but
+ *  take turns on the single connection, each waiting until the previous
+ *  query has returned it (see TDbiConnectionPool::Checkout).  Queries on the same table are
+ *  serialised (see TDbiTableProxy::GetQueryMutex).  Handles should be
+ *  created and destroyed on one thread.
+ *
+ *  Like TDbiWriter, the implementation is in TDbiAsyncResultSetHandle.tpl
+ *  which must be included where the handle is instantiated, alongside an
+ *  instantiation of TDbiResultSetHandle<T>.
+ *
+ */
+
+#include <string>
+#ifndef __CINT__
+#include <future>
+#endif
+
+#include "TDbi.hxx"
+#include "TDbiResultSetHandle.hxx"
+#include "TVldContext.hxx"
+
+namespace CP {
+    class TDbiResultSet;
+    class TDbiTableProxy;
+}
+
+namespace CP {
+    template <class T> class TDbiAsyncResultSetHandle {
+
+    public:
+
+// Constructors and destructors.
+        TDbiAsyncResultSetHandle(const CP::TVldContext& vc,
+                                 TDbi::Task task = TDbi::kDefaultTask,
+                                 TDbi::AbortTest abortTest = TDbi::kTableMissing,
+                                 Bool_t findFullTimeWindow = true);
+        TDbiAsyncResultSetHandle(const std::string& tableName,
+                                 const CP::TVldContext& vc,
+                                 TDbi::Task task = TDbi::kDefaultTask,
+                                 TDbi::AbortTest abortTest = TDbi::kTableMissing,
+                                 Bool_t findFullTimeWindow = true);
+        virtual ~TDbiAsyncResultSetHandle();
+
+// State testing member functions
+
+/// True if the query has completed (never blocks).
+        Bool_t IsReady() const;
+        TDbiTableProxy& TableProxy() const {
+            return fTableProxy;
+        }
+
+// State changing member functions
+
+/// Wait for the query to complete and return its result.  Rethrows any
+/// exception, including CP::EQueryFailed if the abort test failed.
+        const TDbiResultSetHandle<T>& Wait();
+
+    private:
+
+// Disabled (not implemented) copy constructor and asignment.
+
+        TDbiAsyncResultSetHandle(const TDbiAsyncResultSetHandle&);
+        TDbiAsyncResultSetHandle& operator=(const TDbiAsyncResultSetHandle&);
+
+        void Start(const CP::TVldContext& vc,
+                   TDbi::Task task,
+                   TDbi::AbortTest abortTest,
+                   Bool_t findFullTimeWindow);
+
+// Data members
+
+/// Table name (empty for default).
+        std::string fTableName;
+
+/// Proxy for the table.
+        TDbiTableProxy& fTableProxy;
+
+/// Context of the query.
+        CP::TVldContext fContext;
+
+/// Test which if failed makes Wait throw.
+        TDbi::AbortTest fAbortTest;
+
+/// Owned result handle, available once Wait has returned.
+        TDbiResultSetHandle<T>* fHandle;
+
+#ifndef __CINT__
+/// Result, Connect()ed for this handle, being found on the query thread.
+        std::future<const TDbiResultSet*> fFuture;
+#endif
+
+        ClassDefT(TDbiAsyncResultSetHandle<T>,0)  // Asynchronous ResultHandle.
+
+    };
+};
+ClassDefT2(TDbiAsyncResultSetHandle,T)
+
+#endif  // DBIASYNCRESULTSETHANDLE_H
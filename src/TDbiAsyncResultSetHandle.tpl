@@ -0,0 +1,194 @@
+
+#include "TDbiAsyncResultSetHandle.hxx"
+#include "TDbiDatabaseManager.hxx"
+#include "TDbiResultSet.hxx"
+#include "TDbiTableProxy.hxx"
+#include "TDbiLog.hxx"
+#include "MsgFormat.hxx"
+
+#include <chrono>
+
+ClassImpT(CP::TDbiAsyncResultSetHandle,T)
+
+//    Definition of all member functions (static or otherwise)
+//    *******************************************************
+//
+//    -  ordered: ctors, dtor, operators then in alphabetical order.
+
+//.....................................................................
+
+template<class T>
+CP::TDbiAsyncResultSetHandle<T>::TDbiAsyncResultSetHandle(
+    const CP::TVldContext& vc,
+    TDbi::Task task,
+    TDbi::AbortTest abortTest,
+    Bool_t findFullTimeWindow) :
+    fTableProxy(CP::TDbiResultSetHandle<T>::GetTableProxy()),
+    fContext(vc),
+    fAbortTest(abortTest),
+    fHandle(0)
+{
+//
+//  Purpose:  Start context specific query of default table.
+//
+//  Arguments:
+//    vc           in    The Validity Context of the query
+//    task         in    The task of the query
+//    abortTest    in    Test which if failed makes Wait throw.
+//    findFullTimeWindow
+//                 in    Attempt to find full validity of query
+//                        i.e. beyond TDbi::GetTimeGate
+
+    this->Start(vc,task,abortTest,findFullTimeWindow);
+
+}
+
+//.....................................................................
+
+template<class T>
+CP::TDbiAsyncResultSetHandle<T>::TDbiAsyncResultSetHandle(
+    const std::string& tableName,
+    const CP::TVldContext& vc,
+    TDbi::Task task,
+    TDbi::AbortTest abortTest,
+    Bool_t findFullTimeWindow) :
+    fTableName(tableName),
+    fTableProxy(CP::TDbiResultSetHandle<T>::GetTableProxy(tableName)),
+    fContext(vc),
+    fAbortTest(abortTest),
+    fHandle(0)
+{
+//
+//  Purpose:  Start context specific query of alternative table.
+//
+//  Arguments:
+//    tableName    in    Name of table to use.
+//    vc           in    The Validity Context of the query
+//    task         in    The task of the query
+//    abortTest    in    Test which if failed makes Wait throw.
+//    findFullTimeWindow
+//                 in    Attempt to find full validity of query
+//                        i.e. beyond TDbi::GetTimeGate
+
+    this->Start(vc,task,abortTest,findFullTimeWindow);
+
+}
+
+//.....................................................................
+
+template<class T>
+CP::TDbiAsyncResultSetHandle<T>::~TDbiAsyncResultSetHandle() {
+//
+//
+//  Purpose: Destructor
+//
+//  Specification:-
+//  =============
+//
+//  o Wait for any outstanding query, discarding its exception if it
+//    failed, and release the result.
+
+    DbiTrace("Destroying CP::TDbiAsyncResultSetHandle for "
+             << fTableProxy.GetTableName() << "  ");
+
+    if (fFuture.valid()) {
+        try {
+            const CP::TDbiResultSet* result = fFuture.get();
+            if (result && CP::TDbiDatabaseManager::IsActive()) {
+                std::lock_guard<std::recursive_mutex>
+                    lock(fTableProxy.GetQueryMutex());
+                result->Disconnect();
+            }
+        }
+        catch (...) {
+        }
+    }
+    delete fHandle;
+    fHandle = 0;
+
+}
+
+//.....................................................................
+
+template<class T>
+Bool_t CP::TDbiAsyncResultSetHandle<T>::IsReady() const {
+//
+//
+//  Purpose:  Return kTRUE if the query has completed.
+
+    return ! fFuture.valid()
+        || fFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+
+}
+
+//.....................................................................
+
+template<class T>
+void CP::TDbiAsyncResultSetHandle<T>::Start(const CP::TVldContext& vc,
+                                            TDbi::Task task,
+                                            TDbi::AbortTest abortTest,
+                                            Bool_t findFullTimeWindow) {
+//
+//
+//  Purpose:  Launch the query thread.
+//
+//  Program Notes:-
+//  =============
+//
+//  The table proxy was found on this thread, by the constructor, so the
+//  query thread only queries through it, holding the proxy's query lock
+//  while it queries and connects to the result.  It does not touch the
+//  proxy maps of TDbiResultSetHandle or TDbiDatabaseManager, which this
+//  thread may be updating for the next handle.  The result handle is
+//  made by Wait.
+
+    DbiTrace("Starting asynchronous query of " << fTableProxy.GetTableName()
+             << " for " << vc << " task " << task << "  ");
+
+    if (! CP::TDbiDatabaseManager::IsActive()) {
+        fHandle = new CP::TDbiResultSetHandle<T>(fTableProxy,vc,0,abortTest);
+        return;
+    }
+
+    CP::TDbiTableProxy* proxy = &fTableProxy;
+    fFuture = std::async(std::launch::async,
+                         [proxy,vc,task,findFullTimeWindow] {
+                             std::lock_guard<std::recursive_mutex>
+                                 lock(proxy->GetQueryMutex());
+                             const CP::TDbiResultSet* result
+                                 = proxy->Query(vc,task,findFullTimeWindow);
+                             result->Connect();
+                             return result;
+                         });
+
+}
+
+//.....................................................................
+
+template<class T>
+const CP::TDbiResultSetHandle<T>& CP::TDbiAsyncResultSetHandle<T>::Wait() {
+//
+//
+//  Purpose:  Wait for the query to complete.
+//
+//  Return:   The result handle.  Valid for the life of this object.
+//
+//  Exceptions:  Any thrown by the query, e.g. CP::EQueryFailed if the
+//               abort test failed.  Subsequent calls throw
+//               CP::EQueryFailed.
+
+    if (fFuture.valid()) {
+        const CP::TDbiResultSet* result = fFuture.get();
+        fHandle = new CP::TDbiResultSetHandle<T>(fTableProxy,fContext,result,
+                                                 fAbortTest);
+        DbiTrace("Completed asynchronous query of "
+                 << fTableProxy.GetTableName() << " found "
+                 << fHandle->GetNumRows() << " rows" << "  ");
+    }
+    if (! fHandle) {
+        throw CP::EQueryFailed();
+    }
+    return *fHandle;
+
+}
+
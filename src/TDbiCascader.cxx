@@ -1,6 +1,9 @@
+#include <chrono>
 #include <cstdlib>
+#include <ctime>
 #include <memory>
 #include <sstream>
+#include <thread>
 
 #include "TList.h"
 #include "TROOT.h"
@@ -9,6 +12,8 @@
 
 #include "TDbi.hxx"
 #include "TDbiCascader.hxx"
+#include "TDbiConnectionPool.hxx"
+#include "TDbiServices.hxx"
 #include "TDbiString.hxx"
 #include <TDbiLog.hxx>
 #include <MsgFormat.hxx>
@@ -21,6 +26,19 @@ ClassImp(CP::TDbiCascader)
 //   *********************************
 
 
+//   File scope functions
+//   ********************
+
+namespace {
+
+//  Return milliseconds elapsed since start.
+    Double_t MSecsSince(const std::chrono::steady_clock::time_point& start) {
+        return std::chrono::duration<Double_t,std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+}
+
 //    Definition of all member functions (static or otherwise)
 //    *******************************************************
 //
@@ -32,6 +50,7 @@ ClassImp(CP::TDbiCascader)
 ///  Purpose:  Default constructor
 ///
 ///  Arguments: beQuiet - If true, fail quietly. If not be more verbose.
+///             eager   - If true open all entries now (concurrently).
 ///
 ///  Return:    n/a
 ///
@@ -45,6 +64,9 @@ ClassImp(CP::TDbiCascader)
 ///  o  Create Cascader (set up its connections according to values from
 ///     ENV_TSQL_* environment variables).
 ///
+///  o  Unless eager, leave each connection unopened until the entry is
+///     first used (see InitEntry).
+///
 ///  o  If ENV_TSQL_TMP_TBLS is set, call ProcessTmpTblsFile() to initialize
 ///     Temporary Tables on one of the connections in the cascade.
 ///
@@ -64,9 +86,15 @@ ClassImp(CP::TDbiCascader)
 ///    or the _UPDATE alternatives e.g. ENV_TSQL_UPDATE_USER
 ///
 /// The _UPDATE versions take priority.
+///
+/// The time taken by each stage of startup is reported at Debug level.
 ///\endverbatim
-CP::TDbiCascader::TDbiCascader(bool beQuiet):
-    fTempCon(-1), fGlobalSeqNoDbNo(-1) {
+CP::TDbiCascader::TDbiCascader(bool beQuiet, bool eager):
+    fBeQuiet(beQuiet), fTempCon(-1), fGlobalSeqNoDbNo(-1),
+    fReaperStop(kFALSE) {
+
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
 
     // Extract args from  ENV_TSQL environmental variables
     const char* strUser = gSystem->Getenv("ENV_TSQL_UPDATE_USER");
@@ -128,59 +156,31 @@ CP::TDbiCascader::TDbiCascader(bool beQuiet):
 
         CP::TDbiConnection* con;
         // If we are testing the cascade for validity, just try connecting
-        // once, otherwise use defaults.
+        // once, otherwise use defaults.  Opening is deferred to InitEntry.
         if (!beQuiet) {
-            con  = new CP::TDbiConnection(url,user,pswd,1);
+            con  = new CP::TDbiConnection(url,user,pswd,1,true);
         }
         else {
-            con  = new CP::TDbiConnection(url,user,pswd);
+            con  = new CP::TDbiConnection(url,user,pswd,20,true);
         }
 
         fConnections.push_back(con);
-        if (! con->Open()) {
-            fail = true;
-            continue;
+        fEntryState.emplace_back(kEntryUnopened);
+        fEntryMutex.emplace_back();
+        fPools.push_back(new CP::TDbiConnectionPool(con));
+        // ASCII databases are populated per connection so cannot be pooled.
+        if (con->IsAsciiDb()) {
+            fPools.back()->SetPinned();
         }
+    }
 
-        //  Attempt to locate first GlobalSeqNo/GLOBALSEQNO table.
-        if (fGlobalSeqNoDbNo != -1) {
-            continue;
-        }
-        std::unique_ptr<CP::TDbiStatement>  stmtDb(new CP::TDbiStatement(*con));
-        if (! stmtDb.get()) {
-            continue;
-        }
-        TSQLStatement* stmt = stmtDb->ExecuteQuery(
-            "Select * from GLOBALSEQNO where 1=0");
-        if (stmt) {
-            fGlobalSeqNoDbNo = fConnections.size()-1;
-            delete stmt;
-            stmt = 0;
-        }
-
-        //  Check for presence of a DBI_STATE_FLAG table
-
-        if (this->GetTableDbNo("DBI_STATE_FLAGS",entry) != -1) {
-            if (!beQuiet) {
-                DbiSevere(
-                    "  POSSIBLE VERSION SHEAR DETECTED"
-                    << std::endl
-                    << "    The DBI_STATE_FLAGS table is present"
-                    << " on cascade entry " << entry << ".  This table will"
-                    << std::endl
-                    << "    only be introduced to manage backward"
-                    << " incompatible changes that could lead"
-                    << "    to version shear between the code and the database."
-                    << "  This version of the"
-                    << std::endl
-                    << "    code does not support the change the"
-                    << " presence of that table indicates"
-                    << "    so has to shut down." 
-                    << std::endl);
-            }
-            fail = true;
-        }
+    Double_t setupTime = MSecsSince(start);
+    // With failover the job carries on without the entries that failed.
+    if (eager && ! this->OpenAll()
+        && ! CP::TDbiServices::ConnectionFailover()) {
+        fail = true;
     }
+    Double_t openTime = MSecsSince(start) - setupTime;
 
     DbiInfo(*this);
 
@@ -198,6 +198,13 @@ CP::TDbiCascader::TDbiCascader(bool beQuiet):
             fail = true;
         }
     }
+    Double_t totalTime = MSecsSince(start);
+
+    DbiDebug("Cascader startup took " << totalTime << " ms: setup "
+             << setupTime << " ms, "
+             << (eager ? "opening " : "opening deferred ") << openTime
+             << " ms, temporary tables "
+             << totalTime - setupTime - openTime << " ms" << "  ");
 
     //  Abort, if there have been any failures.
     if (fail) {
@@ -217,7 +224,17 @@ CP::TDbiCascader::~TDbiCascader() {
 
     DbiTrace("Destroying CP::TDbiCascader" << "  ");
 
+    {
+        std::lock_guard<std::mutex> lock(fReaperMutex);
+        fReaperStop = kTRUE;
+    }
+    fReaperWake.notify_all();
+    if (fReaper.joinable()) {
+        fReaper.join();
+    }
+
     for (Int_t dbNo = this->GetNumDb()-1; dbNo >= 0; --dbNo) {
+        delete fPools[dbNo];
         delete fConnections[dbNo];
     }
 
@@ -257,7 +274,8 @@ std::ostream& CP::operator<<(std::ostream& os,
     for (Int_t dbNo = 0; dbNo < maxDb; ++dbNo)
         os << cascader.GetStatusAsString(dbNo) << " "
            << ((dbNo == cascader.fGlobalSeqNoDbNo) ? "(auth)  " : "        ")
-           << cascader.GetURL(dbNo) << std::endl;
+           << cascader.GetURL(dbNo) << "  "
+           << *cascader.fPools[dbNo] << std::endl;
     os << std::endl;
     return os;
 
@@ -266,7 +284,7 @@ bool CP::TDbiCascader::canConnect() {
     DbiTrace(" bool CP::TDbiCascader::canConnect() started");
 
     try {
-        CP::TDbiCascader test(false);
+        CP::TDbiCascader test(false,true);
         //   test.NOOP();
         DbiTrace(" bool CP::TDbiCascader::canConnect() return true");
         return true;
@@ -291,8 +309,11 @@ bool CP::TDbiCascader::canConnect() {
 ///                           < 0  Must be local
 ///   dbNo            in     The entry in the cascade for which the SEQNO
 ///                          is required
+///   count           in     The number of consecutive SEQNOs to reserve
+///                          (default 1).
 ///
-///  Return:    The allocated SEQNO or 0 if failure.
+///  Return:    The allocated SEQNO, or the first of the block of count,
+///             or 0 if failure.
 ///
 ///  Contact:   N. West
 ///
@@ -309,15 +330,17 @@ bool CP::TDbiCascader::canConnect() {
 ///\endverbatim
 Int_t CP::TDbiCascader::AllocateSeqNo(const std::string& tableName,
                                       Int_t requireGlobal, /* =0 */
-                                      Int_t dbNo  /* = 0 */) const {
+                                      Int_t dbNo,  /* = 0 */
+                                      UInt_t count /* = 1 */) const {
 
     bool isTemporary = IsTemporaryTable(tableName,dbNo);
+    Int_t globalSeqNoDbNo = this->GetAuthorisingDbNo();
 
     //  Deal with global requests.
 
     if (requireGlobal > 0
-        || (requireGlobal == 0 && dbNo == fGlobalSeqNoDbNo && ! isTemporary)) {
-        if (fGlobalSeqNoDbNo < 0) {
+        || (requireGlobal == 0 && dbNo == globalSeqNoDbNo && ! isTemporary)) {
+        if (globalSeqNoDbNo < 0) {
             DbiWarn("Unable to issue global SEQNO"
                     << " - no authorising DB in cascade"
                     << std::endl
@@ -330,13 +353,89 @@ Int_t CP::TDbiCascader::AllocateSeqNo(const std::string& tableName,
                     << "  will issue local one instead" << "  ");
         }
         else {
-            return this->ReserveNextSeqNo(tableName,true,fGlobalSeqNoDbNo);
+            return this->ReserveNextSeqNo(tableName,true,globalSeqNoDbNo,
+                                          count);
         }
     }
 
     // Deal with local requests
 
-    return this->ReserveNextSeqNo(tableName,false,dbNo);
+    return this->ReserveNextSeqNo(tableName,false,dbNo,count);
+
+}
+
+//.....................................................................
+///\verbatim
+///
+///  Purpose:  Check a newly opened cascade entry.
+///
+///  Arguments:
+///    dbNo         in    Database number (0..GetNumDb()-1)
+///
+///  Return:    true if the entry can be used.
+///
+///  Specification:-
+///  =============
+///
+///  o  Note if the entry has a GLOBALSEQNO table and it is the first in
+///     the cascade that does.
+///
+///  o  Fail if the entry has a DBI_STATE_FLAGS table.
+///
+///  Program Notes:-
+///  =============
+///
+///  The entry's mutex must be held.  Entries may be checked concurrently
+///  so fGlobalSeqNoDbNo is only updated under fInitMutex.
+///\endverbatim
+Bool_t CP::TDbiCascader::CheckEntry(UInt_t dbNo) const {
+
+    CP::TDbiConnection* con = fConnections[dbNo];
+
+    //  Attempt to locate first GlobalSeqNo/GLOBALSEQNO table.
+    Bool_t lookForGlobal;
+    {
+        std::lock_guard<std::mutex> lock(fInitMutex);
+        lookForGlobal = fGlobalSeqNoDbNo == -1
+                        || (UInt_t) fGlobalSeqNoDbNo > dbNo;
+    }
+    if (lookForGlobal) {
+        std::unique_ptr<CP::TDbiStatement>  stmtDb(new CP::TDbiStatement(*con));
+        TSQLStatement* stmt = stmtDb->ExecuteQuery(
+            "Select * from GLOBALSEQNO where 1=0");
+        if (stmt) {
+            std::lock_guard<std::mutex> lock(fInitMutex);
+            if (fGlobalSeqNoDbNo == -1 || (UInt_t) fGlobalSeqNoDbNo > dbNo) {
+                fGlobalSeqNoDbNo = dbNo;
+            }
+            delete stmt;
+            stmt = 0;
+        }
+    }
+
+    //  Check for presence of a DBI_STATE_FLAG table
+
+    if (con->TableExists("DBI_STATE_FLAGS")) {
+        if (!fBeQuiet) {
+            DbiSevere(
+                "  POSSIBLE VERSION SHEAR DETECTED"
+                << std::endl
+                << "    The DBI_STATE_FLAGS table is present"
+                << " on cascade entry " << dbNo << ".  This table will"
+                << std::endl
+                << "    only be introduced to manage backward"
+                << " incompatible changes that could lead"
+                << "    to version shear between the code and the database."
+                << "  This version of the"
+                << std::endl
+                << "    code does not support the change the"
+                << " presence of that table indicates"
+                << "    so has to shut down." 
+                << std::endl);
+        }
+        return false;
+    }
+    return true;
 
 }
 
@@ -354,6 +453,14 @@ Int_t CP::TDbiCascader::AllocateSeqNo(const std::string& tableName,
 ///  Program Notes:-
 ///  =============
 ///
+///  The entry is opened if this is its first use (see InitEntry).
+///
+///  The statement's connection is checked out from the entry's pool and
+///  returned when the statement is deleted.  Creating a statement is also
+///  when connections left lingering (see TDbiServices::ConnectionLinger)
+///  are checked and closed once their linger time has expired; between
+///  statements the reaper thread does the same.
+///
 ///  As the caller is responsible for destroying the statement after use
 ///  consider:-
 ///
@@ -364,11 +471,13 @@ Int_t CP::TDbiCascader::AllocateSeqNo(const std::string& tableName,
 CP::TDbiStatement* CP::TDbiCascader::CreateStatement(UInt_t dbNo) const {
 
 
-    if (this->GetStatus(dbNo) == kFailed) {
+    if (! this->InitEntry(dbNo) || this->GetStatus(dbNo) == kFailed) {
         return 0;
     }
-    CP::TDbiConnection& conDb = *fConnections[dbNo];
-    CP::TDbiStatement* stmtDb = new CP::TDbiStatement(conDb);
+    this->ReapIdleConnections();
+    CP::TDbiConnectionPool* pool = fPools[dbNo];
+    CP::TDbiConnection& conDb = *pool->Checkout();
+    CP::TDbiStatement* stmtDb = new CP::TDbiStatement(conDb,pool);
     stmtDb->PrintExceptions();
     return stmtDb;
 
@@ -451,7 +560,9 @@ Int_t CP::TDbiCascader::CreateTemporaryTable(const std::string& tableNameMc,
         return -1;
     }
 
-// Make connection permanent if not already.
+// Make connection permanent if not already and pin it so that all
+// statements see the temporary table.
+    fPools[dbNoAcc]->SetPinned();
     CP::TDbiConnection& conDb = *fConnections[dbNoAcc];
     if (conDb.IsTemporary()) {
         conDb.SetPermanent();
@@ -557,8 +668,10 @@ int CP::TDbiCascader::GetTempCon() {
     if (fTempCon == -1) {
         for (unsigned int i=0; i < fConnections.size(); ++i) {
 
-            if (fConnections[i]->SupportsTmpTbls()==true) {
+            if (this->InitEntry(i)
+                && fConnections[i]->SupportsTmpTbls()==true) {
                 fTempCon = i;
+                fPools[i]->SetPinned();
                 DbiInfo("Cascader set the temporary connection"
                         << " fTempCon to dbNo " << i 
                         << " (" << fConnections[i]->GetUrl() << ").");
@@ -706,12 +819,29 @@ bool CP::TDbiCascader::ExecTmpTblsSQLStmt(int tempConDbNo,
 
 //@}
 
+///  Purpose: Return the first entry in the cascade with a GLOBALSEQNO
+///  table or -1 if none.  As entries are opened on first use, open them in
+///  turn until that entry is known.
+Int_t CP::TDbiCascader::GetAuthorisingDbNo() const {
+    for (UInt_t dbNo = 0; dbNo < this->GetNumDb(); ++dbNo) {
+        {
+            std::lock_guard<std::mutex> lock(fInitMutex);
+            if (fGlobalSeqNoDbNo >= 0 && dbNo >= (UInt_t) fGlobalSeqNoDbNo) {
+                break;
+            }
+        }
+        this->InitEntry(dbNo);
+    }
+    std::lock_guard<std::mutex> lock(fInitMutex);
+    return fGlobalSeqNoDbNo;
+}
+
 ///  Purpose: Return a connection to caller (CP::TDbiCascader retains
 ///  ownership)
 const CP::TDbiConnection* CP::TDbiCascader::GetConnection(UInt_t dbNo) const {
 
 
-    if (this->GetStatus(dbNo) == kFailed) {
+    if (! this->InitEntry(dbNo) || this->GetStatus(dbNo) == kFailed) {
         return 0;
     }
     return fConnections[dbNo];
@@ -721,7 +851,7 @@ const CP::TDbiConnection* CP::TDbiCascader::GetConnection(UInt_t dbNo) const {
 ///  Purpose: Return a connection to caller (CP::TDbiCascader retains
 ///  ownership)
 CP::TDbiConnection* CP::TDbiCascader::GetConnection(UInt_t dbNo) {
-    if (this->GetStatus(dbNo) == kFailed) {
+    if (! this->InitEntry(dbNo) || this->GetStatus(dbNo) == kFailed) {
         return 0;
     }
     return fConnections[dbNo];
@@ -757,6 +887,24 @@ Int_t CP::TDbiCascader::GetDbNo(const std::string& dbName) const {
 
 }
 
+///  Purpose:  Return the maximum size of the connection pool of a cascade
+///  entry; 1 if it is pinned (see TDbiConnectionPool), 0 if no such entry.
+UInt_t CP::TDbiCascader::GetPoolSize(UInt_t dbNo) const {
+    if (dbNo >= fPools.size()) {
+        return 0;
+    }
+    return fPools[dbNo]->IsPinned() ? 1 : fPools[dbNo]->GetMaxSize();
+}
+
+///  Purpose:  Return the Status of a cascade entry.
+Int_t CP::TDbiCascader::GetStatus(UInt_t dbNo) const {
+    if (dbNo >= GetNumDb() || ! fConnections[dbNo]
+        || fEntryState[dbNo] == kEntryFailed) {
+        return kFailed;
+    }
+    return fConnections[dbNo]->IsClosed() ? kClosed : kOpen;
+}
+
 ///  Purpose:  Return DB connection status as a string.
 ///
 ///  Arguments:
@@ -777,6 +925,8 @@ std::string CP::TDbiCascader::GetStatusAsString(UInt_t dbNo) const {
 Int_t CP::TDbiCascader::GetTableDbNo(const std::string& tableName,
                                      Int_t selectDbNo /* -1 */) const {
     // If selectDbNo >= 0 only look in this entry in the cascade.
+    // Entries that have failed over (see TDbiConnection::IsFailedOver) are
+    // skipped so read-only queries continue with the rest of the cascade.
 
     // If table name has any lower case letters then fail.
     std::string::const_iterator itr    = tableName.begin();
@@ -792,7 +942,7 @@ Int_t CP::TDbiCascader::GetTableDbNo(const std::string& tableName,
             continue;
         }
         const CP::TDbiConnection* con =  this->GetConnection(dbNoTry);
-        if (con && con->TableExists(tableName)) {
+        if (con && ! con->IsFailedOver() && con->TableExists(tableName)) {
             return dbNoTry;
         }
     }
@@ -818,10 +968,89 @@ Int_t CP::TDbiCascader::GetTableDbNo(const std::string& tableName,
 ///\endverbatim
 void CP::TDbiCascader::HoldConnections() {
     for (UInt_t dbNo = 0; dbNo < fConnections.size(); ++dbNo) {
-        fConnections[dbNo]->ConnectStatement();
+        fPools[dbNo]->Hold();
     }
 }
 
+///\verbatim
+///
+///  Purpose:  Open and check cascade entry if this is its first use.
+///
+///  Arguments:
+///    dbNo         in    Database number (0..GetNumDb()-1)
+///
+///  Return:    true if the entry is usable.
+///
+///  Throws:    CP::EBadDatabase() the first time an entry fails to open,
+///             just as the constructor does when opening all entries at
+///             startup, unless it has failed over (see below), and
+///             whenever it fails its checks.  Thereafter the entry's
+///             status is kFailed and this returns false.
+///
+///  Specification:-
+///  =============
+///
+///  o  With failover enabled (see TDbiServices::ConnectionFailover), an
+///     entry that could not be opened is left unopened and false returned,
+///     so that it is skipped until its circuit breaker resets and it is
+///     tried again.  Until then it fails without waiting.
+///
+///  o  Failing CheckEntry (e.g. version shear) is not a connectivity
+///     fault so never fails over.
+///
+///  Program Notes:-
+///  =============
+///
+///  Once an entry is ready or failed this is a single atomic load.  Only
+///  callers of the entry being opened wait for it; each entry has its own
+///  mutex.
+///\endverbatim
+Bool_t CP::TDbiCascader::InitEntry(UInt_t dbNo) const {
+
+    if (dbNo >= fEntryState.size()) {
+        return false;
+    }
+    Int_t state = fEntryState[dbNo].load(std::memory_order_acquire);
+    if (state != kEntryUnopened) {
+        return state == kEntryReady;
+    }
+    std::lock_guard<std::mutex> lock(fEntryMutex[dbNo]);
+    state = fEntryState[dbNo].load(std::memory_order_acquire);
+    if (state != kEntryUnopened) {
+        return state == kEntryReady;
+    }
+
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+    Double_t openTime = 0.;
+    if (! this->OpenEntry(dbNo,openTime)) {
+        if (fConnections[dbNo]->IsFailedOver()) {
+            DbiWarn("Unable to open cascade entry " << dbNo << " ("
+                    << fConnections[dbNo]->GetUrlString()
+                    << "); skipping it until its circuit breaker resets"
+                    << "  ");
+            return false;
+        }
+        fEntryState[dbNo].store(kEntryFailed,std::memory_order_release);
+        DbiSevere("Unable to open cascade entry " << dbNo << " ("
+                  << fConnections[dbNo]->GetUrlString() << ")" << "  ");
+        throw CP::EBadDatabase();
+    }
+    if (! this->CheckEntry(dbNo)) {
+        fEntryState[dbNo].store(kEntryFailed,std::memory_order_release);
+        DbiSevere("Cascade entry " << dbNo << " ("
+                  << fConnections[dbNo]->GetUrlString() << ") failed checks"
+                  << "  ");
+        throw CP::EBadDatabase();
+    }
+    fEntryState[dbNo].store(kEntryReady,std::memory_order_release);
+    DbiDebug("Opened cascade entry " << dbNo << " in "
+             << MSecsSince(start) << " ms (connection " << openTime
+             << " ms)" << "  ");
+    return true;
+
+}
+
 ///  Purpose:  Return kTRUE if tableName is temporary in cascade member dbNo
 Bool_t CP::TDbiCascader::IsTemporaryTable(const std::string& tableName,
                                           Int_t dbNo) const {
@@ -909,6 +1138,141 @@ void CP::TDbiCascader::Lock::SetLock(Bool_t setting) {
 
 }
 
+///\verbatim
+///
+///  Purpose:  Open all cascade entries not yet opened.
+///
+///  Return:    true if all entries are usable.
+///
+///  Throws:    CP::EBadDatabase() if any entry did (see InitEntry) once
+///             all have been tried.
+///
+///  Specification:-
+///  =============
+///
+///  o  Open and check the entries concurrently, one thread per entry
+///     (see InitEntry).
+///
+///  o  Report the time taken to open each entry at Debug level.
+///
+///  Program Notes:-
+///  =============
+///
+///  This is what the constructor does if eager.  It can also be
+///  requested through the TDbiDatabaseManager configuration key
+///  EagerConnect.  Each thread only takes its own entry's mutex, so
+///  entries already in use are not held up.
+///\endverbatim
+Bool_t CP::TDbiCascader::OpenAll() {
+
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+
+    UInt_t numDb = this->GetNumDb();
+    std::vector<Int_t> ready(numDb,0);
+    std::vector<Int_t> threw(numDb,0);
+    std::vector<std::thread> threads;
+    for (UInt_t dbNo = 0; dbNo < numDb; ++dbNo) {
+        threads.push_back(std::thread([this,dbNo,&ready,&threw]() {
+                    try {
+                        ready[dbNo] = this->InitEntry(dbNo);
+                    }
+                    catch (CP::EBadDatabase&) {
+                        threw[dbNo] = 1;
+                    }
+                }));
+    }
+    for (UInt_t thread = 0; thread < threads.size(); ++thread) {
+        threads[thread].join();
+    }
+
+    Bool_t ok = kTRUE;
+    Bool_t bad = kFALSE;
+    for (UInt_t dbNo = 0; dbNo < numDb; ++dbNo) {
+        ok  = ok && ready[dbNo];
+        bad = bad || threw[dbNo];
+    }
+    DbiDebug("Opened " << numDb << " cascade entries in "
+             << MSecsSince(start) << " ms" << "  ");
+    if (bad) {
+        throw CP::EBadDatabase();
+    }
+    return ok;
+
+}
+
+///\verbatim
+///
+///  Purpose:  Open and validate the connection of a cascade entry.
+///
+///  Arguments:
+///    dbNo         in    Database number (0..GetNumDb()-1)
+///    msecs        out   Time taken (msecs).
+///
+///  Return:    true if opened.
+///\endverbatim
+Bool_t CP::TDbiCascader::OpenEntry(UInt_t dbNo, Double_t& msecs) const {
+
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+    Bool_t ok = kTRUE;
+    try {
+        fConnections[dbNo]->Validate();
+    }
+    catch (CP::EBadConnection&) {
+        ok = kFALSE;
+    }
+    msecs = MSecsSince(start);
+    return ok;
+
+}
+
+///  Purpose: Close connections that have lingered beyond the linger time.
+///  This is only a clock read per connection unless one is due to close.
+///
+///  The first call also starts a low-frequency reaper thread (see
+///  RunReaper) so that lingering connections are closed, and their server
+///  slots freed, even if the job makes no further statements.
+void CP::TDbiCascader::ReapIdleConnections() const {
+    if (CP::TDbiServices::ConnectionLinger() <= 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(fReaperMutex);
+        if (! fReaper.joinable() && ! fReaperStop) {
+            fReaper = std::thread(&CP::TDbiCascader::RunReaper,this);
+        }
+    }
+    this->SweepIdleConnections();
+}
+
+///  Purpose: Body of the reaper thread: sweep lingering connections every
+///  half linger time (at least every second) until the cascader is
+///  destroyed.  Pools only close connections no statement holds, so
+///  this cannot close a connection in use on another thread.
+void CP::TDbiCascader::RunReaper() const {
+    std::unique_lock<std::mutex> lock(fReaperMutex);
+    while (! fReaperStop) {
+        int period = CP::TDbiServices::ConnectionLinger()/2;
+        fReaperWake.wait_for(lock,std::chrono::seconds(period > 1 ? period : 1));
+        if (fReaperStop) {
+            break;
+        }
+        lock.unlock();
+        this->SweepIdleConnections();
+        lock.lock();
+    }
+}
+
+///  Purpose: Close connections, in all pools, that have lingered beyond the
+///  linger time.
+void CP::TDbiCascader::SweepIdleConnections() const {
+    time_t now = std::time(0);
+    for (UInt_t dbNo = 0; dbNo < fPools.size(); ++dbNo) {
+        fPools[dbNo]->ReapIdle(now);
+    }
+}
+
 ///\verbatim
 ///
 ///  Purpose: Release temporary connections held open by HoldConnections.
@@ -927,8 +1291,88 @@ void CP::TDbiCascader::Lock::SetLock(Bool_t setting) {
 ///\endverbatim
 void CP::TDbiCascader::ReleaseConnections() {
     for (UInt_t dbNo = 0; dbNo < fConnections.size(); ++dbNo) {
-        fConnections[dbNo]->DisConnectStatement();
+        fPools[dbNo]->Release();
+    }
+}
+
+///\verbatim
+///
+///  Purpose:  Return the unused tail of a block of SEQNOs.
+///
+///  Arguments:
+///   tableName       in    The table for which the block was allocated.
+///   first           in    First unused SEQNO.
+///   last            in    Last SEQNO of the block.
+///   dbNo            in    The entry in the cascade for which the block
+///                         was allocated.
+///
+///  Return:    true if the SEQNO table now has first-1 as the last used.
+///
+///  Specification:-
+///  =============
+///
+///  o If no SEQNOs have been allocated for the table since the block
+///    (i.e. last is still the last used), wind the SEQNO table back so
+///    that first..last can be issued again.
+///
+///  Program Notes:-
+///  =============
+///
+///  Whether the block is global is deduced from its SEQNOs so the same
+///  SEQNO table is used as when it was allocated.
+///\endverbatim
+Bool_t CP::TDbiCascader::ReleaseSeqNos(const std::string& tableName,
+                                       Int_t first,
+                                       Int_t last,
+                                       Int_t dbNo /* = 0 */) const {
+
+    if (first <= 0 || first > last) {
+        return false;
+    }
+    Bool_t isGlobal = ! TDbi::NotGlobalSeqNo(first);
+    if (isGlobal) {
+        dbNo = this->GetAuthorisingDbNo();
+    }
+    std::string seqnoTableName = isGlobal ? "GLOBALSEQNO" : "LOCALSEQNO";
+    if (dbNo < 0 || ! this->TableExists(seqnoTableName,dbNo)) {
+        return false;
+    }
+
+    std::unique_ptr<CP::TDbiStatement> stmtDb(this->CreateStatement(dbNo));
+    if (! stmtDb.get()) {
+        return false;
     }
+    std::string dataTable;
+    if (! this->IsTemporaryTable(tableName,dbNo)
+        && this->TableExists(tableName,dbNo)) {
+        dataTable = tableName;
+    }
+    Lock lock(this->CreateStatement(dbNo),seqnoTableName,dataTable);
+    if (! lock.IsLocked()) {
+        DbiSevere("Unable to lock " << seqnoTableName << "  ");
+        return false;
+    }
+
+    // Only wind back if the block is still the last reserved.
+    CP::TDbiString sql;
+    sql << "select LASTUSEDSEQNO from " << seqnoTableName
+        << " where TABLENAME = '" << tableName << "'";
+    TSQLStatement* stmt = stmtDb->ExecuteQuery(sql.c_str());
+    stmtDb->PrintExceptions(CP::TDbiLog::DebugLevel);
+    Bool_t isLast = stmt && stmt->NextResultRow() && stmt->GetInt(0) == last;
+    delete stmt;
+    stmt = 0;
+    if (! isLast) {
+        return false;
+    }
+
+    sql.Clear();
+    sql << "update " << seqnoTableName << " set LASTUSEDSEQNO = " << first-1
+        << " where TABLENAME = '" << tableName << "'";
+    DbiLog("SEQNO release: " << sql.c_str() << "  ");
+    stmtDb->ExecuteUpdate(sql.c_str());
+    return ! stmtDb->PrintExceptions();
+
 }
 
 ///\verbatim
@@ -943,8 +1387,9 @@ void CP::TDbiCascader::ReleaseConnections() {
 ///                         = false - reserve in LOCALSEQNO table (creating if
 ///                                   required) 
 ///   dbNo            in    The entry in the cascade holding the SEQNO table.
+///   count           in    The number of consecutive SEQNOs to reserve.
 ///
-///  Return:    The allocated SEQNO or 0 if failure.
+///  Return:    The allocated SEQNO (the first if count > 1) or 0 if failure.
 ///
 ///  Contact:   N. West
 ///
@@ -952,10 +1397,16 @@ void CP::TDbiCascader::ReleaseConnections() {
 ///  =============
 ///
 ///  Requests for local SEQNOs may result in the creation of a LOCALSEQNO
-///table.  \endverbatim
+///  table.
+///
+///  The SEQNOs for a table are limited to the band of TDbi::kMAXLOCALSEQNO
+///  above the default ('*') entry; a block that would cross the top of the
+///  band fails and reserves nothing.
+///\endverbatim
 Int_t CP::TDbiCascader::ReserveNextSeqNo(const std::string& tableName,
                                          Bool_t isGlobal,
-                                         UInt_t dbNo) const {
+                                         UInt_t dbNo,
+                                         UInt_t count /* = 1 */) const {
     CP::TDbiString sql;
 
     std::string seqnoTableName = isGlobal ? "GLOBALSEQNO" : "LOCALSEQNO";
@@ -1051,12 +1502,17 @@ Int_t CP::TDbiCascader::ReserveNextSeqNo(const std::string& tableName,
     //  for each tableName/isGlobal/dbNo combination.
 
     static std::string checkedCombinations;
+    static std::mutex checkedMutex;
     std::ostringstream combination;
     combination << ":" << tableName << isGlobal << dbNo << ":";
-    bool notChecked = (checkedCombinations.find(combination.str())
-                       == std::string::npos);
-    if (notChecked) {
-        checkedCombinations += combination.str();
+    bool notChecked;
+    {
+        std::lock_guard<std::mutex> lock(checkedMutex);
+        notChecked = (checkedCombinations.find(combination.str())
+                      == std::string::npos);
+        if (notChecked) {
+            checkedCombinations += combination.str();
+        }
     }
     if (tableNameExists && notChecked) {
         Int_t seqNoMin = seqNoDefault;
@@ -1098,6 +1554,22 @@ Int_t CP::TDbiCascader::ReserveNextSeqNo(const std::string& tableName,
     }
 
 
+    //  Refuse a block that would run past the top of the band that starts
+    //  at the default SEQNO.
+    if (count == 0) {
+        count = 1;
+    }
+    Int_t seqNoLast = seqNoDefault + TDbi::kMAXLOCALSEQNO;
+    if (seqNoTable >= seqNoLast
+        || count > (UInt_t) (seqNoLast - seqNoTable)) {
+        DbiSevere("Database: " << dbNo << " unable to reserve " << count
+                  << " SEQNO(s) for table " << tableName << " in "
+                  << seqnoTableName << ": last used SEQNO " << seqNoTable
+                  << " leaves too few in the band " << seqNoDefault + 1
+                  << " to " << seqNoLast << "  ");
+        return 0;
+    }
+
     //  Update last used SeqNo and record in table.
     sql.Clear();
     sql << "delete from " << seqnoTableName << " where TABLENAME='";
@@ -1108,7 +1580,8 @@ Int_t CP::TDbiCascader::ReserveNextSeqNo(const std::string& tableName,
         return 0;
     }
 
-    seqNoTable++;
+    Int_t seqNoFirst = seqNoTable + 1;
+    seqNoTable += count;
 
     sql.Clear();
     sql << "insert into  " << seqnoTableName << " values('";
@@ -1119,7 +1592,7 @@ Int_t CP::TDbiCascader::ReserveNextSeqNo(const std::string& tableName,
         return 0;
     }
 
-    return seqNoTable;
+    return seqNoFirst;
 }
 
 ///  Purpose: Set connection permanent.
@@ -1130,3 +1603,10 @@ void CP::TDbiCascader::SetPermanent(UInt_t dbNo,
     }
 }
 
+///  Purpose: Set maximum size of all connection pools.
+void CP::TDbiCascader::SetPoolSize(UInt_t maxSize) {
+    for (UInt_t dbNo = 0; dbNo < fPools.size(); ++dbNo) {
+        fPools[dbNo]->SetMaxSize(maxSize);
+    }
+}
+
@@ -13,6 +13,10 @@
 ///   overrride parts of the standard database by introducing higher
 ///   priority non-standard ones above it in a cascade.
 ///
+/// Each entry is opened the first time it is used (or all at once,
+/// concurrently, if TDbiDatabaseManager is configured with
+/// EagerConnect = 1) so short jobs don't wait for entries they never use.
+///
 /// Contact: A.Finch@lancaster.ac.uk
 
 #if !defined(__CINT__) || defined(__MAKECINT__)
@@ -23,6 +27,13 @@
 #include "TDbiStatement.hxx"
 
 #include <map>
+#ifndef __CINT__
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
 #include <ostream>
 #include <string>
 #include <vector>
@@ -30,6 +41,7 @@
 
 namespace CP {
     class TDbiCascader;
+    class TDbiConnectionPool;
     std::ostream& operator<<(std::ostream& os,
                              const CP::TDbiCascader& cascader) ;
 }
@@ -67,12 +79,9 @@ public:
 
     std::string GetDbName(UInt_t dbNo) const;
     Int_t GetDbNo(const std::string& dbName) const;
-    Int_t GetStatus(UInt_t dbNo) const {
-        if (dbNo >= GetNumDb() || ! fConnections[dbNo]) {
-            return kFailed;
-        }
-        return fConnections[dbNo]->IsClosed() ? kClosed : kOpen;
-    }
+    /// Most connections that can be open to the entry at once.
+    UInt_t GetPoolSize(UInt_t dbNo) const;
+    Int_t GetStatus(UInt_t dbNo) const;
     std::string GetStatusAsString(UInt_t dbNo) const ;
     std::string GetURL(UInt_t dbNo) const {
         return (dbNo < GetNumDb()) ? fConnections[dbNo]-> GetUrl(): "";
@@ -83,10 +92,9 @@ public:
 
     Int_t AllocateSeqNo(const std::string& tableName,
                         Int_t requireGlobal = 0,
-                        Int_t dbNo = 0) const;
-    Int_t GetAuthorisingDbNo() const {
-        return fGlobalSeqNoDbNo;
-    }
+                        Int_t dbNo = 0,
+                        UInt_t count = 1) const;
+    Int_t GetAuthorisingDbNo() const;
     UInt_t GetNumDb() const {
         return fConnections.size();
     }
@@ -107,38 +115,86 @@ public:
     bool ExecTmpTblsSQLStmt(int tempConDbNo, const std::string& line,
                             const std::string& tableName);
 
+    /// Open all entries now rather than on first use.
+    Bool_t OpenAll();
+
     void HoldConnections();
     void ReleaseConnections();
+    /// Return unused SEQNOs first..last of a block from AllocateSeqNo if no
+    /// later ones have been allocated.
+    Bool_t ReleaseSeqNos(const std::string& tableName,
+                         Int_t first,
+                         Int_t last,
+                         Int_t dbNo = 0) const;
+    /// Close connections that have lingered beyond the linger time and
+    /// make sure the background reaper is running.
+    void ReapIdleConnections() const;
     void SetPermanent(UInt_t dbNo, Bool_t permanent = true);
+    void SetPoolSize(UInt_t maxSize);
 
 protected:
 
 private:
 
+    /// State of a cascade entry; entries are opened on first use.
+    enum EntryState { kEntryFailed = -1, kEntryUnopened, kEntryReady };
+
+    Bool_t CheckEntry(UInt_t dbNo) const;
+    Bool_t InitEntry(UInt_t dbNo) const;
+    Bool_t OpenEntry(UInt_t dbNo, Double_t& msecs) const;
     Int_t ReserveNextSeqNo(const std::string& tableName,
                            Bool_t isGlobal,
-                           UInt_t dbNo) const;
+                           UInt_t dbNo,
+                           UInt_t count = 1) const;
+    void RunReaper() const;
+    void SweepIdleConnections() const;
     void SetAuthorisingEntry(Int_t entry) {
         fGlobalSeqNoDbNo = entry;
     }
 
     /// Constructors and destructors.
-    TDbiCascader(bool beQuiet=false);
+    TDbiCascader(bool beQuiet=false, bool eager=false);
     virtual ~TDbiCascader();
     TDbiCascader(const TDbiCascader&);  // Not implemented
 
     /// Data members
 
+    /// If true fail quietly.
+    Bool_t fBeQuiet;
+
     /// First connection in the cascade supporting Temporary Tables
     /// Access through GetTempCon() only.
     Int_t fTempCon; // (T2K Extension)
 
-    /// 1st db in cascade with GlobalSeqNo table
-    Int_t fGlobalSeqNoDbNo;
+    /// 1st db in cascade with GlobalSeqNo table (so far as is known; see
+    /// GetAuthorisingDbNo)
+    mutable Int_t fGlobalSeqNoDbNo;
 
     /// Vector of TDbiConnections, one for each DB
     std::vector<TDbiConnection*> fConnections;
 
+    /// Connection pools, one for each DB
+    std::vector<TDbiConnectionPool*> fPools;
+
+#ifndef __CINT__
+    /// EntryState of each DB.  Read without locking once an entry is
+    /// ready or failed.
+    mutable std::deque<std::atomic<Int_t> > fEntryState;
+
+    /// Serialise the opening of each DB, one per entry.
+    mutable std::deque<std::mutex> fEntryMutex;
+
+    /// Protects fGlobalSeqNoDbNo as entries are checked.
+    mutable std::mutex fInitMutex;
+
+    /// Thread closing lingering connections while no statements are made,
+    /// and its stop request (see ReapIdleConnections).
+    mutable std::thread fReaper;
+    mutable std::mutex fReaperMutex;
+    mutable std::condition_variable fReaperWake;
+    mutable Bool_t fReaperStop;
+#endif
+
     /// Mapping Name->DbNo for temporary tables.
     std::map<std::string,Int_t> fTemporaryTables;
 
@@ -16,8 +16,9 @@ ClassImp(CP::TDbiConfigSet)
 //   *********************************
 
 
-//  Instantiate associated Result Pointer and Writer classes.
-//  ********************************************************
+//  Instantiate associated Result Pointer, Writer, Validity Iterator and
+//  Asynchronous Result Pointer classes.
+//  ********************************************************************
 
 #include "TDbiResultSetHandle.tpl"
 template class  CP::TDbiResultSetHandle<CP::TDbiConfigSet>;
@@ -25,6 +26,12 @@ template class  CP::TDbiResultSetHandle<CP::TDbiConfigSet>;
 #include "TDbiWriter.tpl"
 template class  CP::TDbiWriter<CP::TDbiConfigSet>;
 
+#include "TDbiValidityIterator.tpl"
+template class  CP::TDbiValidityIterator<CP::TDbiConfigSet>;
+
+#include "TDbiAsyncResultSetHandle.tpl"
+template class  CP::TDbiAsyncResultSetHandle<CP::TDbiConfigSet>;
+
 //    Definition of all member functions (static or otherwise)
 //    *******************************************************
 //
@@ -8,6 +8,7 @@
 #include "TDbiConnection.hxx"
 #include "TDbiExceptionLog.hxx"
 #include "TDbiServices.hxx"
+#include "TDbiTableMetaData.hxx"
 #include "TDbiLog.hxx"
 
 #include <TList.h>
@@ -18,7 +19,9 @@
 
 #include <cctype>
 #include <cstdlib>
+#include <ctime>
 #include <list>
+#include <random>
 #include <sstream>
 #include <string>
 
@@ -31,17 +34,53 @@ ClassImp(CP::TDbiConnection)
 //   *********************************
 
 
+//   File scope constants and functions
+//   **********************************
+
+namespace {
+
+//  Retry delay before the first retry and the cap on it (msecs).
+    const UInt_t kMinRetryDelay = 1000;
+    const UInt_t kMaxRetryDelay = 30000;
+
+//  Maximum time spent retrying in a single Open (secs).
+    const time_t kMaxRetryTime = 600;
+
+//  Circuit breaker cool-off after the first trip and the cap on it (secs).
+    const time_t kMinCoolOff = 30;
+    const time_t kMaxCoolOff = 1800;
+
+//  Return the delay (msecs) before retry number attempt: exponential
+//  backoff capped at kMaxRetryDelay with random jitter over its upper half
+//  so that many jobs started together do not retry in step.
+    UInt_t RetryDelay(int attempt) {
+        UInt_t delay = kMaxRetryDelay;
+        if (attempt <= 5) {
+            delay = kMinRetryDelay << (attempt - 1);
+            if (delay > kMaxRetryDelay) {
+                delay = kMaxRetryDelay;
+            }
+        }
+        static thread_local std::mt19937 engine((std::random_device())());
+        std::uniform_int_distribution<UInt_t> jitter(0,delay/2);
+        return delay - delay/2 + jitter(engine);
+    }
+
+}
+
 //    Definition of all member functions (static or otherwise)
 //    *******************************************************
 //
 //    -  ordered: ctors, dtor, operators then in alphabetical order.
 
 //.....................................................................
-//      Throws CP::EBadConnection() if can not make connection
+//      Throws CP::EBadConnection() if can not make connection (unless
+//      deferOpen, in which case Validate throws it).
 CP::TDbiConnection::TDbiConnection(const std::string& url      /* = "" */,
                                    const std::string& user     /* = "" */,
                                    const std::string& password /* = "" */,
-                                   int maxConnects) :
+                                   int maxConnects,
+                                   bool deferOpen) :
     fUrlString(url),
     fUrl(url.c_str()),
     fUser(user),
@@ -49,59 +88,32 @@ CP::TDbiConnection::TDbiConnection(const std::string& url      /* = "" */,
     fUrlValidated(false),
     fNumConnectedStatements(0),
     fIsTemporary(true),
-    fServer(0) {
+    fIdleSince(0),
+    fNumReconnectsAvoided(0),
+    fCheckAlive(false),
+    fBreakerUntil(0),
+    fNumBreakerTrips(0),
+    fServer(0),
+    fSchemaDiscovered(false),
+    fSchemaVersionProbed(false),
+    fMaxStatementSize(0) {
 
     fMaxConnectionAttempts = maxConnects;
+    fDbName = fUrl.GetFile();
 
     DbiTrace("Creating CP::TDbiConnection" << "  ");
-    if (this->Open()) {
-        DbiInfo("Successfully opened connection to: "
-                << this->GetUrl() << "  ");
-        fUrlValidated =  true;
-
-        // Initialise the list existing supported tables.
-        this->SetTableExists();
-
-        //  If URL looks O.K., check that both client and server support
-        //  prepared statements.
-        if (fUrlValidated) {
-            if (!fServer->HasStatement()) {
-                DbiError("  This client does not support prepared statements."
-                          << "  ");
-                fUrlValidated = false;
-            }
-
-            std::string serverInfo(fServer->ServerInfo());
-            if (!fServer->HasStatement()) {
-                DbiError("This server (" << serverInfo
-                          << ") does NOT support prepared statements." << "  ");
-                fUrlValidated = false;
-            }
-            if (fUrlValidated) {
-                DbiInfo("This client, and server (" << serverInfo
-                        << ") supports prepared statements." << "  ");
-            }
-            else {
-                DbiError(
-                    std::endl
-                    << "This server does not support prepared statements."
-                    << std::endl
-                    << "If using MYSQL please upgrade to version >4.1"
-                    << std::endl);
-            }
-
-        }
-    }
-    if (!fUrlValidated) {
-        DbiError("FATAL: " << "Aborting due to above errors" << "  ");
-        throw CP::EBadConnection();
+    if (! deferOpen) {
+        this->Validate();
     }
-    fDbName = fUrl.GetFile();
 }
 
 CP::TDbiConnection::~TDbiConnection() {
     DbiTrace("Destroying CP::TDbiConnection" << "  ");
     this->Close(true);
+    std::map<std::string,CP::TDbiTableMetaData*>::iterator itr = fSchema.begin();
+    for (; itr != fSchema.end(); ++itr) {
+        delete itr->second;
+    }
 
 }
 
@@ -128,18 +140,62 @@ Bool_t CP::TDbiConnection::Close(Bool_t force /* = false */) {
 
     delete fServer;
     fServer = 0;
+    fIdleSince = 0;
     DbiDebug("Closed connection: " << this->GetUrl() << "  ");
     return true;
 
 }
 
+///  Close connection if it has been idle for at least the linger time.
+///  Lingering connections are swept by TDbiCascader each time it creates a
+///  statement, and periodically by its reaper thread, so this costs no
+///  more than a clock read.
+Bool_t CP::TDbiConnection::CloseIfLingerExpired(time_t now) {
+
+    std::lock_guard<std::mutex> lock(fLingerMutex);
+    if (! fIdleSince || ! fIsTemporary || fNumConnectedStatements != 0) {
+        return false;
+    }
+    if (now - fIdleSince < CP::TDbiServices::ConnectionLinger()) {
+        return false;
+    }
+    DbiDebug("Closing connection: " << this->GetUrl() << " after lingering "
+             << now - fIdleSince << " secs" << "  ");
+    return this->Close();
+
+}
+
 ///  Purpose: Close idle connection. Idle means there are no active
-///  connections to this database.
+///  connections to this database.  If a linger time has been configured
+///  the connection is left open and just marked idle; it is then either
+///  reused by the next statement or closed by CloseIfLingerExpired.
 void CP::TDbiConnection::CloseIdleConnection() {
 
     if (fIsTemporary &&  fNumConnectedStatements == 0) {
-        this->Close();
+        if (CP::TDbiServices::ConnectionLinger() > 0) {
+            if (! this->IsClosed()) {
+                fIdleSince = std::time(0);
+            }
+        }
+        else {
+            this->Close();
+        }
+    }
+
+}
+
+///  Increment number of statements relying on this connection.  If it
+///  was lingering a reconnect has been avoided, but the server may have
+///  dropped it meanwhile so Open checks it is still alive.
+void CP::TDbiConnection::ConnectStatement() {
+
+    std::lock_guard<std::mutex> lock(fLingerMutex);
+    if (fIdleSince) {
+        ++fNumReconnectsAvoided;
+        fIdleSince = 0;
+        fCheckAlive = true;
     }
+    ++fNumConnectedStatements;
 
 }
 
@@ -196,6 +252,120 @@ TSQLServer* CP::TDbiConnection::GetServer() {
     return fServer;
 }
 
+///  Return true if failover has been enabled (see
+///  TDbiServices::ConnectionFailover) and the circuit breaker is tripped.
+///  TDbiCascader then skips this entry when looking up tables.
+Bool_t CP::TDbiConnection::IsFailedOver() const {
+    return CP::TDbiServices::ConnectionFailover()
+           && std::time(0) < fBreakerUntil;
+}
+
+///  Decrement number of statements relying on this connection and close
+///  (or start lingering) if idle.
+void CP::TDbiConnection::DisConnectStatement() {
+
+    std::lock_guard<std::mutex> lock(fLingerMutex);
+    --fNumConnectedStatements;
+    if (! fNumConnectedStatements) {
+        this->CloseIdleConnection();
+    }
+
+}
+
+///  Fetch column meta data for every table in the database with a single
+///  query.  This replaces a GetTableInfo round trip (or several) per table
+///  with one per connection.  Only MySQL (information_schema) is supported;
+///  for other DBMSs fSchema stays empty and TDbiDBProxy::StoreMetaData
+///  falls back to TSQLServer::GetTableInfo.
+void CP::TDbiConnection::DiscoverSchema() {
+
+    fSchemaDiscovered = true;
+    this->Connect();
+    if (! this->Open() || std::string(fServer->GetDBMS()) != "MySQL") {
+        this->DisConnect();
+        return;
+    }
+
+    TSQLStatement* stmt = this->CreatePreparedStatement(
+        "select TABLE_NAME, COLUMN_NAME, DATA_TYPE, COLUMN_TYPE,"
+        " CHARACTER_MAXIMUM_LENGTH, IS_NULLABLE"
+        " from information_schema.COLUMNS where TABLE_SCHEMA = database()"
+        " order by TABLE_NAME, ORDINAL_POSITION");
+    if (! stmt || ! stmt->Process() || ! stmt->StoreResult()) {
+        DbiWarn("Schema discovery failed for " << this->GetUrl() << "  ");
+        delete stmt;
+        this->DisConnect();
+        return;
+    }
+
+    UInt_t numCols = 0;
+    while (stmt->NextResultRow()) {
+        std::string tableName(stmt->GetString(0));
+        CP::TDbiTableMetaData*& metaData = fSchema[tableName];
+        if (! metaData) {
+            metaData = new CP::TDbiTableMetaData(tableName);
+        }
+        Int_t col = metaData->NumCols() + 1;
+
+        TString name(stmt->GetString(1));
+        name.ToUpper();
+        metaData->SetColName(name.Data(),col);
+
+        // Map onto the values TSQLColumnInfo would have supplied.
+        TString dataType(stmt->GetString(2));
+        dataType.ToUpper();
+        TString colType(stmt->GetString(3));
+        Int_t sqlType = TSQLServer::kSQL_NONE;
+        if (dataType.EndsWith("INT") || dataType == "INTEGER") {
+            sqlType = TSQLServer::kSQL_INTEGER;
+        }
+        else if (dataType == "DECIMAL" || dataType == "NUMERIC") {
+            sqlType = TSQLServer::kSQL_NUMERIC;
+        }
+        else if (dataType == "FLOAT") {
+            sqlType = TSQLServer::kSQL_FLOAT;
+        }
+        else if (dataType == "DOUBLE" || dataType == "REAL") {
+            sqlType = TSQLServer::kSQL_DOUBLE;
+        }
+        else if (dataType == "CHAR") {
+            sqlType = TSQLServer::kSQL_CHAR;
+        }
+        else if (dataType == "VARCHAR" || dataType.EndsWith("TEXT")) {
+            sqlType = TSQLServer::kSQL_VARCHAR;
+        }
+        else if (dataType.BeginsWith("DATE") || dataType.BeginsWith("TIME")) {
+            sqlType = TSQLServer::kSQL_TIMESTAMP;
+        }
+
+        // Size is the character length or, for numbers, the display width.
+        Int_t size = 0;
+        if (! stmt->IsNull(4)) {
+            size = stmt->GetInt(4);
+        }
+        else {
+            Ssiz_t open = colType.First('(');
+            if (open != kNPOS) {
+                size = atoi(colType.Data() + open + 1);
+            }
+        }
+
+        CP::TDbiFieldType fldType(sqlType,size,dataType.Data());
+        if (colType.Contains("unsigned")) {
+            fldType.SetUnsigned();
+        }
+        metaData->SetColFieldType(fldType,col);
+        metaData->SetColIsNullable(col,std::string(stmt->GetString(5)) == "YES");
+        ++numCols;
+    }
+    delete stmt;
+    this->DisConnect();
+
+    DbiLog("Discovered " << numCols << " columns in " << fSchema.size()
+           << " tables on " << this->GetUrl() << "  ");
+
+}
+
 /// Return a reference to a string containing the URL.  The string is shared,
 /// so make a copy of it before subsequent call to this function.
 ///
@@ -215,6 +385,18 @@ const std::string& CP::TDbiConnection::GetUrl() const {
 Bool_t CP::TDbiConnection::Open() {
 
     this->ClearExceptionLog();
+
+    // A reused lingering connection may have been dropped by the server
+    // while idle; if so reopen it rather than fail the next statement.
+    if (fCheckAlive) {
+        fCheckAlive = false;
+        if (fServer && fServer->Ping() != 0) {
+            DbiWarn("Lingering connection to " << this->GetUrl()
+                    << " is no longer alive; reopening" << "  ");
+            delete fServer;
+            fServer = 0;
+        }
+    }
     if (!this->IsClosed()) {
         return true;
     }
@@ -228,9 +410,26 @@ Bool_t CP::TDbiConnection::Open() {
         return false;
     }
 
+    // While the circuit breaker is tripped fail immediately.
+    time_t now = std::time(0);
+    if (now < fBreakerUntil) {
+        std::ostringstream oss;
+        oss << "Not opening: " << fUrlString
+            << "; circuit breaker tripped for another "
+            << fBreakerUntil - now << " secs";
+        DbiDebug(oss.str() << "  ");
+        fExceptionLog.AddEntry(oss.str());
+        return false;
+    }
+
     // Make several attempts (or more if URL is known to be O.K.) to open
-    // connection.
+    // connection, but only one after the breaker has tripped, and give up
+    // after kMaxRetryTime.
     int maxAttempt = fUrlValidated ?  100: fMaxConnectionAttempts ;
+    if (fNumBreakerTrips) {
+        maxAttempt = 1;
+    }
+    time_t retryEnd = now + kMaxRetryTime;
     for (int attempt = 1; attempt <= maxAttempt; attempt++) {
         fServer = TSQLServer::Connect(fUrlString.c_str(),
                                       fUser.c_str(),
@@ -242,17 +441,24 @@ Bool_t CP::TDbiConnection::Open() {
                 << " and password " << fPassword 
                 << " (attempt " << attempt << ")";
             fExceptionLog.AddEntry(oss.str());
-            if (fMaxConnectionAttempts > attempt) {
-                if (attempt == 1) {
-                    DbiSevere(" retrying ... " << "  ");
-                }
-                DbiLog(" Waiting "<<attempt<<" seconds before trying again");
-                gSystem->Sleep(attempt*1000);
+            if (attempt == maxAttempt || std::time(0) >= retryEnd) {
+                break;
+            }
+            if (attempt == 1) {
+                DbiSevere(" retrying ... " << "  ");
             }
+            UInt_t delay = RetryDelay(attempt);
+            DbiLog(" Waiting "<< delay << " msecs before trying again");
+            gSystem->Sleep(delay);
         }
 
         else {
             fServer->EnableErrorOutput(false);
+            if (fNumBreakerTrips) {
+                DbiWarn("Circuit breaker reset for: " << fUrlString << "  ");
+            }
+            fNumBreakerTrips = 0;
+            fBreakerUntil    = 0;
             if (attempt > 1) {
                 DbiWarn("... Connection opened on attempt " << attempt << "  ");
             }
@@ -291,6 +497,22 @@ Bool_t CP::TDbiConnection::Open() {
     DbiSevere("... Failed to open a connection to: " << fUrlString
               << " for user " << fUser << " and pwd " << fPassword << "  ");
 
+    // Trip the circuit breaker.
+    time_t coolOff = kMaxCoolOff;
+    if (fNumBreakerTrips < 6) {
+        coolOff = kMinCoolOff << fNumBreakerTrips;
+        if (coolOff > kMaxCoolOff) {
+            coolOff = kMaxCoolOff;
+        }
+    }
+    ++fNumBreakerTrips;
+    fBreakerUntil = std::time(0) + coolOff;
+    DbiWarn("Circuit breaker tripped for: " << fUrlString << " for "
+            << coolOff << " secs"
+            << (CP::TDbiServices::ConnectionFailover()
+                ? "; read-only queries will use the rest of the cascade" : "")
+            << "  ");
+
     return false;
 
 }
@@ -322,8 +544,96 @@ void  CP::TDbiConnection::RecordException() {
     fExceptionLog.AddEntry(*fServer);
 }
 
+///  Return a cheap probe of the database schema, made once per connection,
+///  that changes whenever tables are created, dropped or altered.  It is
+///  used to validate TDbiMetaDataCache.  Returns "" if the DBMS is not
+///  supported or this is an ASCII database, whose schema is recreated
+///  each time it is opened.
+const std::string& CP::TDbiConnection::GetSchemaVersion() {
+
+    if (fSchemaVersionProbed) {
+        return fSchemaVersion;
+    }
+    fSchemaVersionProbed = true;
+    if (this->IsAsciiDb()) {
+        return fSchemaVersion;
+    }
+    this->Connect();
+    if (! this->Open()) {
+        this->DisConnect();
+        return fSchemaVersion;
+    }
+
+    std::string dbms(fServer->GetDBMS());
+    std::string sql;
+    if (dbms == "MySQL") {
+        sql = "select concat(count(*),'-',coalesce(sum(crc32(concat("
+              "TABLE_NAME,coalesce(CREATE_TIME,'')))),0))"
+              " from information_schema.TABLES"
+              " where TABLE_SCHEMA = database()";
+    }
+    else if (dbms == "SQLite") {
+        sql = "select count(*) || '-' || total(length(sql)) from sqlite_master";
+    }
+    if (! sql.empty()) {
+        TSQLStatement* stmt = this->CreatePreparedStatement(sql);
+        if (stmt && stmt->Process() && stmt->StoreResult()
+            && stmt->NextResultRow()) {
+            fSchemaVersion = dbms + "-" + stmt->GetString(0);
+        }
+        delete stmt;
+    }
+    this->DisConnect();
+    DbiDebug("Schema version of " << this->GetUrl() << ": "
+             << fSchemaVersion << "  ");
+    return fSchemaVersion;
+
+}
+
+///  Return the largest SQL statement, in bytes, that the server will
+///  accept, probed once per connection.  For MySQL this is the
+///  max_allowed_packet, for other DBMSs a conservative default that is
+///  within SQLite's compiled in SQLITE_MAX_SQL_LENGTH.
+UInt_t CP::TDbiConnection::GetMaxStatementSize() {
+
+    if (fMaxStatementSize) {
+        return fMaxStatementSize;
+    }
+    fMaxStatementSize = 1000000;
+    this->Connect();
+    if (this->Open() && std::string(fServer->GetDBMS()) == "MySQL") {
+        TSQLStatement* stmt
+            = this->CreatePreparedStatement("select @@max_allowed_packet");
+        if (stmt && stmt->Process() && stmt->StoreResult()
+            && stmt->NextResultRow() && stmt->GetUInt(0) > 0) {
+            fMaxStatementSize = stmt->GetUInt(0);
+        }
+        delete stmt;
+    }
+    this->DisConnect();
+    DbiDebug("Max statement size of " << this->GetUrl() << ": "
+             << fMaxStatementSize << "  ");
+    return fMaxStatementSize;
+
+}
+
+///  Return meta data for table from schema discovery (run on the first
+///  request) or 0 if not available.  CP::TDbiConnection retains ownership.
+const CP::TDbiTableMetaData* CP::TDbiConnection::GetTableMetaData(
+    const std::string& tableName) {
+
+    if (! fSchemaDiscovered) {
+        this->DiscoverSchema();
+    }
+    std::map<std::string,CP::TDbiTableMetaData*>::const_iterator itr
+        = fSchema.find(tableName);
+    return itr == fSchema.end() ? 0 : itr->second;
+
+}
+
 /// Add name to list of existing tables (necessary when creating tables).  If
-/// tableName is empty then refresh list from the database.
+/// tableName is empty then refresh list from the database.  Any discovered
+/// meta data for the table is dropped as it may have been recreated.
 void  CP::TDbiConnection::SetTableExists(const std::string& tableName) {
 
     if (tableName.empty()) {
@@ -336,6 +646,12 @@ void  CP::TDbiConnection::SetTableExists(const std::string& tableName) {
         delete tableList;
     }
     else {
+        std::map<std::string,CP::TDbiTableMetaData*>::iterator itr
+            = fSchema.find(tableName);
+        if (itr != fSchema.end()) {
+            delete itr->second;
+            fSchema.erase(itr);
+        }
         if (! this->TableExists(tableName)) {
             fExistingTableList += ",'";
             fExistingTableList += tableName;
@@ -383,3 +699,59 @@ bool CP::TDbiConnection::SupportsTmpTbls() {
     return retVal;
 }
 
+
+///  Open the connection for the first time and check that both client and
+///  server support prepared statements.  This is done by the constructor
+///  unless it was asked to defer opening (see TDbiCascader).  Calling it
+///  again once the URL has been validated does nothing.
+///
+///  This throws CP::EBadConnection() if can not make connection.
+void CP::TDbiConnection::Validate() {
+
+    if (fUrlValidated) {
+        return;
+    }
+
+    if (this->Open()) {
+        DbiInfo("Successfully opened connection to: "
+                << this->GetUrl() << "  ");
+        fUrlValidated =  true;
+
+        // Initialise the list existing supported tables.
+        this->SetTableExists();
+
+        //  If URL looks O.K., check that both client and server support
+        //  prepared statements.
+        if (fUrlValidated) {
+            if (!fServer->HasStatement()) {
+                DbiError("  This client does not support prepared statements."
+                          << "  ");
+                fUrlValidated = false;
+            }
+
+            std::string serverInfo(fServer->ServerInfo());
+            if (!fServer->HasStatement()) {
+                DbiError("This server (" << serverInfo
+                          << ") does NOT support prepared statements." << "  ");
+                fUrlValidated = false;
+            }
+            if (fUrlValidated) {
+                DbiInfo("This client, and server (" << serverInfo
+                        << ") supports prepared statements." << "  ");
+            }
+            else {
+                DbiError(
+                    std::endl
+                    << "This server does not support prepared statements."
+                    << std::endl
+                    << "If using MYSQL please upgrade to version >4.1"
+                    << std::endl);
+            }
+
+        }
+    }
+    if (!fUrlValidated) {
+        DbiError("FATAL: " << "Aborting due to above errors" << "  ");
+        throw CP::EBadConnection();
+    }
+}
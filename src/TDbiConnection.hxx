@@ -14,9 +14,28 @@
 ///
 /// \brief
 /// <b>Purpose</b> To minimise connections.
+///
+/// If TDbiDatabaseManager is configured with ConnectionLinger = <secs>,
+/// idle temporary connections are kept open that long before closing so
+/// that a burst of queries does not reconnect for each one.  A lingering
+/// connection is pinged before it is reused and reopened if the server
+/// has dropped it (e.g. after its wait_timeout).
+///
+/// Failed opens are retried with capped exponential backoff and random
+/// jitter.  If all attempts fail a circuit breaker trips and further opens
+/// fail immediately until a cool-off period, which doubles with each
+/// consecutive trip, has passed; then a single attempt is allowed.  With
+/// ConnectionFailover = 1 an entry whose breaker is tripped is skipped by
+/// TDbiCascader when looking up tables, so read-only queries fall through
+/// to the next cascade entry.
 /// Contact: A.Finch@lancaster.ac.uk
 ///
+#include <ctime>
+#include <map>
 #include <string>
+#ifndef __CINT__
+#include <mutex>
+#endif
 
 #ifndef ROOT_Rtypes
 #if !defined(__CINT__) || defined(__MAKECINT__)
@@ -32,6 +51,7 @@
 
 namespace CP {
     class TDbiConnection;
+    class TDbiTableMetaData;
 };
 
 
@@ -45,31 +65,63 @@ public:
     ///    * password - password to use
     ///    * maxConnects = maximum number of connections to attempt before
     ///      giving up, default to 20
+    ///    * deferOpen - if true don't open the connection until Validate
+    ///      is called.
     ///
     /// This throws CP::EBadConnection() if can not make connection
     ///
     TDbiConnection(const std::string& url = "",
                    const std::string& user = "",
                    const std::string& password = "",
-                   int maxConnects=20);
+                   int maxConnects=20,
+                   bool deferOpen=false);
     virtual ~TDbiConnection();
 
     const std::string& GetDbName() const {
         return fDbName;
     }
+    /// Return the largest SQL statement in bytes the server accepts.
+    UInt_t GetMaxStatementSize();
+    UInt_t GetNumReconnectsAvoided() const {
+        return fNumReconnectsAvoided;
+    }
+    /// Return a cheap probe of the database schema that changes whenever
+    /// tables are created, dropped or altered, or "" if unavailable.
+    const std::string& GetSchemaVersion();
+    /// Return meta data for table from schema discovery or 0 if not
+    /// available (table unknown or DBMS doesn't support discovery).
+    const TDbiTableMetaData* GetTableMetaData(const std::string& tableName);
     const std::string& GetPassword() const {
         return fPassword;
     }
     const std::string& GetUrl() const;
+    const std::string& GetUrlString() const {
+        return fUrlString;
+    }
     const std::string& GetUser() const {
         return fUser;
     }
+    Bool_t IsAsciiDb() const {
+        return fUrlString.find('#') != std::string::npos;
+    }
     Bool_t IsClosed() const {
         return ! fServer;
     }
+    /// True if failover is enabled and the circuit breaker is tripped.
+    Bool_t IsFailedOver() const;
+    Bool_t IsLingering() const {
+        return fIdleSince != 0;
+    }
+    /// True for an SQLite file, which allows only one writer at a time.
+    Bool_t IsSQLite() const {
+        return fUrlString.compare(0,7,"sqlite:") == 0;
+    }
     Bool_t IsTemporary() const {
         return fIsTemporary;
     }
+    Bool_t IsValidated() const {
+        return fUrlValidated;
+    }
     Bool_t TableExists(const std::string& tableName) const;
 
     bool SupportsTmpTbls(); // (T2K Extension)
@@ -101,19 +153,13 @@ public:
         this->DisConnectStatement();
     }
 
-    /// Increment number of statements relying on this connection
-    void ConnectStatement() {
-        ++fNumConnectedStatements;
-    }
+    /// Increment number of statements relying on this connection.  If
+    /// the connection was lingering a reconnect has been avoided.
+    void ConnectStatement();
 
     /// Decrement number of statements relying on this connection and
-    /// close if idle
-    void DisConnectStatement() {
-        --fNumConnectedStatements;
-        if (! fNumConnectedStatements) {
-            this->CloseIdleConnection();
-        }
-    }
+    /// close (or start lingering) if idle
+    void DisConnectStatement();
 
     /// Connection is permanent, don't close even when idle.
     void SetPermanent(Bool_t permanent = true) {
@@ -124,6 +170,14 @@ public:
     Bool_t Close(Bool_t force = false);
     Bool_t Open();
 
+    /// Open for the first time and check server.  Throws
+    /// CP::EBadConnection() on failure.
+    void Validate();
+
+    /// Close connection if it has lingered for longer than the linger
+    /// time (see TDbiServices::ConnectionLinger) and return true if closed.
+    Bool_t CloseIfLingerExpired(time_t now);
+
     /// Get server, opening if necessary
     /// TDbiConnection retains ownership
     TSQLServer* GetServer();
@@ -138,6 +192,7 @@ public:
 private:
 
     void CloseIdleConnection();
+    void DiscoverSchema();
 
 
     /// Database Name.
@@ -174,13 +229,52 @@ private:
     /// Connection closes after each I/O (no connections left)
     Bool_t fIsTemporary;
 
+    /// Time a temporary connection became idle but was left open to
+    /// linger or 0 if not lingering.
+    time_t fIdleSince;
+
+    /// Number of times a lingering connection was reused rather than
+    /// reopened.
+    UInt_t fNumReconnectsAvoided;
+
+    /// True if a lingering connection has been reused and must be checked
+    /// to be still alive when next opened (see Open).
+    Bool_t fCheckAlive;
+
+    /// Time until which the circuit breaker is tripped (0 if not).
+    time_t fBreakerUntil;
+
+    /// Number of consecutive times the circuit breaker has tripped.
+    UInt_t fNumBreakerTrips;
+
     /// TSQLServer or 0 if closed
     TSQLServer* fServer;
 
+    /// True once DiscoverSchema has been run.
+    Bool_t fSchemaDiscovered;
+
+    /// Schema version from GetSchemaVersion and true once probed.
+    std::string fSchemaVersion;
+    Bool_t fSchemaVersionProbed;
+
+    /// Maximum statement size from GetMaxStatementSize or 0 if not probed.
+    UInt_t fMaxStatementSize;
+
+#ifndef __CINT__ //  Hide map from CINT; it complains about missing Streamer() etc.
+    /// Table meta data from DiscoverSchema, indexed by table name (owned).
+    std::map<std::string,TDbiTableMetaData*> fSchema;
+#endif  // __CINT__
+
     /// Log of exceptions generated.  Cleared by Open Close and
     /// (implicitly) by CreatePreparedStatement, GetServer
     TDbiExceptionLog fExceptionLog;
 
+#ifndef __CINT__
+    /// Serialises statement counting with closing lingering connections,
+    /// which TDbiCascader's reaper does from its own thread.
+    std::mutex fLingerMutex;
+#endif  // __CINT__
+
     ClassDef(TDbiConnection,0)     // Managed TSQLServer
 
 };
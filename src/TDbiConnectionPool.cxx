@@ -0,0 +1,346 @@
+
+#include <chrono>
+#include <ostream>
+
+#include "TDbi.hxx"
+#include "TDbiConnection.hxx"
+#include "TDbiConnectionPool.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
+
+ClassImp(CP::TDbiConnectionPool)
+
+//   File scope constants
+//   ********************
+
+namespace {
+
+//  Time to wait for a connection to be returned before logging that the
+//  wait continues.
+    const int kMaxWaitSecs = 60;
+
+}
+
+// Definition of global functions (alphabetical order)
+// ***************************************************
+
+std::ostream& CP::operator<<(std::ostream& s, const CP::TDbiConnectionPool& pool) {
+    s << "pool " << pool.GetSize() << "/" << pool.GetMaxSize()
+      << (pool.IsPinned() ? " (pinned)" : "")
+      << " checkouts " << pool.GetNumCheckouts()
+      << " waits " << pool.GetNumWaits()
+      << " reconnects avoided " << pool.GetNumReconnectsAvoided();
+    return s;
+}
+
+//    Definition of all member functions (static or otherwise)
+//    *******************************************************
+//
+//    -  ordered: ctors, dtor, operators then in alphabetical order.
+
+//.....................................................................
+
+CP::TDbiConnectionPool::TDbiConnectionPool(CP::TDbiConnection* primary,
+                                           UInt_t maxSize) :
+    fPrimary(primary),
+    fMaxSize(maxSize > 0 ? maxSize : 1),
+    fPinned(kFALSE),
+    fNumCheckouts(0),
+    fNumWaits(0),
+    fNumOpening(0) {
+//
+//
+//  Purpose:  Constructor
+//
+//  Arguments:
+//    primary      in    The cascader's connection (not adopted).
+//    maxSize      in    Maximum number of connections.
+
+    DbiTrace("Creating CP::TDbiConnectionPool" << "  ");
+
+    fConnections.push_back(fPrimary);
+    fCheckedOut.push_back(0);
+    fOwner.push_back(std::thread::id());
+
+}
+
+//.....................................................................
+
+CP::TDbiConnectionPool::~TDbiConnectionPool() {
+//
+//
+//  Purpose: Destructor
+
+    DbiTrace("Destroying CP::TDbiConnectionPool" << "  ");
+
+    for (UInt_t index = 1; index < fConnections.size(); ++index) {
+        delete fConnections[index];
+    }
+
+}
+
+//.....................................................................
+
+CP::TDbiConnection* CP::TDbiConnectionPool::Checkout() {
+//
+//
+//  Purpose:  Check out a connection.
+//
+//  Return:   Connection (never zero).  It has been connected (see
+//            TDbiConnection::ConnectStatement) and must be handed back
+//            with Return.
+//
+//  Specification:-
+//  =============
+//
+//  o If pinned or of maximum size 1 use the primary connection, waiting
+//    if another thread has it checked out.
+//
+//  o If the calling thread already holds a connection use it again.
+//
+//  o Otherwise use a free connection, preferring the primary, or add a
+//    new one if the pool is not full, or wait for one to be returned.
+//
+//  o Never hand a connection held by one thread to another; a long wait
+//    is only logged.
+//
+//  Program Notes:-
+//  =============
+//
+//  New connections are opened after releasing fMutex as the
+//  TDbiConnection constructor can block for as long as its retries take.
+//  The slot of a connection being opened is reserved by fNumOpening so
+//  the pool cannot overshoot its maximum size.  ConnectStatement only
+//  counts the statement (the server is opened when first used) so stays
+//  under the lock, serialised with Hold, Release, Return and ReapIdle.
+
+    std::unique_lock<std::mutex> lock(fMutex);
+    ++fNumCheckouts;
+
+    std::thread::id self = std::this_thread::get_id();
+    Int_t index = -1;
+
+    if (fPinned || fMaxSize <= 1) {
+        index = 0;
+        if (fCheckedOut[0] && fOwner[0] != self) {
+            ++fNumWaits;
+            Int_t secsWaited = 0;
+            while (! fReturned.wait_for(lock,std::chrono::seconds(kMaxWaitSecs),
+                                        [this] { return ! fCheckedOut[0]; })) {
+                secsWaited += kMaxWaitSecs;
+                DbiWarn("Still waiting, after " << secsWaited
+                        << " secs, for the connection to "
+                        << fPrimary->GetUrl() << "  ");
+            }
+        }
+    }
+    else {
+        for (UInt_t con = 0; con < fConnections.size(); ++con) {
+            if (fCheckedOut[con] && fOwner[con] == self) {
+                index = con;
+                break;
+            }
+        }
+        Bool_t waited = kFALSE;
+        Int_t secsWaited = 0;
+        while (index < 0) {
+            for (UInt_t con = 0; con < fConnections.size(); ++con) {
+                if (! fCheckedOut[con]) {
+                    index = con;
+                    break;
+                }
+            }
+            if (index >= 0) {
+                break;
+            }
+            if (fConnections.size() + fNumOpening < fMaxSize) {
+                ++fNumOpening;
+                lock.unlock();
+                CP::TDbiConnection* con = this->OpenConnection();
+                lock.lock();
+                --fNumOpening;
+                if (con) {
+                    fConnections.push_back(con);
+                    fCheckedOut.push_back(0);
+                    fOwner.push_back(std::thread::id());
+                    index = fConnections.size() - 1;
+                    DbiLog("Added connection " << fConnections.size()
+                           << " to pool for " << fPrimary->GetUrl() << "  ");
+                    break;
+                }
+                DbiWarn("Unable to add connection to pool for "
+                        << fPrimary->GetUrl() << "; limiting pool size to "
+                        << fConnections.size() + fNumOpening << "  ");
+                fMaxSize = fConnections.size() + fNumOpening;
+                if (fMaxSize < 1) {
+                    fMaxSize = 1;
+                }
+                continue;
+            }
+            if (! waited) {
+                ++fNumWaits;
+                waited = kTRUE;
+            }
+            if (fReturned.wait_for(lock,std::chrono::seconds(kMaxWaitSecs))
+                == std::cv_status::timeout) {
+                secsWaited += kMaxWaitSecs;
+                DbiWarn("Still waiting, after " << secsWaited
+                        << " secs, for a pooled connection to "
+                        << fPrimary->GetUrl() << "  ");
+            }
+        }
+    }
+
+    if (! fCheckedOut[index]) {
+        fOwner[index] = self;
+    }
+    ++fCheckedOut[index];
+    CP::TDbiConnection* con = fConnections[index];
+    con->ConnectStatement();
+    return con;
+
+}
+
+//.....................................................................
+
+UInt_t CP::TDbiConnectionPool::GetNumReconnectsAvoided() const {
+//
+//
+//  Purpose:  Return the number of reconnects avoided by lingering,
+//            summed over all connections in the pool.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    UInt_t numAvoided = 0;
+    for (UInt_t index = 0; index < fConnections.size(); ++index) {
+        numAvoided += fConnections[index]->GetNumReconnectsAvoided();
+    }
+    return numAvoided;
+
+}
+
+//.....................................................................
+
+UInt_t CP::TDbiConnectionPool::GetSize() const {
+//
+//
+//  Purpose:  Return the current number of connections in the pool.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fConnections.size();
+
+}
+
+//.....................................................................
+
+void CP::TDbiConnectionPool::Hold() {
+//
+//
+//  Purpose:  Hold the primary connection open.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    fPrimary->ConnectStatement();
+
+}
+
+//.....................................................................
+
+CP::TDbiConnection* CP::TDbiConnectionPool::OpenConnection() const {
+//
+//
+//  Purpose:  Open a new connection for the pool (fMutex must not be
+//            held).
+//
+//  Return:   The new connection or 0 if it could not be opened.
+//
+//  Program Notes:-
+//  =============
+//
+//  Only one connection attempt is made; if the database is too busy to
+//  accept more connections the pool just stops growing.
+
+    try {
+        return new CP::TDbiConnection(fPrimary->GetUrlString(),
+                                      fPrimary->GetUser(),
+                                      fPrimary->GetPassword(),
+                                      1);
+    }
+    catch (CP::EBadConnection&) {
+        return 0;
+    }
+
+}
+
+//.....................................................................
+
+void CP::TDbiConnectionPool::ReapIdle(time_t now) {
+//
+//
+//  Purpose:  Close connections that have lingered too long.
+//
+//  Arguments:
+//    now          in    Current time.
+//
+//  Program Notes:-
+//  =============
+//
+//  Takes the lock so cannot race with a thread checking out the
+//  connection being closed.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (UInt_t index = 0; index < fConnections.size(); ++index) {
+        if (! fCheckedOut[index]) {
+            fConnections[index]->CloseIfLingerExpired(now);
+        }
+    }
+
+}
+
+//.....................................................................
+
+void CP::TDbiConnectionPool::Release() {
+//
+//
+//  Purpose:  Undo Hold.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    fPrimary->DisConnectStatement();
+
+}
+
+//.....................................................................
+
+void CP::TDbiConnectionPool::Return(CP::TDbiConnection* con) {
+//
+//
+//  Purpose:  Return a connection obtained from Checkout.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (UInt_t index = 0; index < fConnections.size(); ++index) {
+        if (fConnections[index] == con && fCheckedOut[index]) {
+            --fCheckedOut[index];
+            con->DisConnectStatement();
+            fReturned.notify_all();
+            return;
+        }
+    }
+    DbiSevere("Attempting to return a connection not checked out from pool for "
+              << fPrimary->GetUrl() << "  ");
+
+}
+
+//.....................................................................
+
+void CP::TDbiConnectionPool::SetMaxSize(UInt_t maxSize) {
+//
+//
+//  Purpose:  Set the maximum number of connections.
+//
+//  Program Notes:-
+//  =============
+//
+//  Reducing the size does not close connections already in the pool.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    fMaxSize = maxSize > 0 ? maxSize : 1;
+
+}
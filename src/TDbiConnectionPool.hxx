@@ -0,0 +1,146 @@
+#ifndef DBICONNECTIONPOOL_H
+#define DBICONNECTIONPOOL_H
+
+/**
+ *
+ * \class CP::TDbiConnectionPool
+ *
+ *
+ * \brief
+ * <b>Concept</b> A pool of TDbiConnections to one cascade entry from
+ *  which statements check out a connection and to which they return it.
+ *
+ * \brief
+ * <b>Purpose</b> To let several threads (parallel table fetches,
+ *  prefetching, writers) talk to the same cascade entry without sharing
+ *  one TSQLServer.
+ *
+ * \brief
+ * <b>Usage Notes</b> The pool always contains the cascader's primary
+ *  connection and grows, on demand, up to its maximum size (default 1,
+ *  so by default all statements use the primary connection exactly as
+ *  before).  Checkouts have thread affinity: while a thread holds a
+ *  connection all its further checkouts return the same one, so nested
+ *  statements (e.g. SEQNO locking) stay on one database session.  A
+ *  thread that finds every connection taken waits for one to be
+ *  returned, however long that takes; a connection is never shared
+ *  between threads.  New connections are opened
+ *  without holding the pool's lock.  A pinned pool (one whose primary
+ *  connection holds temporary tables or an ASCII database) only ever
+ *  hands out the primary connection.
+ *
+ *  The pool size is set with the TDbiDatabaseManager configuration key
+ *  ConnectionPoolSize.
+ *
+ */
+
+#include "Rtypes.h"
+
+#include <ctime>
+#include <iosfwd>
+#include <vector>
+#ifndef __CINT__
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace CP {
+    class TDbiConnection;
+    class TDbiConnectionPool;
+    std::ostream& operator<<(std::ostream& s, const CP::TDbiConnectionPool& pool);
+
+    class TDbiConnectionPool {
+
+    public:
+
+// Constructors and destructors.
+        TDbiConnectionPool(TDbiConnection* primary, UInt_t maxSize = 1);
+        virtual ~TDbiConnectionPool();
+
+// State testing member functions
+        UInt_t GetMaxSize() const {
+            return fMaxSize;
+        }
+        UInt_t GetNumCheckouts() const {
+            return fNumCheckouts;
+        }
+        UInt_t GetNumReconnectsAvoided() const;
+        UInt_t GetNumWaits() const {
+            return fNumWaits;
+        }
+        TDbiConnection* GetPrimary() const {
+            return fPrimary;
+        }
+        UInt_t GetSize() const;
+        Bool_t IsPinned() const {
+            return fPinned;
+        }
+
+// State changing member functions
+
+/// Check out a connection (never zero).  Caller must Return it.
+        TDbiConnection* Checkout();
+/// Return a connection obtained from Checkout.
+        void Return(TDbiConnection* con);
+
+/// Hold/release the primary connection (see TDbiConnectionMaintainer).
+        void Hold();
+        void Release();
+
+/// Close connections that have lingered too long (see
+/// TDbiConnection::CloseIfLingerExpired).
+        void ReapIdle(time_t now);
+
+        void SetMaxSize(UInt_t maxSize);
+        void SetPinned(Bool_t pinned = kTRUE) {
+            fPinned = pinned;
+        }
+
+    private:
+
+// Disabled (not implemented) copy constructor and asignment.
+
+        TDbiConnectionPool(const TDbiConnectionPool&);
+        CP::TDbiConnectionPool& operator=(const CP::TDbiConnectionPool&);
+
+        TDbiConnection* OpenConnection() const;
+
+// Data members
+
+/// The cascader's connection (not owned).
+        TDbiConnection* fPrimary;
+
+/// All connections, fPrimary first.  All but fPrimary are owned.
+        std::vector<TDbiConnection*> fConnections;
+
+/// Number of checkouts outstanding for each connection.
+        std::vector<UInt_t> fCheckedOut;
+
+/// Maximum number of connections.
+        UInt_t fMaxSize;
+
+/// If true only fPrimary is used.
+        Bool_t fPinned;
+
+/// Statistics: total checkouts and number that had to wait.
+        UInt_t fNumCheckouts;
+        UInt_t fNumWaits;
+
+/// Number of connections being opened (outside fMutex) by Checkout.
+        UInt_t fNumOpening;
+
+#ifndef __CINT__
+/// Thread holding each connection (meaningful while fCheckedOut > 0).
+        std::vector<std::thread::id> fOwner;
+
+        mutable std::mutex fMutex;
+        std::condition_variable fReturned;
+#endif
+
+        ClassDef(TDbiConnectionPool,0)   // Pool of connections to one database.
+
+    };
+};
+
+#endif  // DBICONNECTIONPOOL_H
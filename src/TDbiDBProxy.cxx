@@ -4,8 +4,11 @@
 //////////////////////////////////////////////////////////////////////////
 
 
+#include <algorithm>
 #include <memory>
 #include <cassert>
+#include <set>
+#include <sstream>
 
 #include "TCollection.h"
 #include "TList.h"
@@ -21,12 +24,14 @@
 #include "TDbiCascader.hxx"
 #include "TDbiFieldType.hxx"
 #include "TDbiInRowStream.hxx"
+#include "TDbiMetaDataCache.hxx"
 #include "TDbiServices.hxx"
 #include "TDbiString.hxx"
 #include "TDbiStatement.hxx"
 #include "TDbiTableMetaData.hxx"
 #include "TDbiTimerManager.hxx"
 #include "TDbiValidityRec.hxx"
+#include "TDbiVldSnapshot.hxx"
 #include <TDbiLog.hxx>
 #include <MsgFormat.hxx>
 #include "TVldContext.hxx"
@@ -41,6 +46,31 @@ ClassImp(CP::TDbiDBProxy)
 //   Definition of static data members
 //   *********************************
 
+// Upper limit on the size of a set-based maintenance statement, whatever
+// the server accepts, and the space left below the limit for the rest
+// of the statement.
+static const UInt_t kMaxSetStatementSize   = 1024*1024;
+static const UInt_t kSetStatementHeadroom  = 1024;
+
+// Minimum length of a run of consecutive SEQNOs selected with BETWEEN
+// rather than listed.
+static const UInt_t kMinSeqNoRun = 3;
+
+//   Definition of file static functions
+//   ***********************************
+
+// Combine BETWEEN terms, separated by "or", and a comma separated list
+// of SEQNOs into a single condition.
+static std::string JoinSeqNoCondition(const std::string& ranges,
+                                      const std::string& list) {
+    std::string cond = "(" + ranges;
+    if (! list.empty()) {
+        cond += ranges.empty() ? "SEQNO in (" : " or SEQNO in (";
+        cond += list + ")";
+    }
+    return cond + ")";
+}
+
 
 //    Definition of all member functions (static or otherwise)
 //    *******************************************************
@@ -87,7 +117,142 @@ CP::TDbiDBProxy::~TDbiDBProxy() {
              << fTableName << " at " << this
              << "  ");
 
+    this->ClearVldSnapshots();
+
+}
+//.....................................................................
+
+void CP::TDbiDBProxy::AdoptVldSnapshot(UInt_t dbNo,
+                                       CP::TDbiVldSnapshot* snapshot) {
+//
+//
+//  Purpose:  Take ownership of a VLD snapshot for cascade entry dbNo,
+//            replacing any existing one.  It is used, like those made by
+//            LoadVldSnapshots, until ClearVldSnapshots is called.
+
+    if (dbNo >= this->GetNumDb()) {
+        delete snapshot;
+        return;
+    }
+    if (fVldSnapshots.size() < this->GetNumDb()) {
+        fVldSnapshots.resize(this->GetNumDb(),0);
+    }
+    delete fVldSnapshots[dbNo];
+    fVldSnapshots[dbNo] = snapshot;
+
+}
+//.....................................................................
+
+Bool_t CP::TDbiDBProxy::ApplyUpdates(CP::TDbiStatement& stmtDb,
+                                     const std::vector<std::string>& sqls,
+                                     UInt_t dbNo,
+                                     const char* what) const {
+    //
+    //
+    //  Purpose:  Apply updates in a single transaction.
+    //
+    //  Arguments:
+    //    stmtDb       in    Statement of the cascade entry.
+    //    sqls         in    The updates, applied in order.
+    //    dbNo         in    Database number in cascade (starting at 0).
+    //    what         in    Name of the operation for messages.
+    //
+    //  Return:    kTRUE if all applied and committed, otherwise kFALSE
+    //             having rolled back.
+    //
+    //  Program Notes:-
+    //  =============
+    //
+    //  MySQL MyISAM tables ignore transactions so a failure part way
+    //  through can still leave some updates applied.
+
+    stmtDb.StartTransaction();
+    if (stmtDb.PrintExceptions()) {
+        return false;
+    }
+
+    Bool_t ok = true;
+    for (UInt_t index = 0; ok && index < sqls.size(); ++index) {
+        DbiTrace("Database: " << dbNo
+                   << " " << what << " SQL: " << sqls[index] << "  ");
+        if (! stmtDb.ExecuteUpdate(sqls[index].c_str())
+            || stmtDb.PrintExceptions()) {
+            DbiSevere("SQL: " << sqls[index].substr(0,200)
+                      << " Failed. " << "  ");
+            ok = false;
+        }
+    }
+    if (ok) {
+        stmtDb.Commit();
+        ok = ! stmtDb.PrintExceptions();
+    }
+    if (! ok) {
+        stmtDb.Rollback();
+        stmtDb.PrintExceptions();
+        DbiSevere(what << " of " << fTableName << " in cascade entry "
+                  << dbNo << " failed; rolled back" << "  ");
+    }
+    return ok;
+
+}
+
+//.....................................................................
+
+void CP::TDbiDBProxy::ClearVldSnapshots() {
+//
+//
+//  Purpose: Delete all VLD snapshots so that they are reloaded on next use.
+
+    for (std::vector<CP::TDbiVldSnapshot*>::iterator itr = fVldSnapshots.begin();
+         itr != fVldSnapshots.end();
+         ++itr) {
+        delete *itr;
+    }
+    fVldSnapshots.clear();
+
+}
+//.....................................................................
+
+UInt_t CP::TDbiDBProxy::CountValidities() const {
+//
+//
+//  Purpose:  Count validity records.
+//
+//  Return:    Number of rows in the VLD table, qualified by fSqlCondition
+//             if defined, summed over the cascade.
+//
+//  Program Notes:-
+//  =============
+//
+//  Only used for statistics so errors are treated as zero rows.
+
+    UInt_t numRows = 0;
+    UInt_t numDb   = this->GetNumDb();
+    for (UInt_t dbNo = 0; dbNo < numDb; ++dbNo) {
+        if (! this->TableExists(dbNo)) {
+            continue;
+        }
+        CP::TDbiString sql;
+        sql << "select count(*) from " << fTableName << "VLD";
+        if (fSqlCondition != "") {
+            sql << " where " << fSqlCondition;
+        }
+        DbiTrace("Database: " << dbNo
+                 << " count query: " << sql.c_str() << "  ");
+        std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader.CreateStatement(dbNo));
+        if (! stmtDb.get()) {
+            continue;
+        }
+        std::unique_ptr<TSQLStatement> stmt(stmtDb->ExecuteQuery(sql.c_str()));
+        stmtDb->PrintExceptions(CP::TDbiLog::DebugLevel);
+        if (stmt.get() && stmt->NextResultRow() && ! stmt->IsNull(0)) {
+            numRows += stmt->GetUInt(0);
+        }
+    }
+    return numRows;
+
 }
+
 //.....................................................................
 
 void CP::TDbiDBProxy::FindTimeBoundaries(const CP::TVldContext& vc,
@@ -226,6 +391,48 @@ void CP::TDbiDBProxy::FindTimeBoundaries(const CP::TVldContext& vc,
 }
 //.....................................................................
 
+const CP::TDbiVldSnapshot* CP::TDbiDBProxy::GetVldSnapshot(UInt_t dbNo,
+                                                           const CP::TVldTimeStamp& ts) const {
+//
+//
+//  Purpose:  Return VLD snapshot for cascade entry dbNo.
+//
+//  Arguments:
+//    dbNo         in    Database number in cascade (starting at 0).
+//    ts           in    Context time of the query.
+//
+//  Return:    Snapshot or 0 if snapshot mode is disabled or the snapshot
+//             does not cover ts.  Snapshot remains owned by this object.
+//
+//  Specification:-
+//  =============
+//
+//  o Return any snapshot already loaded (see also LoadVldSnapshots).
+//
+//  o Otherwise, in snapshot mode, load the snapshot using the time range
+//    configured in TDbiServices.
+
+    if (dbNo >= this->GetNumDb()) {
+        return 0;
+    }
+    if (fVldSnapshots.size() < this->GetNumDb()) {
+        fVldSnapshots.resize(this->GetNumDb(),0);
+    }
+    CP::TDbiVldSnapshot*& snapshot = fVldSnapshots[dbNo];
+    if (! snapshot) {
+        if (! CP::TDbiServices::VldSnapshot()) {
+            return 0;
+        }
+        CP::TVldTimeStamp start(CP::TDbiServices::VldSnapshotStart(),0);
+        CP::TVldTimeStamp end(CP::TDbiServices::VldSnapshotEnd(),0);
+        snapshot = new CP::TDbiVldSnapshot(*this,dbNo,start,end);
+    }
+    return snapshot->Covers(ts) ? snapshot : 0;
+
+}
+
+//.....................................................................
+
 UInt_t CP::TDbiDBProxy::GetNumDb() const {
     //
     //
@@ -241,6 +448,147 @@ Bool_t CP::TDbiDBProxy::HasEpoch() const {
 }
 //.....................................................................
 
+void CP::TDbiDBProxy::LoadVldSnapshots(const CP::TVldTimeStamp& start,
+                                       const CP::TVldTimeStamp& end) {
+//
+//
+//  Purpose:  Load VLD snapshots for all cascade entries.
+//
+//  Arguments:
+//    start        in    Start of time range to load.
+//    end          in    End of time range to load (exclusive).
+//
+//  Specification:-
+//  =============
+//
+//  o Replace any existing snapshots with ones covering the supplied
+//    range for every cascade entry that has the table.  They are used,
+//    whether or not snapshot mode is enabled, until ClearVldSnapshots
+//    or SetSqlCondition is called.
+
+    this->ClearVldSnapshots();
+    UInt_t numDb = this->GetNumDb();
+    fVldSnapshots.resize(numDb,0);
+    for (UInt_t dbNo = 0; dbNo < numDb; ++dbNo) {
+        if (this->TableExists(dbNo)) {
+            fVldSnapshots[dbNo] = new CP::TDbiVldSnapshot(*this,dbNo,start,end);
+        }
+    }
+
+}
+
+//.....................................................................
+
+void CP::TDbiDBProxy::MakeSeqNoConditions(std::vector<Int_t> seqNos,
+                                          std::string::size_type maxSize,
+                                          std::vector<std::string>& conditions) {
+    //
+    //
+    //  Purpose:  Express a set of SEQNOs as SQL conditions.
+    //
+    //  Arguments:
+    //    seqNos       in    The SEQNOs (in any order, duplicates allowed).
+    //    maxSize      in    Maximum length of a condition.
+    //    conditions   out   Conditions, on SEQNO, that together select
+    //                       exactly seqNos.
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Select runs of at least kMinSeqNoRun consecutive SEQNOs with
+    //    BETWEEN and list the rest with IN.
+    //
+    //  o Start a new condition whenever the current one would exceed
+    //    maxSize.
+
+    conditions.clear();
+    std::sort(seqNos.begin(),seqNos.end());
+    seqNos.erase(std::unique(seqNos.begin(),seqNos.end()),seqNos.end());
+
+    std::string ranges;
+    std::string list;
+    std::vector<Int_t>::size_type index = 0;
+    while (index < seqNos.size()) {
+        std::vector<Int_t>::size_type last = index;
+        while (last+1 < seqNos.size() && seqNos[last+1] == seqNos[last]+1) {
+            ++last;
+        }
+        Bool_t isRun = last - index + 1 >= kMinSeqNoRun;
+        std::ostringstream term;
+        if (isRun) {
+            term << "SEQNO between " << seqNos[index] << " and " << seqNos[last];
+        }
+        else {
+            term << seqNos[index];
+            last = index;
+        }
+        if (! (ranges.empty() && list.empty())
+            && ranges.size() + list.size() + term.str().size() + 20 > maxSize) {
+            conditions.push_back(JoinSeqNoCondition(ranges,list));
+            ranges.clear();
+            list.clear();
+        }
+        std::string& part = isRun ? ranges : list;
+        if (! part.empty()) {
+            part += isRun ? " or " : ",";
+        }
+        part += term.str();
+        index = last + 1;
+    }
+    if (! (ranges.empty() && list.empty())) {
+        conditions.push_back(JoinSeqNoCondition(ranges,list));
+    }
+
+}
+
+//.....................................................................
+
+std::string CP::TDbiDBProxy::MakeValidityRangeSelect(const CP::TVldTimeStamp& start,
+                                                     const CP::TVldTimeStamp& end,
+                                                     UInt_t tag) const {
+    //
+    //
+    //  Purpose:  Return a select of validity records for a time range
+    //            suitable for combining with those of other tables.
+    //
+    //  Arguments:
+    //    start        in    Start of time range.
+    //    end          in    End of time range (exclusive).
+    //    tag          in    Value of final column, used to identify the
+    //                       table when selects are combined with union.
+    //
+    //  Return:    SQL select (without terminating ';').
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Select the same rows as QueryValidityRange but with fixed columns
+    //    so that all VLD tables have the same layout:-
+    //
+    //      SEQNO TIMESTART TIMEEND EPOCH DETECTORMASK SIMMASK TASK
+    //      AGGREGATENO CREATIONDATE INSERTDATE tag
+    //
+    //    EPOCH is 0 for tables that don't have one.
+    //
+    //  o Rows are not ordered; TDbiVldSnapshot sorts them.
+
+    CP::TDbiString sql;
+    sql << "select SEQNO,TIMESTART,TIMEEND,"
+        << (this->HasEpoch() ? "EPOCH" : "0")
+        << ",DETECTORMASK,SIMMASK,TASK,AGGREGATENO,CREATIONDATE,INSERTDATE,"
+        << tag << " from " << fTableName << "VLD"
+        << " where " ;
+    if (fSqlCondition != "") {
+        sql << fSqlCondition << " and ";
+    }
+    sql << "TimeStart < '" << TDbi::MakeDateTimeString(end) << "' "
+        << "and TimeEnd > '" << TDbi::MakeDateTimeString(start) << "'";
+    return sql.GetString();
+
+}
+
+//.....................................................................
+
 CP::TDbiInRowStream*  CP::TDbiDBProxy::QueryAllValidities(UInt_t dbNo,UInt_t seqNo) const {
     //
     //
@@ -299,6 +647,129 @@ CP::TDbiInRowStream*  CP::TDbiDBProxy::QueryAllValidities(UInt_t dbNo,UInt_t seq
 
 
 
+//.....................................................................
+
+UInt_t CP::TDbiDBProxy::QueryFingerprint(const std::string& fingerprint,
+                                         UInt_t dbNo) const {
+    //
+    //
+    //  Purpose:  Find a stored validity set with the same content.
+    //
+    //  Arguments:
+    //    fingerprint  in    Fingerprint of the set (see
+    //                       TDbiSqlValPacket::GetFingerprint).
+    //    dbNo         in    Database number in cascade (starting at 0).
+    //
+    //  Return:    SEQNO of such a set or 0 if none.
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Look up the fingerprint using the DBIFINGERPRINT index, ignoring
+    //    sets whose VLD row has since been removed.
+
+    if (fingerprint.empty() || ! fCascader.TableExists("DBIFINGERPRINT",dbNo)) {
+        return 0;
+    }
+    std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader.CreateStatement(dbNo));
+    if (! stmtDb.get()) {
+        return 0;
+    }
+
+    CP::TDbiString sql;
+    sql << "select f.SEQNO from DBIFINGERPRINT f, " << fTableName << "VLD v"
+        << " where f.TABLENAME = '" << fTableName << "'"
+        << " and f.FINGERPRINT = '" << fingerprint << "'"
+        << " and v.SEQNO = f.SEQNO limit 1;";
+
+    DbiTrace("Database: " << dbNo
+               << " fingerprint query: " << sql.c_str() << "  ");
+
+    TSQLStatement* stmt = stmtDb->ExecuteQuery(sql.c_str());
+    stmtDb->PrintExceptions();
+    UInt_t seqNo = 0;
+    if (stmt && stmt->NextResultRow()) {
+        seqNo = stmt->GetUInt(0);
+    }
+    delete stmt;
+    return seqNo;
+
+}
+
+//.....................................................................
+
+CP::TDbiInRowStream*  CP::TDbiDBProxy::QueryOverlayValidity(const CP::TVldTimeStamp& start,
+                                                            const CP::TVldTimeStamp& end,
+                                                            Int_t detMask,
+                                                            Int_t simMask,
+                                                            const TDbi::Task& task,
+                                                            Int_t aggNo,
+                                                            UInt_t dbNo,
+                                                            Bool_t bestOnly) const {
+    //
+    //
+    //  Purpose:  Apply overlay validity query to database.
+    //
+    //  Arguments:
+    //    start        in    Start of time range.
+    //    end          in    End of time range (exclusive).
+    //    detMask      in    Detector mask of the data to be overlaid.
+    //    simMask      in    SimFlag mask of the data to be overlaid.
+    //    task         in    The task of the query.
+    //    aggNo        in    The aggregate number of the query.
+    //    dbNo         in    Database number in cascade (starting at 0).
+    //    bestOnly     in    If true return only the highest priority record.
+    //
+    //  Return:    New CP::TDbiResultSet object.
+    //             NB  Caller is responsible for deleting..
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Return the validity records of a single aggregate that overlap
+    //    the time range and masks, qualifying selection by fSqlCondition if
+    //    defined, in the same priority order as QueryValidity.
+    //
+    //  Program Notes:-
+    //  =============
+    //
+    //  Used to find the record that new data would overlay (see
+    //  TDbiTableProxy::QueryOverlayCreationDate) without the time gate
+    //  and time boundary queries of a full context query.
+
+    CP::TDbiString sql;
+
+    std::string orderByName("CREATIONDATE desc");
+    if (this->HasEpoch()) {
+        orderByName = "EPOCH desc,TIMESTART desc,INSERTDATE desc";
+    }
+    sql << "select * from " << fTableName << "VLD"
+        << " where " ;
+    if (fSqlCondition != "") {
+        sql << fSqlCondition << " and ";
+    }
+    sql << "TimeStart < '" << TDbi::MakeDateTimeString(end) << "' "
+        << "and TimeEnd > '" << TDbi::MakeDateTimeString(start) << "' "
+        << "and DetectorMask & " << static_cast<unsigned int>(detMask)
+        << " and SimMask & " << static_cast<unsigned int>(simMask)
+        << " and Task = " << task
+        << " and AggregateNo = " << aggNo
+        << " order by " << orderByName;
+    if (bestOnly) {
+        sql << " limit 1";
+    }
+    sql << ";" << '\0';
+
+    DbiTrace("Database: " << dbNo
+               << " overlay query: " << sql.c_str() << "  ");
+
+    //  Apply query and return result..
+
+    CP::TDbiStatement* stmtDb = fCascader.CreateStatement(dbNo);
+    return new CP::TDbiInRowStream(stmtDb,sql,fMetaValid,fTableProxy,dbNo);
+
+}
+
 //.....................................................................
 
 CP::TDbiInRowStream*  CP::TDbiDBProxy::QuerySeqNo(UInt_t seqNo, UInt_t dbNo) const {
@@ -603,6 +1074,55 @@ CP::TDbiInRowStream*  CP::TDbiDBProxy::QueryValidity(UInt_t seqNo,
 
 //.....................................................................
 
+CP::TDbiInRowStream*  CP::TDbiDBProxy::QueryValidityRange(const CP::TVldTimeStamp& start,
+                                                          const CP::TVldTimeStamp& end,
+                                                          UInt_t dbNo) const {
+    //
+    //
+    //  Purpose:  Apply time range validity query to database.
+    //
+    //  Arguments:
+    //    start        in    Start of time range.
+    //    end          in    End of time range (exclusive).
+    //    dbNo         in    Database number in cascade (starting at 0).
+    //
+    //  Return:    New CP::TDbiResultSet object.
+    //             NB  Caller is responsible for deleting..
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Return all validity records, for any detector, SimFlag and task,
+    //    that overlap the time range, qualifying selection by fSqlCondition
+    //    if defined, in the same priority order as QueryValidity.
+
+    CP::TDbiString sql;
+
+    std::string orderByName("CREATIONDATE desc");
+    if (this->HasEpoch()) {
+        orderByName = "EPOCH desc,TIMESTART desc,INSERTDATE desc";
+    }
+    sql << "select * from " << fTableName << "VLD"
+        << " where " ;
+    if (fSqlCondition != "") {
+        sql << fSqlCondition << " and ";
+    }
+    sql << "TimeStart < '" << TDbi::MakeDateTimeString(end) << "' "
+        << "and TimeEnd > '" << TDbi::MakeDateTimeString(start) << "'"
+        << " order by " << orderByName << ";" << '\0';
+
+    DbiTrace("Database: " << dbNo
+               << " range query: " << sql.c_str() << "  ");
+
+    //  Apply query and return result..
+
+    CP::TDbiStatement* stmtDb = fCascader.CreateStatement(dbNo);
+    return new CP::TDbiInRowStream(stmtDb,sql,fMetaValid,fTableProxy,dbNo);
+
+}
+
+//.....................................................................
+
 Bool_t CP::TDbiDBProxy::RemoveSeqNo(UInt_t seqNo,
                                     UInt_t dbNo) const {
     //
@@ -616,55 +1136,128 @@ Bool_t CP::TDbiDBProxy::RemoveSeqNo(UInt_t seqNo,
     //  Return:    kTRUE if output successful,otherwise kFALSE.
     //
     //  Contact:   N. West
+
+    std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader.CreateStatement(dbNo));
+    if (! stmtDb.get()) {
+        return false;
+    }
+    return this->RemoveSeqNo(seqNo,*stmtDb);
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiDBProxy::RemoveSeqNo(UInt_t seqNo,
+                                    CP::TDbiStatement& stmtDb) const {
+    //
+    //
+    //  Purpose:  Remove sequence number in main and auxiliary tables.
+    //
+    //  Arguments:
+    //    seqNo        in    The sequence number to be removed.
+    //    stmtDb       in    Statement of the cascade entry to use.
+    //
+    //  Return:    kTRUE if output successful,otherwise kFALSE.
+    //
+    //  Contact:   N. West
     //
     //  Specification:-
     //  =============
     //
     //  o Remove sequence number in main and auxiliary tables.
+    //
+    //  o Also remove any fingerprint held for it, as RemoveSeqNos does.
 
     //  Program Notes:-
     //  =============
 
-    //  None.
+    //  The caller's statement does not identify its cascade entry so
+    //  DBIFINGERPRINT is looked for on the statement's own connection.
 
+    std::vector<std::pair<std::string,std::string> > tables;
+    tables.push_back(std::make_pair(fTableName,std::string()));
+    tables.push_back(std::make_pair(fTableName + "VLD",std::string()));
+    if (stmtDb.TableExists("DBIFINGERPRINT")) {
+        tables.push_back(std::make_pair(std::string("DBIFINGERPRINT"),
+                                        "TABLENAME = '" + fTableName + "' and "));
+    }
 
-    // Generate SQL to remove SeqNo in main table.
-    CP::TDbiString sql;
-    sql  << "delete from  " << fTableName
-         << " where SEQNO = " << seqNo << ";"
-         << '\0';
+    for (UInt_t table = 0; table < tables.size(); ++table) {
+        CP::TDbiString sql;
+        sql << "delete from  " << tables[table].first << " where "
+            << tables[table].second << "SEQNO = " << seqNo << ";"
+            << '\0';
 
-    DbiTrace("Database: " << dbNo
-               << " RemoveSeqNo SQL: " << sql.c_str() << "  ");
+        DbiTrace("RemoveSeqNo SQL: " << sql.c_str() << "  ");
 
-    //  Apply query.
-    std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader.CreateStatement(dbNo));
-    if (! stmtDb.get()) {
-        return false;
-    }
-    if (! stmtDb->ExecuteUpdate(sql.c_str()) || stmtDb->PrintExceptions()) {
-        DbiSevere("SQL: " << sql.c_str()
-                  << " Failed. " << "  ");
-        return false;
+        //  Apply query.
+        if (! stmtDb.ExecuteUpdate(sql.c_str()) || stmtDb.PrintExceptions()) {
+            DbiSevere("SQL: " << sql.c_str()
+                      << " Failed. " << "  ");
+            return false;
+        }
     }
 
-    // Generate SQL to remove SeqNo in validity table.
-    sql.GetString().erase();
-    sql << "delete from  " << fTableName
-        << "VLD where SEQNO = " << seqNo << ";"
-        << '\0';
+    return true;
 
-    DbiTrace("Database: " << dbNo
-               << " RemoveSeqNo SQL: " << sql.c_str() << "  ");
+}
 
-    //  Apply query.
-    if (! stmtDb->ExecuteUpdate(sql.c_str()) ||  stmtDb->PrintExceptions()) {
-        DbiSevere("SQL: " << sql.c_str()
-                  << " Failed. " << "  ");
+//.....................................................................
+
+Bool_t CP::TDbiDBProxy::RemoveSeqNos(const std::vector<UInt_t>& seqNos,
+                                     UInt_t dbNo) const {
+    //
+    //
+    //  Purpose:  Remove a set of sequence numbers in main and auxiliary
+    //            tables.
+    //
+    //  Arguments:
+    //    seqNos       in    The sequence numbers to be removed.
+    //    dbNo         in    Database number in cascade (starting at 0).
+    //
+    //  Return:    kTRUE if all removed, otherwise kFALSE with none
+    //             removed.
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Delete with as few statements as possible, selecting SEQNOs by
+    //    range and list (see MakeSeqNoConditions), all in one transaction.
+    //
+    //  o Also remove any fingerprints held for them.
+
+    if (seqNos.empty()) {
+        return true;
+    }
+    std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader.CreateStatement(dbNo));
+    if (! stmtDb.get()) {
         return false;
     }
 
-    return true;
+    std::vector<std::string> conditions;
+    MakeSeqNoConditions(std::vector<Int_t>(seqNos.begin(),seqNos.end()),
+                        std::min<UInt_t>(stmtDb->GetMaxStatementSize(),
+                                         kMaxSetStatementSize)
+                        - kSetStatementHeadroom,
+                        conditions);
+
+    std::vector<std::pair<std::string,std::string> > tables
+        = this->SeqNoTables(dbNo);
+    std::vector<std::string> sqls;
+    for (UInt_t table = 0; table < tables.size(); ++table) {
+        for (UInt_t cond = 0; cond < conditions.size(); ++cond) {
+            sqls.push_back("delete from " + tables[table].first + " where "
+                           + tables[table].second + conditions[cond] + ";");
+        }
+    }
+
+    Bool_t ok = this->ApplyUpdates(*stmtDb,sqls,dbNo,"RemoveSeqNos");
+    if (ok) {
+        DbiLog("Removed " << seqNos.size() << " SEQNOs from " << fTableName
+               << " in cascade entry " << dbNo << " with " << sqls.size()
+               << " statements" << "  ");
+    }
+    return ok;
 
 }
 
@@ -714,6 +1307,48 @@ Bool_t CP::TDbiDBProxy::ReplaceInsertDate(const CP::TVldTimeStamp& ts,
 }
 //.....................................................................
 
+Bool_t CP::TDbiDBProxy::ReplaceInsertDates(const CP::TVldTimeStamp& ts,
+                                           const std::vector<UInt_t>& seqNos,
+                                           UInt_t dbNo) const {
+    //
+    //
+    //  Purpose:  Replace insertion date for a set of sequence numbers.
+    //
+    //  Arguments:
+    //    ts           in    Time stamp for new insertion date.
+    //    seqNos       in    The sequence numbers of the rows to be replaced.
+    //    dbNo         in    Database number in cascade (starting at 0).
+    //
+    //  Return:    kTRUE if all replaced, otherwise kFALSE with none
+    //             replaced.
+
+    if (seqNos.empty()) {
+        return true;
+    }
+    std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader.CreateStatement(dbNo));
+    if (! stmtDb.get()) {
+        return false;
+    }
+
+    std::vector<std::string> conditions;
+    MakeSeqNoConditions(std::vector<Int_t>(seqNos.begin(),seqNos.end()),
+                        std::min<UInt_t>(stmtDb->GetMaxStatementSize(),
+                                         kMaxSetStatementSize)
+                        - kSetStatementHeadroom,
+                        conditions);
+
+    std::vector<std::string> sqls;
+    for (UInt_t cond = 0; cond < conditions.size(); ++cond) {
+        sqls.push_back("update " + fTableName + "VLD set INSERTDATE = \'"
+                       + ts.AsString("s") + "\' where " + conditions[cond]
+                       + ";");
+    }
+    return this->ApplyUpdates(*stmtDb,sqls,dbNo,"ReplaceInsertDates");
+
+}
+
+//.....................................................................
+
 Bool_t CP::TDbiDBProxy::ReplaceSeqNo(UInt_t oldSeqNo,
                                      UInt_t newSeqNo,
                                      UInt_t dbNo) const {
@@ -734,6 +1369,8 @@ Bool_t CP::TDbiDBProxy::ReplaceSeqNo(UInt_t oldSeqNo,
     //  =============
     //
     //  o Replace sequence number in main and auxiliary tables.
+    //
+    //  o Also renumber any fingerprint held for it, as ReplaceSeqNos does.
 
     //  Program Notes:-
     //  =============
@@ -746,44 +1383,302 @@ Bool_t CP::TDbiDBProxy::ReplaceSeqNo(UInt_t oldSeqNo,
         return false;
     }
 
-    // Generate SQL to replace SeqNo in validity table.
-    CP::TDbiString sql;
-    sql << "update  " << fTableName
-        << "VLD set SEQNO = " << newSeqNo
-        << " where SEQNO = " << oldSeqNo << ";"
-        << '\0';
+    std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader.CreateStatement(dbNo));
+    if (! stmtDb.get()) {
+        return false;
+    }
 
-    DbiTrace("Database: " << dbNo
-               << " ReplaceSeqNo SQL: " << sql.c_str() << "  ");
+    std::vector<std::pair<std::string,std::string> > tables
+        = this->SeqNoTables(dbNo);
+    for (UInt_t table = 0; table < tables.size(); ++table) {
+        CP::TDbiString sql;
+        sql << "update  " << tables[table].first
+            << " set SEQNO = " << newSeqNo
+            << " where " << tables[table].second << "SEQNO = " << oldSeqNo
+            << ";" << '\0';
+
+        DbiTrace("Database: " << dbNo
+                   << " ReplaceSeqNo SQL: " << sql.c_str() << "  ");
+
+        //  Apply query.
+        if (! stmtDb->ExecuteUpdate(sql.c_str()) || stmtDb->PrintExceptions()) {
+            DbiSevere("SQL: " << sql.c_str()
+                      << " Failed. " << "  ");
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiDBProxy::ReplaceSeqNos(const std::vector<std::pair<UInt_t,UInt_t> >& seqNoPairs,
+                                      UInt_t dbNo) const {
+    //
+    //
+    //  Purpose:  Replace a set of sequence numbers in main and auxiliary
+    //            tables.
+    //
+    //  Arguments:
+    //    seqNoPairs   in    (old,new) sequence numbers.
+    //    dbNo         in    Database number in cascade (starting at 0).
+    //
+    //  Return:    kTRUE if all replaced, otherwise kFALSE with none
+    //             replaced.
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Reject the set if any old or new SEQNO appears twice.
+    //
+    //  o Renumber runs of at least kMinSeqNoRun consecutive old SEQNOs
+    //    moved by the same offset with one range update and the rest with
+    //    CASE updates over lists of SEQNOs, all in one transaction.
+    //
+    //  o If any new SEQNO is also an old one first negate all the old
+    //    SEQNOs, so that no row is renumbered onto one yet to be moved,
+    //    and then renumber from the negated values.
+    //
+    //  o Also renumber any fingerprints held for them.
+
+    if (seqNoPairs.empty()) {
+        return true;
+    }
+
+    std::vector<std::pair<UInt_t,UInt_t> > pairs(seqNoPairs);
+    std::sort(pairs.begin(),pairs.end());
+    std::set<UInt_t> oldSeqNos;
+    std::set<UInt_t> newSeqNos;
+    for (UInt_t index = 0; index < pairs.size(); ++index) {
+        if (! oldSeqNos.insert(pairs[index].first).second
+            || ! newSeqNos.insert(pairs[index].second).second) {
+            DbiSevere("Cannot renumber SEQNO " << pairs[index].first
+                      << " to " << pairs[index].second << " of " << fTableName
+                      << "; SEQNO appears more than once" << "  ");
+            return false;
+        }
+    }
+    Bool_t negate = false;
+    for (std::set<UInt_t>::const_iterator itr = newSeqNos.begin();
+         ! negate && itr != newSeqNos.end();
+         ++itr) {
+        negate = oldSeqNos.count(*itr) > 0;
+    }
+    Int_t sign = negate ? -1 : 1;
+    const std::string current = negate ? "-SEQNO" : "SEQNO";
 
-    //  Apply query.
     std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader.CreateStatement(dbNo));
     if (! stmtDb.get()) {
         return false;
     }
-    if (! stmtDb->ExecuteUpdate(sql.c_str()) || stmtDb->PrintExceptions()) {
-        DbiSevere("SQL: " << sql.c_str()
-                  << " Failed. " << "  ");
-        return false;
+    std::string::size_type maxSize
+        = std::min<UInt_t>(stmtDb->GetMaxStatementSize(),kMaxSetStatementSize)
+          - kSetStatementHeadroom;
+
+    // Split into runs with a common offset, each as a (new value,
+    // condition) pair, and the remaining isolated pairs.
+    std::vector<std::pair<std::string,std::string> > runs;
+    std::vector<std::pair<UInt_t,UInt_t> > singles;
+    UInt_t index = 0;
+    while (index < pairs.size()) {
+        Long64_t offset = Long64_t(pairs[index].second) - pairs[index].first;
+        UInt_t last = index;
+        while (last+1 < pairs.size()
+               && pairs[last+1].first == pairs[last].first+1
+               && Long64_t(pairs[last+1].second) - pairs[last+1].first == offset) {
+            ++last;
+        }
+        if (last - index + 1 >= kMinSeqNoRun) {
+            Int_t bound1 = sign*Int_t(pairs[index].first);
+            Int_t bound2 = sign*Int_t(pairs[last].first);
+            std::ostringstream value;
+            value << current << (offset < 0 ? " - " : " + ")
+                  << (offset < 0 ? -offset : offset);
+            std::ostringstream cond;
+            cond << "SEQNO between " << std::min(bound1,bound2)
+                 << " and " << std::max(bound1,bound2);
+            runs.push_back(std::make_pair(value.str(),cond.str()));
+        }
+        else {
+            last = index;
+            singles.push_back(pairs[index]);
+        }
+        index = last + 1;
     }
 
-    // Generate SQL to replace SeqNo in main table.
-    sql.GetString().erase();
-    sql  << "update  " << fTableName
-         << " set SEQNO = " << newSeqNo
-         << " where SEQNO = " << oldSeqNo << ";"
-         << '\0';
+    std::vector<std::string> negateConds;
+    if (negate) {
+        MakeSeqNoConditions(std::vector<Int_t>(oldSeqNos.begin(),oldSeqNos.end()),
+                            maxSize,negateConds);
+    }
 
-    DbiTrace("Database: " << dbNo
-               << " ReplaceSeqNo SQL: " << sql.c_str() << "  ");
+    std::vector<std::pair<std::string,std::string> > tables
+        = this->SeqNoTables(dbNo);
+    std::vector<std::string> sqls;
+    for (UInt_t table = 0; table < tables.size(); ++table) {
+        const std::string update = "update " + tables[table].first
+                                   + " set SEQNO = ";
+        const std::string& where = tables[table].second;
+        for (UInt_t cond = 0; cond < negateConds.size(); ++cond) {
+            sqls.push_back(update + "-SEQNO where " + where
+                           + negateConds[cond] + ";");
+        }
+        for (UInt_t run = 0; run < runs.size(); ++run) {
+            sqls.push_back(update + runs[run].first + " where " + where
+                           + runs[run].second + ";");
+        }
+        std::ostringstream cases;
+        std::ostringstream list;
+        for (UInt_t single = 0; single < singles.size(); ++single) {
+            Int_t oldValue = sign*Int_t(singles[single].first);
+            if (! list.str().empty()) {
+                list << ",";
+            }
+            cases << " when " << oldValue << " then " << singles[single].second;
+            list << oldValue;
+            if (single+1 == singles.size()
+                || cases.str().size() + list.str().size() > maxSize) {
+                sqls.push_back(update + "case SEQNO" + cases.str()
+                               + " end where " + where + "SEQNO in ("
+                               + list.str() + ");");
+                cases.str("");
+                list.str("");
+            }
+        }
+    }
 
-    //  Apply query.
+    Bool_t ok = this->ApplyUpdates(*stmtDb,sqls,dbNo,"ReplaceSeqNos");
+    if (ok) {
+        DbiLog("Renumbered " << pairs.size() << " SEQNOs of " << fTableName
+               << " in cascade entry " << dbNo << " with " << sqls.size()
+               << " statements" << "  ");
+    }
+    return ok;
+
+}
+
+//.....................................................................
+
+std::vector<std::pair<std::string,std::string> >
+CP::TDbiDBProxy::SeqNoTables(UInt_t dbNo) const {
+    //
+    //
+    //  Purpose:  Return the tables holding rows keyed by this table's
+    //            SEQNOs, each with any condition (ending "and ") needed
+    //            to select its rows.
+    //
+    //  Arguments:
+    //    dbNo         in    Database number in cascade (starting at 0).
+
+    std::vector<std::pair<std::string,std::string> > tables;
+    tables.push_back(std::make_pair(fTableName + "VLD",std::string()));
+    tables.push_back(std::make_pair(fTableName,std::string()));
+    if (fCascader.TableExists("DBIFINGERPRINT",dbNo)) {
+        tables.push_back(std::make_pair(std::string("DBIFINGERPRINT"),
+                                        "TABLENAME = '" + fTableName + "' and "));
+    }
+    return tables;
+
+}
+
+//.....................................................................
+
+void CP::TDbiDBProxy::SetSqlCondition(const std::string& sql) {
+//
+//
+//  Purpose:  Set SQL condition (see Usage Notes).
+//
+//  Program Notes:-
+//  =============
+//
+//  VLD snapshots were loaded under the old condition so are discarded.
+
+    fSqlCondition = sql;
+    this->ClearVldSnapshots();
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiDBProxy::StoreFingerprint(UInt_t seqNo,
+                                         const std::string& fingerprint,
+                                         UInt_t dbNo) const {
+    //
+    //
+    //  Purpose:  Record the fingerprint of a stored validity set.
+    //
+    //  Arguments:
+    //    seqNo        in    The set's SEQNO.
+    //    fingerprint  in    Its fingerprint (see
+    //                       TDbiSqlValPacket::GetFingerprint).
+    //    dbNo         in    Database number in cascade (starting at 0).
+    //
+    //  Return:    kTRUE if recorded.
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Create the DBIFINGERPRINT table, and its index, if required.
+    //
+    //  o Replace any fingerprint already held for the SEQNO.
+
+    //  Program Notes:-
+    //  =============
+
+    //  The table is created outside of any transaction as MySQL commits
+    //  implicitly on CREATE.
+
+    if (fingerprint.empty()) {
+        return false;
+    }
+    std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader.CreateStatement(dbNo));
+    if (! stmtDb.get()) {
+        return false;
+    }
+
+    CP::TDbiString sql;
+    if (! fCascader.TableExists("DBIFINGERPRINT",dbNo)) {
+        sql << "CREATE TABLE DBIFINGERPRINT"
+            << "(TABLENAME      CHAR(64) NOT NULL,\n"
+            << " SEQNO          INT NOT NULL,\n"
+            << " FINGERPRINT    CHAR(32) NOT NULL,\n"
+            << " PRIMARY KEY (TABLENAME,SEQNO))";
+        DbiLog("Database: " << dbNo
+               << " create fingerprint table query: "
+               << sql.c_str() << "  ");
+        stmtDb->ExecuteUpdate(sql.c_str());
+        if (stmtDb->PrintExceptions()) {
+            return false;
+        }
+        sql.Clear();
+        sql << "CREATE INDEX DBIFINGERPRINTIDX"
+            << " ON DBIFINGERPRINT (TABLENAME,FINGERPRINT)";
+        stmtDb->ExecuteUpdate(sql.c_str());
+        if (stmtDb->PrintExceptions()) {
+            return false;
+        }
+        fCascader.GetConnection(dbNo)->SetTableExists("DBIFINGERPRINT");
+    }
+
+    sql.Clear();
+    sql << "delete from DBIFINGERPRINT where TABLENAME = '" << fTableName
+        << "' and SEQNO = " << seqNo << ";";
+    DbiTrace("StoreFingerprint SQL: " << sql.c_str() << "  ");
     if (! stmtDb->ExecuteUpdate(sql.c_str()) || stmtDb->PrintExceptions()) {
-        DbiSevere("SQL: " << sql.c_str()
-                  << " Failed. " << "  ");
+        DbiSevere("SQL: " << sql.c_str() << " Failed. " << "  ");
         return false;
     }
 
+    sql.Clear();
+    sql << "insert into DBIFINGERPRINT values ('" << fTableName << "',"
+        << seqNo << ",'" << fingerprint << "');";
+    DbiTrace("StoreFingerprint SQL: " << sql.c_str() << "  ");
+    if (! stmtDb->ExecuteUpdate(sql.c_str()) || stmtDb->PrintExceptions()) {
+        DbiSevere("SQL: " << sql.c_str() << " Failed. " << "  ");
+        return false;
+    }
     return true;
 
 }
@@ -799,10 +1694,35 @@ void  CP::TDbiDBProxy::StoreMetaData(CP::TDbiTableMetaData& metaData) const {
 
     DbiTrace("Get meta-data for table: " << metaData.TableName());
 
-    //  Check each Db in turn until table found and store table meta data.
+    //  Check each Db in turn until table found and store table meta data,
+    //  skipping entries that don't have the table and using the schema
+    //  discovered for the whole database (see
+    //  TDbiConnection::GetTableMetaData) if possible.
 
     for (UInt_t dbNo = 0; dbNo < fCascader.GetNumDb(); dbNo++) {
         CP::TDbiConnection* connection = fCascader.GetConnection(dbNo);
+        if (! connection || ! connection->TableExists(metaData.TableName())) {
+            continue;
+        }
+        CP::TDbiMetaDataCache& cache = CP::TDbiMetaDataCache::gMetaDataCache;
+        std::string schemaVersion;
+        if (cache.IsEnabled()) {
+            schemaVersion = connection->GetSchemaVersion();
+            if (cache.Fetch(connection->GetUrlString(),schemaVersion,metaData)) {
+                DbiTrace("Meta-data from cache for cascade entry "
+                         << dbNo << "  ");
+                return;
+            }
+        }
+        const CP::TDbiTableMetaData* discovered
+            = connection->GetTableMetaData(metaData.TableName());
+        if (discovered) {
+            DbiTrace("Meta-data from schema discovery on cascade entry "
+                     << dbNo << "  ");
+            metaData = *discovered;
+            cache.Store(connection->GetUrlString(),schemaVersion,metaData);
+            return;
+        }
         TSQLServer* server = connection->GetServer();
         if (! server) {
             continue;
@@ -863,6 +1783,7 @@ void  CP::TDbiDBProxy::StoreMetaData(CP::TDbiTableMetaData& metaData) const {
         }
         delete meta;
         connection->DisConnect();
+        cache.Store(connection->GetUrlString(),schemaVersion,metaData);
         return;
     }
 }
@@ -27,6 +27,13 @@
  *   QueryAllValidities
  *   QueryValidity
  *
+ * Fingerprints of stored validity sets, used to detect repeated
+ * uploads, are held in the DBIFINGERPRINT table of each cascade entry
+ * (TABLENAME, SEQNO, FINGERPRINT), created by the first
+ * StoreFingerprint and indexed on TABLENAME and FINGERPRINT.  The
+ * RemoveSeqNo(s) and ReplaceSeqNo(s) member functions keep them in step
+ * with the sets.
+ *
  * Contact: A.Finch@lancaster.ac.uk
  *
  *
@@ -36,14 +43,17 @@
 
 #include <string>
 #include <list>
+#include <utility>
 #include <vector>
 
 namespace CP {
     class TDbiCascader;
     class TDbiInRowStream;
+    class TDbiStatement;
     class TDbiTableMetaData;
     class TDbiTableProxy;
     class TDbiValidityRec;
+    class TDbiVldSnapshot;
 }
 namespace CP {
     class TVldContext;
@@ -70,6 +80,7 @@ namespace CP {
         virtual ~TDbiDBProxy();
 
 // State testing member functions
+        UInt_t CountValidities() const;
         Bool_t HasEpoch() const;
         UInt_t GetNumDb() const;
         const std::string& GetTableName() const {
@@ -78,6 +89,15 @@ namespace CP {
         const TDbiTableProxy* GetTableProxy() const {
             return fTableProxy;
         }
+/// Return the VLD snapshot for dbNo if it covers ts, loading it on
+/// first use if snapshot mode is enabled, otherwise return 0.
+        const TDbiVldSnapshot* GetVldSnapshot(UInt_t dbNo,
+                                              const CP::TVldTimeStamp& ts) const;
+/// Select of validity records in [start,end) with a fixed column layout
+/// and a final column holding tag, for combining tables with union.
+        std::string MakeValidityRangeSelect(const CP::TVldTimeStamp& start,
+                                            const CP::TVldTimeStamp& end,
+                                            UInt_t tag) const;
         void StoreMetaData(TDbiTableMetaData& metaData) const;
         Bool_t TableExists(Int_t selectDbNo=-1) const;
 
@@ -90,6 +110,21 @@ namespace CP {
                                 CP::TVldTimeStamp& start,
                                 CP::TVldTimeStamp& end) const;
         TDbiInRowStream* QueryAllValidities(UInt_t dbNo,UInt_t seqNo=0) const;
+/// SEQNO of a stored validity set with this fingerprint (see
+/// TDbiSqlValPacket::GetFingerprint) or 0 if none.
+        UInt_t QueryFingerprint(const std::string& fingerprint,
+                                UInt_t dbNo) const;
+/// Validity records of one aggregate overlapping [start,end) and the
+/// detector and SimFlag masks, in priority order; only the first if
+/// bestOnly.
+        TDbiInRowStream* QueryOverlayValidity(const CP::TVldTimeStamp& start,
+                                              const CP::TVldTimeStamp& end,
+                                              Int_t detMask,
+                                              Int_t simMask,
+                                              const TDbi::Task& task,
+                                              Int_t aggNo,
+                                              UInt_t dbNo,
+                                              Bool_t bestOnly) const;
         TDbiInRowStream* QuerySeqNo(UInt_t seqNo,UInt_t dbNo) const;
 #ifndef __CINT__
 /// Secondary query for aggregate and extended context queries.
@@ -106,21 +141,46 @@ namespace CP {
                                        UInt_t dbNo) const;
         TDbiInRowStream* QueryValidity(UInt_t seqNo,
                                        UInt_t dbNo) const;
+/// All validity records overlapping [start,end) in priority order.
+        TDbiInRowStream* QueryValidityRange(const CP::TVldTimeStamp& start,
+                                            const CP::TVldTimeStamp& end,
+                                            UInt_t dbNo) const;
 
 // Store (output) member functions
+/// Record the fingerprint of a stored validity set in DBIFINGERPRINT.
+        Bool_t StoreFingerprint(UInt_t seqNo,
+                                const std::string& fingerprint,
+                                UInt_t dbNo) const;
         Bool_t ReplaceInsertDate(const CP::TVldTimeStamp& ts,
                                  UInt_t SeqNo,
                                  UInt_t dbNo) const;
         Bool_t RemoveSeqNo(UInt_t seqNo,
                            UInt_t dbNo) const;
+/// As above but using the caller's statement, e.g. within its transaction.
+        Bool_t RemoveSeqNo(UInt_t seqNo,
+                           TDbiStatement& stmtDb) const;
         Bool_t ReplaceSeqNo(UInt_t oldSeqNo,
                             UInt_t newSeqNo,
                             UInt_t dbNo) const;
+#ifndef __CINT__
+/// Set-based variants for maintenance of many SEQNOs.  Each applies all
+/// its updates in one transaction and succeeds or fails as a whole.
+        Bool_t RemoveSeqNos(const std::vector<UInt_t>& seqNos,
+                            UInt_t dbNo) const;
+        Bool_t ReplaceInsertDates(const CP::TVldTimeStamp& ts,
+                                  const std::vector<UInt_t>& seqNos,
+                                  UInt_t dbNo) const;
+/// Pairs are (old SEQNO, new SEQNO).
+        Bool_t ReplaceSeqNos(const std::vector<std::pair<UInt_t,UInt_t> >& seqNoPairs,
+                             UInt_t dbNo) const;
+#endif
 
 // State changing member functions
-        void SetSqlCondition(const std::string& sql) {
-            fSqlCondition = sql;
-        }
+        void AdoptVldSnapshot(UInt_t dbNo, TDbiVldSnapshot* snapshot);
+        void ClearVldSnapshots();
+        void LoadVldSnapshots(const CP::TVldTimeStamp& start,
+                              const CP::TVldTimeStamp& end);
+        void SetSqlCondition(const std::string& sql);
 
     private:
 
@@ -129,6 +189,18 @@ namespace CP {
         TDbiDBProxy(const TDbiDBProxy&);
         CP::TDbiDBProxy& operator=(const CP::TDbiDBProxy&);
 
+#ifndef __CINT__
+        Bool_t ApplyUpdates(TDbiStatement& stmtDb,
+                            const std::vector<std::string>& sqls,
+                            UInt_t dbNo,
+                            const char* what) const;
+        static void MakeSeqNoConditions(std::vector<Int_t> seqNos,
+                                        std::string::size_type maxSize,
+                                        std::vector<std::string>& conditions);
+        std::vector<std::pair<std::string,std::string> >
+        SeqNoTables(UInt_t dbNo) const;
+#endif
+
 // Data members
 
 /// Reference to one and only cascader
@@ -150,6 +222,11 @@ namespace CP {
 /// Owning TDbiTableProxy.
         const TDbiTableProxy* fTableProxy;
 
+#ifndef __CINT__
+/// Owned VLD snapshots, indexed by cascade entry (lazily loaded).
+        mutable std::vector<TDbiVldSnapshot*> fVldSnapshots;
+#endif
+
         ClassDef(TDbiDBProxy,0)     //  Proxy for physical database.
 
     };
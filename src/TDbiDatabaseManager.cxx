@@ -1,7 +1,11 @@
 // $Id: TDbiDatabaseManager.cxx,v 1.2 2011/06/09 14:44:29 finch Exp $
+#include <algorithm>
 #include <vector>
 #include <cstdlib>
+#include <future>
+#include <memory>
 
+#include "TSQLStatement.h"
 #include "TSystem.h"
 
 #include "TString.h"
@@ -11,9 +15,17 @@
 #include "TDbiCache.hxx"
 #include "TDbiCascader.hxx"
 #include "TDbiConfigSet.hxx"
+#include "TDbiConnectionMaintainer.hxx"
 #include "TDbiServices.hxx"
 #include "TDbiDatabaseManager.hxx"
+#include "TDbiMetaDataCache.hxx"
+#include "TDbiQueryPlan.hxx"
 #include "TDbiTableProxy.hxx"
+#include "TDbiResultSet.hxx"
+#include "TDbiStatement.hxx"
+#include "TDbiTimeGateStats.hxx"
+#include "TDbiVldSnapshot.hxx"
+#include "TSeqNoAllocator.hxx"
 #include <TDbiLog.hxx>
 #include <MsgFormat.hxx>
 #include "UtilString.hxx"
@@ -54,9 +66,12 @@ int CP::TDbiDatabaseManager::Cleaner::fgCount = 0;
 
 //  None.
 CP::TDbiDatabaseManager::TDbiDatabaseManager() :
-    fCascader(0) {
+    fCascader(0),
+    fQueryPlan(0),
+    fSeqNoAllocator(0) {
 
     fCascader = new CP::TDbiCascader;
+    fSeqNoAllocator = new CP::TSeqNoAllocator;
 
     // Get any environment configuration.
     this->SetConfigFromEnvironment();
@@ -87,6 +102,16 @@ CP::TDbiDatabaseManager::~TDbiDatabaseManager() {
         CP::TDbiExceptionLog::GetGELog().Print();
     }
 
+    // Return any SEQNOs reserved but not used while the cascade is still
+    // available.
+    fSeqNoAllocator->ReleaseUnused();
+
+    // Save time gate statistics and meta data while logging and gSystem
+    // are still available (if configured, see TimeGateStats and
+    // MetaDataCache).
+    CP::TDbiTimeGateStats::gTimeGateStats.Save();
+    CP::TDbiMetaDataCache::gMetaDataCache.Save();
+
     int shutdown = 0;
     if (! this->GetConfig().Get("Shutdown",shutdown)
         || shutdown == 0) {
@@ -98,6 +123,8 @@ CP::TDbiDatabaseManager::~TDbiDatabaseManager() {
 
     // Destroy all owned objects.
 
+    this->ClearQueryPlan();
+
     for (std::map<std::string,CP::TDbiTableProxy*>::iterator itr 
              = fTPmap.begin();
          itr != fTPmap.end();
@@ -106,6 +133,9 @@ CP::TDbiDatabaseManager::~TDbiDatabaseManager() {
         delete tp;
     }
 
+    delete fSeqNoAllocator;
+    fSeqNoAllocator = 0;
+
     delete fCascader;
     fCascader = 0;
 
@@ -174,6 +204,11 @@ void CP::TDbiDatabaseManager::ApplySqlCondition(
     proxy->SetSqlCondition(sqlFull);
 }
 
+void CP::TDbiDatabaseManager::ClearQueryPlan() {
+    delete fQueryPlan;
+    fQueryPlan = 0;
+}
+
 void CP::TDbiDatabaseManager::ClearRollbacks() {
     fEpochRollback.Clear();
     fRollbackDates.Clear();
@@ -263,6 +298,73 @@ void CP::TDbiDatabaseManager::Config() {
         }
     }
 
+    // Check for request to pool connections to each cascade entry
+    // and remove from the TDbiRegistry.
+
+    int poolSize = 0;
+    if (reg.Get("ConnectionPoolSize",poolSize)) {
+        reg.RemoveKey("ConnectionPoolSize");
+        if (poolSize > 0) {
+            fCascader->SetPoolSize(poolSize);
+            DbiInfo("Setting connection pool size to " << poolSize << "  ");
+        }
+    }
+
+    // Check for request to reserve SEQNOs in blocks and remove from the
+    // TDbiRegistry.
+
+    int seqNoBlockSize = 0;
+    if (reg.Get("SeqNoBlockSize",seqNoBlockSize)) {
+        reg.RemoveKey("SeqNoBlockSize");
+        fSeqNoAllocator->SetBlockSize(seqNoBlockSize > 0 ? seqNoBlockSize : 1);
+        if (seqNoBlockSize > 1) {
+            DbiInfo("Reserving SEQNOs in blocks of " << seqNoBlockSize << "  ");
+        }
+    }
+
+    // Check for request to skip cascade entries whose connections cannot
+    // be opened and remove from the TDbiRegistry.
+
+    int connectionFailover = 0;
+    if (reg.Get("ConnectionFailover",connectionFailover)) {
+        reg.RemoveKey("ConnectionFailover");
+        CP::TDbiServices::fConnectionFailover = connectionFailover > 0;
+        if (connectionFailover > 0) {
+            DbiInfo("Read-only queries will skip unreachable cascade entries"
+                    << "  ");
+        }
+    }
+
+    // Check for request to open all cascade entries now rather than on
+    // first use and remove from the TDbiRegistry.  This follows
+    // ConnectionFailover, with which entries that fail are skipped.
+
+    int eagerConnect = 0;
+    if (reg.Get("EagerConnect",eagerConnect)) {
+        reg.RemoveKey("EagerConnect");
+        if (eagerConnect > 0) {
+            DbiInfo("Opening all cascade entries" << "  ");
+            if (! fCascader->OpenAll()
+                && ! CP::TDbiServices::ConnectionFailover()) {
+                throw CP::EBadDatabase();
+            }
+        }
+    }
+
+    // Check for request to keep idle connections open for a while
+    // and remove from the TDbiRegistry.
+
+    int connectionLinger = 0;
+    if (reg.Get("ConnectionLinger",connectionLinger)) {
+        reg.RemoveKey("ConnectionLinger");
+        CP::TDbiServices::fConnectionLinger
+            = connectionLinger > 0 ? connectionLinger : 0;
+        if (connectionLinger > 0) {
+            DbiInfo("Idle connections will linger for "
+                    << connectionLinger << " secs" << "  ");
+        }
+    }
+
     // Check for request to order context queries and remove from the TDbiRegistry.
 
     int OrderContextQuery = 0;
@@ -274,6 +376,77 @@ void CP::TDbiDatabaseManager::Config() {
         }
     }
 
+    // Check for request to load and save time gate statistics
+    // and remove from the TDbiRegistry.
+
+    const char* statsFile = 0;
+    if (reg.Get("TimeGateStats",statsFile)) {
+        TString tmp(statsFile);
+        reg.RemoveKey("TimeGateStats");
+        gSystem->ExpandPathName(tmp);
+        if (tmp.Contains("$")) {
+            DbiWarn("File name expansion failed for TimeGateStats: "
+                    << tmp.Data() << "  ");
+        }
+        else {
+            CP::TDbiTimeGateStats::gTimeGateStats.Load(tmp.Data());
+        }
+    }
+
+    // Check for request to load and save table meta data
+    // and remove from the TDbiRegistry.
+
+    const char* metaDataFile = 0;
+    if (reg.Get("MetaDataCache",metaDataFile)) {
+        TString tmp(metaDataFile);
+        reg.RemoveKey("MetaDataCache");
+        gSystem->ExpandPathName(tmp);
+        if (tmp.Contains("$")) {
+            DbiWarn("File name expansion failed for MetaDataCache: "
+                    << tmp.Data() << "  ");
+        }
+        else {
+            CP::TDbiMetaDataCache::gMetaDataCache.Load(tmp.Data());
+        }
+    }
+
+    // Check for request to resolve validity queries from in-memory
+    // VLD snapshots and remove from the TDbiRegistry.
+
+    int vldSnapshot = 0;
+    if (reg.Get("VldSnapshot",vldSnapshot)) {
+        reg.RemoveKey("VldSnapshot");
+        CP::TDbiServices::fVldSnapshot = vldSnapshot > 0;
+        if (vldSnapshot > 0) {
+            DbiInfo("Resolving validity queries from VLD snapshots" << "  ");
+        }
+    }
+
+    const char* snapshotLimits[] = { "VldSnapshotStart", "VldSnapshotEnd" };
+    for (int limitNum = 0; limitNum < 2; ++limitNum) {
+        const char* limitKey = snapshotLimits[limitNum];
+        const char* dateStr  = 0;
+        if (! reg.Get(limitKey,dateStr)) {
+            continue;
+        }
+        std::string date(dateStr);
+        reg.RemoveKey(limitKey);
+        Bool_t ok = kFALSE;
+        CP::TVldTimeStamp ts(TDbi::MakeTimeStamp(date,&ok));
+        if (! ok) {
+            DbiWarn("Ignoring bad date for " << limitKey << ": "
+                    << date << "  ");
+            continue;
+        }
+        if (limitNum == 0) {
+            CP::TDbiServices::fVldSnapshotStart = ts.GetSec();
+        }
+        else {
+            CP::TDbiServices::fVldSnapshotEnd = ts.GetSec();
+        }
+        DbiInfo("Setting " << limitKey << " to " << date << "  ");
+    }
+
     // Abort if TDbiRegistry contains any unknown keys
 
     const char* knownKeys[]   = { "Level2Cache",
@@ -305,6 +478,49 @@ void CP::TDbiDatabaseManager::Config() {
 
 //.....................................................................
 
+void CP::TDbiDatabaseManager::FindTableProxies(const std::vector<std::string>& tableNames,
+                                               std::vector<CP::TDbiTableProxy*>& proxies) const {
+//
+//
+//  Purpose: Find the existing table proxies for a list of table names.
+//
+//  Arguments:
+//    tableNames   in    Table names.
+//    proxies      out   Every table proxy already created for them.
+//
+//  Program Notes:-
+//  =============
+//
+//  Proxies are created by the first TDbiResultSetHandle for a row type
+//  so tables not yet used must be passed as proxies, using
+//  TDbiResultSetHandle<T>::GetTableProxy, instead.
+
+    proxies.clear();
+    std::vector<std::string>::const_iterator itrName    = tableNames.begin();
+    std::vector<std::string>::const_iterator itrNameEnd = tableNames.end();
+    for (; itrName != itrNameEnd; ++itrName) {
+        std::string prefix = CP::UtilString::ToUpper(*itrName) + "::";
+        Bool_t found = kFALSE;
+        std::map<std::string,CP::TDbiTableProxy*>::const_iterator itr
+            = fTPmap.lower_bound(prefix);
+        for (; itr != fTPmap.end()
+                 && itr->first.compare(0,prefix.size(),prefix) == 0;
+             ++itr) {
+            if (itr->second) {
+                proxies.push_back(itr->second);
+                found = kTRUE;
+            }
+        }
+        if (! found) {
+            DbiWarn("Table " << *itrName
+                    << " has no table proxy yet; ignoring it" << "  ");
+        }
+    }
+
+}
+
+//.....................................................................
+
 CP::TDbiTableProxy&
 CP::TDbiDatabaseManager::GetTableProxy(const std::string& tableNameReq,
                                        const CP::TDbiTableRow* tableRow) {
@@ -387,6 +603,326 @@ CP::TDbiDatabaseManager& CP::TDbiDatabaseManager::Instance() {
 
 //.....................................................................
 
+const CP::TDbiQueryPlan& CP::TDbiDatabaseManager::LoadQueryPlan(
+    const std::vector<std::string>& tableNames,
+    const CP::TVldTimeStamp& start,
+    const CP::TVldTimeStamp& end,
+    CP::DbiDetector::Detector_t det,
+    CP::DbiSimFlag::SimFlag_t simFlag,
+    const TDbi::Task& task) {
+//
+//
+//  Purpose: Load everything needed for a set of tables over a time span.
+//
+//  Arguments:
+//    tableNames   in    Names of the tables (see FindTableProxies).
+//    start        in    Start of span.
+//    end          in    End of span (exclusive).
+//    det          in    Detector of all queries.
+//    simFlag      in    SimFlag of all queries.
+//    task         in    Task of all queries.
+//
+//  Return:    The plan, which reports what was loaded.  It remains owned
+//             by this object until replaced or cleared.
+
+    std::vector<CP::TDbiTableProxy*> proxies;
+    this->FindTableProxies(tableNames,proxies);
+    return this->LoadQueryPlan(proxies,start,end,det,simFlag,task);
+
+}
+
+//.....................................................................
+
+const CP::TDbiQueryPlan& CP::TDbiDatabaseManager::LoadQueryPlan(
+    const std::vector<CP::TDbiTableProxy*>& proxies,
+    const CP::TVldTimeStamp& start,
+    const CP::TVldTimeStamp& end,
+    CP::DbiDetector::Detector_t det,
+    CP::DbiSimFlag::SimFlag_t simFlag,
+    const TDbi::Task& task) {
+//
+//
+//  Purpose: Load everything needed for a set of tables over a time span.
+//
+//  Arguments:
+//    proxies      in    The tables, e.g. from
+//                       TDbiResultSetHandle<T>::GetTableProxy().
+//    start        in    Start of span.
+//    end          in    End of span (exclusive).
+//    det          in    Detector of all queries.
+//    simFlag      in    SimFlag of all queries.
+//    task         in    Task of all queries.
+//
+//  Return:    The plan, which reports what was loaded.  It remains owned
+//             by this object until replaced or cleared.
+//
+//  Specification:-
+//  =============
+//
+//  o Release any previous plan.
+//
+//  o For each table resolve all validity intervals in the span and load
+//    their data in bulk (see TDbiTableProxy::QuerySpan), holding the
+//    results in the cache so that context queries in the span never
+//    reach the database.
+
+    this->ClearQueryPlan();
+    fQueryPlan = new CP::TDbiQueryPlan(start,end,det,simFlag,task);
+
+    std::vector<CP::TDbiTableProxy*>::const_iterator itr    = proxies.begin();
+    std::vector<CP::TDbiTableProxy*>::const_iterator itrEnd = proxies.end();
+    for (; itr != itrEnd; ++itr) {
+        if (*itr && (*itr)->TableExists()) {
+            fQueryPlan->Load(**itr);
+        }
+    }
+
+    DbiLog(*fQueryPlan << "  ");
+    return *fQueryPlan;
+
+}
+
+//.....................................................................
+
+void CP::TDbiDatabaseManager::LoadPrefetchSnapshots(
+    const std::vector<CP::TDbiTableProxy*>& proxies,
+    const CP::TVldContext& vc) {
+//
+//
+//  Purpose: Load VLD snapshots for a set of tables with one query per
+//           cascade entry.
+//
+//  Arguments:
+//    proxies      in    Tables to load.
+//    vc           in    Context whose time is to be covered.
+//
+//  Specification:-
+//  =============
+//
+//  o For each table cover the context time extended either side by the
+//    table's time gate.
+//
+//  o For each cascade entry combine the validity selects of all tables
+//    it holds (see TDbiDBProxy::MakeValidityRangeSelect) with "union all",
+//    using the position in proxies as the tag, and distribute the rows.
+//
+//  o Give each table a snapshot for each entry holding it, even if
+//    empty; if the query fails the table's snapshot for that entry is
+//    simply missing and queries fall back to the database.
+
+    UInt_t numTables = proxies.size();
+    std::vector<CP::TVldTimeStamp> starts;
+    std::vector<CP::TVldTimeStamp> ends;
+    time_t sec = vc.GetTimeStamp().GetSec();
+    for (UInt_t index = 0; index < numTables; ++index) {
+        Int_t timeGate = TDbi::GetTimeGate(proxies[index]->GetTableName());
+        starts.push_back(CP::TVldTimeStamp(sec - timeGate,0));
+        ends.push_back(CP::TVldTimeStamp(sec + timeGate + 1,0));
+    }
+
+    UInt_t numDb = fCascader->GetNumDb();
+    for (UInt_t dbNo = 0; dbNo < numDb; ++dbNo) {
+        std::string sql;
+        std::vector<Bool_t> present(numTables,kFALSE);
+        for (UInt_t index = 0; index < numTables; ++index) {
+            const CP::TDbiDBProxy& dbProxy = proxies[index]->GetDBProxy();
+            if (! dbProxy.TableExists(dbNo)) {
+                continue;
+            }
+            if (! sql.empty()) {
+                sql += " union all ";
+            }
+            sql += dbProxy.MakeValidityRangeSelect(starts[index],ends[index],index);
+            present[index] = kTRUE;
+        }
+        if (sql.empty()) {
+            continue;
+        }
+        DbiTrace("Database: " << dbNo
+                 << " prefetch query: " << sql << "  ");
+
+        std::unique_ptr<CP::TDbiStatement> stmtDb(fCascader->CreateStatement(dbNo));
+        if (! stmtDb.get()) {
+            continue;
+        }
+        std::unique_ptr<TSQLStatement> stmt(stmtDb->ExecuteQuery(sql.c_str()));
+        stmtDb->PrintExceptions(CP::TDbiLog::DebugLevel);
+        if (! stmt.get()) {
+            DbiWarn("Prefetch validity query failed on cascade entry "
+                    << dbNo << "  ");
+            continue;
+        }
+
+        std::vector< std::vector<CP::TDbiValidityRec> > vrecs(numTables);
+        UInt_t numRows = 0;
+        while (stmt->NextResultRow()) {
+            UInt_t index = stmt->GetUInt(10);
+            if (index >= numTables) {
+                continue;
+            }
+            CP::TVldRange range(stmt->GetInt(4),
+                                stmt->GetInt(5),
+                                TDbi::MakeTimeStamp(stmt->GetString(1)),
+                                TDbi::MakeTimeStamp(stmt->GetString(2)),
+                                "From Database");
+            CP::TDbiValidityRec vrec(range,
+                                     stmt->GetInt(6),
+                                     stmt->GetInt(7),
+                                     stmt->GetUInt(0),
+                                     dbNo,
+                                     kFALSE,
+                                     TDbi::MakeTimeStamp(stmt->GetString(8)),
+                                     stmt->GetUInt(3));
+            vrec.SetInsertDate(TDbi::MakeTimeStamp(stmt->GetString(9)));
+            vrec.SetTableProxy(proxies[index]);
+            vrecs[index].push_back(vrec);
+            ++numRows;
+        }
+
+        for (UInt_t index = 0; index < numTables; ++index) {
+            if (! present[index]) {
+                continue;
+            }
+            CP::TDbiTableProxy* proxy = proxies[index];
+            std::lock_guard<std::recursive_mutex> lock(proxy->GetQueryMutex());
+            proxy->AdoptVldSnapshot(dbNo,
+                                    new CP::TDbiVldSnapshot(proxy->GetTableName(),
+                                                            dbNo,
+                                                            starts[index],
+                                                            ends[index],
+                                                            vrecs[index],
+                                                            proxy->GetDBProxy().HasEpoch()));
+        }
+        DbiLog("Prefetched " << numRows << " VLD rows for " << numTables
+               << " tables from cascade entry " << dbNo << "  ");
+    }
+
+}
+
+//.....................................................................
+
+UInt_t CP::TDbiDatabaseManager::Prefetch(const std::vector<std::string>& tableNames,
+                                         const CP::TVldContext& vc,
+                                         const TDbi::Task& task) {
+//
+//
+//  Purpose: Fill the caches of a set of tables for a single context.
+//
+//  Arguments:
+//    tableNames   in    Names of the tables.
+//    vc           in    The Validity Context.
+//    task         in    The task.
+//
+//  Return:    The number of tables prefetched.
+//
+//  Specification:-
+//  =============
+//
+//  o Prefetch every table proxy already created for each table name
+//    (see FindTableProxies).
+
+    std::vector<CP::TDbiTableProxy*> proxies;
+    this->FindTableProxies(tableNames,proxies);
+    return this->Prefetch(proxies,vc,task);
+
+}
+
+//.....................................................................
+
+UInt_t CP::TDbiDatabaseManager::Prefetch(const std::vector<CP::TDbiTableProxy*>& proxies,
+                                         const CP::TVldContext& vc,
+                                         const TDbi::Task& task) {
+//
+//
+//  Purpose: Fill the caches of a set of tables for a single context.
+//
+//  Arguments:
+//    proxies      in    The tables, e.g. from
+//                       TDbiResultSetHandle<T>::GetTableProxy().
+//    vc           in    The Validity Context.
+//    task         in    The task.
+//
+//  Return:    The number of tables prefetched.
+//
+//  Specification:-
+//  =============
+//
+//  o Unless in snapshot mode, load the VLD rows of all the tables around
+//    the context time with one query per cascade entry (see
+//    LoadPrefetchSnapshots).
+//
+//  o Apply the context query to each table concurrently (the validity
+//    resolution is local so this overlaps the data queries) and then
+//    discard the snapshots.  The results are left in the table caches so
+//    that handles subsequently made for the same context find them
+//    there.
+
+//  Program Notes:-
+//  =============
+//
+//  Data queries only overlap if TDbiDatabaseManager is configured with
+//  ConnectionPoolSize > 1.  Each query holds its table's query mutex, so
+//  a table is never queried by a prefetch and another thread at once.
+
+    std::vector<CP::TDbiTableProxy*> tables;
+    std::vector<CP::TDbiTableProxy*>::const_iterator itr    = proxies.begin();
+    std::vector<CP::TDbiTableProxy*>::const_iterator itrEnd = proxies.end();
+    for (; itr != itrEnd; ++itr) {
+        if (*itr && (*itr)->TableExists()
+            && std::find(tables.begin(),tables.end(),*itr) == tables.end()) {
+            tables.push_back(*itr);
+        }
+    }
+    if (tables.empty()) {
+        return 0;
+    }
+
+    // Stack object to hold connections
+    CP::TDbiConnectionMaintainer cm(fCascader);
+
+    Bool_t loadSnapshots = ! CP::TDbiServices::VldSnapshot();
+    if (loadSnapshots) {
+        this->LoadPrefetchSnapshots(tables,vc);
+    }
+
+    std::vector< std::future<UInt_t> > queries;
+    for (itr = tables.begin(); itr != tables.end(); ++itr) {
+        CP::TDbiTableProxy* proxy = *itr;
+        queries.push_back(std::async(std::launch::async,
+                                     [proxy,vc,task] {
+                                         std::lock_guard<std::recursive_mutex>
+                                             lock(proxy->GetQueryMutex());
+                                         return proxy->Query(vc,task)->GetNumRows();
+                                     }));
+    }
+    UInt_t numRows = 0;
+    UInt_t numTables = 0;
+    for (UInt_t index = 0; index < queries.size(); ++index) {
+        try {
+            numRows += queries[index].get();
+            ++numTables;
+        }
+        catch (std::exception& e) {
+            DbiWarn("Prefetch of table " << tables[index]->GetTableName()
+                    << " failed: " << e.what() << "  ");
+        }
+    }
+
+    if (loadSnapshots) {
+        for (itr = tables.begin(); itr != tables.end(); ++itr) {
+            std::lock_guard<std::recursive_mutex> lock((*itr)->GetQueryMutex());
+            (*itr)->ClearVldSnapshots();
+        }
+    }
+
+    DbiLog("Prefetched " << numRows << " rows from " << numTables
+           << " tables for " << vc << "  ");
+    return numTables;
+
+}
+
+//.....................................................................
+
 void CP::TDbiDatabaseManager::PurgeCaches() {
 //
 //
@@ -540,6 +1076,32 @@ void CP::TDbiDatabaseManager::ShowStatistics() const {
     }
     msg << "\n" << std::endl;
 
+    msg << "\n\nTime gate statistics:-\n\n"
+        << "Table Name                             "
+        << " Queries  Rows per  Filtered     Total      Time\n"
+        << "                                       "
+        << "            Query  per Query  Filtered      Gate" << std::endl;
+
+    for (std::map<std::string,CP::TDbiTableProxy*>::const_iterator itr = fTPmap.begin();
+         itr != fTPmap.end();
+         ++itr) {
+        const CP::TDbiTableProxy* tp = (*itr).second;
+        std::string name = tp->GetTableName();
+        if (name.size() < 40) {
+            name.append(40-name.size(),' ');
+        }
+        msg << name;
+        // Only count the VLD rows of tables this job has queried.
+        CP::TDbiTimeGateStats& stats = CP::TDbiTimeGateStats::gTimeGateStats;
+        UInt_t tableRows = 0;
+        if (stats.GetNumQueries(tp->GetTableName()) && tp->TableExists()) {
+            tableRows = tp->GetDBProxy().CountValidities();
+        }
+        stats.Print(msg,tp->GetTableName(),tableRows);
+        msg << std::endl;
+    }
+    msg << "\n" << std::endl;
+
 //  Only want to look at cascader so by-pass constness.
 
     DbiInfo(const_cast<CP::TDbiDatabaseManager*>(this)->GetCascader());
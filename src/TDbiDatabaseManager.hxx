@@ -25,6 +25,8 @@
 #endif
 #include <map>
 #include <string>
+#include <vector>
+#include "TDbi.hxx"
 #include "TDbiCfgConfigurable.hxx"
 #include "TDbiSimFlagAssociation.hxx"
 #include "TDbiRollbackDates.hxx"
@@ -34,9 +36,11 @@
 
 namespace CP {
     class TDbiCascader;
+    class TDbiQueryPlan;
     class TDbiTableProxy;
     class TDbiTableRow;
     class TDbiValidate;
+    class TSeqNoAllocator;
 }
 
 namespace CP {
@@ -58,13 +62,41 @@ namespace CP {
         }
 
         void Config();
+        /// Release the results held by the current query plan.
+        void ClearQueryPlan();
         void ClearRollbacks();
         void ClearSimFlagAssociation();
         TDbiCascader& GetCascader() {
             return *fCascader;
         }
+        /// Allocator of the SEQNOs of validity sets being written.
+        TSeqNoAllocator& GetSeqNoAllocator() {
+            return *fSeqNoAllocator;
+        }
         TDbiTableProxy& GetTableProxy(const std::string& tableName,
                                       const TDbiTableRow* tableRow) ;
+        /// Load everything needed for a set of tables over a time span so
+        /// that queries within it never reach the database.
+        const TDbiQueryPlan& LoadQueryPlan(const std::vector<std::string>& tableNames,
+                                           const CP::TVldTimeStamp& start,
+                                           const CP::TVldTimeStamp& end,
+                                           CP::DbiDetector::Detector_t det,
+                                           CP::DbiSimFlag::SimFlag_t simFlag,
+                                           const TDbi::Task& task = TDbi::kDefaultTask);
+        const TDbiQueryPlan& LoadQueryPlan(const std::vector<TDbiTableProxy*>& proxies,
+                                           const CP::TVldTimeStamp& start,
+                                           const CP::TVldTimeStamp& end,
+                                           CP::DbiDetector::Detector_t det,
+                                           CP::DbiSimFlag::SimFlag_t simFlag,
+                                           const TDbi::Task& task = TDbi::kDefaultTask);
+        /// Fill the caches of a set of tables for one context so that
+        /// handles subsequently made for it don't query the database.
+        UInt_t Prefetch(const std::vector<std::string>& tableNames,
+                        const CP::TVldContext& vc,
+                        const TDbi::Task& task = TDbi::kDefaultTask);
+        UInt_t Prefetch(const std::vector<TDbiTableProxy*>& proxies,
+                        const CP::TVldContext& vc,
+                        const TDbi::Task& task = TDbi::kDefaultTask);
         void PurgeCaches();
         void RefreshMetaData(const std::string& tableName);
         void SetSqlCondition(const std::string& sql="");
@@ -79,6 +111,10 @@ namespace CP {
 
         // State changing member functions
 
+        void FindTableProxies(const std::vector<std::string>& tableNames,
+                              std::vector<TDbiTableProxy*>& proxies) const;
+        void LoadPrefetchSnapshots(const std::vector<TDbiTableProxy*>& proxies,
+                                   const CP::TVldContext& vc);
         void SetConfigFromEnvironment();
 
     public:
@@ -119,6 +155,12 @@ namespace CP {
         /// Default optional condition.
         std::string fSqlCondition;
 
+        /// Current query plan (owned) or 0 if none.
+        TDbiQueryPlan* fQueryPlan;
+
+        /// SEQNO allocator (owned).
+        TSeqNoAllocator* fSeqNoAllocator;
+
 #ifndef __CINT__  // Hide map from CINT; complains: missing Streamer() etc.
         /// TableName::RowName -> TableProxy
         std::map<std::string,TDbiTableProxy*> fTPmap;
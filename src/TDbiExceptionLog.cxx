@@ -36,6 +36,14 @@ CP::TDbiExceptionLog::TDbiExceptionLog(const CP::TDbiException* e) {
 }
 //.....................................................................
 
+CP::TDbiExceptionLog::TDbiExceptionLog(const CP::TDbiExceptionLog& that) :
+    fEntries(that.GetEntries()) {
+
+    DbiTrace("Creating CP::TDbiExceptionLog" << "  ");
+
+}
+//.....................................................................
+
 
 CP::TDbiExceptionLog::~TDbiExceptionLog() {
 
@@ -46,6 +54,19 @@ CP::TDbiExceptionLog::~TDbiExceptionLog() {
 
 //.....................................................................
 
+CP::TDbiExceptionLog& CP::TDbiExceptionLog::operator=(const CP::TDbiExceptionLog& that) {
+
+    if (this != &that) {
+        std::vector<CP::TDbiException> entries(that.GetEntries());
+        std::lock_guard<std::mutex> lock(fMutex);
+        fEntries.swap(entries);
+    }
+    return *this;
+
+}
+
+//.....................................................................
+
 std::ostream& CP::operator<<(std::ostream& os,
                              const CP::TDbiExceptionLog& el) {
 
@@ -54,8 +75,9 @@ std::ostream& CP::operator<<(std::ostream& os,
     }
     else {
         os << "Database exception log:-" << std::endl;
-        std::vector<CP::TDbiException>::const_iterator itr(el.GetEntries().begin()),
-            itrEnd(el.GetEntries().end());
+        const std::vector<CP::TDbiException> entries(el.GetEntries());
+        std::vector<CP::TDbiException>::const_iterator itr(entries.begin()),
+            itrEnd(entries.end());
         while (itr != itrEnd) {
             os << *itr << std::endl;
             ++itr;
@@ -66,17 +88,37 @@ std::ostream& CP::operator<<(std::ostream& os,
 
 }
 
+//.....................................................................
+///
+///
+/// Purpose:  Add an entry.
+void CP::TDbiExceptionLog::AddEntry(const CP::TDbiException& e) {
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    fEntries.push_back(e);
+
+}
+
 //.....................................................................
 ///
 ///
 /// Purpose:  Add all entries from el.
 void CP::TDbiExceptionLog::AddLog(const CP::TDbiExceptionLog& el) {
 
-    const std::vector<CP::TDbiException>& ve = el.GetEntries();
-    std::vector<CP::TDbiException>::const_iterator itr(ve.begin()), itrEnd(ve.end());
-    while (itr != itrEnd) {
-        this->AddEntry(*itr++);
-    }
+    const std::vector<CP::TDbiException> ve(el.GetEntries());
+    std::lock_guard<std::mutex> lock(fMutex);
+    fEntries.insert(fEntries.end(),ve.begin(),ve.end());
+
+}
+
+//.....................................................................
+///
+///
+/// Purpose:  Remove all entries.
+void CP::TDbiExceptionLog::Clear() {
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    fEntries.clear();
 
 }
 
@@ -87,11 +129,37 @@ void CP::TDbiExceptionLog::Copy(CP::TDbiExceptionLog& that, UInt_t start) const
 //
 
 
-    UInt_t maxEntry = fEntries.size();
-    while (start <= maxEntry) {
-        that.AddEntry(fEntries[start++]);
+    std::vector<CP::TDbiException> entries;
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        if (start < fEntries.size()) {
+            entries.assign(fEntries.begin() + start,fEntries.end());
+        }
+    }
+    std::vector<CP::TDbiException>::const_iterator itr(entries.begin()),
+        itrEnd(entries.end());
+    while (itr != itrEnd) {
+        that.AddEntry(*itr++);
     }
 
+}
+
+//.....................................................................
+///  Purpose: Return a copy of the entries.
+std::vector<CP::TDbiException> CP::TDbiExceptionLog::GetEntries() const {
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fEntries;
+
+}
+
+//.....................................................................
+///  Purpose: Return true if there are no entries.
+Bool_t CP::TDbiExceptionLog::IsEmpty() const {
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fEntries.empty();
+
 }
 //.....................................................................
 /// Purpose:  Print contents to cout.
@@ -104,6 +172,15 @@ void CP::TDbiExceptionLog::Print() const {
 
 }
 
+//.....................................................................
+///  Purpose: Return the number of entries.
+UInt_t CP::TDbiExceptionLog::Size() const {
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fEntries.size();
+
+}
+
 
 
 
@@ -19,6 +19,9 @@
 /// they can be analysed in the upper levels of the DBI and beyond. They are
 /// stored in a std::vector of CP::TDbiException s
 ///
+/// Worker threads add to the Global Exception Log while others read it so
+/// every member function locks the log; GetEntries returns a copy.
+///
 /// Contact: A.Finch@lancaster.ac.uk
 ///
 ///
@@ -30,6 +33,9 @@
 #include <iosfwd>
 #include <string>
 #include <vector>
+#ifndef __CINT__
+#include <mutex>
+#endif
 
 class TSQLServer;
 class TSQLStatement;
@@ -42,29 +48,22 @@ namespace CP {
 class CP::TDbiExceptionLog {
 public:
     TDbiExceptionLog(const TDbiException* e = 0);
+    TDbiExceptionLog(const TDbiExceptionLog& that);
     virtual ~TDbiExceptionLog();
+    TDbiExceptionLog& operator=(const TDbiExceptionLog& that);
 
     /// State testing member functions
 
-    Bool_t IsEmpty() const {
-        return fEntries.size() == 0;
-    }
-    const std::vector<CP::TDbiException>&
-    GetEntries() const {
-        return fEntries;
-    }
+    Bool_t IsEmpty() const;
+    std::vector<CP::TDbiException> GetEntries() const;
     void Print() const;
-    UInt_t Size() const {
-        return fEntries.size();
-    }
+    UInt_t Size() const;
     void Copy(TDbiExceptionLog& that, UInt_t start=0) const;
 
     /// State changing member functions
 
     void AddLog(const TDbiExceptionLog& el);
-    void AddEntry(const TDbiException& e) {
-        fEntries.push_back(e);
-    }
+    void AddEntry(const TDbiException& e);
     void AddEntry(const char* errMsg, Int_t code = -1) {
         this->AddEntry(TDbiException(errMsg,code));
     }
@@ -77,9 +76,7 @@ public:
     void AddEntry(const TSQLStatement& statement) {
         this->AddEntry(TDbiException(statement));
     }
-    void Clear() {
-        fEntries.clear();
-    }
+    void Clear();
 
     /// The Global Exception Log
     static TDbiExceptionLog& GetGELog() {
@@ -91,6 +88,11 @@ private:
     /// The exception entries.
     std::vector<TDbiException> fEntries;
 
+#ifndef __CINT__
+    /// Guards fEntries.
+    mutable std::mutex fMutex;
+#endif
+
     /// Global Exception Log
     static TDbiExceptionLog fgGELog;
 
@@ -32,17 +32,19 @@ ClassImp(CP::TDbiFieldType)
 
 //.....................................................................
 
-CP::TDbiFieldType::TDbiFieldType(Int_t type /* = TDbi::kInt */) {
+CP::TDbiFieldType::TDbiFieldType(Int_t type /* = TDbi::kInt */,
+                                 Int_t size /* = -1 */) {
 //
 //
 //  Purpose:  Default constructor
 //
 //  Arguments:
 //    type     in    Data type  (default TDbi::kInt).
+//    size     in    Size in bytes (default: -1 - take size from type)
 
 
 
-    this->Init(type);
+    this->Init(type,size);
 
 }
 //.....................................................................
@@ -32,7 +32,7 @@ namespace CP {
                              };
 
         // Constructors and destructors.
-        TDbiFieldType(Int_t type = TDbi::kInt);
+        TDbiFieldType(Int_t type = TDbi::kInt, Int_t size = -1);
         TDbiFieldType(Int_t type,
                       Int_t size,
                       const char* typeName);
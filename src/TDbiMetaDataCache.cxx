@@ -0,0 +1,363 @@
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "TSystem.h"
+
+#include "TDbi.hxx"
+#include "TDbiFieldType.hxx"
+#include "TDbiMetaDataCache.hxx"
+#include "TDbiTableMetaData.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
+
+ClassImp(CP::TDbiMetaDataCache)
+
+
+//   Definition of static data members
+//   *********************************
+
+
+CP::TDbiMetaDataCache CP::TDbiMetaDataCache::gMetaDataCache;
+
+// Definition of member functions (alphabetical order)
+// ***************************************************
+
+//.....................................................................
+
+CP::TDbiMetaDataCache::TDbiMetaDataCache() :
+    fModified(kFALSE) {
+//
+//
+//  Purpose:  Default constructor
+
+
+    DbiTrace("Creating CP::TDbiMetaDataCache" << "  ");
+
+}
+
+//.....................................................................
+
+CP::TDbiMetaDataCache::~TDbiMetaDataCache() {
+//
+//
+//  Purpose: Destructor
+//
+//  Program Notes:-
+//  =============
+//
+//  The cache is a static so is destroyed after logging and gSystem may
+//  have gone; TDbiDatabaseManager saves it instead.
+
+
+    DbiTrace("Destroying CP::TDbiMetaDataCache" << "  ");
+    std::map<std::string,UrlEntry>::iterator itr = fUrls.begin();
+    for (; itr != fUrls.end(); ++itr) {
+        Clear(itr->second);
+    }
+
+}
+
+//.....................................................................
+
+void CP::TDbiMetaDataCache::Clear(UrlEntry& entry) {
+//
+//
+//  Purpose:  Delete all meta data for a URL.
+
+    std::map<std::string,CP::TDbiTableMetaData*>::iterator itr
+        = entry.fTables.begin();
+    for (; itr != entry.fTables.end(); ++itr) {
+        delete itr->second;
+    }
+    entry.fTables.clear();
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiMetaDataCache::Fetch(const std::string& url,
+                                    const std::string& schemaVersion,
+                                    CP::TDbiTableMetaData& metaData) {
+//
+//
+//  Purpose:  Copy cached meta data for table.
+//
+//  Arguments:
+//    url           in    Cascade entry URL.
+//    schemaVersion in    Current schema version of the entry.
+//    metaData      in    Empty meta data apart from table name.
+//                  out   Filled from cache if found.
+//
+//  Return:    kTRUE if found.
+//
+//  Specification:-
+//  =============
+//
+//  o If the schema version has changed discard everything cached for
+//    the URL; it will be refilled by Store.
+
+    if (! this->IsEnabled() || schemaVersion.empty()) {
+        return kFALSE;
+    }
+    std::lock_guard<std::mutex> lock(fMutex);
+    std::map<std::string,UrlEntry>::iterator itrUrl = fUrls.find(url);
+    if (itrUrl == fUrls.end()) {
+        return kFALSE;
+    }
+    UrlEntry& entry = itrUrl->second;
+    if (entry.fSchemaVersion != schemaVersion) {
+        DbiLog("Schema of " << url << " has changed; discarding "
+               << entry.fTables.size() << " cached tables" << "  ");
+        Clear(entry);
+        entry.fSchemaVersion = schemaVersion;
+        fModified = kTRUE;
+        return kFALSE;
+    }
+    std::map<std::string,CP::TDbiTableMetaData*>::const_iterator itr
+        = entry.fTables.find(metaData.TableName());
+    if (itr == entry.fTables.end()) {
+        return kFALSE;
+    }
+    metaData = *itr->second;
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiMetaDataCache::Load(const std::string& fileName) {
+//
+//
+//  Purpose:  Load cache from file.
+//
+//  Arguments:
+//    fileName     in    File to load from and, at the end of the job,
+//                       save to.
+//
+//  Return:    kTRUE if loaded.  A missing file is not an error; it will be
+//             created when the job ends.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    fFileName = fileName;
+
+    Int_t numTables = ReadEntries(fileName,fUrls);
+    if (numTables < 0) {
+        DbiInfo("No meta data cache in " << fileName
+                << "; will create at end of job" << "  ");
+        return kFALSE;
+    }
+
+    DbiLog("Loaded meta data for " << numTables << " tables from "
+           << fileName << "  ");
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Int_t CP::TDbiMetaDataCache::ReadEntries(const std::string& fileName,
+                                         std::map<std::string,UrlEntry>& urls) {
+//
+//
+//  Purpose:  Add the meta data in a file to urls.
+//
+//  Return:    The number of tables read or -1 if the file cannot be read.
+//
+//  Program Notes:-
+//  =============
+//
+//  An URL in the file replaces any meta data already held for it.
+
+    std::ifstream in(fileName.c_str());
+    if (! in) {
+        return -1;
+    }
+
+    Int_t numTables = 0;
+    UrlEntry* entry = 0;
+    std::string line;
+    while (std::getline(in,line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream is(line);
+        std::string keyword;
+        is >> keyword;
+        if (keyword == "URL") {
+            std::string url;
+            entry = 0;
+            if (is >> url) {
+                entry = &urls[url];
+                Clear(*entry);
+                is >> entry->fSchemaVersion;
+            }
+            continue;
+        }
+        UInt_t numCols = 0;
+        std::string tableName;
+        if (keyword != "TABLE" || ! entry || ! (is >> tableName >> numCols)) {
+            DbiWarn("Ignoring bad meta data cache line: " << line << "  ");
+            continue;
+        }
+        CP::TDbiTableMetaData* metaData = new CP::TDbiTableMetaData(tableName);
+        Bool_t ok = kTRUE;
+        for (UInt_t col = 1; ok && col <= numCols; ++col) {
+            std::string name;
+            Int_t type = 0;
+            Int_t size = 0;
+            Int_t isNullable = 0;
+            if (std::getline(in,line)) {
+                std::istringstream isCol(line);
+                ok = (isCol >> name >> type >> size >> isNullable) ? kTRUE : kFALSE;
+            }
+            else {
+                ok = kFALSE;
+            }
+            if (ok) {
+                metaData->SetColName(name,col);
+                metaData->SetColFieldType(CP::TDbiFieldType(type,size),col);
+                metaData->SetColIsNullable(col,isNullable);
+            }
+        }
+        if (! ok) {
+            DbiWarn("Truncated meta data cache entry for " << tableName << "  ");
+            delete metaData;
+            break;
+        }
+        delete entry->fTables[tableName];
+        entry->fTables[tableName] = metaData;
+        ++numTables;
+    }
+    return numTables;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiMetaDataCache::Save() const {
+//
+//
+//  Purpose:  Save cache to the configured file if it has changed.
+//
+//  Return:    kTRUE if saved or nothing to save.
+//
+//  Specification:-
+//  =============
+//
+//  o Merge the meta data held with that now in the file, so that tables
+//    saved by other jobs since this one started are kept.  For an URL
+//    held at a different schema version the meta data held replaces the
+//    file's.
+//
+//  Program Notes:-
+//  =============
+//
+//  Written to a temporary file, unique to this process, and renamed so
+//  that concurrent jobs cannot leave a partial file.  Jobs saving at the
+//  same moment can still lose one another's tables, which only costs
+//  queries in later jobs.
+
+    if (fFileName.empty()) {
+        return kFALSE;
+    }
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (! fModified) {
+        return kTRUE;
+    }
+    std::map<std::string,UrlEntry> merged;
+    ReadEntries(fFileName,merged);
+    std::map<std::string,UrlEntry>::const_iterator itrUrl = fUrls.begin();
+    for (; itrUrl != fUrls.end(); ++itrUrl) {
+        const UrlEntry& held = itrUrl->second;
+        UrlEntry& entry = merged[itrUrl->first];
+        if (entry.fSchemaVersion != held.fSchemaVersion) {
+            Clear(entry);
+            entry.fSchemaVersion = held.fSchemaVersion;
+        }
+        std::map<std::string,CP::TDbiTableMetaData*>::const_iterator itr
+            = held.fTables.begin();
+        for (; itr != held.fTables.end(); ++itr) {
+            CP::TDbiTableMetaData*& metaData = entry.fTables[itr->first];
+            delete metaData;
+            metaData = new CP::TDbiTableMetaData(*itr->second);
+        }
+    }
+
+    std::ostringstream tmpName;
+    tmpName << fFileName << "." << gSystem->GetPid() << ".tmp";
+    std::ofstream out(tmpName.str().c_str());
+    UInt_t numTables = 0;
+    if (out) {
+        out << "# URL url schema_version" << std::endl
+            << "# TABLE name num_cols" << std::endl
+            << "# name type size nullable (one line per column)" << std::endl;
+        for (itrUrl = merged.begin(); itrUrl != merged.end(); ++itrUrl) {
+            const UrlEntry& entry = itrUrl->second;
+            out << "URL " << itrUrl->first << " " << entry.fSchemaVersion
+                << std::endl;
+            std::map<std::string,CP::TDbiTableMetaData*>::const_iterator itr
+                = entry.fTables.begin();
+            for (; itr != entry.fTables.end(); ++itr) {
+                const CP::TDbiTableMetaData& metaData = *itr->second;
+                UInt_t numCols = metaData.NumCols();
+                out << "TABLE " << itr->first << " " << numCols << std::endl;
+                for (UInt_t col = 1; col <= numCols; ++col) {
+                    const CP::TDbiFieldType& type = metaData.ColFieldType(col);
+                    out << metaData.ColName(col) << " " << type.GetType()
+                        << " " << type.GetSize() << " "
+                        << metaData.ColIsNullable(col) << std::endl;
+                }
+                ++numTables;
+            }
+        }
+        out.close();
+    }
+    std::map<std::string,UrlEntry>::iterator itrMerged = merged.begin();
+    for (; itrMerged != merged.end(); ++itrMerged) {
+        Clear(itrMerged->second);
+    }
+
+    if (! out || std::rename(tmpName.str().c_str(),fFileName.c_str()) != 0) {
+        DbiWarn("Unable to save meta data cache to " << fFileName << "  ");
+        std::remove(tmpName.str().c_str());
+        return kFALSE;
+    }
+    fModified = kFALSE;
+    DbiLog("Saved meta data for " << numTables
+           << " tables to " << fFileName << "  ");
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+void CP::TDbiMetaDataCache::Store(const std::string& url,
+                                  const std::string& schemaVersion,
+                                  const CP::TDbiTableMetaData& metaData) {
+//
+//
+//  Purpose:  Add meta data for a table to the cache.
+//
+//  Arguments:
+//    url           in    Cascade entry URL.
+//    schemaVersion in    Current schema version of the entry.
+//    metaData      in    Meta data for table.
+
+    if (! this->IsEnabled() || schemaVersion.empty()
+        || metaData.NumCols() == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(fMutex);
+    UrlEntry& entry = fUrls[url];
+    if (entry.fSchemaVersion != schemaVersion) {
+        Clear(entry);
+        entry.fSchemaVersion = schemaVersion;
+    }
+    CP::TDbiTableMetaData*& cached = entry.fTables[metaData.TableName()];
+    delete cached;
+    cached = new CP::TDbiTableMetaData(metaData);
+    fModified = kTRUE;
+
+}
@@ -0,0 +1,107 @@
+#ifndef DBIMETADATACACHE_H
+#define DBIMETADATACACHE_H
+
+/**
+ *
+ * \class CP::TDbiMetaDataCache
+ *
+ *
+ * \brief
+ * <b>Concept</b> A local file holding TDbiTableMetaData for each cascade
+ *  URL and table, tagged with the schema version of the database it came
+ *  from.
+ *
+ * \brief
+ * <b>Purpose</b> To spare short jobs the meta data queries made each time
+ *  a TDbiTableProxy is created.  If TDbiDatabaseManager is configured with
+ *
+ *    MetaDataCache = "file name"
+ *
+ *  TDbiDBProxy::StoreMetaData looks here first and only queries the
+ *  database if the table is missing or the schema version (see
+ *  TDbiConnection::GetSchemaVersion) has changed, in which case all
+ *  entries for that URL are discarded.  New meta data is merged into the
+ *  file by TDbiDatabaseManager when the job ends.
+ *
+ */
+
+#include "Rtypes.h"
+
+#include <map>
+#include <string>
+#ifndef __CINT__
+#include <mutex>
+#endif
+
+namespace CP {
+    class TDbiTableMetaData;
+}
+
+namespace CP {
+
+    class TDbiMetaDataCache {
+
+    public:
+
+// Constructors and destructors.
+        TDbiMetaDataCache();
+        virtual ~TDbiMetaDataCache();
+
+// State testing member functions
+
+        Bool_t IsEnabled() const {
+            return ! fFileName.empty();
+        }
+        Bool_t Save() const;
+
+// State changing member functions
+
+/// Copy cached meta data into metaData returning true if found.
+        Bool_t Fetch(const std::string& url,
+                     const std::string& schemaVersion,
+                     TDbiTableMetaData& metaData);
+        Bool_t Load(const std::string& fileName);
+        void Store(const std::string& url,
+                   const std::string& schemaVersion,
+                   const TDbiTableMetaData& metaData);
+
+        static TDbiMetaDataCache gMetaDataCache;
+
+    private:
+
+// Disabled (not implemented) copy constructor and asignment.
+
+        TDbiMetaDataCache(const TDbiMetaDataCache&);
+        CP::TDbiMetaDataCache& operator=(const CP::TDbiMetaDataCache&);
+
+/// Meta data for one URL.
+        struct UrlEntry {
+            std::string fSchemaVersion;
+            std::map<std::string,TDbiTableMetaData*> fTables;
+        };
+
+        static void Clear(UrlEntry& entry);
+        static Int_t ReadEntries(const std::string& fileName,
+                                 std::map<std::string,UrlEntry>& urls);
+
+// Data members
+
+/// File to load from and save to (empty to disable).
+        std::string fFileName;
+
+/// True if anything has been stored since loading or saving.
+        mutable Bool_t fModified;
+
+#ifndef __CINT__ //  Hide map from CINT; it complains about missing Streamer() etc.
+/// Cached meta data indexed by URL.
+        std::map<std::string,UrlEntry> fUrls;
+
+        mutable std::mutex fMutex;
+#endif  // __CINT__
+
+        ClassDef(TDbiMetaDataCache,0)   // Meta data cache file.
+
+    };
+};
+
+#endif  // DBIMETADATACACHE_H
@@ -15,11 +15,9 @@
 
 ClassImp(CP::TDbiOutRowStream)
 
-#define OUT(t,v)                                \
+#define OUT(t,v,store)                          \
     if ( ! StoreDefaultIfInvalid(t) ) {         \
-        std::ostringstream out;                 \
-        out << std::setprecision(16)<< v;       \
-        Store(out.str());                       \
+        store(v);                               \
     }                                           \
      
 // If writing unsigned dat as signed, convert bit pattern to signed,
@@ -32,9 +30,9 @@ ClassImp(CP::TDbiOutRowStream)
         Int_t v_signed = (Int_t) v;                                                  \
         if ( fType.GetType() == TDbi::kTiny  && v & 0x80   ) v_signed |= 0xffffff00;  \
         if ( fType.GetType() == TDbi::kShort && v & 0x8000 ) v_signed |= 0xffff0000;  \
-        OUT(TDbi::kInt,v_signed); }                                                   \
+        OUT(TDbi::kInt,v_signed,StoreInteger); }                                      \
     else {                                                                         \
-        OUT(t,v);                                                                    \
+        OUT(t,v,StoreInteger);                                                       \
     }                                                                              \
      
 //   Definition of static data members
@@ -79,19 +77,19 @@ CP::TDbiOutRowStream::~TDbiOutRowStream() {
 //.....................................................................
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(Bool_t src) {
-    OUT(TDbi::kBool,src);  return *this;
+    OUT(TDbi::kBool,src,StoreInteger);  return *this;
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(Char_t src) {
-    OUT(TDbi::kChar,src);  return *this;
+    OUT(TDbi::kChar,std::string(1,src),Store);  return *this;
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(const Char_t* src) {
-    OUT(TDbi::kString,src);  return *this;
+    OUT(TDbi::kString,src,Store);  return *this;
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(Short_t src) {
-    OUT(TDbi::kShort,src);  return *this;
+    OUT(TDbi::kShort,src,StoreInteger);  return *this;
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(UShort_t src) {
@@ -99,7 +97,7 @@ CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(UShort_t src) {
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(Int_t src) {
-    OUT(TDbi::kInt,src);  return *this;
+    OUT(TDbi::kInt,src,StoreInteger);  return *this;
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(UInt_t src) {
@@ -107,22 +105,19 @@ CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(UInt_t src) {
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(Float_t src) {
-    OUT(TDbi::kFloat,src); return *this;
+    OUT(TDbi::kFloat,src,StoreReal); return *this;
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(Double_t src) {
-    OUT(TDbi::kDouble,src);  return *this;
+    OUT(TDbi::kDouble,src,StoreReal);  return *this;
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(const std::string& src) {
-    OUT(TDbi::kString,src); return *this;
+    OUT(TDbi::kString,src,Store); return *this;
 }
 
 CP::TDbiOutRowStream& CP::TDbiOutRowStream::operator<<(const CP::TVldTimeStamp& src) {
-    if (! StoreDefaultIfInvalid(TDbi::kDate)) {
-        Store(TDbi::MakeDateTimeString(src).c_str());
-    }
-    return *this;
+    OUT(TDbi::kDate,src,StoreDate); return *this;
 }
 
 
@@ -178,50 +173,51 @@ Bool_t CP::TDbiOutRowStream::StoreDefaultIfInvalid(TDbi::DataTypes type) {
 void CP::TDbiOutRowStream::Store(const std::string& str)  {
 //
 //
-//  Purpose: Store string value as comma separated values but exclude SeqNo.
+//  Purpose: Store value supplied as a string.
 //
 //  Arguments:
 //    str          in    Value to be stored.
 //
-//  Return:
-//
-//  Contact:   N. West
-//
 //  Specification:-
 //  =============
 //
-//  o Store string value in CSV with separator from
-//    previous value and increment fNumValues.  If required
-//    enclose value in quotes. If storing the SeqNo column then
-//    store a single '?' instead which will be replace during
-//    SQL generation - see
+//  o Store value and move to the next column.  Quoting and special
+//    characters are dealt with if the row is converted to SQL text
+//    (see TDbiRowBuffer::AppendCSV).
 
-//  Program Notes:-
-//  =============
+    fRow.AddText(str,CurColFieldType().GetConcept());
+    IncrementCurCol();
+}
 
-//  None.
+//.....................................................................
 
-    UInt_t concept = CurColFieldType().GetConcept();
-    std::string delim = "";
-    if (concept == TDbi::kString
-        || concept == TDbi::kDate
-        || concept == TDbi::kChar) {
-        delim = "\'";
-    }
+void CP::TDbiOutRowStream::StoreDate(const CP::TVldTimeStamp& ts)  {
+//
+//
+//  Purpose: Store date value and move to the next column.
 
-    if (CurColNum()> 1) {
-        fCSV += ',';
-    }
-    fCSV += delim;
-    if (concept != TDbi::kString) {
-        fCSV += str;
-    }
-//  When exporting strings, take care of special characters.
-    else {
-        CP::UtilString::MakePrintable(str.c_str(),fCSV);
-    }
-    fCSV += delim;
+    fRow.AddDate(ts,CurColFieldType().GetConcept());
     IncrementCurCol();
 }
 
+//.....................................................................
+
+void CP::TDbiOutRowStream::StoreInteger(Long64_t value)  {
+//
+//
+//  Purpose: Store integer value and move to the next column.
+
+    fRow.AddInteger(value,CurColFieldType().GetConcept());
+    IncrementCurCol();
+}
 
+//.....................................................................
+
+void CP::TDbiOutRowStream::StoreReal(Double_t value)  {
+//
+//
+//  Purpose: Store floating point value and move to the next column.
+
+    fRow.AddReal(value,CurColFieldType().GetConcept());
+    IncrementCurCol();
+}
@@ -16,6 +16,8 @@
  * <b>Purpose</b> This is a helper class CP::for TDbiSqlValPacket. Its
  *  primary purpose is to provide an << operator with built-type
  *  checking to simplify the writing of TDbiTableRow subclasses.
+ *  Values are held in their native types in a TDbiRowBuffer; GetCSV
+ *  formats them as SQL text when required.
  *
  * Contact: A.Finch@lancaster.ac.uk
  *
@@ -25,6 +27,7 @@
 #include <string>
 
 #include "TDbi.hxx"
+#include "TDbiRowBuffer.hxx"
 #include "TDbiRowStream.hxx"
 
 namespace CP {
@@ -52,8 +55,13 @@ namespace CP {
         Bool_t HasGoodData() const {
             return ! fBadData && IsComplete();
         }
-        const std::string& GetCSV() const {
-            return fCSV;
+        std::string GetCSV() const {
+            std::string csv;
+            fRow.AppendCSV(csv);
+            return csv;
+        }
+        const TDbiRowBuffer& GetRow() const {
+            return fRow;
         }
         Bool_t IsComplete() const {
             return CurColNum() == NumCols()+1;
@@ -77,7 +85,7 @@ namespace CP {
 
         void Clear() {
             fBadData = kFALSE;
-            fCSV.erase();
+            fRow.Clear();
             ClearCurCol();
         }
 
@@ -87,15 +95,18 @@ namespace CP {
 
 // State changing member functions
         void Store(const std::string& str);
+        void StoreDate(const CP::TVldTimeStamp& ts);
         Bool_t StoreDefaultIfInvalid(TDbi::DataTypes type);
+        void StoreInteger(Long64_t value);
+        void StoreReal(Double_t value);
 
 // Data members
 
 /// Set KTRUE if streamed bad data
         Bool_t fBadData;
 
-/// Comma separated list of values.
-        std::string fCSV;
+/// Values of the row.
+        TDbiRowBuffer fRow;
 
         ClassDef(TDbiOutRowStream,0)  //Output stream for single table row
 
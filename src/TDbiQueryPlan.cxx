@@ -0,0 +1,113 @@
+
+#include <ostream>
+
+#include "TDbiQueryPlan.hxx"
+#include "TDbiResultSet.hxx"
+#include "TDbiTableProxy.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
+
+ClassImp(CP::TDbiQueryPlan)
+
+//   Definition of global functions (alphabetical order)
+//   ***************************************************
+
+std::ostream& CP::operator<<(std::ostream& s, const CP::TDbiQueryPlan& plan) {
+//
+//
+//  Purpose:  Output summary of query plan.
+
+    s << "Query plan for " << plan.GetTimeStart().AsString("s")
+      << " .. " << plan.GetTimeEnd().AsString("s")
+      << " detector " << static_cast<Int_t>(plan.GetDetector())
+      << " SimFlag " << static_cast<Int_t>(plan.GetSimFlag())
+      << " task " << plan.GetTask() << ": "
+      << plan.GetNumTables() << " tables, "
+      << plan.GetNumIntervals() << " validity intervals, preloaded "
+      << plan.GetNumRows() << " rows ("
+      << plan.GetNumBytes() << " bytes)";
+    return s;
+
+}
+
+// Definition of member functions (alphabetical order)
+// ***************************************************
+
+//.....................................................................
+
+CP::TDbiQueryPlan::TDbiQueryPlan(const CP::TVldTimeStamp& start,
+                                 const CP::TVldTimeStamp& end,
+                                 CP::DbiDetector::Detector_t det,
+                                 CP::DbiSimFlag::SimFlag_t simFlag,
+                                 const TDbi::Task& task) :
+    fTimeStart(start),
+    fTimeEnd(end),
+    fDetector(det),
+    fSimFlag(simFlag),
+    fTask(task),
+    fNumIntervals(0),
+    fNumRows(0),
+    fNumBytes(0) {
+//
+//
+//  Purpose:  Constructor
+//
+//  Arguments:
+//    start        in    Start of span.
+//    end          in    End of span (exclusive).
+//    det          in    Detector of all queries.
+//    simFlag      in    SimFlag of all queries.
+//    task         in    Task of all queries.
+
+    DbiTrace("Creating CP::TDbiQueryPlan" << "  ");
+
+}
+
+//.....................................................................
+
+CP::TDbiQueryPlan::~TDbiQueryPlan() {
+//
+//
+//  Purpose: Destructor
+//
+//  Specification:-
+//  =============
+//
+//  o Disconnect all loaded results so the caches can purge them.
+
+    DbiTrace("Destroying CP::TDbiQueryPlan" << "  ");
+
+    for (UInt_t index = 0; index < fProxies.size(); ++index) {
+        std::lock_guard<std::recursive_mutex>
+            lock(fProxies[index]->GetQueryMutex());
+        std::vector<const CP::TDbiResultSet*>& results = fResults[index];
+        for (UInt_t res = 0; res < results.size(); ++res) {
+            results[res]->Disconnect();
+        }
+    }
+
+}
+
+//.....................................................................
+
+void CP::TDbiQueryPlan::Load(CP::TDbiTableProxy& proxy) {
+//
+//
+//  Purpose:  Load a table over the plan's span and add it to the totals.
+//
+//  Arguments:
+//    proxy        in    Proxy of table to load.
+
+    fProxies.push_back(&proxy);
+    fResults.push_back(std::vector<const CP::TDbiResultSet*>());
+    fTables.push_back(proxy.GetTableName());
+
+    UInt_t numRows = 0;
+    ULong64_t numBytes = 0;
+    fNumIntervals += proxy.QuerySpan(fTimeStart,fTimeEnd,fDetector,fSimFlag,
+                                     fTask,fResults.back(),numRows,numBytes);
+    fNumRows  += numRows;
+    fNumBytes += numBytes;
+
+}
+
@@ -0,0 +1,135 @@
+#ifndef DBIQUERYPLAN_H
+#define DBIQUERYPLAN_H
+
+/**
+ *
+ * \class CP::TDbiQueryPlan
+ *
+ *
+ * \brief
+ * <b>Concept</b> The set of tables a job will read over a fixed time span
+ *  for one detector, SimFlag and task, together with the results loaded
+ *  for them.
+ *
+ * \brief
+ * <b>Purpose</b> To let production jobs, which know their run's time span
+ *  and tables before the first event, load everything up front so that
+ *  event time queries are all satisfied from the caches.
+ *
+ * \brief
+ * <b>Usage Notes</b>
+ *
+ *  const CP::TDbiQueryPlan& plan
+ *      = CP::TDbiDatabaseManager::Instance().LoadQueryPlan(tables,
+ *                                                          start,end,
+ *                                                          det,simFlag);
+ *  DbiInfo(plan);
+ *
+ *  The plan holds every loaded result (see TDbiTableProxy::QuerySpan)
+ *  so that the caches cannot purge them, until it is replaced or cleared
+ *  with TDbiDatabaseManager::ClearQueryPlan.
+ *
+ */
+
+#include "DbiDetector.hxx"
+#include "DbiSimFlag.hxx"
+#include "TDbi.hxx"
+#include "TVldTimeStamp.hxx"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace CP {
+    class TDbiQueryPlan;
+    class TDbiResultSet;
+    class TDbiTableProxy;
+    std::ostream& operator<<(std::ostream& s, const CP::TDbiQueryPlan& plan);
+}
+
+namespace CP {
+
+    class TDbiQueryPlan {
+
+    public:
+
+// Constructors and destructors.
+        TDbiQueryPlan(const CP::TVldTimeStamp& start,
+                      const CP::TVldTimeStamp& end,
+                      CP::DbiDetector::Detector_t det,
+                      CP::DbiSimFlag::SimFlag_t simFlag,
+                      const TDbi::Task& task);
+        virtual ~TDbiQueryPlan();
+
+// State testing member functions
+        CP::DbiDetector::Detector_t GetDetector() const {
+            return fDetector;
+        }
+        ULong64_t GetNumBytes() const {
+            return fNumBytes;
+        }
+        UInt_t GetNumIntervals() const {
+            return fNumIntervals;
+        }
+        UInt_t GetNumRows() const {
+            return fNumRows;
+        }
+        UInt_t GetNumTables() const {
+            return fTables.size();
+        }
+        CP::DbiSimFlag::SimFlag_t GetSimFlag() const {
+            return fSimFlag;
+        }
+        TDbi::Task GetTask() const {
+            return fTask;
+        }
+        const CP::TVldTimeStamp& GetTimeEnd() const {
+            return fTimeEnd;
+        }
+        const CP::TVldTimeStamp& GetTimeStart() const {
+            return fTimeStart;
+        }
+
+// State changing member functions
+
+/// Load a table over the plan's span (see TDbiTableProxy::QuerySpan).
+        void Load(TDbiTableProxy& proxy);
+
+    private:
+
+// Disabled (not implemented) copy constructor and asignment.
+
+        TDbiQueryPlan(const TDbiQueryPlan&);
+        CP::TDbiQueryPlan& operator=(const CP::TDbiQueryPlan&);
+
+// Data members
+
+/// Time span (end exclusive).
+        CP::TVldTimeStamp fTimeStart;
+        CP::TVldTimeStamp fTimeEnd;
+
+/// Context of all queries.
+        CP::DbiDetector::Detector_t fDetector;
+        CP::DbiSimFlag::SimFlag_t fSimFlag;
+        TDbi::Task fTask;
+
+/// Names of tables loaded.
+        std::vector<std::string> fTables;
+
+/// Totals over all tables.
+        UInt_t fNumIntervals;
+        UInt_t fNumRows;
+        ULong64_t fNumBytes;
+
+#ifndef __CINT__
+/// Proxies and the results loaded from them, each Connect()ed.
+        std::vector<TDbiTableProxy*> fProxies;
+        std::vector< std::vector<const TDbiResultSet*> > fResults;
+#endif
+
+        ClassDef(TDbiQueryPlan,0)   // Up front load of a job's tables.
+
+    };
+};
+
+#endif  // DBIQUERYPLAN_H
@@ -68,6 +68,10 @@ namespace CP {
                             UInt_t seqNo,
                             UInt_t dbNo,
                             TDbi::AbortTest abortTest = TDbi::kTableMissing);
+        TDbiResultSetHandle(TDbiTableProxy& tableProxy,
+                            const CP::TVldContext& vc,
+                            const TDbiResultSet* result,
+                            TDbi::AbortTest abortTest = TDbi::kTableMissing);
         virtual ~TDbiResultSetHandle();
 
 
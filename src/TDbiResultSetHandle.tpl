@@ -76,7 +76,11 @@ namespace CP {
         T pet;
         DbiTrace(  "Creating copy TDbiResultSetHandle for " << pet.GetName()
                    << " Table Proxy at " << &fTableProxy << "  ");
-        if ( fResult ) fResult->Connect();
+        if ( fResult ) {
+            std::lock_guard<std::recursive_mutex>
+                lock(fTableProxy.GetQueryMutex());
+            fResult->Connect();
+        }
 
     }
 
@@ -324,6 +328,57 @@ namespace CP {
 
     ///.....................................................................
 
+    template<class T>
+    TDbiResultSetHandle<T>::TDbiResultSetHandle(CP::TDbiTableProxy& tableProxy,
+                                                const CP::TVldContext& vc,
+                                                const CP::TDbiResultSet* result,
+                                                TDbi::AbortTest abortTest) :
+        fAbortTest(abortTest),
+        fTableProxy(tableProxy),
+        fResult(result),
+        fDetType(vc.GetDetector()),
+        fSimType(vc.GetSimFlag())
+    {
+        ///
+        ///
+        ///  Purpose:  Adopt the result of a context specific query already
+        ///            applied to tableProxy, e.g. on another thread.
+        ///
+        ///  Arguments:
+        ///    tableProxy   in    Proxy the query was applied to.
+        ///    vc           in    The Validity Context of the query.
+        ///    result       in    The result, already Connect()ed on behalf
+        ///                       of this handle.
+        ///    abortTest    in    Test which if failed triggers abort.
+        ///
+        ///  Return:    n/a
+        ///
+        ///  Specification:-
+        ///  =============
+        ///
+        ///  o Create ResultHandle and apply abort test.
+
+        ///  Program Notes:-
+        ///  =============
+
+        ///  Neither the proxy maps nor the timer manager are touched, so
+        ///  the query itself can be made on any thread.
+
+        DbiTrace( "Creating TDbiResultSetHandle for "
+                  << fTableProxy.GetTableName() << " from an applied query"
+                  << "  ");
+        if ( fResult && this->ApplyAbortTest() ) {
+            DbiSevere( "FATAL: "
+                       << "while applying validity context query for "
+                       << vc.AsString());
+            this->Disconnect();
+            throw  CP::EQueryFailed();
+        }
+
+    }
+
+    ///.....................................................................
+
     template<class T>
     TDbiResultSetHandle<T>::~TDbiResultSetHandle() {
         ///
@@ -410,6 +465,8 @@ namespace CP {
 
         if ( fResult && CP::TDbiDatabaseManager::IsActive() ) {
             DbiTrace("Have result and manager is active, so disconnect");
+            std::lock_guard<std::recursive_mutex>
+                lock(fTableProxy.GetQueryMutex());
             fResult->Disconnect();
         }
         fResult = 0;
@@ -727,8 +784,12 @@ namespace CP {
         CP::TDbiTimerManager::gTimerManager.RecBegin(
             fTableProxy.GetTableName(), sizeof(T));
         Disconnect();
-        fResult = fTableProxy.Query(vc,task,findFullTimeWindow);
-        fResult->Connect();
+        {
+            std::lock_guard<std::recursive_mutex>
+                lock(fTableProxy.GetQueryMutex());
+            fResult = fTableProxy.Query(vc,task,findFullTimeWindow);
+            fResult->Connect();
+        }
         CP::TDbiTimerManager::gTimerManager.RecEnd(fResult->GetNumRows());
 
         if ( this->ApplyAbortTest() ) {
@@ -789,8 +850,12 @@ namespace CP {
 
         CP::TDbiTimerManager::gTimerManager.RecBegin(fTableProxy.GetTableName(), sizeof(T));
         Disconnect();
-        fResult = fTableProxy.Query(context.GetString(),task,data,fillOpts);
-        fResult->Connect();
+        {
+            std::lock_guard<std::recursive_mutex>
+                lock(fTableProxy.GetQueryMutex());
+            fResult = fTableProxy.Query(context.GetString(),task,data,fillOpts);
+            fResult->Connect();
+        }
         CP::TDbiTimerManager::gTimerManager.RecEnd(fResult->GetNumRows());
         if ( this->ApplyAbortTest() ) {
             DbiSevere( "FATAL: " << "while applying extended context query for "
@@ -848,8 +913,12 @@ namespace CP {
 
         /// Play safe and don't allow result to be used; it's validity may not
         /// have been trimmed by neighbouring records.
-        fResult = fTableProxy.Query(vrec,kFALSE);
-        fResult->Connect();
+        {
+            std::lock_guard<std::recursive_mutex>
+                lock(fTableProxy.GetQueryMutex());
+            fResult = fTableProxy.Query(vrec,kFALSE);
+            fResult->Connect();
+        }
         CP::TDbiTimerManager::gTimerManager.RecEnd(fResult->GetNumRows());
         if ( this->ApplyAbortTest() ) {
             DbiSevere( "FATAL: " << "while applying validity rec query for "
@@ -898,8 +967,12 @@ namespace CP {
                   << seqNo << "" << "  ");
         CP::TDbiTimerManager::gTimerManager.RecBegin(fTableProxy.GetTableName(), sizeof(T));
         Disconnect();
-        fResult = fTableProxy.Query(seqNo,dbNo);
-        fResult->Connect();
+        {
+            std::lock_guard<std::recursive_mutex>
+                lock(fTableProxy.GetQueryMutex());
+            fResult = fTableProxy.Query(seqNo,dbNo);
+            fResult->Connect();
+        }
         CP::TDbiTimerManager::gTimerManager.RecEnd(fResult->GetNumRows());
         if ( this->ApplyAbortTest() ) {
             DbiSevere( "while applying SEQNO query for "
@@ -0,0 +1,211 @@
+
+#include <iomanip>
+#include <sstream>
+
+#include "TSQLStatement.h"
+
+#include "TDbi.hxx"
+#include "TDbiRowBuffer.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
+#include "UtilString.hxx"
+#include "TVldTimeStamp.hxx"
+
+ClassImp(CP::TDbiRowBuffer)
+
+//   Definition of static data members
+//   *********************************
+
+
+//    Definition of all member functions (static or otherwise)
+//    *******************************************************
+//
+//    -  ordered: ctors, dtor, operators then in alphabetical order.
+
+//.....................................................................
+
+CP::TDbiRowBuffer::TDbiRowBuffer() {
+//
+//
+//  Purpose:  Default constructor
+
+    DbiTrace("Creating CP::TDbiRowBuffer" << "  ");
+
+}
+
+//.....................................................................
+
+CP::TDbiRowBuffer::~TDbiRowBuffer() {
+//
+//
+//  Purpose: Destructor
+
+    DbiTrace("Destroying CP::TDbiRowBuffer" << "  ");
+
+}
+
+//.....................................................................
+
+void CP::TDbiRowBuffer::AddDate(const CP::TVldTimeStamp& value,
+                                UInt_t concept) {
+//
+//
+//  Purpose:  Add date value (held to the second as SQL DateTime).
+
+    fValues.push_back(Value(kDate,concept));
+    fValues.back().fInt = value.GetSec();
+
+}
+
+//.....................................................................
+
+void CP::TDbiRowBuffer::AddInteger(Long64_t value, UInt_t concept) {
+//
+//
+//  Purpose:  Add integer value.
+
+    fValues.push_back(Value(kInteger,concept));
+    fValues.back().fInt = value;
+
+}
+
+//.....................................................................
+
+void CP::TDbiRowBuffer::AddReal(Double_t value, UInt_t concept) {
+//
+//
+//  Purpose:  Add floating point value.
+
+    fValues.push_back(Value(kReal,concept));
+    fValues.back().fReal = value;
+
+}
+
+//.....................................................................
+
+void CP::TDbiRowBuffer::AddText(const std::string& value, UInt_t concept) {
+//
+//
+//  Purpose:  Add value already in text form.
+
+    fValues.push_back(Value(kText,concept));
+    fValues.back().fText = value;
+
+}
+
+//.....................................................................
+
+void CP::TDbiRowBuffer::AppendCSV(std::string& csv, UInt_t firstCol) const {
+//
+//
+//  Purpose:  Append values as comma separated SQL literals.
+//
+//  Arguments:
+//    csv          in/out  String to append to.
+//    firstCol     in      First column to append (0..).
+//
+//  Specification:-
+//  =============
+//
+//  o Produce exactly what TDbiOutRowStream wrote before values were
+//    buffered: numbers to 16 significant figures, dates as SQL DateTime,
+//    values of string, date and char columns quoted and those of string
+//    columns made printable.
+
+    for (UInt_t col = firstCol; col < fValues.size(); ++col) {
+        const Value& value = fValues[col];
+        std::string str;
+        switch (value.fType) {
+        case kInteger:
+        case kReal: {
+            std::ostringstream out;
+            out << std::setprecision(16);
+            if (value.fType == kInteger) {
+                out << value.fInt;
+            }
+            else {
+                out << value.fReal;
+            }
+            str = out.str();
+            break;
+        }
+        case kDate:
+            str = TDbi::MakeDateTimeString(
+                CP::TVldTimeStamp(static_cast<time_t>(value.fInt),0));
+            break;
+        default:
+            str = value.fText;
+        }
+
+        std::string delim = "";
+        if (value.fConcept == TDbi::kString
+            || value.fConcept == TDbi::kDate
+            || value.fConcept == TDbi::kChar) {
+            delim = "\'";
+        }
+        if (col > firstCol) {
+            csv += ',';
+        }
+        csv += delim;
+        if (value.fConcept != TDbi::kString) {
+            csv += str;
+        }
+        else {
+            CP::UtilString::MakePrintable(str.c_str(),csv);
+        }
+        csv += delim;
+    }
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiRowBuffer::Bind(TSQLStatement& stmt,
+                               Int_t firstParam,
+                               UInt_t firstCol) const {
+//
+//
+//  Purpose:  Bind values to a prepared statement.
+//
+//  Arguments:
+//    stmt         in/out  Prepared statement positioned at the required
+//                         iteration (see TSQLStatement::NextIteration).
+//    firstParam   in      Parameter number of first value.
+//    firstCol     in      First column to bind (0..).
+//
+//  Return:    kTRUE if all values bound.
+//
+//  Program Notes:-
+//  =============
+//
+//  Values held as text, such as the default substituted for bad data,
+//  are bound as strings and converted by the server.
+
+    Bool_t ok = kTRUE;
+    Int_t param = firstParam;
+    for (UInt_t col = firstCol; ok && col < fValues.size(); ++col, ++param) {
+        const Value& value = fValues[col];
+        switch (value.fType) {
+        case kInteger:
+            ok = stmt.SetLong64(param,value.fInt);
+            break;
+        case kReal:
+            ok = stmt.SetDouble(param,value.fReal);
+            break;
+        case kDate: {
+            CP::TVldTimeStamp ts(static_cast<time_t>(value.fInt),0);
+            UInt_t year = 0, month = 0, day = 0, hour = 0, min = 0, sec = 0;
+            ts.GetDate(kTRUE,0,&year,&month,&day);
+            ts.GetTime(kTRUE,0,&hour,&min,&sec);
+            ok = stmt.SetDatime(param,year,month,day,hour,min,sec);
+            break;
+        }
+        default:
+            ok = stmt.SetString(param,value.fText.c_str(),
+                                value.fText.size()+1);
+        }
+    }
+    return ok;
+
+}
+
@@ -0,0 +1,107 @@
+#ifndef DBIROWBUFFER_H
+#define DBIROWBUFFER_H
+
+/**
+ *
+ *
+ * \class CP::TDbiRowBuffer
+ *
+ *
+ * \brief
+ * <b>Concept</b> The values of a single table row held in their native
+ *  types, together with the concept (see TDbi::DataTypes) of each
+ *  column.
+ *
+ * \brief
+ * <b>Purpose</b> Filled by TDbiOutRowStream so that rows being written
+ *  can be bound directly to a prepared insert rather than being
+ *  formatted as SQL text and parsed again.  The text form, as written
+ *  to .update files, is only generated on request by AppendCSV.
+ *
+ * Contact: A.Finch@lancaster.ac.uk
+ *
+ *
+ */
+
+#if !defined(__CINT__) || defined(__MAKECINT__)
+#include "Rtypes.h"
+#endif
+
+#include <string>
+#include <vector>
+
+class TSQLStatement;
+
+namespace CP {
+    class TVldTimeStamp;
+}
+
+namespace CP {
+
+    class TDbiRowBuffer {
+
+    public:
+
+// Types and enum
+
+/// How a value is held.
+        typedef enum EValueType {
+            kInteger,
+            kReal,
+            kText,
+            kDate
+        } ValueType_t;
+
+// Constructors and destructors.
+        TDbiRowBuffer();
+        virtual ~TDbiRowBuffer();
+
+// State testing member functions
+
+/// Append values from column firstCol as comma separated SQL literals.
+        void AppendCSV(std::string& csv, UInt_t firstCol = 0) const;
+/// Bind values from column firstCol to consecutive parameters from
+/// firstParam.
+        Bool_t Bind(TSQLStatement& stmt,
+                    Int_t firstParam,
+                    UInt_t firstCol = 0) const;
+        UInt_t GetNumCols() const {
+            return fValues.size();
+        }
+
+// State changing member functions
+
+        void AddDate(const CP::TVldTimeStamp& value, UInt_t concept);
+        void AddInteger(Long64_t value, UInt_t concept);
+        void AddReal(Double_t value, UInt_t concept);
+        void AddText(const std::string& value, UInt_t concept);
+        void Clear() {
+            fValues.clear();
+        }
+
+    private:
+
+/// A single value.
+        struct Value {
+            Value(ValueType_t type, UInt_t concept) :
+                fType(type), fConcept(concept), fInt(0), fReal(0.) {}
+            UChar_t fType;
+            UChar_t fConcept;
+            Long64_t fInt;    // kInteger value or kDate seconds.
+            Double_t fReal;
+            std::string fText;
+        };
+
+// Data members
+
+#ifndef __CINT__
+/// Values in column order.
+        std::vector<Value> fValues;
+#endif
+
+        ClassDef(TDbiRowBuffer,0)     // Typed values of a table row.
+
+    };
+};
+
+#endif  // DBIROWBUFFER_H
@@ -0,0 +1,721 @@
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include "TSQLServer.h"
+#include "TSQLStatement.h"
+
+#include "TDbi.hxx"
+#include "TDbiCascader.hxx"
+#include "TDbiConnection.hxx"
+#include "TDbiDatabaseManager.hxx"
+#include "TDbiDBProxy.hxx"
+#include "TDbiSQLiteExporter.hxx"
+#include "TDbiString.hxx"
+#include "TDbiTableMetaData.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
+#include "UtilString.hxx"
+
+ClassImp(CP::TDbiSQLiteExporter)
+
+//   Definition of static data members
+//   *********************************
+
+// Maximum number of SEQNOs in the "in" list of a main table select.
+static const UInt_t kMaxSeqNosPerSelect = 1000;
+
+// Table of the SQLite file holding the sync watermark of each table.
+static const char* kWatermarkTable = "SNAPSHOTSYNC";
+
+// Seconds the INSERTDATE watermark is set back to re-scan sets that were
+// committed late, with an INSERTDATE earlier than those already held.
+static const Double_t kWatermarkOverlap = 3600.;
+
+// Definition of member functions (alphabetical order)
+// ***************************************************
+
+//.....................................................................
+
+CP::TDbiSQLiteExporter::TDbiSQLiteExporter(const std::string& fileName) :
+    fFileName(fileName),
+    fTarget(0),
+    fHasTimeRange(kFALSE),
+    fSimFlag(CP::DbiSimFlag::kUnknown),
+    fDbNo(-1),
+    fBatchSize(10000),
+    fSourceDbNo(-1),
+    fInTransaction(kFALSE),
+    fNumTables(0),
+    fNumRows(0) {
+//
+//
+//  Purpose:  Constructor
+//
+//  Arguments:
+//    fileName     in    Name of SQLite file to write.  Created if
+//                       necessary when the first table is exported.
+
+    DbiTrace("Creating CP::TDbiSQLiteExporter for " << fFileName << "  ");
+
+}
+
+//.....................................................................
+
+CP::TDbiSQLiteExporter::~TDbiSQLiteExporter() {
+//
+//
+//  Purpose: Destructor
+
+    DbiTrace("Destroying CP::TDbiSQLiteExporter for " << fFileName << "  ");
+
+    if (fTarget) {
+        fTarget->Close();
+    }
+    delete fTarget;
+    fTarget = 0;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::CopyMainRows(TSQLServer* source,
+                                            const std::string& tableName,
+                                            std::vector<UInt_t>& seqNos,
+                                            Bool_t replace) {
+//
+//
+//  Purpose:  Copy the main table rows of a set of SEQNOs.
+//
+//  Arguments:
+//    source       in    Server to read.
+//    tableName    in    Name of main table.
+//    seqNos       in    SEQNOs to copy (sorted on exit).
+//    replace      in    If true first delete any rows of these SEQNOs
+//                       already in the file.
+//
+//  Return:    kTRUE if all rows copied.
+
+    std::sort(seqNos.begin(),seqNos.end());
+    for (UInt_t first = 0; first < seqNos.size();
+         first += kMaxSeqNosPerSelect) {
+        UInt_t last = std::min<UInt_t>(first + kMaxSeqNosPerSelect,
+                                       seqNos.size());
+        CP::TDbiString seqNoList;
+        for (UInt_t index = first; index < last; ++index) {
+            seqNoList << (index == first ? "" : ",") << seqNos[index];
+        }
+        CP::TDbiString sql;
+        if (replace) {
+            sql << "delete from " << tableName << " where SEQNO in ("
+                << seqNoList.GetString() << ")";
+            if (! fTarget->Exec(sql.c_str())) {
+                DbiSevere("Failed to delete from " << tableName << " in "
+                          << fFileName << "  ");
+                return kFALSE;
+            }
+            sql.GetString() = "";
+        }
+        sql << "select * from " << tableName << " where SEQNO in ("
+            << seqNoList.GetString() << ")";
+        if (! this->CopyRows(source,sql.GetString(),tableName,0)) {
+            return kFALSE;
+        }
+    }
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::CopyRows(TSQLServer* source,
+                                        const std::string& select,
+                                        const std::string& tableName,
+                                        std::vector<UInt_t>* seqNos,
+                                        Bool_t replace) {
+//
+//
+//  Purpose:  Copy the rows of a select into a table of the SQLite file.
+//
+//  Arguments:
+//    source       in    Server to read.
+//    select       in    SQL select of the rows to copy.
+//    tableName    in    Name of table to insert into.
+//    seqNos       out   If not null, the SEQNO of each row is appended.
+//    replace      in    If true replace rows with the same primary key.
+//
+//  Return:    kTRUE if all rows copied.
+//
+//  Specification:-
+//  =============
+//
+//  o Insert each row with a prepared statement, binding every value as
+//    a string and leaving it to the column's type affinity to convert.
+//
+//  o Commit every fBatchSize rows unless a Sync holds the transaction.
+
+    TSQLStatement* stmt = source->Statement(select.c_str());
+    if (! stmt || ! stmt->Process() || ! stmt->StoreResult()) {
+        DbiSevere("Failed to read " << tableName << " using: "
+                  << select << "  ");
+        delete stmt;
+        return kFALSE;
+    }
+
+    Int_t numFields = stmt->GetNumFields();
+    Int_t seqNoField = -1;
+    CP::TDbiString insert;
+    insert << (replace ? "insert or replace into " : "insert into ")
+           << tableName << " (";
+    for (Int_t field = 0; field < numFields; ++field) {
+        std::string name(CP::UtilString::ToUpper(stmt->GetFieldName(field)));
+        if (name == "SEQNO") {
+            seqNoField = field;
+        }
+        insert << (field ? "," : "") << name;
+    }
+    insert << ") values (";
+    for (Int_t field = 0; field < numFields; ++field) {
+        insert << (field ? ",?" : "?");
+    }
+    insert << ")";
+
+    Bool_t ok = kTRUE;
+    TSQLStatement* ins = 0;
+    UInt_t numInBatch = 0;
+    ULong64_t numRows = 0;
+
+    while (ok && stmt->NextResultRow()) {
+        if (! ins) {
+            if (! fInTransaction) {
+                fTarget->StartTransaction();
+            }
+            ins = fTarget->Statement(insert.c_str());
+            if (! ins) {
+                ok = kFALSE;
+                break;
+            }
+        }
+        ok = ins->NextIteration();
+        for (Int_t field = 0; ok && field < numFields; ++field) {
+            if (stmt->IsNull(field)) {
+                ok = ins->SetNull(field);
+            }
+            else {
+                const char* value = stmt->GetString(field);
+                ok = ins->SetString(field,value,strlen(value)+1);
+            }
+        }
+        if (seqNos && seqNoField >= 0) {
+            seqNos->push_back(stmt->GetUInt(seqNoField));
+        }
+        ++numRows;
+        if (ok && ++numInBatch >= fBatchSize) {
+            ok = ins->Process();
+            delete ins;
+            ins = 0;
+            ok = ok && (fInTransaction || fTarget->Commit());
+            numInBatch = 0;
+        }
+    }
+    delete stmt;
+
+    if (ins) {
+        ok = ok && ins->Process();
+        delete ins;
+        ins = 0;
+        ok = ok && (fInTransaction || fTarget->Commit());
+    }
+    if (! ok) {
+        if (! fInTransaction) {
+            fTarget->Rollback();
+        }
+        DbiSevere("Failed to insert into " << tableName << " in " << fFileName
+                  << " after " << numRows << " rows" << "  ");
+        return kFALSE;
+    }
+
+    fNumRows += numRows;
+    DbiVerbose("Copied " << numRows << " rows into " << tableName << "  ");
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::CreateTable(const CP::TDbiTableMetaData& metaData) {
+//
+//
+//  Purpose:  Create table in the SQLite file, replacing any existing one.
+//
+//  Arguments:
+//    metaData     in    Meta data of table to create.
+//
+//  Return:    kTRUE if created.
+
+    std::string tableName(metaData.TableName());
+    std::string sql("drop table if exists " + tableName);
+    fTarget->Exec(sql.c_str());
+    sql = metaData.Sql(kFALSE);
+    if (! fTarget->Exec(sql.c_str())) {
+        DbiSevere("Failed to create " << tableName << " in " << fFileName
+                  << " using: " << sql << "  ");
+        return kFALSE;
+    }
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::Export(const std::vector<std::string>& tableNames) {
+//
+//
+//  Purpose:  Export tables (main and VLD) to the SQLite file.
+//
+//  Arguments:
+//    tableNames   in    Names of main tables to export.
+//
+//  Return:    kTRUE if all tables exported.
+
+    return this->Run(tableNames,kFALSE);
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::ExportTable(TSQLServer* source,
+                                           const std::string& tableName) {
+//
+//
+//  Purpose:  Export a single table (main and VLD) to the SQLite file.
+//
+//  Arguments:
+//    source       in    Server to read.
+//    tableName    in    Name of main table to export.
+//
+//  Return:    kTRUE if table exported.
+//
+//  Specification:-
+//  =============
+//
+//  o Create both tables without their secondary indexes.
+//
+//  o Copy the VLD rows that pass the filters, then the main rows of the
+//    same SEQNOs.
+//
+//  o Create the VLD table indexes once it has been loaded.
+//
+//  o Record the sync watermark.
+
+    std::string vldName(tableName + "VLD");
+    CP::TDbiDBProxy dbProxy(CP::TDbiDatabaseManager::Instance().GetCascader(),
+                            tableName,0,0,0);
+    CP::TDbiTableMetaData metaData(tableName);
+    CP::TDbiTableMetaData metaValid(vldName);
+    dbProxy.StoreMetaData(metaData);
+    dbProxy.StoreMetaData(metaValid);
+    if (! metaData.NumCols() || ! metaValid.NumCols()) {
+        DbiSevere("Cannot export " << tableName
+                  << "; no meta data for main or VLD table" << "  ");
+        return kFALSE;
+    }
+    if (! this->CreateTable(metaData) || ! this->CreateTable(metaValid)) {
+        return kFALSE;
+    }
+
+    std::string filter(this->VldFilter());
+    Bool_t filtered = filter != "";
+    CP::TDbiString sql;
+    sql << "select * from " << vldName;
+    if (filtered) {
+        sql << " where " << filter;
+    }
+    std::vector<UInt_t> seqNos;
+    if (! this->CopyRows(source,sql.GetString(),vldName,
+                         filtered ? &seqNos : 0)) {
+        return kFALSE;
+    }
+
+    if (! filtered) {
+        if (! this->CopyRows(source,"select * from " + tableName,
+                             tableName,0)) {
+            return kFALSE;
+        }
+    }
+    else if (! this->CopyMainRows(source,tableName,seqNos,kFALSE)) {
+        return kFALSE;
+    }
+
+    const char* columns[] = {"TIMESTART", "TIMEEND"};
+    for (UInt_t index = 0; index < 2; ++index) {
+        sql.GetString() = "";
+        sql << "create index " << vldName << "_" << columns[index]
+            << " on " << vldName << " (" << columns[index] << ")";
+        if (! fTarget->Exec(sql.c_str())) {
+            DbiSevere("Failed to index " << vldName << " in " << fFileName
+                      << " using: " << sql.GetString() << "  ");
+            return kFALSE;
+        }
+    }
+    if (! this->RecordWatermark(source,tableName)) {
+        return kFALSE;
+    }
+
+    ++fNumTables;
+    DbiVerbose("Exported " << tableName << " ("
+               << (filtered ? "filtered" : "all rows") << ")" << "  ");
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::Open() {
+//
+//
+//  Purpose:  Open the SQLite file if not already open.
+//
+//  Return:    kTRUE if open.
+//
+//  Program Notes:-
+//  =============
+//
+//  The file is a disposable copy, so SQLite is told not to wait for each
+//  commit to reach the disk.
+
+    if (fTarget) {
+        return kTRUE;
+    }
+
+    std::string url("sqlite://" + fFileName);
+    fTarget = TSQLServer::Connect(url.c_str(),"","");
+    if (! fTarget || ! fTarget->IsConnected()) {
+        DbiSevere("Cannot open SQLite file " << fFileName << "  ");
+        delete fTarget;
+        fTarget = 0;
+        return kFALSE;
+    }
+    fTarget->Exec("pragma synchronous = off");
+
+    std::string sql("create table if not exists ");
+    sql += kWatermarkTable;
+    sql += " (TABLENAME VARCHAR(64) not null primary key,"
+           " INSERTDATE DATETIME not null, LASTSEQNO INTEGER not null,"
+           " SYNCDATE DATETIME not null)";
+    if (! fTarget->Exec(sql.c_str())) {
+        DbiSevere("Cannot create " << kWatermarkTable << " in "
+                  << fFileName << "  ");
+        return kFALSE;
+    }
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::ReadWatermark(const std::string& tableName,
+                                             std::string& insertDate,
+                                             UInt_t& seqNo) const {
+//
+//
+//  Purpose:  Read the sync watermark of a table from the SQLite file.
+//
+//  Arguments:
+//    tableName    in    Name of main table.
+//    insertDate   out   Latest VLD INSERTDATE held.
+//    seqNo        out   Last global SEQNO allocated when last synced.
+//
+//  Return:    kTRUE if the table has a watermark.
+
+    CP::TDbiString sql;
+    sql << "select INSERTDATE,LASTSEQNO from " << kWatermarkTable
+        << " where TABLENAME = '" << tableName << "'";
+    TSQLStatement* stmt = fTarget->Statement(sql.c_str());
+    Bool_t found = stmt && stmt->Process() && stmt->StoreResult()
+                   && stmt->NextResultRow();
+    if (found) {
+        insertDate = stmt->GetString(0);
+        seqNo      = stmt->GetUInt(1);
+    }
+    delete stmt;
+    return found;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::RecordWatermark(TSQLServer* source,
+                                               const std::string& tableName) {
+//
+//
+//  Purpose:  Record the sync watermark of a table in the SQLite file.
+//
+//  Arguments:
+//    source       in    Server being read.
+//    tableName    in    Name of main table.
+//
+//  Return:    kTRUE if recorded.
+//
+//  Specification:-
+//  =============
+//
+//  o The INSERTDATE watermark is the earlier of the latest INSERTDATE
+//    now held and the start of the source snapshot, less an overlap of
+//    kWatermarkOverlap secs.
+//
+//  o The SEQNO watermark is the source's last used global SEQNO for the
+//    table or, if it has none, the highest SEQNO now held.
+//
+//  Program Notes:-
+//  =============
+//
+//  A SEQNO can be reserved, and its INSERTDATE set, well before its set
+//  is committed so neither the latest INSERTDATE nor the last used SEQNO
+//  alone bounds the sets still to come.  The overlap means each sync
+//  re-copies a trailing window of sets, which is harmless as they are
+//  replaced.
+
+    std::string vldName(tableName + "VLD");
+    CP::TDbiString sql;
+    sql << "select max(INSERTDATE),max(SEQNO) from " << vldName;
+    TSQLStatement* stmt = fTarget->Statement(sql.c_str());
+    std::string insertDate(TDbi::MakeDateTimeString(CP::TVldTimeStamp::GetBOT()));
+    UInt_t seqNo = 0;
+    if (stmt && stmt->Process() && stmt->StoreResult()
+        && stmt->NextResultRow() && ! stmt->IsNull(0)) {
+        CP::TVldTimeStamp latest(TDbi::MakeTimeStamp(stmt->GetString(0)));
+        if (fSnapshotStart < latest) {
+            latest = fSnapshotStart;
+        }
+        latest.Add(-kWatermarkOverlap);
+        insertDate = TDbi::MakeDateTimeString(latest);
+        seqNo      = stmt->GetUInt(1);
+    }
+    delete stmt;
+
+    CP::TDbiCascader& cascader
+        = CP::TDbiDatabaseManager::Instance().GetCascader();
+    if (cascader.TableExists("GLOBALSEQNO",fSourceDbNo)) {
+        sql.GetString() = "";
+        sql << "select LASTUSEDSEQNO from GLOBALSEQNO where TABLENAME = '"
+            << tableName << "'";
+        stmt = source->Statement(sql.c_str());
+        if (stmt && stmt->Process() && stmt->StoreResult()
+            && stmt->NextResultRow()) {
+            seqNo = stmt->GetUInt(0);
+        }
+        delete stmt;
+    }
+
+    sql.GetString() = "";
+    sql << "insert or replace into " << kWatermarkTable
+        << " (TABLENAME,INSERTDATE,LASTSEQNO,SYNCDATE) values ('"
+        << tableName << "','" << insertDate << "'," << seqNo << ",'"
+        << TDbi::MakeDateTimeString(CP::TVldTimeStamp()) << "')";
+    if (! fTarget->Exec(sql.c_str())) {
+        DbiSevere("Failed to record watermark of " << tableName << " in "
+                  << fFileName << "  ");
+        return kFALSE;
+    }
+    DbiVerbose("Watermark of " << tableName << " INSERTDATE " << insertDate
+               << " SEQNO " << seqNo << "  ");
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::Run(const std::vector<std::string>& tableNames,
+                                   Bool_t sync) {
+//
+//
+//  Purpose:  Export or sync tables.
+//
+//  Arguments:
+//    tableNames   in    Names of main tables.
+//    sync         in    If true sync (see SyncTable) rather than export.
+//
+//  Return:    kTRUE if all tables succeeded.
+//
+//  Specification:-
+//  =============
+//
+//  o Group the tables by the cascade entry they are read from and read
+//    each group in a single transaction so that the export is consistent.
+//
+//  o For a sync, hold a single transaction on the file, committing only
+//    if every table succeeded.
+//
+//  o Update the SQLite query planner statistics.
+
+    if (! this->Open()) {
+        return kFALSE;
+    }
+
+    CP::TDbiCascader& cascader
+        = CP::TDbiDatabaseManager::Instance().GetCascader();
+
+    Bool_t ok = kTRUE;
+    std::map<Int_t,std::vector<std::string> > tablesByDb;
+    for (UInt_t index = 0; index < tableNames.size(); ++index) {
+        std::string tableName(CP::UtilString::ToUpper(tableNames[index]));
+        Int_t dbNo = cascader.GetTableDbNo(tableName,fDbNo);
+        if (dbNo < 0) {
+            DbiSevere("Cannot export " << tableName
+                      << "; not found in cascade" << "  ");
+            ok = kFALSE;
+            continue;
+        }
+        tablesByDb[dbNo].push_back(tableName);
+    }
+
+    if (sync) {
+        fTarget->StartTransaction();
+        fInTransaction = kTRUE;
+    }
+
+    std::map<Int_t,std::vector<std::string> >::const_iterator itr
+        = tablesByDb.begin();
+    for (; itr != tablesByDb.end(); ++itr) {
+        CP::TDbiConnection* connection = cascader.GetConnection(itr->first);
+        TSQLServer* source = connection ? connection->GetServer() : 0;
+        if (! source) {
+            DbiSevere("Cannot export from cascade entry " << itr->first
+                      << "; unable to connect" << "  ");
+            ok = kFALSE;
+            continue;
+        }
+        connection->Connect();
+        fSourceDbNo = itr->first;
+        fSnapshotStart = CP::TVldTimeStamp();
+        if (std::string(source->GetDBMS()) == "MySQL") {
+            source->Exec("start transaction with consistent snapshot");
+        }
+        else {
+            source->StartTransaction();
+        }
+        const std::vector<std::string>& tables = itr->second;
+        for (UInt_t index = 0; index < tables.size() && (ok || ! sync); ++index) {
+            ok = (sync ? this->SyncTable(source,tables[index])
+                       : this->ExportTable(source,tables[index])) && ok;
+        }
+        source->Commit();
+        connection->DisConnect();
+        fSourceDbNo = -1;
+    }
+
+    if (sync) {
+        fInTransaction = kFALSE;
+        if (ok) {
+            ok = fTarget->Commit();
+        }
+        else {
+            fTarget->Rollback();
+            DbiSevere("Sync of " << fFileName << " failed; rolled back" << "  ");
+            return kFALSE;
+        }
+    }
+
+    fTarget->Exec("analyze");
+
+    DbiLog((sync ? "Synced " : "Exported ") << fNumTables << " tables ("
+           << fNumRows << " rows) to " << fFileName << "  ");
+    return ok;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::Sync(const std::vector<std::string>& tableNames) {
+//
+//
+//  Purpose:  Copy new or changed rows of tables into the SQLite file.
+//
+//  Arguments:
+//    tableNames   in    Names of main tables to sync.
+//
+//  Return:    kTRUE if all tables synced.  If not, the file is unchanged.
+
+    return this->Run(tableNames,kTRUE);
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiSQLiteExporter::SyncTable(TSQLServer* source,
+                                         const std::string& tableName) {
+//
+//
+//  Purpose:  Copy new or changed rows of a single table into the file.
+//
+//  Arguments:
+//    source       in    Server to read.
+//    tableName    in    Name of main table to sync.
+//
+//  Return:    kTRUE if table synced.
+//
+//  Specification:-
+//  =============
+//
+//  o If the table has no watermark export it in full.
+//
+//  o Otherwise replace the VLD rows, passing the filters, that have an
+//    INSERTDATE at or after the watermark or a SEQNO beyond it, then
+//    replace the main rows of the same SEQNOs.
+//
+//  o Record the new watermark.
+
+    std::string insertDate;
+    UInt_t lastSeqNo = 0;
+    if (! this->ReadWatermark(tableName,insertDate,lastSeqNo)) {
+        DbiLog("No watermark for " << tableName << " in " << fFileName
+               << "; exporting in full" << "  ");
+        return this->ExportTable(source,tableName);
+    }
+
+    std::string vldName(tableName + "VLD");
+    CP::TDbiString sql;
+    sql << "select * from " << vldName << " where (INSERTDATE >= '"
+        << insertDate << "' or SEQNO > " << lastSeqNo << ")";
+    std::string filter(this->VldFilter());
+    if (filter != "") {
+        sql << " and " << filter;
+    }
+    ULong64_t numRows = fNumRows;
+    std::vector<UInt_t> seqNos;
+    if (! this->CopyRows(source,sql.GetString(),vldName,&seqNos,kTRUE)
+        || ! this->CopyMainRows(source,tableName,seqNos,kTRUE)
+        || ! this->RecordWatermark(source,tableName)) {
+        return kFALSE;
+    }
+
+    ++fNumTables;
+    DbiVerbose("Synced " << tableName << ": " << seqNos.size()
+               << " validities, " << fNumRows - numRows << " rows" << "  ");
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+std::string CP::TDbiSQLiteExporter::VldFilter() const {
+//
+//
+//  Purpose:  Return the SQL condition on VLD rows of the filters or ""
+//            if there are none.
+
+    CP::TDbiString sql;
+    if (fHasTimeRange) {
+        sql << "TimeStart < '" << TDbi::MakeDateTimeString(fTimeEnd) << "' "
+            << "and TimeEnd > '" << TDbi::MakeDateTimeString(fTimeStart) << "'";
+    }
+    if (fSimFlag != CP::DbiSimFlag::kUnknown) {
+        sql << (fHasTimeRange ? " and " : "")
+            << "(SimMask & " << static_cast<Int_t>(fSimFlag) << ")";
+    }
+    return sql.GetString();
+
+}
+
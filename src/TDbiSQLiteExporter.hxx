@@ -0,0 +1,190 @@
+#ifndef DBISQLITEEXPORTER_H
+#define DBISQLITEEXPORTER_H
+
+/**
+ *
+ * \class CP::TDbiSQLiteExporter
+ *
+ *
+ * \brief
+ * <b>Concept</b> Writer of a consistent snapshot of selected tables,
+ *  main and VLD, into a standalone SQLite database file.
+ *
+ * \brief
+ * <b>Purpose</b> To let batch jobs read their constants from a local file
+ *  placed at the front of the cascade rather than querying the central
+ *  server for every job.
+ *
+ * \brief
+ * <b>Usage Notes</b>
+ *
+ *  CP::TDbiSQLiteExporter exporter("calib.sqlite");
+ *  exporter.SetTimeRange(start,end);             // Optional.
+ *  exporter.SetSimFlag(CP::DbiSimFlag::kData);   // Optional.
+ *  if ( ! exporter.Export(tableNames) ) ...
+ *
+ *  then, in the job:-
+ *
+ *  export ENV_TSQL_URL="sqlite://calib.sqlite;$ENV_TSQL_URL"
+ *
+ *  Rows are read from a single cascade entry (by default the first that
+ *  holds each table) inside one transaction so that, on MySQL, all tables
+ *  come from the same consistent snapshot.  Without filters every row is
+ *  exported; with them only VLD rows that overlap the time range and
+ *  whose SIMMASK includes the SimFlag, together with their main table
+ *  rows.  Any existing copy of an exported table in the file is replaced.
+ *
+ *  Rows are inserted in transactions of SetBatchSize rows (default 10000)
+ *  and the TIMESTART and TIMEEND indexes of the VLD tables are created
+ *  once they are loaded.  The file is intended to be read only, it has
+ *  no GLOBALSEQNO or LOCALSEQNO table so cannot be an authorising entry.
+ *
+ *  Sync(tableNames) refreshes an existing file.  For each table it
+ *  copies, using the same filters, only the VLD rows that are new or
+ *  changed since the table's watermark, i.e. with an INSERTDATE at or
+ *  after the latest one already held (or the start of the read if
+ *  earlier) less an hour's overlap, or a SEQNO above the last global
+ *  SEQNO (see GLOBALSEQNO) allocated at the time, replacing any previous
+ *  copy along with its main table rows.  The overlap catches sets
+ *  committed some time after their INSERTDATE and the SEQNO test rows
+ *  written by clients whose clocks lag the watermark.  The whole sync is
+ *  one transaction on the file.  Watermarks are recorded in the file's
+ *  SNAPSHOTSYNC table by both Export and Sync; tables without one are
+ *  exported in full.  Rows deleted from the source are not removed.
+ *
+ */
+
+#include "DbiSimFlag.hxx"
+#include "TVldTimeStamp.hxx"
+
+#include <string>
+#include <vector>
+
+class TSQLServer;
+
+namespace CP {
+    class TDbiSQLiteExporter;
+    class TDbiTableMetaData;
+}
+
+namespace CP {
+
+    class TDbiSQLiteExporter {
+
+    public:
+
+// Constructors and destructors.
+        TDbiSQLiteExporter(const std::string& fileName);
+        virtual ~TDbiSQLiteExporter();
+
+// State testing member functions
+        const std::string& GetFileName() const {
+            return fFileName;
+        }
+        ULong64_t GetNumRows() const {
+            return fNumRows;
+        }
+        UInt_t GetNumTables() const {
+            return fNumTables;
+        }
+
+// State changing member functions
+
+/// Export tables (main and VLD) and return true if all succeeded.
+        Bool_t Export(const std::vector<std::string>& tableNames);
+
+/// Copy new or changed rows of tables exported earlier (see Usage Notes)
+/// and return true if all succeeded.
+        Bool_t Sync(const std::vector<std::string>& tableNames);
+
+/// Number of rows inserted per SQLite transaction.
+        void SetBatchSize(UInt_t batchSize) {
+            fBatchSize = batchSize ? batchSize : 1;
+        }
+/// Read from this cascade entry or, if < 0 (default), the first holding
+/// each table.
+        void SetDbNo(Int_t dbNo) {
+            fDbNo = dbNo;
+        }
+/// Only export VLD rows whose SIMMASK includes simFlag.
+        void SetSimFlag(CP::DbiSimFlag::SimFlag_t simFlag) {
+            fSimFlag = simFlag;
+        }
+/// Only export VLD rows that overlap start .. end (exclusive).
+        void SetTimeRange(const CP::TVldTimeStamp& start,
+                          const CP::TVldTimeStamp& end) {
+            fTimeStart = start;
+            fTimeEnd = end;
+            fHasTimeRange = kTRUE;
+        }
+
+    private:
+
+// Disabled (not implemented) copy constructor and asignment.
+
+        TDbiSQLiteExporter(const TDbiSQLiteExporter&);
+        CP::TDbiSQLiteExporter& operator=(const CP::TDbiSQLiteExporter&);
+
+        Bool_t CopyMainRows(TSQLServer* source,
+                            const std::string& tableName,
+                            std::vector<UInt_t>& seqNos,
+                            Bool_t replace);
+        Bool_t CopyRows(TSQLServer* source,
+                        const std::string& select,
+                        const std::string& tableName,
+                        std::vector<UInt_t>* seqNos,
+                        Bool_t replace = kFALSE);
+        Bool_t CreateTable(const CP::TDbiTableMetaData& metaData);
+        Bool_t ExportTable(TSQLServer* source,
+                           const std::string& tableName);
+        Bool_t Open();
+        Bool_t ReadWatermark(const std::string& tableName,
+                             std::string& insertDate,
+                             UInt_t& seqNo) const;
+        Bool_t RecordWatermark(TSQLServer* source,
+                               const std::string& tableName);
+        Bool_t Run(const std::vector<std::string>& tableNames,
+                   Bool_t sync);
+        Bool_t SyncTable(TSQLServer* source,
+                         const std::string& tableName);
+        std::string VldFilter() const;
+
+// Data members
+
+/// Name of the SQLite file.
+        std::string fFileName;
+
+/// Connection to the SQLite file or 0 if not open.
+        TSQLServer* fTarget;
+
+/// Filters.
+        Bool_t fHasTimeRange;
+        CP::TVldTimeStamp fTimeStart;
+        CP::TVldTimeStamp fTimeEnd;
+        CP::DbiSimFlag::SimFlag_t fSimFlag;
+
+/// Cascade entry to read or -1 for the first holding the table.
+        Int_t fDbNo;
+
+/// Rows per SQLite transaction.
+        UInt_t fBatchSize;
+
+/// Cascade entry currently being read.
+        Int_t fSourceDbNo;
+
+/// Time the read of the current cascade entry started.
+        CP::TVldTimeStamp fSnapshotStart;
+
+/// True while a Sync holds a single transaction open on the file.
+        Bool_t fInTransaction;
+
+/// Totals over all exported tables.
+        UInt_t fNumTables;
+        ULong64_t fNumRows;
+
+        ClassDef(TDbiSQLiteExporter,0)   // Export tables to SQLite.
+
+    };
+};
+
+#endif  // DBISQLITEEXPORTER_H
@@ -12,6 +12,11 @@
 
 bool CP::TDbiServices::fOrderContextQuery          = false;
 bool CP::TDbiServices::fAsciiDBConectionsTemporary = true;
+bool CP::TDbiServices::fConnectionFailover        = false;
+int  CP::TDbiServices::fConnectionLinger           = 0;
+bool CP::TDbiServices::fVldSnapshot                = false;
+int  CP::TDbiServices::fVldSnapshotEnd             = 0x7FFFFFFF;
+int  CP::TDbiServices::fVldSnapshotStart           = 0;
 
 // Definition of static member functions (alphabetical order)
 // **********************************************************
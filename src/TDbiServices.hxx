@@ -36,16 +36,36 @@ namespace CP {
         static bool AsciiDBConectionsTemporary() {
             return fAsciiDBConectionsTemporary;
         }
+        static bool ConnectionFailover() {
+            return fConnectionFailover;
+        }
+        static int ConnectionLinger() {
+            return fConnectionLinger;
+        }
         static bool OrderContextQuery() {
             return fOrderContextQuery;
         }
+        static bool VldSnapshot() {
+            return fVldSnapshot;
+        }
+        static int VldSnapshotEnd() {
+            return fVldSnapshotEnd;
+        }
+        static int VldSnapshotStart() {
+            return fVldSnapshotStart;
+        }
 
     private:
 
 // Data members
 
         static bool fAsciiDBConectionsTemporary;
+        static bool fConnectionFailover;
+        static int  fConnectionLinger;
         static bool fOrderContextQuery;
+        static bool fVldSnapshot;
+        static int  fVldSnapshotEnd;
+        static int  fVldSnapshotStart;
 
     };
 };
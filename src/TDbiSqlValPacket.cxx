@@ -23,6 +23,9 @@
 #include <MsgFormat.hxx>
 #include "UtilString.hxx"
 #include "TVldRange.hxx"
+#include "TMD5.h"
+#include "TSQLStatement.h"
+#include "TStopwatch.h"
 
 ClassImp(CP::TDbiSqlValPacket)
 
@@ -37,6 +40,14 @@ enum EFillState { kLOOKING_FOR_HEADER,
 //   Definition of static data members
 //   *********************************
 
+// Upper limit on the size of a combined insert statement, whatever the
+// server accepts, and the space left below the limit for safety.
+static const UInt_t kMaxBulkInsertSize  = 16*1024*1024;
+static const UInt_t kBulkInsertHeadroom = 1024;
+
+// Maximum number of parameters bound to one statement, the lowest limit
+// of the supported DBMSs (SQLite's default SQLITE_MAX_VARIABLE_NUMBER).
+static const UInt_t kMaxBoundParams = 999;
 
 //   Definition of file static members functions
 //   *******************************************
@@ -214,17 +225,19 @@ void CP::TDbiSqlValPacket::AddRow(const std::string& row) {
 //  Purpose: Add row.
 //
 
+    // Keep statements in order.
+    this->MakeSqlStmts();
+
     std::string sql("INSERT INTO ");
     sql += this->GetTableName();
     if (this->GetNumSqlStmts() == 0) {
         sql += "VLD";
     }
     sql += " VALUES (" + row + ");";
-    std::ostringstream seqno;
-    seqno << this->GetSeqNo();
-    this->SetSeqNoOnRow(sql,seqno.str());
-    fSqlStmts.push_back(sql);
-    ++fNumStmts;
+    if (! this->AddStmt(sql)) {
+        DbiSevere("Cannot add row \"" << row << "\" to packet" << "  ");
+        ++fNumErrors;
+    }
 
 }
 
@@ -262,11 +275,85 @@ Bool_t CP::TDbiSqlValPacket::AddRow(const CP::TDbiTableProxy& tblProxy,
         ++fNumErrors;
         return kFALSE;
     }
-    this->AddRow(outRow.GetCSV());
+    if (isVld) {
+        this->AddRow(outRow.GetCSV());
+    }
+    else {
+        fRows.push_back(outRow.GetRow());
+        ++fNumStmts;
+        fFingerprint.clear();
+    }
     return kTRUE;
 }
 //.....................................................................
 ///\verbatim
+///
+///  Purpose:  Add a complete SQL statement.
+///
+///  Arguments:
+///    sql          in    Statement of form:-
+///                         INSERT INTO <table> VALUES (<seqno>,...);
+///
+///  Return:    kTRUE if the statement had the expected form.
+///
+///  Specification:-
+///  =============
+///
+///  o Hold only the part of the statement after the SEQNO value, the
+///    SEQNO and table name being supplied when the statement is
+///    rendered (see MakeStmt) so that SetSeqNo need not touch the rows.
+///
+///  o For the first (VLD) statement also remove the trailing
+///    CREATIONDATE and INSERTDATE, recording them in fCreationDate and
+///    fInsertDate, so that SetCreationDate need not touch it either.
+///\endverbatim
+Bool_t CP::TDbiSqlValPacket::AddStmt(const std::string& sql) {
+
+    std::string::size_type locStart = sql.find('(');
+    if (locStart == std::string::npos) {
+        return kFALSE;
+    }
+    locStart = sql.find(',',locStart);
+    if (locStart == std::string::npos) {
+        return kFALSE;
+    }
+
+    fFingerprint.clear();
+    if (this->GetNumSqlStmts() > 0) {
+        fSqlStmts.push_back(sql.substr(locStart));
+        ++fNumStmts;
+        return kTRUE;
+    }
+
+    //  Split the VLD row assuming:  "...,'creationdate','insertdate');"
+    std::string::size_type locEnd = sql.rfind(')');
+    if (locEnd == std::string::npos || locEnd <= locStart) {
+        return kFALSE;
+    }
+    std::string::size_type locInsert = sql.rfind(',',locEnd);
+    if (locInsert == std::string::npos || locInsert <= locStart) {
+        return kFALSE;
+    }
+    std::string::size_type locCreate = sql.rfind(',',locInsert-1);
+    if (locCreate == std::string::npos || locCreate <= locStart) {
+        return kFALSE;
+    }
+    std::string date = sql.substr(locCreate+1,locInsert-locCreate-1);
+    if (date.size() >= 2 && date[0] == '\'') {
+        date = date.substr(1,date.size()-2);
+    }
+    fCreationDate = TDbi::MakeTimeStamp(date);
+    fInsertDate = sql.substr(locInsert+1,locEnd-locInsert-1);
+    if (fInsertDate.size() >= 2 && fInsertDate[0] == '\'') {
+        fInsertDate = fInsertDate.substr(1,fInsertDate.size()-2);
+    }
+    fSqlStmts.push_back(sql.substr(locStart,locCreate-locStart));
+    ++fNumStmts;
+    return kTRUE;
+
+}
+//.....................................................................
+///\verbatim
 ///  Purpose:  Compare to another CP::TDbiSqlValPacket
 ///
 ///  Arguments:
@@ -522,13 +609,6 @@ Bool_t CP::TDbiSqlValPacket::Fill(std::ifstream& is) {
                         // Trailer looks good return with object filled.
                         fSeqNo     = seqNoHead;
                         fTableName = nameHead;
-
-                        //Dig out the creation date from the first record.
-                        std::string date = this->GetStmtValues(0)[9];
-                        //Remove the quotes.
-                        date.erase(0,1);
-                        date.erase(date.size()-1,1);
-                        fCreationDate = TDbi::MakeTimeStamp(date);
                         return kTRUE;
 
                     }
@@ -544,8 +624,11 @@ Bool_t CP::TDbiSqlValPacket::Fill(std::ifstream& is) {
             else {
                 sql += line;
                 if (sql[sql.size()-1] == ';') {
-                    fSqlStmts.push_back(sql);
-                    ++fNumStmts;
+                    // The VLD statement also supplies the creation date.
+                    if (! this->AddStmt(sql)) {
+                        Report("Bad SQL",lineNum,sql);
+                        state = kLOOKING_FOR_HEADER;
+                    }
                     sql = "";
                 }
             }
@@ -561,6 +644,54 @@ Bool_t CP::TDbiSqlValPacket::Fill(std::ifstream& is) {
     return kFALSE;
 
 }
+//.....................................................................
+///\verbatim
+///
+///  Purpose:  Return a fingerprint of the packet's content.
+///
+///  Return:   MD5 digest as 32 hex digits, or empty if the packet has no
+///            statements.
+///
+///  Specification:-
+///  =============
+///
+///  o Hash the VLD fields other than SEQNO, CREATIONDATE and INSERTDATE
+///    followed by the values of each data row, in order, other than its
+///    SEQNO.  Two packets differing only in those have the same
+///    fingerprint.
+///
+///  o Hash typed rows in their SQL text form, without converting them,
+///    so that a packet has the same fingerprint whether built by a
+///    writer or filled from an .update file.
+///
+///  o Compute once, the first time required, and cache until the
+///    content changes.
+///\endverbatim
+const std::string& CP::TDbiSqlValPacket::GetFingerprint() const {
+
+    if (! fFingerprint.empty() || this->GetNumSqlStmts() == 0) {
+        return fFingerprint;
+    }
+
+    TMD5 md5;
+    for (std::list<std::string>::const_iterator itr = fSqlStmts.begin();
+         itr != fSqlStmts.end();
+         ++itr) {
+        md5.Update(reinterpret_cast<const UChar_t*>(itr->data()),itr->size());
+    }
+    std::string sql;
+    for (UInt_t row = 0; row < fRows.size(); ++row) {
+        sql = ",";
+        fRows[row].AppendCSV(sql,1);
+        sql += ");";
+        md5.Update(reinterpret_cast<const UChar_t*>(sql.data()),sql.size());
+    }
+    md5.Final();
+    fFingerprint = md5.AsString();
+    return fFingerprint;
+
+}
+
 //.....................................................................
 /// Return a selected statment
 std::string CP::TDbiSqlValPacket::GetStmt(UInt_t stmtNo) const {
@@ -571,15 +702,19 @@ std::string CP::TDbiSqlValPacket::GetStmt(UInt_t stmtNo) const {
     if (stmtNo >= this->GetNumSqlStmts()) {
         return "";
     }
+    if (stmtNo >= fSqlStmts.size()) {
+        this->MakeSqlStmts();
+    }
 
     // Locate statement
     std::list<std::string>::const_iterator itr = fSqlStmts.begin();
+    Bool_t isVld = stmtNo == 0;
     while (stmtNo) {
         ++itr;
         --stmtNo;
     }
 
-    return *itr;
+    return this->MakeStmt(*itr,isVld);
 
 }
 //.....................................................................
@@ -648,6 +783,9 @@ Bool_t CP::TDbiSqlValPacket::IsEqual(const CP::TDbiSqlValPacket& that,
                                      const Char_t* thisName,
                                      const Char_t* thatName) const {
 //
+    this->MakeSqlStmts();
+    that.MakeSqlStmts();
+
     if (fSeqNo           != that.fSeqNo
         || fTableName       != that.fTableName
         || fNumStmts != that.fNumStmts) {
@@ -670,12 +808,14 @@ Bool_t CP::TDbiSqlValPacket::IsEqual(const CP::TDbiSqlValPacket& that,
 
     Bool_t isEqual = kTRUE;
 
-    // Strip off InsertDate from first statement (assume its
-    // the last parameter in list).
+    // Compare first statement without InsertDate.
 
-    std::string strThis = (*itrThis).substr(0,(*itrThis).rfind(','));
-    std::string strThat = (*itrThat).substr(0,(*itrThat).rfind(','));
-    if (strThis != strThat) {
+    if (*itrThis != *itrThat
+        || fCreationDate.GetSec() != that.fCreationDate.GetSec()) {
+        std::string strThis = this->MakeStmt(*itrThis,kTRUE);
+        std::string strThat = that.MakeStmt(*itrThat,kTRUE);
+        strThis = strThis.substr(0,strThis.rfind(','));
+        strThat = strThat.substr(0,strThat.rfind(','));
         if (! log) {
             return kFALSE;
         }
@@ -755,8 +895,10 @@ Bool_t CP::TDbiSqlValPacket::IsEqual(const CP::TDbiSqlValPacket& that,
             isEqual = kFALSE;
             DbiInfo("Difference on data record "
                     << ":-\n"
-                    << "  " << thisName << ": " << **shadowThisItr  << "  "
-                    << "  " << thatName << ": " << **shadowThatItr  << "  ");
+                    << "  " << thisName << ": "
+                    << this->MakeStmt(**shadowThisItr,kFALSE)  << "  "
+                    << "  " << thatName << ": "
+                    << that.MakeStmt(**shadowThatItr,kFALSE)  << "  ");
         }
         ++shadowThisItr;
         ++shadowThatItr;
@@ -766,6 +908,57 @@ Bool_t CP::TDbiSqlValPacket::IsEqual(const CP::TDbiSqlValPacket& that,
 
 }
 
+//.....................................................................
+/// Convert any typed data rows to SQL statements.
+void CP::TDbiSqlValPacket::MakeSqlStmts() const {
+//
+//
+//  Purpose:  Convert typed data rows (see TDbiRowBuffer) to SQL
+//            statements, appending them to fSqlStmts in order.
+//
+//  Program Notes:-
+//  =============
+//
+//  As for all data rows only the part after the SEQNO is held.
+
+    for (UInt_t row = 0; row < fRows.size(); ++row) {
+        std::string sql(",");
+        fRows[row].AppendCSV(sql,1);
+        sql += ");";
+        fSqlStmts.push_back(sql);
+    }
+    fRows.clear();
+
+}
+
+//.....................................................................
+///\verbatim
+///
+///  Purpose:  Render a complete SQL statement.
+///
+///  Arguments:
+///    tail         in    Statement as held in fSqlStmts (see AddStmt).
+///    isVld        in    kTRUE if the VLD statement.
+///    insertDate   in    INSERTDATE of VLD statement or, if empty
+///                       (default), the one it was filled with.
+///
+///  Return:    INSERT INTO <table> VALUES (<seqno>...);
+///\endverbatim
+std::string CP::TDbiSqlValPacket::MakeStmt(const std::string& tail,
+                                           Bool_t isVld,
+                                           const std::string& insertDate) const {
+
+    std::ostringstream sql;
+    sql << "INSERT INTO " << this->GetTableName()
+        << (isVld ? "VLD" : "") << " VALUES (" << fSeqNo << tail;
+    if (isVld) {
+        sql << ",\'" << TDbi::MakeDateTimeString(fCreationDate) << "\',\'"
+            << (insertDate.empty() ? fInsertDate : insertDate) << "\');";
+    }
+    return sql.str();
+
+}
+
 //.....................................................................
 /// Print the current state
 void CP::TDbiSqlValPacket::Print(Option_t* /* option */) const {
@@ -781,6 +974,8 @@ void CP::TDbiSqlValPacket::Print(Option_t* /* option */) const {
             << "   CreationDate " << fCreationDate
             << "  ");
 
+    this->MakeSqlStmts();
+
     DbiInfo("   MySQL Main table creation: \"" << fSqlMySqlMetaMain << "\"" << "  ");
 
     DbiInfo("   MySQL VLD table creation: \"" << fSqlMySqlMetaVld << "\"" << "  ");
@@ -789,7 +984,8 @@ void CP::TDbiSqlValPacket::Print(Option_t* /* option */) const {
         std::list<std::string>::const_iterator itr    = fSqlStmts.begin();
         std::list<std::string>::const_iterator itrEnd = fSqlStmts.end();
         for (; itr != itrEnd; ++itr) {
-            DbiInfo("   SqlStmt \"" << *itr << "\"" << "  ");
+            DbiInfo("   SqlStmt \"" << this->MakeStmt(*itr,itr == fSqlStmts.begin())
+                    << "\"" << "  ");
         }
     }
     else {
@@ -885,8 +1081,11 @@ void CP::TDbiSqlValPacket::Reset() {
     fSqlMySqlMetaMain = "";
     fSqlMySqlMetaVld  = "";
     fSqlStmts.clear();
+    fRows.clear();
     fNumStmts    = 0;
     fTableName   = "";
+    fInsertDate  = "";
+    fFingerprint = "";
 
 }
 //.....................................................................
@@ -895,26 +1094,9 @@ void CP::TDbiSqlValPacket::SetCreationDate(CP::TVldTimeStamp ts) {
 //
 //
 //
+//  The validity row is completed with it when rendered (see MakeStmt).
     fCreationDate = ts;
 
-    //  Update the validity row assuming:  "...,'creationdate',insertdate);"
-    if (this->GetNumSqlStmts() == 0) {
-        return;
-    }
-
-    std::string& vldRow = *fSqlStmts.begin();
-    std::string::size_type locEnd = vldRow.rfind(',');
-    if (locEnd == std::string::npos) {
-        return;
-    }
-    locEnd -=2;
-    std::string::size_type locStart = vldRow.rfind(',',locEnd);
-    if (locStart == std::string::npos) {
-        return;
-    }
-    locStart+=2;
-    vldRow.replace(locStart,locEnd-locStart+1,ts.AsString("s"));
-
 }
 //.....................................................................
 /// Set EPOCH
@@ -923,14 +1105,15 @@ void CP::TDbiSqlValPacket::SetEpoch(UInt_t epoch) {
 //
 //  Purpose:  Set EPOCH
 
-    //  Update the validity row assuming:  "(seqno,timestart,timeend,epoch,....)
+    //  Update the validity row assuming:  ",timestart,timeend,epoch,...."
+    //  (the SEQNO being supplied when rendered).
     if (this->GetNumSqlStmts() == 0) {
         return;
     }
 
     std::string& vldRow = *fSqlStmts.begin();
     std::string::size_type locStart = 0;
-    for (int field = 0; field < 3; ++field) {
+    for (int field = 0; field < 2; ++field) {
         locStart = vldRow.find(',',locStart+1);
         if (locStart == std::string::npos) {
             return;
@@ -945,6 +1128,7 @@ void CP::TDbiSqlValPacket::SetEpoch(UInt_t epoch) {
     std::ostringstream epoch_str;
     epoch_str << epoch;
     vldRow.replace(locStart,locEnd-locStart+1,epoch_str.str());
+    fFingerprint.clear();
 
 }
 
@@ -982,45 +1166,14 @@ void CP::TDbiSqlValPacket::SetSeqNo(UInt_t seqno) {
 //
 //
 //  Purpose:  Set Sequence number.
-
-    fSeqNo = seqno;
-
-    //  Update all rows
-    if (this->GetNumSqlStmts() == 0) {
-        return;
-    }
-
-    std::ostringstream tmp;
-    tmp << seqno;
-    const std::string seqnoStr = tmp.str();
-
-    std::list<std::string>::iterator itr    = fSqlStmts.begin();
-    std::list<std::string>::iterator itrEnd = fSqlStmts.end();
-    for (; itr != itrEnd; ++itr) {
-        SetSeqNoOnRow(*itr,seqnoStr);
-    }
-
-
-}
-
-//.....................................................................
-///  Purpose:  Set Sequence number on supplied row
-void CP::TDbiSqlValPacket::SetSeqNoOnRow(std::string& row,const std::string& seqno) {
 //
+//  Program Notes:-
+//  =============
 //
+//  Rows are held without their SEQNO, which is supplied when they are
+//  rendered or bound, so none need updating.
 
-//  Update row assuming:  "...(seqno, ...."
-
-    std::string::size_type locStart = row.find('(');
-    if (locStart == std::string::npos) {
-        return;
-    }
-    ++locStart;
-    std::string::size_type locEnd = row.find(',',locStart);
-    if (locEnd == std::string::npos) {
-        return;
-    }
-    row.replace(locStart,locEnd-locStart,seqno);
+    fSeqNo = seqno;
 
 }
 
@@ -1042,6 +1195,15 @@ void CP::TDbiSqlValPacket::SetSeqNoOnRow(std::string& row,const std::string& seq
 ///
 ///  o Output validity packet to specified database modifying
 ///    InsertDate to be current date.
+///
+///  o Apply the removal of any existing SeqNo, the VLD row and the data
+///    rows in a single transaction, rolled back if any part fails.
+///
+///  Program Notes:-
+///  =============
+///
+///  MySQL MyISAM tables ignore transactions so a failure part way
+///  through can still leave a partial packet.
 ///\endverbatim
 Bool_t CP::TDbiSqlValPacket::Store(UInt_t dbNo, Bool_t replace) const {
 
@@ -1050,17 +1212,6 @@ Bool_t CP::TDbiSqlValPacket::Store(UInt_t dbNo, Bool_t replace) const {
         return kFALSE;
     }
 
-    //Just use any old table row object just to get a CP::TDbiDBProxy.
-    CP::TDbiConfigSet pet;
-    CP::TDbiTableProxy& tp =  CP::TDbiDatabaseManager::Instance()
-                              .GetTableProxy(this->GetTableName(),&pet);
-    if (replace) {
-        const CP::TDbiDBProxy& proxy = tp.GetDBProxy();
-        if (! proxy.RemoveSeqNo(this->GetSeqNo(),dbNo)) {
-            return kFALSE;
-        }
-    }
-
     // Locate required CP::TDbiStatement.
     std::unique_ptr<CP::TDbiStatement>
         stmtDb(CP::TDbiDatabaseManager::Instance()
@@ -1072,69 +1223,220 @@ Bool_t CP::TDbiSqlValPacket::Store(UInt_t dbNo, Bool_t replace) const {
         return kFALSE;
     }
 
+    TStopwatch timer;
+    stmtDb->StartTransaction();
+    if (stmtDb->PrintExceptions()) {
+        return kFALSE;
+    }
+
+    if (! this->Store(*stmtDb,replace)) {
+        stmtDb->Rollback();
+        stmtDb->PrintExceptions();
+        DbiSevere("Failed to store SEQNO " << this->GetSeqNo() << " of "
+                  << this->GetTableName() << "; rolled back" << "  ");
+        return kFALSE;
+    }
+    stmtDb->Commit();
+    if (stmtDb->PrintExceptions()) {
+        return kFALSE;
+    }
+
+    timer.Stop();
+    DbiVerbose("Stored " << this->GetNumSqlStmts() - 1 << " rows of "
+               << this->GetTableName() << " SEQNO " << this->GetSeqNo()
+               << " in " << timer.RealTime() << " secs" << "  ");
+    return kTRUE;
+
+}
+
+//.....................................................................
+///\verbatim
+///
+///  Purpose:  Output validity packet using a statement whose transaction
+///            is managed by the caller.
+///
+///  Arguments:
+///    stmtDb       in    Statement of the cascade entry.
+///    replace      in    If true replace existing SeqNo (default: kFALSE).
+///
+///  Return:    kTRUE if successfully stored.
+///
+///  Specification:-
+///  =============
+///
+///  o As Store(dbNo,replace) but neither start nor end a transaction so
+///    that several packets can be committed together (see
+///    TDbiWriterSession).
+///
+///  o Combine data rows held as SQL into multi-row inserts each as large
+///    as the server accepts (see TDbiConnection::GetMaxStatementSize).
+///
+///  o Bind typed data rows directly (see StoreRows).
+///\endverbatim
+Bool_t CP::TDbiSqlValPacket::Store(CP::TDbiStatement& stmtDb,
+                                   Bool_t replace) const {
+
+    if (! CanBeStored()) {
+        return kFALSE;
+    }
+
+    Bool_t ok = kTRUE;
+    if (replace) {
+        //Just use any old table row object just to get a CP::TDbiDBProxy.
+        CP::TDbiConfigSet pet;
+        CP::TDbiTableProxy& tp =  CP::TDbiDatabaseManager::Instance()
+                                  .GetTableProxy(this->GetTableName(),&pet);
+        const CP::TDbiDBProxy& proxy = tp.GetDBProxy();
+        ok = proxy.RemoveSeqNo(this->GetSeqNo(),stmtDb);
+    }
 
     // Loop processing all SQL statements
     Bool_t first = kTRUE;
-    int combineInserts = 0;
-    int maxInserts = 20;
+    std::string::size_type maxSize
+        = std::min<UInt_t>(stmtDb.GetMaxStatementSize(),kMaxBulkInsertSize)
+          - kBulkInsertHeadroom;
+    std::ostringstream seqNoStr;
+    seqNoStr << this->GetSeqNo();
+    const std::string seqNo = seqNoStr.str();
+    const std::string insert = "INSERT INTO " + this->GetTableName() + " VALUES ";
     std::string sqlInserts;
 
     for (std::list<std::string>::const_iterator itr = fSqlStmts.begin();
-         itr != fSqlStmts.end();
+         ok && itr != fSqlStmts.end();
          ++itr) {
         if (first) {
 //    On first statement replace InsertDate by current datetime.
-            std::string sql = *itr;
-            std::list<std::string>::size_type locDate = sql.rfind(",\'");
-            if (locDate !=  std::string::npos) {
-                CP::TVldTimeStamp now;
-                sql.replace(locDate+2,19,TDbi::MakeDateTimeString(now));
-            }
-            stmtDb->ExecuteUpdate(sql.c_str());
-            if (stmtDb->PrintExceptions()) {
-                return kFALSE;
-            }
+            CP::TVldTimeStamp now;
+            std::string sql = this->MakeStmt(*itr,kTRUE,
+                                             TDbi::MakeDateTimeString(now));
+            stmtDb.ExecuteUpdate(sql.c_str());
+            ok = ! stmtDb.PrintExceptions();
             first = kFALSE;
             continue;
         }
 
-        std::string sql = *itr;
+//  Reduce database I/O by combining rows into insert statements
+//  up to the size the server accepts.  Each row is held as the part
+//  after its SEQNO, ending ");".
 
-//  Reduce database I/O by combining groups of insert commands.
-
-        std::string::size_type insertIndex = sql.find("VALUES (");
-        if (insertIndex == std::string::npos) {
-            DbiSevere("Unexpected SQL : " << sql
-                      << "\n  should be of form INSERT INTO ... VALUES (...);" << "  ");
-            return kFALSE;
+        const std::string& tail = *itr;
+        if (! sqlInserts.empty()
+            && sqlInserts.size() + seqNo.size() + tail.size() + 1 > maxSize) {
+            stmtDb.ExecuteUpdate(sqlInserts.c_str());
+            ok = ! stmtDb.PrintExceptions();
+            sqlInserts.clear();
         }
-        ++combineInserts;
-        if (combineInserts == 1) {
-            sqlInserts = sql;
+        if (sqlInserts.empty()) {
+            sqlInserts = insert;
         }
         else {
             sqlInserts[sqlInserts.size()-1] = ',';
-            sqlInserts += sql.substr(insertIndex+7);
         }
-        if (combineInserts >= maxInserts) {
-            stmtDb->ExecuteUpdate(sqlInserts.c_str());
-            if (stmtDb->PrintExceptions()) {
+        sqlInserts += '(';
+        sqlInserts += seqNo;
+        sqlInserts += tail;
+    }
+
+// Deal with last group of inserts.
+    if (ok && ! sqlInserts.empty()) {
+        stmtDb.ExecuteUpdate(sqlInserts.c_str());
+        ok = ! stmtDb.PrintExceptions();
+    }
+
+// Bind any typed data rows.
+    if (ok && ! fRows.empty()) {
+        ok = this->StoreRows(stmtDb);
+    }
+
+    return ok;
+
+}
+
+//.....................................................................
+///\verbatim
+///
+///  Purpose:  Insert typed data rows by binding them to prepared
+///            statements.
+///
+///  Arguments:
+///    stmtDb       in    Statement of the cascade entry (with the
+///                       transaction of Store open).
+///
+///  Return:    kTRUE if all rows inserted.
+///
+///  Specification:-
+///  =============
+///
+///  o Insert blocks of rows with a multi-row statement of placeholders,
+///    with as many rows as kMaxBoundParams allows, binding each block as
+///    one iteration of the statement.  A final partial block needs its
+///    own statement.
+///
+///  o Bind the packet's SEQNO in place of the dummy held by each row.
+///\endverbatim
+Bool_t CP::TDbiSqlValPacket::StoreRows(CP::TDbiStatement& stmtDb) const {
+
+    UInt_t numCols = fRows.front().GetNumCols();
+    UInt_t rowsPerStmt = numCols ? std::max<UInt_t>(1,kMaxBoundParams/numCols) : 1;
+
+    Bool_t ok = kTRUE;
+    TSQLStatement* stmt = 0;
+    UInt_t stmtRows = 0;
+    for (UInt_t first = 0; ok && first < fRows.size(); first += rowsPerStmt) {
+        UInt_t numRows = std::min<UInt_t>(rowsPerStmt,fRows.size()-first);
+        if (numRows != stmtRows) {
+            if (stmt) {
+                ok = stmt->Process();
+                if (! ok) {
+                    DbiSevere("Insert into " << this->GetTableName()
+                              << " failed: " << stmt->GetErrorMsg() << "  ");
+                }
+                delete stmt;
+                stmt = 0;
+            }
+            if (! ok) {
+                break;
+            }
+            std::string placeholders("(");
+            for (UInt_t col = 0; col < numCols; ++col) {
+                placeholders += col ? ",?" : "?";
+            }
+            placeholders += ")";
+            std::string sql("INSERT INTO ");
+            sql += this->GetTableName();
+            sql += " VALUES ";
+            for (UInt_t row = 0; row < numRows; ++row) {
+                sql += row ? "," : "";
+                sql += placeholders;
+            }
+            stmt = stmtDb.CreatePreparedStatement(sql.c_str());
+            if (! stmt) {
+                stmtDb.PrintExceptions();
                 return kFALSE;
             }
-            combineInserts = 0;
+            stmtRows = numRows;
+        }
+        ok = stmt->NextIteration();
+        for (UInt_t row = 0; ok && row < numRows; ++row) {
+            ok = stmt->SetLong64(row*numCols,this->GetSeqNo())
+                 && fRows[first+row].Bind(*stmt,row*numCols+1,1);
+        }
+        if (! ok) {
+            DbiSevere("Failed to bind rows of " << this->GetTableName()
+                      << ": " << stmt->GetErrorMsg() << "  ");
         }
     }
-
-// Deal with last group of inserts.
-    if (combineInserts) {
-        stmtDb->ExecuteUpdate(sqlInserts.c_str());
-        combineInserts = 0;
-        if (stmtDb->PrintExceptions()) {
-            return kFALSE;
+    if (stmt) {
+        if (ok) {
+            ok = stmt->Process();
+            if (! ok) {
+                DbiSevere("Insert into " << this->GetTableName()
+                          << " failed: " << stmt->GetErrorMsg() << "  ");
+            }
         }
+        delete stmt;
     }
-
-    return kTRUE;
+    return ok;
 
 }
 //.....................................................................
@@ -1187,10 +1489,12 @@ Bool_t CP::TDbiSqlValPacket::Write(std::ofstream& ios,
 
     ios << ">>>>>" << GetTableName() << "  " << GetSeqNo() << std::endl;
 
+    this->MakeSqlStmts();
+
     for (std::list<std::string>::const_iterator itr = fSqlStmts.begin();
          itr != fSqlStmts.end();
          ++itr) {
-        ios << (*itr) << std::endl;
+        ios << this->MakeStmt(*itr,itr == fSqlStmts.begin()) << std::endl;
     }
 
     ios << "<<<<<" << GetTableName() << "  " << GetSeqNo() << std::endl;
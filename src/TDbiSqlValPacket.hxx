@@ -15,6 +15,20 @@
  * <b>Purpose</b> Used as part of database maintenance as the unit of
  *   transfer between databases.
  *
+ *   Data rows added from TDbiTableRow objects are held as typed values
+ *   (see TDbiRowBuffer) and bound directly to prepared inserts by Store;
+ *   they are only converted to SQL text if required, e.g. by Write or
+ *   GetStmt.
+ *
+ *   The SEQNO and creation date are not held in the statements but
+ *   supplied when they are rendered or bound, so SetSeqNo and
+ *   SetCreationDate are cheap whatever the size of the packet.
+ *
+ *   GetFingerprint hashes the content that makes a packet a duplicate
+ *   of another, i.e. all but its SEQNO and dates, so that repeated
+ *   uploads can be found without fetching and comparing packets (see
+ *   TDbiDBProxy::QueryFingerprint).
+ *
  * Contact: A.Finch@lancaster.ac.uk
  *
  *
@@ -25,6 +39,7 @@
 #endif
 
 #include "TDbi.hxx"
+#include "TDbiRowBuffer.hxx"
 #include "TDbiTableProxy.hxx"
 #include "TVldTimeStamp.hxx"
 
@@ -34,6 +49,7 @@
 #include <string>
 
 namespace CP {
+    class TDbiStatement;
     class TDbiTableRow;
     class TDbiValidityRec;
     class TVldRange;
@@ -79,6 +95,8 @@ namespace CP {
         CP::TVldTimeStamp GetCreationDate() const {
             return fCreationDate;
         }
+/// Hash of the content, see GetFingerprint in TDbiSqlValPacket.cxx.
+        const std::string& GetFingerprint() const;
         std::string GetStmt(UInt_t stmtNo) const;
         std::vector<std::string> GetStmtValues(UInt_t stmtNo) const;
         const std::string& GetTableName() const {
@@ -92,6 +110,7 @@ namespace CP {
 //  I/O
         Bool_t Fill(std::ifstream& is);
         Bool_t Store(UInt_t dbNo, Bool_t replace = kFALSE) const;
+        Bool_t Store(TDbiStatement& stmtDb, Bool_t replace = kFALSE) const;
         Bool_t Write(std::ofstream& ios,
                      Bool_t addMetadata = kFALSE) const;
 
@@ -121,14 +140,19 @@ namespace CP {
 
     private:
         void AddRow(const std::string& row);
+        Bool_t AddStmt(const std::string& sql);
         Bool_t AddRow(const TDbiTableProxy& tblProxy,
                       const TDbiValidityRec* vrec,
                       const TDbiTableRow& row);
         void Report(const char* msg,
                     UInt_t line_num,
                     const std::string& line);
+        void MakeSqlStmts() const;
+        std::string MakeStmt(const std::string& tail,
+                             Bool_t isVld,
+                             const std::string& insertDate = "") const;
         void SetMetaData() const;
-        void SetSeqNoOnRow(std::string& row,const std::string& seqno);
+        Bool_t StoreRows(TDbiStatement& stmtDb) const;
 
         TDbiSqlValPacket(const TDbiSqlValPacket&);   // Not allowed.
 
@@ -147,8 +171,14 @@ namespace CP {
 /// As fSqlMySqlMetaMain but for aux. table.
         mutable std::string fSqlMySqlMetaVld;
 
-/// Set of SQL statements to generate packet.
-        std::list<std::string>  fSqlStmts;
+/// Set of SQL statements to generate packet, each held as the part after
+/// the SEQNO value and, for the first (VLD) one, before CREATIONDATE.
+        mutable std::list<std::string>  fSqlStmts;
+
+#ifndef __CINT__
+/// Data rows, following those in fSqlStmts, not yet converted to SQL.
+        mutable std::vector<CP::TDbiRowBuffer> fRows;
+#endif
 
 /// Number of statements
         UInt_t fNumStmts;
@@ -159,6 +189,12 @@ namespace CP {
 /// Creation date, or object creation date if unfilled.
         CP::TVldTimeStamp fCreationDate;
 
+/// Insert date of VLD row (SQL DateTime) as filled.
+        std::string fInsertDate;
+
+/// Cached fingerprint or empty if not yet computed.
+        mutable std::string fFingerprint;
+
         ClassDef(TDbiSqlValPacket,0)           // SQL to generate Validity Packet.
 
     };
@@ -12,6 +12,7 @@
 
 #include "TString.h"
 
+#include "TDbiConnectionPool.hxx"
 #include "TDbiStatement.hxx"
 #include "TDbiTableMetaData.hxx"
 #include <TDbiLog.hxx>
@@ -33,7 +34,10 @@ ClassImp(CP::TDbiStatement)
 
 //.....................................................................
 
-CP::TDbiStatement::TDbiStatement(CP::TDbiConnection& conDb): fConDb(conDb) {
+CP::TDbiStatement::TDbiStatement(CP::TDbiConnection& conDb,
+                                 CP::TDbiConnectionPool* pool):
+    fConDb(conDb),
+    fPool(pool) {
     //
     //
     //  Purpose:  Constructor
@@ -43,10 +47,14 @@ CP::TDbiStatement::TDbiStatement(CP::TDbiConnection& conDb): fConDb(conDb) {
     //  Return:
     //
     //  conDb    in    The connection associated with the statement.
+    //  pool     in    Pool conDb was checked out from (already connected)
+    //                 or 0.
     //
     
     DbiTrace("Creating CP::TDbiStatement for" << fConDb.GetDbName());
-    fConDb.ConnectStatement();
+    if (! fPool) {
+        fConDb.ConnectStatement();
+    }
 
 }
 
@@ -54,7 +62,54 @@ CP::TDbiStatement::TDbiStatement(CP::TDbiConnection& conDb): fConDb(conDb) {
 
 CP::TDbiStatement::~TDbiStatement() {
     DbiTrace("Destroying CP::TDbiStatement for " << fConDb.GetDbName());
-    fConDb.DisConnectStatement();
+    if (fPool) {
+        fPool->Return(&fConDb);
+    }
+    else {
+        fConDb.DisConnectStatement();
+    }
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiStatement::Commit() {
+    //  Purpose:  Commit the current transaction.
+    //
+    //  Return true if successful.
+
+    this->ClearExceptionLog();
+
+    DbiInfo("Commit:" << fConDb.GetDbName() << "  ");
+    TSQLServer* server = fConDb.GetServer();
+    if (! server) {
+        this->AppendExceptionLog(fConDb);
+        return false;
+    }
+    if (! server->Commit()) {
+        fConDb.RecordException();
+        this->AppendExceptionLog(fConDb);
+        return false;
+    }
+    return fExceptionLog.IsEmpty();
+
+}
+
+//.....................................................................
+
+TSQLStatement*
+CP::TDbiStatement::CreatePreparedStatement(const TString& sql) {
+    // Create a prepared statement (caller must delete) whose parameters
+    // have still to be bound.  Return NULL if failure.
+
+    this->ClearExceptionLog();
+
+    DbiInfo("CreatePreparedStatement:" << fConDb.GetDbName()
+            << ":" << sql << "  ");
+    TSQLStatement* stmt = fConDb.CreatePreparedStatement(sql.Data());
+    if (! stmt) {
+        this->AppendExceptionLog(fConDb);
+    }
+    return stmt;
 }
 
 //.....................................................................
@@ -163,4 +218,51 @@ Bool_t CP::TDbiStatement::PrintExceptions(Int_t level) const {
 
 }
 
+//.....................................................................
+
+Bool_t CP::TDbiStatement::Rollback() {
+    //  Purpose:  Roll back the current transaction.
+    //
+    //  Return true if successful.
+
+    this->ClearExceptionLog();
+
+    DbiInfo("Rollback:" << fConDb.GetDbName() << "  ");
+    TSQLServer* server = fConDb.GetServer();
+    if (! server) {
+        this->AppendExceptionLog(fConDb);
+        return false;
+    }
+    if (! server->Rollback()) {
+        fConDb.RecordException();
+        this->AppendExceptionLog(fConDb);
+        return false;
+    }
+    return fExceptionLog.IsEmpty();
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiStatement::StartTransaction() {
+    //  Purpose:  Start a transaction, ended by Commit or Rollback.
+    //
+    //  Return true if successful.
+
+    this->ClearExceptionLog();
+
+    DbiInfo("StartTransaction:" << fConDb.GetDbName() << "  ");
+    TSQLServer* server = fConDb.GetServer();
+    if (! server) {
+        this->AppendExceptionLog(fConDb);
+        return false;
+    }
+    if (! server->StartTransaction()) {
+        fConDb.RecordException();
+        this->AppendExceptionLog(fConDb);
+        return false;
+    }
+    return fExceptionLog.IsEmpty();
+
+}
 
@@ -31,14 +31,17 @@
 #include <list>
 
 namespace CP {
+    class TDbiConnectionPool;
     class TDbiException;
 
     class TDbiStatement {
 
     public:
 
-        /// Constructors and destructors.
-        TDbiStatement(TDbiConnection& conDb);
+        /// Constructors and destructors.  If pool is supplied conDb has
+        /// been checked out from it and is returned to it on destruction.
+        TDbiStatement(TDbiConnection& conDb,
+                      TDbiConnectionPool* pool = 0);
         virtual ~TDbiStatement();
 
         /// State testing member functions
@@ -65,6 +68,27 @@ namespace CP {
         /// Apply an update and return success/fail.
         Bool_t ExecuteUpdate(const TString& sql="");
 
+        /// Give caller an unprocessed TSQLStatement for sql with
+        /// parameters to bind or 0 if failed.
+        TSQLStatement* CreatePreparedStatement(const TString& sql);
+
+        /// Transaction control; all return success/fail.  Updates between
+        /// StartTransaction and Commit or Rollback are applied atomically
+        /// if the DBMS (and, for MySQL, the table engine) supports it.
+        Bool_t StartTransaction();
+        Bool_t Commit();
+        Bool_t Rollback();
+
+        /// Largest SQL statement in bytes the server accepts.
+        UInt_t GetMaxStatementSize() {
+            return fConDb.GetMaxStatementSize();
+        }
+
+        /// True if the statement's connection knows of the table.
+        Bool_t TableExists(const std::string& tableName) const {
+            return fConDb.TableExists(tableName);
+        }
+
     private:
 
         void AppendExceptionLog(TDbiException* e)  {
@@ -91,6 +115,9 @@ namespace CP {
         ///Connection associated with this statement.
         TDbiConnection& fConDb;
 
+        ///Pool from which fConDb was checked out (if any).
+        TDbiConnectionPool* fPool;
+
         /// A log of reported exceptions.
         /// Cleared by calling ExecuteQuery, ExecuteUpdate
         TDbiExceptionLog fExceptionLog;
@@ -292,11 +292,15 @@ void CP::TDbiTableMetaData::SetFromSql(const std::string& sql) {
 
 //.....................................................................
 
-std::string CP::TDbiTableMetaData::Sql() const {
+std::string CP::TDbiTableMetaData::Sql(Bool_t inlineKeys) const {
 //
 //
 //  Purpose:  Return SQL string to create table.
 //
+//  Arguments:
+//    inlineKeys   in    If false omit the VLD table keys (e.g. for SQLite
+//                       which only supports separate "create index").
+//
 //  Return:    SQL command to create required table.
 
     Bool_t mainTable = fTableName.substr(fTableName.size()-3,3) != "VLD";
@@ -344,7 +348,7 @@ std::string CP::TDbiTableMetaData::Sql() const {
         if (mainTable) {
             sql << ", primary key (SEQNO,ROW_COUNTER)";
         }
-        else {
+        else if (inlineKeys) {
             sql << ", key TIMESTART (TIMESTART), key TIMEEND (TIMEEND)";
         }
         sql << ")";
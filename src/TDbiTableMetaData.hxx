@@ -29,6 +29,8 @@ namespace CP {
     class TDbiTableMetaData {
         
         friend class TDbiDBProxy;  //See ctor program notes.
+        friend class TDbiConnection;  //Fills from schema discovery.
+        friend class TDbiMetaDataCache;  //Fills from cache file.
         
     public:
         
@@ -38,8 +40,10 @@ namespace CP {
         
         // State testing member functions
         
-        /// Return SQL string to create table.
-        std::string Sql() const;
+        /// Return SQL string to create table.  If inlineKeys is false the
+        /// VLD table's TIMESTART and TIMEEND keys, which not all DBMSs accept
+        /// inline, are omitted and must be created separately.
+        std::string Sql(Bool_t inlineKeys = kTRUE) const;
         
         std::string TableName() const {
             return fTableName;
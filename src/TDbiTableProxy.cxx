@@ -8,15 +8,20 @@
 #include "TDbiResultSetAgg.hxx"
 #include "TDbiResultSetNonAgg.hxx"
 #include "TDbiInRowStream.hxx"
+#include "TDbiServices.hxx"
 #include "TDbiTableProxy.hxx"
 #include "TDbiTableRow.hxx"
 #include "TDbiTimerManager.hxx"
 #include "TDbiValidityRec.hxx"
 #include "TDbiValidityRecBuilder.hxx"
 
+#include "TClass.h"
+
 #include "TDbiLog.hxx"
 #include "MsgFormat.hxx"
 
+#include <algorithm>
+#include <map>
 #include <string>
 #include <sstream>
 
@@ -167,6 +172,7 @@ const CP::TDbiResultSet* CP::TDbiTableProxy::Query(const CP::TVldContext& vc,
 
     //  See if there is one already in the cache for universal aggregate no.
 
+    std::lock_guard<std::recursive_mutex> lock(fQueryMutex);
     DbiTrace("Query for " << vc << " task " << task);
     
     if (const CP::TDbiResultSet* result = fCache->Search(vc,task)) {
@@ -177,7 +183,7 @@ const CP::TDbiResultSet* CP::TDbiTableProxy::Query(const CP::TVldContext& vc,
     CP::TDbiConnectionMaintainer cm(fCascader);
 
     // Make Global Exception Log bookmark
-    UInt_t startGEL = CP::TDbiExceptionLog::GetGELog().Size()+1;
+    UInt_t startGEL = CP::TDbiExceptionLog::GetGELog().Size();
 
     // Build a complete set of effective validity record from the database.
     CP::TDbiValidityRecBuilder builder(fDBProxy,vc,task,-1,findFullTimeWindow);
@@ -276,6 +282,7 @@ const CP::TDbiResultSet* CP::TDbiTableProxy::Query(const std::string& context,
 //  (which task encoded into the context) into a single semi-colon
 //  separated string.
 
+    std::lock_guard<std::recursive_mutex> lock(fQueryMutex);
     std::ostringstream os;
     os << context;
     if (task != TDbi::kAnyTask
@@ -297,7 +304,7 @@ const CP::TDbiResultSet* CP::TDbiTableProxy::Query(const std::string& context,
     CP::TDbiConnectionMaintainer cm(fCascader);  //Stack object to hold connections
 
 // Make Global Exception Log bookmark
-    UInt_t startGEL = CP::TDbiExceptionLog::GetGELog().Size()+1;
+    UInt_t startGEL = CP::TDbiExceptionLog::GetGELog().Size();
 
 // Build a complete set of effective validity records from the database.
     CP::TDbiValidityRecBuilder builder(fDBProxy,context,task);
@@ -331,10 +338,11 @@ const CP::TDbiResultSet* CP::TDbiTableProxy::Query(UInt_t seqNo,UInt_t dbNo) {
 //
 //  Return:    Query result (never zero even if query fails).
 
+    std::lock_guard<std::recursive_mutex> lock(fQueryMutex);
     CP::TDbiConnectionMaintainer cm(fCascader);  //Stack object to hold connections
 
 // Make Global Exception Log bookmark
-    UInt_t startGEL = CP::TDbiExceptionLog::GetGELog().Size()+1;
+    UInt_t startGEL = CP::TDbiExceptionLog::GetGELog().Size();
 
     // Apply SEQNO query to cascade member.
     CP::TDbiInRowStream* rs = fDBProxy.QueryValidity(seqNo,dbNo);
@@ -389,10 +397,11 @@ const CP::TDbiResultSet* CP::TDbiTableProxy::Query(
 
 
     //Stack object to hold connections
+    std::lock_guard<std::recursive_mutex> lock(fQueryMutex);
     CP::TDbiConnectionMaintainer cm(fCascader);
 
     // Make Global Exception Log bookmark
-    UInt_t startGEL = CP::TDbiExceptionLog::GetGELog().Size()+1;
+    UInt_t startGEL = CP::TDbiExceptionLog::GetGELog().Size();
 
     if (canReuse) {
         DbiTrace("Try to recover from L2 cache");
@@ -455,6 +464,307 @@ const CP::TDbiResultSet* CP::TDbiTableProxy::Query(
 
 //.....................................................................
 
+UInt_t CP::TDbiTableProxy::QueryContexts(const std::vector<CP::TVldContext>& contexts,
+                                         const TDbi::Task& task,
+                                         std::vector<const CP::TDbiResultSet*>& results,
+                                         std::vector<UInt_t>& resultIndex,
+                                         Bool_t findFullTimeWindow) {
+    //
+    //
+    //  Purpose: Apply a set of context specific queries to database table.
+    //
+    //  Arguments:
+    //    contexts     in    The Validity Contexts, ideally sorted by time.
+    //    task         in    The task of the queries.
+    //    results      out   The distinct query results.
+    //    resultIndex  out   For each context the index of its result in results.
+    //    findFullTimeWindow
+    //                 in    Attempt to find full validity of query
+    //                        i.e. beyond TDbi::GetTimeGate
+    //
+    //  Return:    The number of distinct results.
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Unless in snapshot mode, load a VLD snapshot covering all the
+    //    contexts with a single validity query per cascade entry.
+    //
+    //  o Apply each context query in turn; those that fall within an
+    //    already resolved validity are satisfied from the cache and the
+    //    rest are resolved locally against the snapshot.
+    //
+    //  o Return each distinct result once, Connect()ed on behalf of the
+    //    caller who must Disconnect() it when finished with it.
+
+    //  Program Notes:-
+    //  =============
+    //
+    //  Connecting the results as they are found also prevents later
+    //  queries in the sweep purging them from the cache.
+    //
+    //  If a query throws (e.g. a cascade entry fails to open) the guard
+    //  clears the snapshots and disconnects the results collected so far.
+
+    // Stack object to undo a partial sweep.
+    struct SweepGuard {
+        SweepGuard(CP::TDbiTableProxy* proxy,
+                   std::vector<const CP::TDbiResultSet*>& results) :
+            fProxy(proxy), fResults(results),
+            fClearSnapshots(kFALSE), fDismissed(kFALSE) {}
+        ~SweepGuard() {
+            if (fClearSnapshots) {
+                fProxy->ClearVldSnapshots();
+            }
+            if (fDismissed) {
+                return;
+            }
+            for (UInt_t index = 0; index < fResults.size(); ++index) {
+                fResults[index]->Disconnect();
+            }
+            fResults.clear();
+        }
+        CP::TDbiTableProxy* fProxy;
+        std::vector<const CP::TDbiResultSet*>& fResults;
+        Bool_t fClearSnapshots;
+        Bool_t fDismissed;
+    };
+
+    std::lock_guard<std::recursive_mutex> lock(fQueryMutex);
+    results.clear();
+    resultIndex.clear();
+    if (contexts.empty()) {
+        return 0;
+    }
+
+    // Stack object to hold connections
+    CP::TDbiConnectionMaintainer cm(fCascader);
+    SweepGuard guard(this,results);
+
+    // Find the range spanned by the contexts, extended by the time gate.
+    Bool_t loadSnapshots = ! CP::TDbiServices::VldSnapshot();
+    if (loadSnapshots) {
+        time_t tsMin = contexts.front().GetTimeStamp().GetSec();
+        time_t tsMax = tsMin;
+        std::vector<CP::TVldContext>::const_iterator itr    = contexts.begin();
+        std::vector<CP::TVldContext>::const_iterator itrEnd = contexts.end();
+        for (; itr != itrEnd; ++itr) {
+            time_t sec = itr->GetTimeStamp().GetSec();
+            if (sec < tsMin) {
+                tsMin = sec;
+            }
+            if (sec > tsMax) {
+                tsMax = sec;
+            }
+        }
+        Int_t timeGate = TDbi::GetTimeGate(fTableName);
+        guard.fClearSnapshots = kTRUE;
+        this->LoadVldSnapshots(CP::TVldTimeStamp(tsMin - timeGate,0),
+                               CP::TVldTimeStamp(tsMax + timeGate + 1,0));
+    }
+
+    std::map<const CP::TDbiResultSet*,UInt_t> resultToIndex;
+    resultIndex.reserve(contexts.size());
+    std::vector<CP::TVldContext>::const_iterator itr    = contexts.begin();
+    std::vector<CP::TVldContext>::const_iterator itrEnd = contexts.end();
+    for (; itr != itrEnd; ++itr) {
+        const CP::TDbiResultSet* result
+            = this->Query(*itr,task,findFullTimeWindow);
+        std::map<const CP::TDbiResultSet*,UInt_t>::const_iterator found
+            = resultToIndex.find(result);
+        if (found != resultToIndex.end()) {
+            resultIndex.push_back(found->second);
+            continue;
+        }
+        result->Connect();
+        UInt_t index = results.size();
+        resultToIndex[result] = index;
+        results.push_back(result);
+        resultIndex.push_back(index);
+    }
+
+    guard.fDismissed = kTRUE;
+
+    DbiLog("Bulk query of table " << fTableName << " resolved "
+           << contexts.size() << " contexts to " << results.size()
+           << " distinct results" << "  ");
+
+    return results.size();
+
+}
+
+//.....................................................................
+
+UInt_t CP::TDbiTableProxy::QuerySpan(const CP::TVldTimeStamp& start,
+                                     const CP::TVldTimeStamp& end,
+                                     CP::DbiDetector::Detector_t det,
+                                     CP::DbiSimFlag::SimFlag_t simFlag,
+                                     const TDbi::Task& task,
+                                     std::vector<const CP::TDbiResultSet*>& results,
+                                     UInt_t& numRows,
+                                     ULong64_t& numBytes) {
+    //
+    //
+    //  Purpose: Load into the cache every result needed for context queries
+    //           over a time span.
+    //
+    //  Arguments:
+    //    start        in    Start of span.
+    //    end          in    End of span (exclusive).
+    //    det          in    Detector of all queries.
+    //    simFlag      in    SimFlag of all queries.
+    //    task         in    The task of all queries.
+    //    results      out   The results loaded, each Connect()ed on behalf
+    //                       of the caller who must Disconnect() them.
+    //    numRows      out   Number of data rows loaded from the database.
+    //    numBytes     out   Approximate memory they occupy.
+    //
+    //  Return:    The number of validity intervals in the span.
+    //
+    //  Specification:-
+    //  =============
+    //
+    //  o Unless in snapshot mode, load a VLD snapshot covering the span.
+    //
+    //  o Step through the span resolving each validity interval in turn
+    //    and collecting the SEQNOs that are not already cached.
+    //
+    //  o Fetch the data for all of them with one query per cascade entry
+    //    and cache it.
+    //
+    //  o Apply the context query for each interval; they are now all
+    //    satisfied from the cache.
+
+    //  Program Notes:-
+    //  =============
+    //
+    //  The results are Connect()ed so that the cache does not purge them
+    //  while queries move through the span.  For non-aggregated tables
+    //  the data is cached against the effective validity record of its
+    //  interval; if an overlay splits one SEQNO into several intervals
+    //  only the first is preloaded and the others are queried separately.
+
+    std::lock_guard<std::recursive_mutex> lock(fQueryMutex);
+    results.clear();
+    numRows  = 0;
+    numBytes = 0;
+    if (! (start < end)) {
+        return 0;
+    }
+
+    // Stack object to hold connections
+    CP::TDbiConnectionMaintainer cm(fCascader);
+
+    Bool_t loadSnapshots = ! CP::TDbiServices::VldSnapshot();
+    if (loadSnapshots) {
+        Int_t timeGate = TDbi::GetTimeGate(fTableName);
+        this->LoadVldSnapshots(CP::TVldTimeStamp(start.GetSec() - timeGate,0),
+                               CP::TVldTimeStamp(end.GetSec() + timeGate + 1,0));
+    }
+
+    // Resolve the validity intervals.  Required validity records are
+    // indexed by cascade entry and SEQNO.
+    typedef std::map<UInt_t,CP::TDbiValidityRec> SeqToVRec_t;
+    std::map<UInt_t,SeqToVRec_t> required;
+    std::vector<CP::TVldContext> contexts;
+    Bool_t nonAggregated = kFALSE;
+    CP::TVldTimeStamp ts(start);
+    while (ts < end) {
+        CP::TVldContext vc(det,simFlag,ts);
+        contexts.push_back(vc);
+        CP::TVldTimeStamp intervalEnd;
+        if (const CP::TDbiResultSet* result = fCache->Search(vc,task)) {
+            intervalEnd = result->GetValidityRec().GetVldRange().GetTimeEnd();
+        }
+        else {
+            CP::TDbiValidityRecBuilder builder(fDBProxy,vc,task);
+            nonAggregated = builder.NonAggregated();
+            Int_t firstRow = nonAggregated ? 0 : 1;
+            Int_t maxRow   = builder.GetNumValidityRec() - 1;
+            CP::TDbiValidityRec vrecAll = builder.GetValidityRec(firstRow);
+            for (Int_t rowNo = firstRow; rowNo <= maxRow; ++rowNo) {
+                const CP::TDbiValidityRec& vrec = builder.GetValidityRec(rowNo);
+                const CP::TVldRange& range = vrec.GetVldRange();
+                vrecAll.AndTimeWindow(range.GetTimeStart(),range.GetTimeEnd());
+                if (vrec.IsGap() || ! vrec.GetSeqNo()
+                    || (! nonAggregated && fCache->Search(vrec))) {
+                    continue;
+                }
+                SeqToVRec_t& seqToVRec = required[vrec.GetDbNo()];
+                if (seqToVRec.find(vrec.GetSeqNo()) == seqToVRec.end()) {
+                    seqToVRec[vrec.GetSeqNo()] = vrec;
+                }
+            }
+            intervalEnd = vrecAll.GetVldRange().GetTimeEnd();
+        }
+        if (! (ts < intervalEnd)) {
+            DbiWarn("Query span of table " << fTableName
+                    << " failed to advance beyond " << ts << "  ");
+            break;
+        }
+        ts = intervalEnd;
+    }
+
+    // Fetch the data in bulk.
+    UInt_t rowSize = fTableRow ? fTableRow->IsA()->Size() : 0;
+    std::map<UInt_t,SeqToVRec_t>::const_iterator itrDb    = required.begin();
+    std::map<UInt_t,SeqToVRec_t>::const_iterator itrDbEnd = required.end();
+    for (; itrDb != itrDbEnd; ++itrDb) {
+        const SeqToVRec_t& seqToVRec = itrDb->second;
+        std::vector<UInt_t> seqNos;
+        for (SeqToVRec_t::const_iterator itr = seqToVRec.begin();
+             itr != seqToVRec.end(); ++itr) {
+            seqNos.push_back(itr->first);
+        }
+        CP::TDbiInRowStream* rs = fDBProxy.QuerySeqNos(seqNos,itrDb->first);
+        while (! rs->IsExhausted()) {
+            Int_t seqNo;
+            *rs >> seqNo;
+            rs->DecrementCurCol();
+            SeqToVRec_t::const_iterator itrSeq = seqToVRec.find(seqNo);
+            if (itrSeq == seqToVRec.end()) {
+                DbiSevere("Unexpected SeqNo: " << seqNo << "  ");
+                CP::TDbiResultSetNonAgg discard(rs,fTableRow,0);
+                continue;
+            }
+            CP::TDbiResultSetNonAgg* result
+                = new CP::TDbiResultSetNonAgg(rs,fTableRow,&itrSeq->second);
+            // Components of aggregates are only found via their validity
+            // records so, like TDbiResultSetAgg, don't register a key.
+            fCache->Adopt(result,nonAggregated);
+            result->Connect();
+            results.push_back(result);
+            numRows  += result->GetNumRows();
+            numBytes += static_cast<ULong64_t>(result->GetNumRows()) * rowSize;
+        }
+        delete rs;
+    }
+
+    // Apply the context queries.
+    std::vector<CP::TVldContext>::const_iterator itr    = contexts.begin();
+    std::vector<CP::TVldContext>::const_iterator itrEnd = contexts.end();
+    for (; itr != itrEnd; ++itr) {
+        const CP::TDbiResultSet* result = this->Query(*itr,task);
+        if (std::find(results.begin(),results.end(),result) == results.end()) {
+            result->Connect();
+            results.push_back(result);
+        }
+    }
+
+    if (loadSnapshots) {
+        this->ClearVldSnapshots();
+    }
+
+    DbiLog("Query span of table " << fTableName << " resolved "
+           << contexts.size() << " validity intervals, preloading "
+           << numRows << " rows (" << numBytes << " bytes)" << "  ");
+
+    return contexts.size();
+
+}
+
+//.....................................................................
+
 void CP::TDbiTableProxy::RefreshMetaData() {
 //
 //
@@ -510,41 +820,105 @@ CP::TVldTimeStamp CP::TDbiTableProxy::QueryOverlayCreationDate(const CP::TDbiVal
 // than a few minutes apart)
 
 
-    //  Create a context that corresponds to the start time of the validity
-    //  range.  Note that it is O.K. to use SimFlag and Detector masks
-    //  even though this could make the context ambiguous because the
-    //  context is only to be used to query the database and the SimFlag and
-    //  Detector values will be ORed against existing data so will match
-    //  all possible data that this validity range could overlay which is
-    //  just what we want.
+    //  Only the highest priority record of the same aggregate and task that
+    //  covers the start time of the validity range matters.  Note that it
+    //  is O.K. to use SimFlag and Detector masks as they will be ANDed
+    //  against existing data so will match all possible data that this
+    //  validity range could overlay which is just what we want.  Rather
+    //  than build a full set of effective validity records (see
+    //  CP::TDbiValidityRecBuilder), ask the selected database for just
+    //  that record.
 
     const CP::TVldRange& vr(vrec.GetVldRange());
-    CP::TVldContext vc((CP::DbiDetector::Detector_t) vr.GetDetectorMask(),
-                       (CP::DbiSimFlag::SimFlag_t) vr.GetSimMask(),
-                       vr.GetTimeStart());
+    const CP::TVldTimeStamp& start(vr.GetTimeStart());
+    CP::TVldTimeStamp end(start.GetSec() + 1,0);
 
     CP::TDbiConnectionMaintainer cm(fCascader);  //Stack object to hold connections
 
-    // Build a complete set of effective validity records from the
-    // selected database.
-    CP::TDbiValidityRecBuilder builder(fDBProxy,vc,vrec.GetTask(),dbNo);
+    std::vector<CP::TDbiValidityRec> vrecs;
+    this->QueryOverlayValidities(vrec,dbNo,start,end,kTRUE,vrecs);
+    const CP::TDbiValidityRec* vrecOvlay = vrecs.empty() ? 0 : &vrecs.front();
+    CP::TVldTimeStamp ovlayTS(MakeOverlayCreationDate(vrec,vrecOvlay));
 
-    // Pick up the validity record for the current aggregate.
-    const CP::TDbiValidityRec& vrecOvlay(builder.GetValidityRecFromAggNo(vrec.GetAggregateNo()));
+    DbiDebug("Looking for overlay creation date for: "
+             << vrec << "found it would overlap SEQNO "
+             << (vrecOvlay ? vrecOvlay->GetSeqNo() : 0)
+             << " so overlay creation date set to "
+             << ovlayTS.AsString("s") << "  ");
+    return ovlayTS;
+
+}
+
+//.....................................................................
+
+UInt_t CP::TDbiTableProxy::QueryOverlayValidities(const CP::TDbiValidityRec& vrec,
+                                                  UInt_t dbNo,
+                                                  const CP::TVldTimeStamp& start,
+                                                  const CP::TVldTimeStamp& end,
+                                                  Bool_t bestOnly,
+                                                  std::vector<CP::TDbiValidityRec>& vrecs) {
+//
+//
+//  Purpose:  Find the validity records new data could overlay.
+//
+//  Arguments:
+//    vrec         in    Validity record of the new data.
+//    dbNo         in    Cascade entry it is to be written to.
+//    start        in    Start of time range.
+//    end          in    End of time range (exclusive).
+//    bestOnly     in    If true only return the highest priority record.
+//    vrecs        out   The records found, in priority order.
+//
+//  Return:    The number of records found.
+
+    vrecs.clear();
+    if (! fDBProxy.TableExists(dbNo)) {
+        return 0;
+    }
+
+    const CP::TVldRange& vr(vrec.GetVldRange());
+    CP::TDbiInRowStream* rs = fDBProxy.QueryOverlayValidity(start,end,
+                                                            vr.GetDetectorMask(),
+                                                            vr.GetSimMask(),
+                                                            vrec.GetTask(),
+                                                            vrec.GetAggregateNo(),
+                                                            dbNo,
+                                                            bestOnly);
+    CP::TDbiValidityRec tr;
+    CP::TDbiResultSetNonAgg result(rs,&tr,0,kFALSE);
+    delete rs;
+    UInt_t numRows = result.GetNumRows();
+    for (UInt_t row = 0; row < numRows; ++row) {
+        const CP::TDbiValidityRec* vrecRow
+            = dynamic_cast<const CP::TDbiValidityRec*>(result.GetTableRow(row));
+        if (vrecRow) {
+            vrecs.push_back(*vrecRow);
+            vrecs.back().SetDbNo(dbNo);
+        }
+    }
+    return vrecs.size();
+
+}
+
+//.....................................................................
+
+CP::TVldTimeStamp CP::TDbiTableProxy::MakeOverlayCreationDate(const CP::TDbiValidityRec& vrec,
+                                                              const CP::TDbiValidityRec* overlaid) {
+//
+//
+//  Purpose:  Return the overlay Creation Date for vrec.
+//
+//  Arguments:
+//    vrec         in    Validity record of the new data.
+//    overlaid     in    Highest priority record it overlays, or 0 if none.
 
     // If its a gap i.e. nothing is overlayed, return the start time, otherwise
     // return its Creation Date plus one minute.
-    CP::TVldTimeStamp ovlayTS(vr.GetTimeStart());
-    if (! vrecOvlay.IsGap()) {
-        time_t overlaySecs = vrecOvlay.GetCreationDate().GetSec();
-        ovlayTS = CP::TVldTimeStamp(overlaySecs + 60,0);
+    if (! overlaid || overlaid->IsGap()) {
+        return vrec.GetVldRange().GetTimeStart();
     }
-
-    DbiDebug("Looking for overlay creation date for: "
-             << vrec << "found it would overlap: "
-             << vrecOvlay << " so overlay creation date set to "
-             << ovlayTS.AsString("s") << "  ");
-    return ovlayTS;
+    time_t overlaySecs = overlaid->GetCreationDate().GetSec();
+    return CP::TVldTimeStamp(overlaySecs + 60,0);
 
 }
 //.....................................................................
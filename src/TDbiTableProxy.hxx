@@ -28,6 +28,10 @@
 #include "TVldTimeStamp.hxx"
 
 #include <string>
+#include <vector>
+#ifndef __CINT__
+#include <mutex>
+#endif
 
 namespace CP {
     class TDbiCache;
@@ -67,6 +71,13 @@ namespace CP {
         TDbiCache* GetCache() {
             return fCache;
         }
+#ifndef __CINT__
+        /// Lock held by each query.  Hold it across a query and the
+        /// Connect of its result if other threads may query this table.
+        std::recursive_mutex& GetQueryMutex() const {
+            return fQueryMutex;
+        }
+#endif
 
         ///\verbatim 
         ///  Purpose:  Apply context specific query to database table and return result.
@@ -160,6 +171,69 @@ namespace CP {
         ///\endverbatim
         const TDbiResultSet* Query(const TDbiValidityRec& vrec,
                                    Bool_t canReuse = kTRUE);
+#ifndef __CINT__
+        ///\verbatim
+        ///
+        ///  Purpose:  Apply a set of context specific queries in one sweep.
+        ///
+        ///  Arguments:
+        ///    contexts     in    The Validity Contexts, ideally sorted by time.
+        ///    task         in    The task of the queries.
+        ///    results      out   The distinct query results.
+        ///    resultIndex  out   For each context the index of its result in results.
+        ///    findFullTimeWindow
+        ///                 in    Attempt to find full validity of query
+        ///
+        ///  Return:    The number of distinct results.
+        ///
+        ///  Program Notes:-
+        ///  =============
+        ///
+        ///  All contexts are resolved against a single VLD snapshot (see
+        ///  CP::TDbiVldSnapshot) so the only database traffic is one validity
+        ///  query per cascade entry plus one data query per distinct result.
+        ///  Each returned result is Connect()ed and the caller must
+        ///  Disconnect() it when finished.
+        ///\endverbatim
+        UInt_t QueryContexts(const std::vector<CP::TVldContext>& contexts,
+                             const TDbi::Task& task,
+                             std::vector<const TDbiResultSet*>& results,
+                             std::vector<UInt_t>& resultIndex,
+                             Bool_t findFullTimeWindow = true);
+        ///\verbatim
+        ///
+        ///  Purpose:  Load into the cache every result needed for context
+        ///            queries over a time span.
+        ///
+        ///  Arguments:
+        ///    start        in    Start of span.
+        ///    end          in    End of span (exclusive).
+        ///    det          in    Detector of all queries.
+        ///    simFlag      in    SimFlag of all queries.
+        ///    task         in    The task of all queries.
+        ///    results      out   The results loaded.
+        ///    numRows      out   Number of data rows loaded from the database.
+        ///    numBytes     out   Approximate memory they occupy.
+        ///
+        ///  Return:    The number of validity intervals in the span.
+        ///
+        ///  Program Notes:-
+        ///  =============
+        ///
+        ///  Intervals are resolved against a VLD snapshot of the span and
+        ///  the data of all of them is fetched with one query per cascade
+        ///  entry.  Each returned result is Connect()ed and the caller must
+        ///  Disconnect() it when finished.  See CP::TDbiQueryPlan.
+        ///\endverbatim
+        UInt_t QuerySpan(const CP::TVldTimeStamp& start,
+                         const CP::TVldTimeStamp& end,
+                         CP::DbiDetector::Detector_t det,
+                         CP::DbiSimFlag::SimFlag_t simFlag,
+                         const TDbi::Task& task,
+                         std::vector<const TDbiResultSet*>& results,
+                         UInt_t& numRows,
+                         ULong64_t& numBytes);
+#endif
         ///\verbatim
         ///
         ///  Purpose:  Determine a suitable Creation Date so that this validity
@@ -206,6 +280,35 @@ namespace CP {
         CP::TVldTimeStamp QueryOverlayCreationDate(const TDbiValidityRec& vrec,
                                                    UInt_t dbNo);
         ///
+        ///  Purpose:  Return, in vrecs, the validity records of vrec's
+        ///            aggregate, task and masks overlapping start..end
+        ///            (exclusive) in the selected DB, in priority order or
+        ///            just the highest if bestOnly.  Returns the number.
+        UInt_t QueryOverlayValidities(const TDbiValidityRec& vrec,
+                                      UInt_t dbNo,
+                                      const CP::TVldTimeStamp& start,
+                                      const CP::TVldTimeStamp& end,
+                                      Bool_t bestOnly,
+                                      std::vector<TDbiValidityRec>& vrecs);
+        ///
+        ///  Purpose:  Return the overlay Creation Date for vrec given the
+        ///            record it overlays, or 0 if none (see
+        ///            QueryOverlayCreationDate).
+        static CP::TVldTimeStamp MakeOverlayCreationDate(const TDbiValidityRec& vrec,
+                                                         const TDbiValidityRec* overlaid);
+        ///
+        ///  Purpose:  Adopt/load/clear VLD snapshots (see CP::TDbiDBProxy).
+        void AdoptVldSnapshot(UInt_t dbNo, TDbiVldSnapshot* snapshot) {
+            fDBProxy.AdoptVldSnapshot(dbNo,snapshot);
+        }
+        void ClearVldSnapshots() {
+            fDBProxy.ClearVldSnapshots();
+        }
+        void LoadVldSnapshots(const CP::TVldTimeStamp& start,
+                              const CP::TVldTimeStamp& end) {
+            fDBProxy.LoadVldSnapshots(start,end);
+        }
+        ///
         ///
         ///  Purpose:  Refresh meta data for table.
         ///
@@ -330,6 +433,12 @@ namespace CP {
         /// Pet object used to create new rows.
         TDbiTableRow* fTableRow;
 
+#ifndef __CINT__
+        /// Serialises queries so the table can be queried from several
+        /// threads (see TDbiAsyncResultSetHandle).
+        mutable std::recursive_mutex fQueryMutex;
+#endif
+
         ClassDef(TDbiTableProxy,0)        // Object to query a specific table.
 
     };
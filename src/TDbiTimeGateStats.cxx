@@ -0,0 +1,353 @@
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "TSystem.h"
+
+#include "TDbi.hxx"
+#include "TDbiTimeGateStats.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
+
+ClassImp(CP::TDbiTimeGateStats)
+
+
+//   Definition of static data members
+//   *********************************
+
+
+CP::TDbiTimeGateStats CP::TDbiTimeGateStats::gTimeGateStats;
+
+//   File scope constants
+//   ********************
+
+namespace {
+
+//  Minimum number of queries before statistics are trusted.
+    const UInt_t kMinQueries = 3;
+
+//  Limits of a suggested time gate (see TDbi::SetTimeGate).
+    const Int_t kMinTimeGate = 60;
+    const Int_t kMaxTimeGate = 100*24*60*60;
+
+}
+
+// Definition of member functions (alphabetical order)
+// ***************************************************
+
+//.....................................................................
+
+CP::TDbiTimeGateStats::TDbiTimeGateStats() {
+//
+//
+//  Purpose:  Default constructor
+
+
+    DbiTrace("Creating CP::TDbiTimeGateStats" << "  ");
+
+}
+
+//.....................................................................
+
+CP::TDbiTimeGateStats::~TDbiTimeGateStats() {
+//
+//
+//  Purpose: Destructor
+//
+//  Program Notes:-
+//  =============
+//
+//  Statistics are not saved here; this is a static object, destroyed in
+//  no defined order with respect to logging and gSystem.  See
+//  ~TDbiDatabaseManager.
+
+
+    DbiTrace("Destroying CP::TDbiTimeGateStats" << "  ");
+
+}
+
+//.....................................................................
+
+UInt_t CP::TDbiTimeGateStats::GetNumQueries(const std::string& tableName) const {
+//
+//
+//  Purpose:  Return the number of queries of table made by this job.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    std::map<std::string,TableStats>::const_iterator itr
+        = fJobStats.find(tableName);
+    return itr == fJobStats.end() ? 0 : itr->second.fNumQueries;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiTimeGateStats::Load(const std::string& fileName) {
+//
+//
+//  Purpose:  Load statistics from file and prime time gates.
+//
+//  Arguments:
+//    fileName     in    File to load from and, at the end of the job,
+//                       save to.
+//
+//  Return:    kTRUE if statistics were loaded.  A missing file is not
+//             an error; it will be created when the job ends.
+//
+//  Specification:-
+//  =============
+//
+//  o Add statistics in file to any already accumulated.
+//
+//  o Set the time gate of each table for which there are enough
+//    statistics.
+//
+//  o Only the queries recorded after this are saved; Save adds them to
+//    the file as it is at the time.
+
+    fFileName = fileName;
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    Int_t numTables = ReadStats(fileName,fStats);
+    if (numTables < 0) {
+        DbiInfo("No time gate statistics in " << fileName
+                << "; will create at end of job" << "  ");
+        return kFALSE;
+    }
+
+    std::map<std::string,TableStats>::const_iterator itr    = fStats.begin();
+    std::map<std::string,TableStats>::const_iterator itrEnd = fStats.end();
+    for (; itr != itrEnd; ++itr) {
+        Int_t timeGate = this->SuggestTimeGate(itr->first);
+        if (timeGate > 0) {
+            TDbi::SetTimeGate(itr->first,timeGate);
+        }
+    }
+
+    DbiLog("Loaded time gate statistics for " << numTables
+           << " tables from " << fileName << "  ");
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+void CP::TDbiTimeGateStats::Print(std::ostream& s,
+                                  const std::string& tableName,
+                                  UInt_t tableRows) const {
+//
+//
+//  Purpose:  Print statistics of this job's queries of table.
+//
+//  Arguments:
+//    s            in    Output stream.
+//    tableName    in    Table name.
+//    tableRows    in    Number of rows in its VLD table (summed over the
+//                       cascade).
+//
+//  Specification:-
+//  =============
+//
+//  o Print queries, mean VLD rows returned per query, mean rows
+//    filtered out by the time gate per query, the total filtered out and
+//    the current time gate.
+//
+//  Program Notes:-
+//  =============
+//
+//  Statistics loaded from the file are for earlier jobs, when the table
+//  may have held a different number of rows, so are not included.  Nor
+//  are queries already saved (see Save).
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    std::map<std::string,TableStats>::const_iterator itr
+        = fJobStats.find(tableName);
+    if (itr == fJobStats.end() || itr->second.fNumQueries == 0) {
+        s << "   no queries";
+        return;
+    }
+    const TableStats& stats = itr->second;
+    Double_t meanRows = stats.fSumRows/stats.fNumQueries;
+    Double_t filtered = stats.fNumQueries*static_cast<Double_t>(tableRows)
+                        - stats.fSumRows;
+    if (filtered < 0.) {
+        filtered = 0.;
+    }
+
+    s << std::setw(8)  << stats.fNumQueries
+      << std::setw(10) << std::setprecision(4) << meanRows
+      << std::setw(10) << std::setprecision(4) << filtered/stats.fNumQueries
+      << std::setw(12) << std::setprecision(6) << filtered
+      << std::setw(10) << TDbi::GetTimeGate(tableName);
+
+}
+
+//.....................................................................
+
+Int_t CP::TDbiTimeGateStats::ReadStats(const std::string& fileName,
+                                       std::map<std::string,TableStats>& stats) {
+//
+//
+//  Purpose:  Add the statistics in a file to stats.
+//
+//  Return:    The number of tables read or -1 if the file cannot be read.
+
+    std::ifstream in(fileName.c_str());
+    if (! in) {
+        return -1;
+    }
+
+    Int_t numTables = 0;
+    std::string line;
+    while (std::getline(in,line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream is(line);
+        std::string tableName;
+        TableStats read;
+        if (! (is >> tableName >> read.fNumQueries >> read.fSumRows
+               >> read.fSumAggregates >> read.fSumTimeWindows)) {
+            DbiWarn("Ignoring bad time gate statistics line: " << line << "  ");
+            continue;
+        }
+        TableStats& current = stats[tableName];
+        current.fNumQueries     += read.fNumQueries;
+        current.fSumRows        += read.fSumRows;
+        current.fSumAggregates  += read.fSumAggregates;
+        current.fSumTimeWindows += read.fSumTimeWindows;
+        ++numTables;
+    }
+    return numTables;
+
+}
+
+//.....................................................................
+
+void CP::TDbiTimeGateStats::RecordQuery(const std::string& tableName,
+                                        UInt_t numRows,
+                                        UInt_t numAggregates,
+                                        Double_t sumTimeWindows) {
+//
+//
+//  Purpose:  Record the outcome of a primary (validity) query.
+//
+//  Arguments:
+//    tableName      in    Table name.
+//    numRows        in    Number of VLD rows returned.
+//    numAggregates  in    Number of aggregates found.
+//    sumTimeWindows in    Sum of the time windows (secs) of the rows.
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    TableStats* stats[2] = { &fStats[tableName], &fJobStats[tableName] };
+    for (Int_t index = 0; index < 2; ++index) {
+        ++stats[index]->fNumQueries;
+        stats[index]->fSumRows        += numRows;
+        stats[index]->fSumAggregates  += numAggregates;
+        stats[index]->fSumTimeWindows += sumTimeWindows;
+    }
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiTimeGateStats::Save() const {
+//
+//
+//  Purpose:  Save statistics to the configured file.
+//
+//  Return:    kTRUE if saved.
+//
+//  Specification:-
+//  =============
+//
+//  o Add the queries recorded since Load, or the last Save, to the
+//    statistics now in the file, so that those saved by other jobs
+//    since this one started are kept.
+//
+//  Program Notes:-
+//  =============
+//
+//  Written to a temporary file, unique to this process, and renamed so
+//  that concurrent jobs cannot leave a partial file.  Jobs saving at the
+//  same moment can still lose one another's queries, which only costs
+//  statistics.
+
+    if (fFileName.empty()) {
+        return kFALSE;
+    }
+    std::lock_guard<std::mutex> lock(fMutex);
+    std::map<std::string,TableStats> merged(fJobStats);
+    ReadStats(fFileName,merged);
+
+    std::ostringstream tmpName;
+    tmpName << fFileName << "." << gSystem->GetPid() << ".tmp";
+    std::ofstream out(tmpName.str().c_str());
+    if (! out) {
+        DbiWarn("Unable to write time gate statistics to " << tmpName.str() << "  ");
+        return kFALSE;
+    }
+
+    out << "# TABLE NUMQUERIES SUMROWS SUMAGGREGATES SUMTIMEWINDOWS" << std::endl;
+    out << std::setprecision(15);
+    std::map<std::string,TableStats>::const_iterator itr    = merged.begin();
+    std::map<std::string,TableStats>::const_iterator itrEnd = merged.end();
+    for (; itr != itrEnd; ++itr) {
+        const TableStats& stats = itr->second;
+        out << itr->first << " " << stats.fNumQueries << " " << stats.fSumRows
+            << " " << stats.fSumAggregates << " " << stats.fSumTimeWindows
+            << std::endl;
+    }
+    out.close();
+
+    if (! out || std::rename(tmpName.str().c_str(),fFileName.c_str()) != 0) {
+        DbiWarn("Unable to save time gate statistics to " << fFileName << "  ");
+        std::remove(tmpName.str().c_str());
+        return kFALSE;
+    }
+    fJobStats.clear();
+    DbiLog("Saved time gate statistics for " << merged.size()
+           << " tables to " << fFileName << "  ");
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Int_t CP::TDbiTimeGateStats::SuggestTimeGate(const std::string& tableName) const {
+//
+//
+//  Purpose:  Suggest a time gate for table.
+//
+//  Return:   Suggested time gate (secs) or 0 if too few statistics.
+//
+//  Specification:-
+//  =============
+//
+//  o Apply TDbiValidityRecBuilder's original heuristic, 3 times the
+//    number of aggregates times the mean time window, but averaged
+//    over all recorded queries.
+
+    std::map<std::string,TableStats>::const_iterator itr = fStats.find(tableName);
+    if (itr == fStats.end()) {
+        return 0;
+    }
+    const TableStats& stats = itr->second;
+    if (stats.fNumQueries < kMinQueries || stats.fSumRows <= 0.) {
+        return 0;
+    }
+
+    Double_t meanAggregates = stats.fSumAggregates/stats.fNumQueries;
+    Double_t meanTimeWindow = stats.fSumTimeWindows/stats.fSumRows;
+    Double_t timeGate       = 3. * meanAggregates * meanTimeWindow;
+    if (timeGate > kMaxTimeGate) {
+        return kMaxTimeGate;
+    }
+    if (timeGate < kMinTimeGate) {
+        return kMinTimeGate;
+    }
+    return static_cast<Int_t>(timeGate);
+
+}
@@ -0,0 +1,110 @@
+#ifndef DBITIMEGATESTATS_H
+#define DBITIMEGATESTATS_H
+
+/**
+ *
+ * \class CP::TDbiTimeGateStats
+ *
+ *
+ * \brief
+ * <b>Concept</b> Per-table statistics on primary (validity) queries:
+ *  VLD rows returned, aggregates found and validity window lengths.
+ *
+ * \brief
+ * <b>Purpose</b> To choose the time gate (see TDbi::GetTimeGate) from
+ *  accumulated experience rather than from the single query that
+ *  happens to trigger TDbiValidityRecBuilder's adjustment, and to
+ *  carry that experience between jobs.  If TDbiDatabaseManager is
+ *  configured with
+ *
+ *    TimeGateStats = "file name"
+ *
+ *  statistics are loaded from the file, used to prime the time gates
+ *  and written back, with this job's queries added, when the job ends
+ *  (see ~TDbiDatabaseManager).  Save merges this job's queries into the
+ *  file as it is then, so concurrent jobs sharing the file add to it
+ *  rather than overwrite one another.
+ *
+ */
+
+#include "Rtypes.h"
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#ifndef __CINT__
+#include <mutex>
+#endif
+
+namespace CP {
+
+    class TDbiTimeGateStats {
+
+    public:
+
+// Constructors and destructors.
+        TDbiTimeGateStats();
+        virtual ~TDbiTimeGateStats();
+
+// State testing member functions
+
+/// Return the number of queries of table made by this job.
+        UInt_t GetNumQueries(const std::string& tableName) const;
+/// Print statistics of this job's queries of table, given the number of
+/// VLD rows it holds.
+        void Print(std::ostream& s,
+                   const std::string& tableName,
+                   UInt_t tableRows) const;
+        Bool_t Save() const;
+/// Return suggested time gate or 0 if not enough data to judge.
+        Int_t SuggestTimeGate(const std::string& tableName) const;
+
+// State changing member functions
+
+        Bool_t Load(const std::string& fileName);
+        void RecordQuery(const std::string& tableName,
+                         UInt_t numRows,
+                         UInt_t numAggregates,
+                         Double_t sumTimeWindows);
+
+        static TDbiTimeGateStats gTimeGateStats;
+
+    private:
+
+/// Statistics for one table.
+        struct TableStats {
+            TableStats() : fNumQueries(0), fSumRows(0.),
+                           fSumAggregates(0.), fSumTimeWindows(0.) {}
+            UInt_t   fNumQueries;
+            Double_t fSumRows;
+            Double_t fSumAggregates;
+            Double_t fSumTimeWindows;
+        };
+
+#ifndef __CINT__
+        static Int_t ReadStats(const std::string& fileName,
+                               std::map<std::string,TableStats>& stats);
+#endif  // __CINT__
+
+// Data members
+
+/// File to save statistics to (empty to disable).
+        std::string fFileName;
+
+#ifndef __CINT__ //  Hide map from CINT; it complains about missing Streamer() etc.
+/// Statistics indexed by table name.
+        std::map<std::string,TableStats> fStats;
+
+/// Statistics of this job's queries not yet saved.
+        mutable std::map<std::string,TableStats> fJobStats;
+
+/// Guards fStats as queries may be made from several threads.
+        mutable std::mutex fMutex;
+#endif  // __CINT__
+
+        ClassDef(TDbiTimeGateStats,0)   // Time gate statistics.
+
+    };
+};
+
+#endif  // DBITIMEGATESTATS_H
@@ -34,7 +34,8 @@ CP::TDbiTimerManager CP::TDbiTimerManager::gTimerManager;
 //.....................................................................
 
 CP::TDbiTimerManager::TDbiTimerManager() :
-    fEnabled(kTRUE) {
+    fEnabled(kTRUE),
+    fOwner(std::this_thread::get_id()) {
 //
 //
 //  Purpose:  Default constructor
@@ -80,6 +81,22 @@ CP::TDbiTimer* CP::TDbiTimerManager::GetCurrent() {
 }
 //.....................................................................
 
+Bool_t CP::TDbiTimerManager::IsActive() const {
+//
+//
+//  Purpose:  Return true if enabled and called from the owning thread.
+//
+//  Program Notes:-
+//  =============
+//
+//  The timers form a single push-down stack so queries made concurrently
+//  from other threads (see TDbiAsyncResultSetHandle) are not timed.
+
+    return fEnabled && std::this_thread::get_id() == fOwner;
+}
+
+//.....................................................................
+
 CP::TDbiTimer* CP::TDbiTimerManager::Pop() {
 //
 //
@@ -138,7 +155,7 @@ void CP::TDbiTimerManager::RecBegin(std::string tableName, UInt_t rowSize) {
 
 //  Suspend current timer, if any, and start a new one.
 
-    if (! fEnabled) {
+    if (! this->IsActive()) {
         return;
     }
     CP::TDbiTimer* timer = this->Push();
@@ -156,7 +173,7 @@ void CP::TDbiTimerManager::RecEnd(UInt_t numRows) {
 //
 //  Contact:   N. West
 
-    if (! fEnabled) {
+    if (! this->IsActive()) {
         return;
     }
 
@@ -182,7 +199,7 @@ void CP::TDbiTimerManager::RecFillAgg(Int_t /* aggNo */) {
 //
 //  Contact:   N. West
 
-    if (! fEnabled) {
+    if (! this->IsActive()) {
         return;
     }
 
@@ -199,7 +216,7 @@ void CP::TDbiTimerManager::RecMainQuery() {
 //
 //  Contact:   N. West
 
-    if (! fEnabled) {
+    if (! this->IsActive()) {
         return;
     }
     CP::TDbiTimer* timer = this->GetCurrent();
@@ -221,7 +238,7 @@ void CP::TDbiTimerManager::StartSubWatch(UInt_t subWatch) {
 //
 //  Contact:   N. West
 
-    if (! fEnabled) {
+    if (! this->IsActive()) {
         return;
     }
     CP::TDbiTimer* timer = this->GetCurrent();
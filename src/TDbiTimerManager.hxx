@@ -14,6 +14,9 @@
 
 #include <string>
 #include <list>
+#ifndef __CINT__
+#include <thread>
+#endif
 
 namespace CP {
     class TDbiTableMetaData;
@@ -48,6 +51,7 @@ namespace CP {
     private:
 
         TDbiTimer* GetCurrent();
+        Bool_t IsActive() const;
         TDbiTimer* Pop();
         TDbiTimer* Push();
 
@@ -57,6 +61,9 @@ namespace CP {
         Bool_t fSubWatchEnabled;
         // SubWatch Enable/disable (not used now).
         std::list<TDbiTimer*> fTimers;      // Push-down stack of timers.
+#ifndef __CINT__
+        std::thread::id fOwner;             // Thread that may use the timers.
+#endif
 
         ClassDef(TDbiTimerManager,0)    // Simple query timer
 
@@ -0,0 +1,486 @@
+
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <utility>
+
+#include "TDbiCascader.hxx"
+#include "TDbiConfigSet.hxx"
+#include "TDbiConnectionMaintainer.hxx"
+#include "TDbiDBProxy.hxx"
+#include "TDbiDatabaseManager.hxx"
+#include "TDbiSqlValPacket.hxx"
+#include "TDbiStatement.hxx"
+#include "TDbiTableProxy.hxx"
+#include "TDbiUpdateApplier.hxx"
+#include "TSeqNoAllocator.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
+
+ClassImp(CP::TDbiUpdateApplier)
+
+//   Definition of static data members
+//   *********************************
+
+
+//    Definition of all member functions (static or otherwise)
+//    *******************************************************
+//
+//    -  ordered: ctors, dtor, operators then in alphabetical order.
+
+//.....................................................................
+
+CP::TDbiUpdateApplier::TDbiUpdateApplier(UInt_t dbNo) :
+    fDbNo(dbNo),
+    fBatchSize(1000),
+    fKeepSeqNos(kFALSE),
+    fNumThreads(1),
+    fProgressInterval(10.),
+    fRequireGlobal(0),
+    fThreadsInUse(1),
+    fNumSets(0),
+    fNumRows(0),
+    fNumErrors(0),
+    fLastReport(0.),
+    fRowsPerSec(0.) {
+//
+//
+//  Purpose:  Constructor
+//
+//  Arguments:
+//    dbNo         in    Cascade entry to update.
+
+    DbiTrace("Creating CP::TDbiUpdateApplier" << "  ");
+
+}
+
+//.....................................................................
+
+CP::TDbiUpdateApplier::~TDbiUpdateApplier() {
+//
+//
+//  Purpose: Destructor
+
+    DbiTrace("Destroying CP::TDbiUpdateApplier" << "  ");
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiUpdateApplier::Apply(const std::string& fileName) {
+//
+//
+//  Purpose:  Apply all packets in an .update file.
+//
+//  Arguments:
+//    fileName     in    The file.
+//
+//  Return:    kTRUE if every packet was read and stored.
+//
+//  Specification:-
+//  =============
+//
+//  o Use no more threads than the entry has pooled connections, as a
+//    connection holding a transaction is never shared.
+//
+//  o Read packets one at a time, adding each to its table's batch and
+//    dispatching the batch to be stored (see Dispatch) once full.
+//
+//  o Stop reading at the first bad packet or failed batch.
+//
+//  o Dispatch the remaining partial batches, wait for all to complete
+//    and discard any packets left unstored.
+
+    fBatches.clear();
+    fTables.clear();
+    fInFlight.clear();
+    fNumSets    = 0;
+    fNumRows    = 0;
+    fNumErrors  = 0;
+    fLastReport = 0.;
+    fRowsPerSec = 0.;
+
+    CP::TDbiCascader& cascader = CP::TDbiDatabaseManager::Instance()
+                                 .GetCascader();
+    if (fDbNo >= cascader.GetNumDb()) {
+        DbiSevere("Cannot apply " << fileName
+                  << " to non-existant cascade entry " << fDbNo << "  ");
+        return kFALSE;
+    }
+    std::ifstream is(fileName.c_str());
+    if (! is.is_open()) {
+        DbiSevere("Cannot open update file " << fileName << "  ");
+        return kFALSE;
+    }
+    fThreadsInUse = fNumThreads;
+    UInt_t poolSize = cascader.GetPoolSize(fDbNo);
+    if (fThreadsInUse > poolSize) {
+        DbiWarn("Applying " << fileName << " with " << poolSize
+                << " thread(s), not " << fNumThreads << ", as cascade entry "
+                << fDbNo << " has a ConnectionPoolSize of " << poolSize
+                << "  ");
+        fThreadsInUse = poolSize;
+    }
+    // SQLite allows one write transaction at a time; others get SQLITE_BUSY.
+    const CP::TDbiConnection* connection = cascader.GetConnection(fDbNo);
+    if (fThreadsInUse > 1 && connection && connection->IsSQLite()) {
+        DbiInfo("Applying " << fileName << " with 1 thread as cascade entry "
+                << fDbNo << " is an SQLite file" << "  ");
+        fThreadsInUse = 1;
+    }
+
+    // Stack object to hold connections
+    CP::TDbiConnectionMaintainer cm(&cascader);
+
+    fTimer.Start(kTRUE);
+    Bool_t ok = kTRUE;
+    while (ok) {
+        std::unique_ptr<CP::TDbiSqlValPacket> packet(new CP::TDbiSqlValPacket);
+        Bool_t filled = packet->Fill(is);
+        if (packet->GetNumErrors()) {
+            DbiSevere("Bad validity packet in " << fileName
+                      << "; no further packets applied" << "  ");
+            ++fNumErrors;
+            ok = kFALSE;
+            break;
+        }
+        if (! filled) {
+            break;
+        }
+        const std::string tableName = packet->GetTableName();
+        if (! this->PrepareTable(*packet)) {
+            ++fNumErrors;
+            ok = kFALSE;
+            break;
+        }
+        std::vector<CP::TDbiSqlValPacket*>& batch = fBatches[tableName];
+        batch.push_back(packet.release());
+        if (batch.size() >= fBatchSize) {
+            ok = this->Dispatch(tableName);
+        }
+        this->ReportProgress(kFALSE);
+    }
+
+    std::map<std::string,std::vector<CP::TDbiSqlValPacket*> >::iterator itr;
+    for (itr = fBatches.begin(); ok && itr != fBatches.end(); ++itr) {
+        if (! itr->second.empty()) {
+            ok = this->Dispatch(itr->first);
+        }
+    }
+    if (! this->WaitForBatches(0)) {
+        ok = kFALSE;
+    }
+    for (itr = fBatches.begin(); itr != fBatches.end(); ++itr) {
+        for (UInt_t index = 0; index < itr->second.size(); ++index) {
+            delete itr->second[index];
+        }
+    }
+    fBatches.clear();
+
+    this->ReportProgress(kTRUE);
+    fTimer.Stop();
+    if (! ok) {
+        DbiSevere("Applied only " << fNumSets << " validity sets of "
+                  << fileName << " to cascade entry " << fDbNo << "  ");
+    }
+    return ok;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiUpdateApplier::ApplyBatch(const std::string& tableName,
+                                         const CP::TDbiDBProxy* dbProxy,
+                                         const std::vector<CP::TDbiSqlValPacket*>& packets) const {
+//
+//
+//  Purpose:  Store a batch of packets of one table (runs on its own
+//            thread).
+//
+//  Arguments:
+//    tableName    in    The table.
+//    dbProxy      in    The table's database proxy.
+//    packets      in    Its packets, in file order, with their SEQNOs.
+//                       Deleted.
+//
+//  Return:    kTRUE if all stored.
+//
+//  Specification:-
+//  =============
+//
+//  o Store all the packets in one transaction, rolled back if any fails,
+//    first removing any existing sets with the same SEQNOs if keeping
+//    the file's SEQNOs.
+
+//  Program Notes:-
+//  =============
+//
+//  The statement is made on this thread so checks out its own
+//  connection from the entry's pool (see TDbiConnectionPool).  Nothing
+//  else is shared: SEQNOs are reserved, and returned, by the dispatching
+//  thread (see Dispatch and WaitForBatches) and dbProxy is used rather
+//  than looking the table proxy up (see TDbiSqlValPacket::Store).
+
+    Bool_t ok = kTRUE;
+    std::unique_ptr<CP::TDbiStatement> stmtDb(
+        CP::TDbiDatabaseManager::Instance().GetCascader()
+        .CreateStatement(fDbNo));
+    if (! stmtDb.get()) {
+        DbiWarn("Attempting to write to non-existant cascade entry "
+                << fDbNo << "  ");
+        ok = kFALSE;
+    }
+    if (ok) {
+        stmtDb->StartTransaction();
+        ok = ! stmtDb->PrintExceptions();
+    }
+    for (UInt_t index = 0; ok && index < packets.size(); ++index) {
+        if (fKeepSeqNos) {
+            ok = dbProxy->RemoveSeqNo(packets[index]->GetSeqNo(),*stmtDb);
+        }
+        ok = ok && packets[index]->Store(*stmtDb);
+    }
+    if (ok) {
+        stmtDb->Commit();
+        ok = ! stmtDb->PrintExceptions();
+    }
+    else if (stmtDb.get()) {
+        stmtDb->Rollback();
+        stmtDb->PrintExceptions();
+    }
+    stmtDb.reset();
+
+    if (! ok) {
+        DbiSevere("Failed to store " << packets.size()
+                  << " validity sets of " << tableName
+                  << " in cascade entry " << fDbNo << "; rolled back" << "  ");
+    }
+    for (UInt_t index = 0; index < packets.size(); ++index) {
+        delete packets[index];
+    }
+    return ok;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiUpdateApplier::Dispatch(const std::string& tableName) {
+//
+//
+//  Purpose:  Start storing the batch collected for a table.
+//
+//  Arguments:
+//    tableName    in    The table.
+//
+//  Return:    kTRUE unless an earlier batch, waited for here, failed or
+//             SEQNOs could not be reserved.
+//
+//  Specification:-
+//  =============
+//
+//  o Wait until the table has no batch in flight and there is a thread
+//    free.
+//
+//  o Unless keeping the file's SEQNOs, reserve a block for the batch and
+//    assign them in order.
+//
+//  o Hand the batch over to a new thread (see ApplyBatch).
+
+//  Program Notes:-
+//  =============
+//
+//  SEQNOs are reserved here, on the dispatching thread, as the cascader's
+//  SEQNO tables and table lists are not safe to update from several
+//  threads at once.
+
+    if (! this->WaitForBatches(fThreadsInUse-1,tableName)) {
+        return kFALSE;
+    }
+
+    std::vector<CP::TDbiSqlValPacket*>& batch = fBatches[tableName];
+    InFlight flight;
+    flight.fTableName = tableName;
+    flight.fFirstSeqNo = 0;
+    flight.fNumSets   = batch.size();
+    flight.fNumRows   = 0;
+    if (! fKeepSeqNos) {
+        flight.fFirstSeqNo = CP::TDbiDatabaseManager::Instance()
+            .GetSeqNoAllocator()
+            .ReserveSeqNos(tableName,batch.size(),fRequireGlobal,fDbNo);
+        if (flight.fFirstSeqNo <= 0) {
+            DbiSevere("Cannot get " << batch.size()
+                      << " sequence numbers for table " << tableName << "  ");
+            fNumErrors += batch.size();
+            return kFALSE;
+        }
+    }
+    for (UInt_t index = 0; index < batch.size(); ++index) {
+        if (! fKeepSeqNos) {
+            batch[index]->SetSeqNo(flight.fFirstSeqNo+index);
+        }
+        flight.fNumRows += batch[index]->GetNumSqlStmts() - 1;
+    }
+    flight.fResult = std::async(std::launch::async,
+                                &CP::TDbiUpdateApplier::ApplyBatch,
+                                this,tableName,fTables[tableName],batch);
+    batch.clear();
+    fInFlight.push_back(std::move(flight));
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+UInt_t CP::TDbiUpdateApplier::GetNumTables() const {
+//
+//
+//  Purpose:  Return the number of tables in the last file applied.
+
+    return fTables.size();
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiUpdateApplier::PrepareTable(const CP::TDbiSqlValPacket& packet) {
+//
+//
+//  Purpose:  Check, on first sight of a table, that its packets can be
+//            stored.
+//
+//  Arguments:
+//    packet       in    The first packet of the table.
+//
+//  Return:    kTRUE if the table exists or has been created.
+//
+//  Specification:-
+//  =============
+//
+//  o Create the table from the packet's metadata if missing.
+//
+//  o Make the table proxy here and keep its database proxy for the
+//    storing threads.
+
+    const std::string& tableName = packet.GetTableName();
+    std::map<std::string,const CP::TDbiDBProxy*>::const_iterator itr
+        = fTables.find(tableName);
+    if (itr != fTables.end()) {
+        return itr->second != 0;
+    }
+
+    CP::TDbiDatabaseManager& dbm = CP::TDbiDatabaseManager::Instance();
+    Bool_t ok = kTRUE;
+    if (! dbm.GetCascader().TableExists(tableName,fDbNo)) {
+        DbiLog("Creating table " << tableName << " in cascade entry "
+               << fDbNo << "  ");
+        ok = packet.CreateTable(fDbNo);
+        if (! ok) {
+            DbiSevere("Cannot create table " << tableName
+                      << " in cascade entry " << fDbNo << "  ");
+        }
+    }
+    const CP::TDbiDBProxy* dbProxy = 0;
+    if (ok) {
+        CP::TDbiConfigSet pet;
+        dbProxy = &dbm.GetTableProxy(tableName,&pet).GetDBProxy();
+    }
+    fTables[tableName] = dbProxy;
+    return ok;
+
+}
+
+//.....................................................................
+
+void CP::TDbiUpdateApplier::ReleaseSeqNos(const InFlight& flight) const {
+//
+//
+//  Purpose:  Return the SEQNOs reserved for a batch that failed, where
+//            possible (see TDbiCascader::ReleaseSeqNos).
+//
+//  Arguments:
+//    flight       in    The batch.
+
+    if (flight.fFirstSeqNo <= 0) {
+        return;
+    }
+    Int_t first = flight.fFirstSeqNo;
+    Int_t last  = first + flight.fNumSets - 1;
+    if (! CP::TDbiDatabaseManager::Instance().GetCascader()
+        .ReleaseSeqNos(flight.fTableName,first,last,fDbNo)) {
+        DbiWarn("SEQNOs " << first << ".." << last << " reserved for "
+                << flight.fTableName << " were not used and cannot be returned"
+                << "  ");
+    }
+
+}
+
+//.....................................................................
+
+void CP::TDbiUpdateApplier::ReportProgress(Bool_t force) {
+//
+//
+//  Purpose:  Log progress if due.
+//
+//  Arguments:
+//    force        in    Log whether due or not.
+
+    Double_t secs = fTimer.RealTime();
+    fTimer.Continue();
+    if (! force && secs - fLastReport < fProgressInterval) {
+        return;
+    }
+    fLastReport = secs;
+    fRowsPerSec = secs > 0. ? fNumRows/secs : 0.;
+    DbiLog("Applied " << fNumSets << " validity sets (" << fNumRows
+           << " rows) of " << fTables.size() << " tables in " << secs
+           << " secs (" << fRowsPerSec << " rows/sec)" << "  ");
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiUpdateApplier::WaitForBatches(UInt_t maxInFlight,
+                                             const std::string& tableName) {
+//
+//
+//  Purpose:  Wait, oldest first, for batches to complete.
+//
+//  Arguments:
+//    maxInFlight  in    Stop once no more than this many are in flight ...
+//    tableName    in    ... and none of this table.
+//
+//  Return:    kTRUE unless a batch waited for failed.
+
+    Bool_t ok = kTRUE;
+    while (! fInFlight.empty()) {
+        Bool_t wait = fInFlight.size() > maxInFlight;
+        for (UInt_t index = 0; ! wait && index < fInFlight.size(); ++index) {
+            wait = fInFlight[index].fTableName == tableName;
+        }
+        if (! wait) {
+            break;
+        }
+        InFlight& flight = fInFlight.front();
+        Bool_t stored = kFALSE;
+        try {
+            stored = flight.fResult.get();
+        }
+        catch (std::exception& e) {
+            DbiSevere("Storing validity sets of " << flight.fTableName
+                      << " failed: " << e.what() << "  ");
+        }
+        if (stored) {
+            fNumSets += flight.fNumSets;
+            fNumRows += flight.fNumRows;
+        }
+        else {
+            fNumErrors += flight.fNumSets;
+            ok = kFALSE;
+            this->ReleaseSeqNos(flight);
+        }
+        fInFlight.erase(fInFlight.begin());
+    }
+    return ok;
+
+}
+
@@ -0,0 +1,208 @@
+#ifndef DBIUPDATEAPPLIER_H
+#define DBIUPDATEAPPLIER_H
+
+/**
+ *
+ * \class CP::TDbiUpdateApplier
+ *
+ *
+ * \brief
+ * <b>Concept</b> Reader of an .update file, as written by
+ *  TDbiWriter::Close(fileSpec), that stores its validity packets in a
+ *  cascade entry.
+ *
+ * \brief
+ * <b>Purpose</b> To apply update files in a single process, without
+ *  starting a database client for every statement, and to keep the
+ *  servers busy by applying different tables at the same time.
+ *
+ * \brief
+ * <b>Usage Notes</b>
+ *
+ *  CP::TDbiUpdateApplier applier(dbNo);
+ *  applier.SetRequireGlobal(1);      // Optional, see below.
+ *  applier.SetNumThreads(4);         // Optional.
+ *  if ( ! applier.Apply("calib.update") ) ...
+ *
+ *  The file is read one packet at a time (see TDbiSqlValPacket::Fill)
+ *  and the packets of each table collected into batches of SetBatchSize
+ *  (default 1000).  Each batch is stored in one transaction on a
+ *  connection checked out of the entry's pool, with up to SetNumThreads
+ *  (default 1) batches, always of different tables, in flight at once.
+ *  A connection holding a transaction is never shared so no more threads
+ *  are used than TDbiDatabaseManager's ConnectionPoolSize (see
+ *  TDbiCascader::GetPoolSize); one more lets SEQNOs be reserved without
+ *  waiting for a batch to finish.  SQLite files allow only one write
+ *  transaction at a time so are always applied with one thread.  Batches
+ *  of the same table are stored in file order.
+ *
+ *  By default each batch is given a block of new SEQNOs, reserved with a
+ *  single update of the SEQNO table (see TSeqNoAllocator::ReserveSeqNos),
+ *  of the type selected by SetRequireGlobal (see
+ *  TDbiCascader::AllocateSeqNo).  Blocks are reserved, and returned, on
+ *  the thread calling Apply; the storing threads only use their own
+ *  connections.  SetKeepSeqNos instead stores packets
+ *  with the SEQNOs in the file, replacing any already present.  If a
+ *  batch fails its transaction is rolled back, its block returned where
+ *  possible (see TDbiCascader::ReleaseSeqNos) and no further packets are
+ *  read; batches already committed are kept.
+ *
+ *  Tables missing from the entry are created from the packet's metadata,
+ *  if the file has any (see TDbiSqlValPacket::Write), otherwise their
+ *  packets fail.
+ *
+ *  Progress is logged (DbiLog) at most every SetProgressInterval seconds
+ *  (default 10) and the totals are available from GetNumSets, GetNumRows
+ *  and GetRowsPerSec once Apply returns.
+ *
+ */
+
+#if !defined(__CINT__) || defined(__MAKECINT__)
+#include "Rtypes.h"
+#endif
+
+#include "TStopwatch.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#ifndef __CINT__
+#include <future>
+#endif
+
+namespace CP {
+    class TDbiDBProxy;
+    class TDbiSqlValPacket;
+}
+
+namespace CP {
+
+    class TDbiUpdateApplier {
+
+    public:
+
+// Constructors and destructors.
+        TDbiUpdateApplier(UInt_t dbNo = 0);
+        virtual ~TDbiUpdateApplier();
+
+// State testing member functions
+        UInt_t GetDbNo() const {
+            return fDbNo;
+        }
+        UInt_t GetNumErrors() const {
+            return fNumErrors;
+        }
+        ULong64_t GetNumRows() const {
+            return fNumRows;
+        }
+        UInt_t GetNumSets() const {
+            return fNumSets;
+        }
+        UInt_t GetNumTables() const;
+/// Data rows per second achieved by the last Apply.
+        Double_t GetRowsPerSec() const {
+            return fRowsPerSec;
+        }
+
+// State changing member functions
+
+/// Apply all packets in fileName and return true if all were stored.
+        Bool_t Apply(const std::string& fileName);
+
+/// Number of packets stored per transaction.
+        void SetBatchSize(UInt_t batchSize) {
+            fBatchSize = batchSize ? batchSize : 1;
+        }
+/// Store packets with the SEQNOs in the file, replacing existing ones.
+        void SetKeepSeqNos(Bool_t keep = kTRUE) {
+            fKeepSeqNos = keep;
+        }
+/// Maximum number of tables applied at the same time.
+        void SetNumThreads(UInt_t numThreads) {
+            fNumThreads = numThreads ? numThreads : 1;
+        }
+/// Minimum number of seconds between progress reports.
+        void SetProgressInterval(Double_t secs) {
+            fProgressInterval = secs;
+        }
+/// SEQNO type of new SEQNOs (see TDbiCascader::AllocateSeqNo).
+        void SetRequireGlobal(Int_t requireGlobal) {
+            fRequireGlobal = requireGlobal;
+        }
+
+    private:
+
+// Disabled (not implemented) copy constructor and asignment.
+
+        TDbiUpdateApplier(const TDbiUpdateApplier&);
+        CP::TDbiUpdateApplier& operator=(const CP::TDbiUpdateApplier&);
+
+        Bool_t ApplyBatch(const std::string& tableName,
+                          const CP::TDbiDBProxy* dbProxy,
+                          const std::vector<CP::TDbiSqlValPacket*>& packets) const;
+        Bool_t Dispatch(const std::string& tableName);
+        Bool_t PrepareTable(const CP::TDbiSqlValPacket& packet);
+        void ReportProgress(Bool_t force);
+        Bool_t WaitForBatches(UInt_t maxInFlight,
+                              const std::string& tableName = "");
+
+#ifndef __CINT__
+/// A batch being stored.
+        struct InFlight {
+            std::string fTableName;
+            Int_t fFirstSeqNo;      // 0 if keeping the file's SEQNOs.
+            UInt_t fNumSets;
+            ULong64_t fNumRows;
+            std::future<Bool_t> fResult;
+        };
+
+        void ReleaseSeqNos(const InFlight& flight) const;
+#endif
+
+// Data members
+
+/// Cascade entry being updated.
+        UInt_t fDbNo;
+
+/// Options.
+        UInt_t fBatchSize;
+        Bool_t fKeepSeqNos;
+        UInt_t fNumThreads;
+        Double_t fProgressInterval;
+        Int_t fRequireGlobal;
+
+/// Threads used by the last Apply: fNumThreads limited to the entry's
+/// connection pool size.
+        UInt_t fThreadsInUse;
+
+#ifndef __CINT__
+/// Packets collected for each table but not yet dispatched.  Owned.
+        std::map<std::string,std::vector<CP::TDbiSqlValPacket*> > fBatches;
+
+/// Tables seen and, if they can be stored, their database proxies.
+        std::map<std::string,const CP::TDbiDBProxy*> fTables;
+
+/// Batches being stored, oldest first.
+        std::vector<InFlight> fInFlight;
+#endif
+
+/// Totals over the last Apply, counting committed batches only.
+        UInt_t fNumSets;
+        ULong64_t fNumRows;
+
+/// Packets that could not be read or stored.
+        UInt_t fNumErrors;
+
+/// Time since the start of Apply and when progress was last reported.
+        TStopwatch fTimer;
+        Double_t fLastReport;
+
+/// Throughput of the last Apply.
+        Double_t fRowsPerSec;
+
+        ClassDef(TDbiUpdateApplier,0)   // Apply an .update file.
+
+    };
+};
+
+#endif  // DBIUPDATEAPPLIER_H
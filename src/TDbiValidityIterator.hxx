@@ -0,0 +1,129 @@
+#ifndef DBIVALIDITYITERATOR_H
+#define DBIVALIDITYITERATOR_H
+
+/**
+ *
+ * \class CP::TDbiValidityIterator
+ *
+ *
+ * \brief
+ * <b>Concept</b>  Templated iterator over the successive effective
+ *  validity intervals of a table between two times.
+ *
+ * \brief
+ * <b>Purpose</b> To walk the complete validity history of a table, for
+ *  example to plot calibration constants, visiting every distinct
+ *  interval exactly once.  Stepping a TDbiResultSetHandle in fixed time
+ *  increments both misses short intervals and repeats long ones.
+ *
+ * \brief
+ * <b>Usage Notes</b>
+ *
+ *  CP::TDbiValidityIterator<CP::TDemo_DB_Table> itr(vc,end);
+ *  while ( itr.Next() ) {
+ *    const CP::TVldRange& range = itr.GetRange();
+ *    const CP::TDbiResultSetHandle<CP::TDemo_DB_Table>& rs
+ *        = itr.GetResultSetHandle();
+ *    ...
+ *  }
+ *
+ *  The first interval is the one containing the time of vc, subsequent
+ *  ones are obtained with TDbiResultSetHandle::NextQuery and all ranges
+ *  are limited to [vc time, end).  Unless VLD snapshot mode is already
+ *  enabled, all VLD rows for the period are prefetched into a
+ *  TDbiVldSnapshot so interval boundaries are resolved locally and only
+ *  the data of each new aggregate is fetched.  Only one iterator per
+ *  table should be active at a time.
+ *
+ *  Like TDbiWriter, the implementation is in TDbiValidityIterator.tpl
+ *  which must be included where the iterator is instantiated, alongside
+ *  an instantiation of TDbiResultSetHandle<T>.
+ *
+ */
+
+#include <string>
+
+#include "TDbi.hxx"
+#include "TDbiResultSetHandle.hxx"
+#include "TVldContext.hxx"
+#include "TVldRange.hxx"
+#include "TVldTimeStamp.hxx"
+
+namespace CP {
+    class TDbiTableProxy;
+}
+
+namespace CP {
+    template <class T> class TDbiValidityIterator {
+
+    public:
+
+// Constructors and destructors.
+        TDbiValidityIterator(const CP::TVldContext& vc,
+                             const CP::TVldTimeStamp& end,
+                             TDbi::Task task = TDbi::kDefaultTask,
+                             const std::string& tableName = "");
+        virtual ~TDbiValidityIterator();
+
+// State testing member functions
+        UInt_t GetNumIntervals() const {
+            return fNumIntervals;
+        }
+        const CP::TVldRange& GetRange() const {
+            return fRange;
+        }
+        const TDbiResultSetHandle<T>& GetResultSetHandle() const {
+            return *fHandle;
+        }
+
+// State changing member functions
+
+/// Step to the next interval, returning false once past the end.
+        Bool_t Next();
+
+    private:
+
+// Disabled (not implemented) copy constructor and asignment.
+
+        TDbiValidityIterator(const TDbiValidityIterator&);
+        TDbiValidityIterator& operator=(const TDbiValidityIterator&);
+
+// Data members
+
+/// Context of first query.
+        CP::TVldContext fContext;
+
+/// End of iteration (exclusive).
+        CP::TVldTimeStamp fEnd;
+
+/// Task of all queries.
+        TDbi::Task fTask;
+
+/// Table name (empty for default).
+        std::string fTableName;
+
+/// Proxy for the table.
+        TDbiTableProxy& fTableProxy;
+
+/// Owned result handle, created on first call to Next.
+        TDbiResultSetHandle<T>* fHandle;
+
+/// True if this iterator loaded (and so must clear) VLD snapshots.
+        Bool_t fOwnsSnapshots;
+
+/// Current interval, limited to the iteration range.
+        CP::TVldRange fRange;
+
+/// Number of intervals visited so far.
+        UInt_t fNumIntervals;
+
+/// True once past the end.
+        Bool_t fDone;
+
+        ClassDefT(TDbiValidityIterator<T>,0)  // Iterator over validity intervals.
+
+    };
+};
+ClassDefT2(TDbiValidityIterator,T)
+
+#endif  // DBIVALIDITYITERATOR_H
@@ -0,0 +1,157 @@
+
+#include "TDbiServices.hxx"
+#include "TDbiTableProxy.hxx"
+#include "TDbiValidityIterator.hxx"
+#include "TDbiValidityRec.hxx"
+#include "TDbiLog.hxx"
+#include "MsgFormat.hxx"
+
+ClassImpT(CP::TDbiValidityIterator,T)
+
+//    Definition of all member functions (static or otherwise)
+//    *******************************************************
+//
+//    -  ordered: ctors, dtor, operators then in alphabetical order.
+
+//.....................................................................
+
+template<class T>
+CP::TDbiValidityIterator<T>::TDbiValidityIterator(const CP::TVldContext& vc,
+                                                  const CP::TVldTimeStamp& end,
+                                                  TDbi::Task task,
+                                                  const std::string& tableName) :
+    fContext(vc),
+    fEnd(end),
+    fTask(task),
+    fTableName(tableName),
+    fTableProxy(CP::TDbiResultSetHandle<T>::GetTableProxy(tableName)),
+    fHandle(0),
+    fOwnsSnapshots(kFALSE),
+    fNumIntervals(0),
+    fDone(kFALSE)
+{
+//
+//  Purpose:  Constructor
+//
+//  Arguments:
+//    vc            in       Context of first query (start of iteration).
+//    end           in       End of iteration (exclusive).
+//    task          in       Task of all queries.
+//    tableName     in       Table name (default: "" - get table name
+//                           from object type)
+//
+//  Specification:-
+//  =============
+//
+//  o Prefetch all VLD rows that can contribute to intervals in
+//    [vc time, end), extended by the time gate, unless snapshot mode
+//    is already enabled.
+
+    DbiTrace("Creating CP::TDbiValidityIterator for "
+             << fTableProxy.GetTableName() << "  ");
+
+    if (! CP::TDbiServices::VldSnapshot() && fTableProxy.TableExists()) {
+        Int_t timeGate = TDbi::GetTimeGate(fTableProxy.GetTableName());
+        CP::TVldTimeStamp start(vc.GetTimeStamp().GetSec() - timeGate,0);
+        CP::TVldTimeStamp stop(end.GetSec() + timeGate,0);
+        fTableProxy.LoadVldSnapshots(start,stop);
+        fOwnsSnapshots = kTRUE;
+    }
+
+}
+
+//.....................................................................
+
+template<class T>
+CP::TDbiValidityIterator<T>::~TDbiValidityIterator() {
+//
+//
+//  Purpose: Destructor
+
+    DbiTrace("Destroying CP::TDbiValidityIterator for "
+             << fTableProxy.GetTableName() << " after "
+             << fNumIntervals << " intervals" << "  ");
+
+    delete fHandle;
+    fHandle = 0;
+    if (fOwnsSnapshots) {
+        fTableProxy.ClearVldSnapshots();
+    }
+
+}
+
+//.....................................................................
+
+template<class T>
+Bool_t CP::TDbiValidityIterator<T>::Next() {
+//
+//
+//  Purpose:  Step to the next validity interval.
+//
+//  Return:   kTRUE if there is a new interval, kFALSE once past the end.
+//
+//  Specification:-
+//  =============
+//
+//  o On the first call apply the query for the starting context,
+//    thereafter step across the end of the current interval using
+//    TDbiResultSetHandle::NextQuery.
+//
+//  o Limit the resulting range to the iteration range.
+
+    if (fDone) {
+        return kFALSE;
+    }
+
+    if (! fHandle) {
+        if (fContext.GetTimeStamp() >= fEnd) {
+            fDone = kTRUE;
+            return kFALSE;
+        }
+        fHandle = new CP::TDbiResultSetHandle<T>(fTableName,fContext,fTask,
+                                                 TDbi::kDisabled);
+    }
+    else {
+        if (fRange.GetTimeEnd() >= fEnd) {
+            fDone = kTRUE;
+            DbiLog("Iterated over " << fNumIntervals
+                   << " validity intervals of table "
+                   << fTableProxy.GetTableName() << "  ");
+            return kFALSE;
+        }
+        fHandle->NextQuery(kTRUE);
+    }
+
+    const CP::TDbiResultSet* result = fHandle->GetResult();
+    if (! result) {
+        fDone = kTRUE;
+        return kFALSE;
+    }
+
+    const CP::TVldRange& range = result->GetValidityRec().GetVldRange();
+    CP::TVldTimeStamp start = range.GetTimeStart();
+    CP::TVldTimeStamp end   = range.GetTimeEnd();
+    if (start < fContext.GetTimeStamp()) {
+        start = fContext.GetTimeStamp();
+    }
+    if (end > fEnd) {
+        end = fEnd;
+    }
+
+//  Guard against failing to make progress.
+    if (fNumIntervals > 0 && end <= fRange.GetTimeEnd()) {
+        DbiWarn("Validity iteration of table " << fTableProxy.GetTableName()
+                << " failed to advance beyond " << fRange.GetTimeEnd() << "  ");
+        fDone = kTRUE;
+        return kFALSE;
+    }
+
+    fRange = CP::TVldRange(range.GetDetectorMask(),
+                           range.GetSimMask(),
+                           start,
+                           end,
+                           range.GetDataSource());
+    ++fNumIntervals;
+    return kTRUE;
+
+}
@@ -112,6 +112,9 @@ namespace CP {
         void SetEpoch(UInt_t epoch) {
             fEpoch = epoch;
         }
+        void SetInsertDate(const CP::TVldTimeStamp& insertDate) {
+            fInsertDate = insertDate;
+        }
         void SetTableProxy(const TDbiTableProxy* tp) {
             fTableProxy = tp;
         }
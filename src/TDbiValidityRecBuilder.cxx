@@ -1,13 +1,17 @@
 // $Id: TDbiValidityRecBuilder.cxx,v 1.1 2011/01/18 05:49:20 finch Exp $
 
+#include <memory>
+
 #include "DbiDetector.hxx"
 #include "DbiSimFlag.hxx"
 #include "TDbiDBProxy.hxx"
 #include "TDbiResultSetNonAgg.hxx"
 #include "TDbiInRowStream.hxx"
 #include "TDbiSimFlagAssociation.hxx"
+#include "TDbiTimeGateStats.hxx"
 #include "TDbiValidityRec.hxx"
 #include "TDbiValidityRecBuilder.hxx"
+#include "TDbiVldSnapshot.hxx"
 #include <TDbiLog.hxx>
 #include <MsgFormat.hxx>
 #include "TVldContext.hxx"
@@ -76,7 +80,7 @@ CP::TDbiValidityRecBuilder::TDbiValidityRecBuilder(const CP::TDbiDBProxy& proxy,
     CP::TVldTimeStamp             ts(vc.GetTimeStamp());
     CP::DbiSimFlag::SimFlag_t       simTry(sim);
     const std::string& tableName = proxy.GetTableName();
-    Int_t sumTimeWindows = 0;
+    Double_t sumTimeWindows = 0.;
     Int_t numTimeWindows = 0;
 
 //  Contruct a default (gap) validity record fGap.
@@ -133,26 +137,43 @@ CP::TDbiValidityRecBuilder::TDbiValidityRecBuilder(const CP::TDbiDBProxy& proxy,
                 ++listItr;
                 CP::TVldContext vcTry(det,simTry,ts);
 
-//      Apply validity query and build result set.
+//      Apply validity query, to the VLD snapshot if there is one (but
+//      never for a selected DB - writers must see the current state),
+//      otherwise to the database, and build result set.
+
+                const CP::TDbiVldSnapshot* snapshot
+                    = selectDbNo < 0 ? proxy.GetVldSnapshot(dbNo,ts) : 0;
+                std::vector<const CP::TDbiValidityRec*> vrecs;
+                CP::TDbiValidityRec tr;
+                std::unique_ptr<CP::TDbiResultSetNonAgg> result;
 
-                CP::TDbiInRowStream* rs = proxy.QueryValidity(vcTry,fTask,dbNo);
+                if (snapshot) {
+                    snapshot->QueryValidity(vcTry,fTask,vrecs);
+                }
+                else {
+                    CP::TDbiInRowStream* rs = proxy.QueryValidity(vcTry,fTask,dbNo);
 
 //      Build a result from the result set and drop result set.
 
-                CP::TDbiValidityRec tr;
-                CP::TDbiResultSetNonAgg result(rs,&tr,0,kFALSE);
-                delete rs;
+                    result.reset(new CP::TDbiResultSetNonAgg(rs,&tr,0,kFALSE));
+                    delete rs;
+                    UInt_t numRows = result->GetNumRows();
+                    for (UInt_t row = 0; row < numRows; ++row) {
+                        vrecs.push_back(dynamic_cast<const CP::TDbiValidityRec*>(
+                                            result->GetTableRow(row)));
+                    }
+                }
 
-//      Loop over all entries in CP::TDbiResultSet and, for each Aggregate,
+//      Loop over all selected validity records and, for each Aggregate,
 //      find effective validity range of best, or of gap if none.
 
 //      Initialise lowest priority VLD to a gap. It will be used by FindTimeBoundaries.
                 const CP::TDbiValidityRec* lowestPriorityVrec = &fGap;
 
-                UInt_t numRows = result.GetNumRows();
-                for (UInt_t row = 0; row < numRows; ++row) {
-                    const CP::TDbiValidityRec* vr = dynamic_cast<const CP::TDbiValidityRec*>(
-                                                        result.GetTableRow(row));
+                std::vector<const CP::TDbiValidityRec*>::const_iterator vrItr    = vrecs.begin();
+                std::vector<const CP::TDbiValidityRec*>::const_iterator vrItrEnd = vrecs.end();
+                for (; vrItr != vrItrEnd; ++vrItr) {
+                    const CP::TDbiValidityRec* vr = *vrItr;
 
                     Int_t aggNo = vr->GetAggregateNo();
 
@@ -201,7 +222,12 @@ CP::TDbiValidityRecBuilder::TDbiValidityRecBuilder(const CP::TDbiDBProxy& proxy,
 //      and the default (gap) validity record.
                 if (findFullTimeWindow) {
                     CP::TVldTimeStamp start, end;
-                    proxy.FindTimeBoundaries(vcTry,fTask,dbNo,*lowestPriorityVrec,resolveByCreationDate,start,end);
+                    if (snapshot) {
+                        snapshot->FindTimeBoundaries(vcTry,fTask,*lowestPriorityVrec,resolveByCreationDate,start,end);
+                    }
+                    else {
+                        proxy.FindTimeBoundaries(vcTry,fTask,dbNo,*lowestPriorityVrec,resolveByCreationDate,start,end);
+                    }
                     DbiDebug("Trimming validity records to "
                              << start << " .. " << end << "  ");
                     std::vector<CP::TDbiValidityRec>::iterator itr(fVRecs.begin()), itrEnd(fVRecs.end());
@@ -210,6 +236,16 @@ CP::TDbiValidityRecBuilder::TDbiValidityRecBuilder(const CP::TDbiDBProxy& proxy,
                     }
                     fGap.AndTimeWindow(start,end);
                 }
+
+//      Nothing is known about rows outside the snapshot so limit
+//      all validity records and the gap to it.
+                if (snapshot) {
+                    std::vector<CP::TDbiValidityRec>::iterator itr(fVRecs.begin()), itrEnd(fVRecs.end());
+                    for (; itr != itrEnd; ++itr) {
+                        itr->AndTimeWindow(snapshot->GetTimeStart(),snapshot->GetTimeEnd());
+                    }
+                    fGap.AndTimeWindow(snapshot->GetTimeStart(),snapshot->GetTimeEnd());
+                }
             }
 
         }
@@ -252,13 +288,16 @@ CP::TDbiValidityRecBuilder::TDbiValidityRecBuilder(const CP::TDbiDBProxy& proxy,
 
     }
 
-// Adjust the time gate if grossly wrong.
+// Record the query statistics and adjust the time gate if grossly wrong.
     if (numTimeWindows > 0) {
-        Int_t timeGateCalc = 3 * fVRecs.size() * sumTimeWindows/numTimeWindows;
-        // Limit to 100 days and allow for overflow.
-        if (timeGateCalc > 100*24*60*60 || timeGateCalc < 0
-           ) {
-            timeGateCalc = 100*24*60*60;
+        CP::TDbiTimeGateStats& stats = CP::TDbiTimeGateStats::gTimeGateStats;
+        stats.RecordQuery(tableName,numVRecIn,fVRecs.size(),sumTimeWindows);
+        Int_t timeGateCalc = stats.SuggestTimeGate(tableName);
+        // Until there are enough statistics, judge by this query alone.
+        if (timeGateCalc <= 0) {
+            Double_t calc = 3. * fVRecs.size() * sumTimeWindows/numTimeWindows;
+            // Limit to 100 days.
+            timeGateCalc = calc > 100*24*60*60 ? 100*24*60*60 : static_cast<Int_t>(calc);
         }
         Int_t timeGateCurr = TDbi::GetTimeGate(tableName);
         if (timeGateCurr < timeGateCalc/10
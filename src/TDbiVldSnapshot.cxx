@@ -0,0 +1,356 @@
+
+#include <algorithm>
+
+#include "DbiDetector.hxx"
+#include "DbiSimFlag.hxx"
+#include "TDbiDBProxy.hxx"
+#include "TDbiInRowStream.hxx"
+#include "TDbiResultSetNonAgg.hxx"
+#include "TDbiVldSnapshot.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
+
+ClassImp(CP::TDbiVldSnapshot)
+
+//   File scope helpers
+//   ******************
+
+namespace {
+
+//  Order indices into a vector of validity records by ascending TIMESTART.
+    class StartTimeOrder {
+    public:
+        StartTimeOrder(const std::vector<CP::TDbiValidityRec>& vrecs) :
+            fVRecs(vrecs) {}
+        bool operator()(UInt_t lhs, UInt_t rhs) const {
+            return fVRecs[lhs].GetVldRange().GetTimeStart()
+                < fVRecs[rhs].GetVldRange().GetTimeStart();
+        }
+    private:
+        const std::vector<CP::TDbiValidityRec>& fVRecs;
+    };
+
+//  Order validity records by descending priority, as TDbiDBProxy's
+//  validity queries do.
+    class PriorityOrder {
+    public:
+        PriorityOrder(Bool_t hasEpoch) : fHasEpoch(hasEpoch) {}
+        bool operator()(const CP::TDbiValidityRec& lhs,
+                        const CP::TDbiValidityRec& rhs) const {
+            if (! fHasEpoch) {
+                return lhs.GetCreationDate() > rhs.GetCreationDate();
+            }
+            if (lhs.GetEpoch() != rhs.GetEpoch()) {
+                return lhs.GetEpoch() > rhs.GetEpoch();
+            }
+            const CP::TVldTimeStamp& lhsStart = lhs.GetVldRange().GetTimeStart();
+            const CP::TVldTimeStamp& rhsStart = rhs.GetVldRange().GetTimeStart();
+            if (lhsStart != rhsStart) {
+                return lhsStart > rhsStart;
+            }
+            return lhs.GetInsertDate() > rhs.GetInsertDate();
+        }
+    private:
+        Bool_t fHasEpoch;
+    };
+
+}
+
+//    Definition of all member functions (static or otherwise)
+//    *******************************************************
+//
+//    -  ordered: ctors, dtor, operators then in alphabetical order.
+
+//.....................................................................
+
+CP::TDbiVldSnapshot::TDbiVldSnapshot(const CP::TDbiDBProxy& proxy,
+                                     UInt_t dbNo,
+                                     const CP::TVldTimeStamp& start,
+                                     const CP::TVldTimeStamp& end) :
+    fDbNo(dbNo),
+    fTableName(proxy.GetTableName()),
+    fTimeStart(start),
+    fTimeEnd(end) {
+//
+//  Purpose:  Constructor
+//
+//  Arguments:
+//    proxy        in    Database proxy for the table.
+//    dbNo         in    Cascade entry to load from.
+//    start        in    Start of time range to load.
+//    end          in    End of time range to load (exclusive).
+//
+//  Specification:-
+//  =============
+//
+//  o Load, with a single query, every VLD row that overlaps the time
+//    range and build the interval index.
+
+    DbiTrace("Creating CP::TDbiVldSnapshot for " << fTableName
+             << " on cascade entry " << dbNo << "  ");
+
+    CP::TDbiInRowStream* rs = proxy.QueryValidityRange(start,end,dbNo);
+    CP::TDbiValidityRec tr;
+    CP::TDbiResultSetNonAgg result(rs,&tr,0,kFALSE);
+    delete rs;
+
+    UInt_t numRows = result.GetNumRows();
+    fVRecs.reserve(numRows);
+    for (UInt_t row = 0; row < numRows; ++row) {
+        const CP::TDbiValidityRec* vr
+            = dynamic_cast<const CP::TDbiValidityRec*>(result.GetTableRow(row));
+        if (vr) {
+            fVRecs.push_back(*vr);
+        }
+    }
+
+    this->BuildIndex();
+
+}
+
+//.....................................................................
+
+CP::TDbiVldSnapshot::TDbiVldSnapshot(const std::string& tableName,
+                                     UInt_t dbNo,
+                                     const CP::TVldTimeStamp& start,
+                                     const CP::TVldTimeStamp& end,
+                                     std::vector<CP::TDbiValidityRec>& vrecs,
+                                     Bool_t hasEpoch) :
+    fDbNo(dbNo),
+    fTableName(tableName),
+    fTimeStart(start),
+    fTimeEnd(end) {
+//
+//  Purpose:  Constructor from rows already read from the database.
+//
+//  Arguments:
+//    tableName    in    Table name.
+//    dbNo         in    Cascade entry the rows came from.
+//    start        in    Start of time range covered.
+//    end          in    End of time range covered (exclusive).
+//    vrecs        in    Every VLD row that overlaps the time range,
+//                       in any order.
+//                 out   Empty (the rows are taken over).
+//    hasEpoch     in    True if the table uses the EPOCH priority scheme.
+//
+//  Specification:-
+//  =============
+//
+//  o Sort the rows into descending priority order and build the interval
+//    index.
+
+    DbiTrace("Creating CP::TDbiVldSnapshot for " << fTableName
+             << " on cascade entry " << dbNo << " from "
+             << vrecs.size() << " rows" << "  ");
+
+    fVRecs.swap(vrecs);
+    std::stable_sort(fVRecs.begin(),fVRecs.end(),PriorityOrder(hasEpoch));
+    this->BuildIndex();
+
+}
+
+//.....................................................................
+
+CP::TDbiVldSnapshot::~TDbiVldSnapshot() {
+//
+//
+//  Purpose: Destructor
+
+    DbiTrace("Destroying CP::TDbiVldSnapshot for " << fTableName << "  ");
+
+}
+
+//.....................................................................
+
+void CP::TDbiVldSnapshot::BuildIndex() {
+//
+//
+//  Purpose:  Build the interval index of the rows.
+
+    UInt_t numVRecs = fVRecs.size();
+    fByStart.resize(numVRecs);
+    for (UInt_t index = 0; index < numVRecs; ++index) {
+        fByStart[index] = index;
+    }
+    std::sort(fByStart.begin(),fByStart.end(),StartTimeOrder(fVRecs));
+
+    fMaxEnd.reserve(numVRecs);
+    for (UInt_t index = 0; index < numVRecs; ++index) {
+        CP::TVldTimeStamp maxEnd
+            = fVRecs[fByStart[index]].GetVldRange().GetTimeEnd();
+        if (index > 0 && fMaxEnd[index-1] > maxEnd) {
+            maxEnd = fMaxEnd[index-1];
+        }
+        fMaxEnd.push_back(maxEnd);
+    }
+
+    DbiLog("Loaded VLD snapshot of " << numVRecs << " rows for table "
+           << fTableName << " from cascade entry " << fDbNo
+           << " covering " << fTimeStart.AsString("s")
+           << " .. " << fTimeEnd.AsString("s") << "  ");
+
+}
+
+//.....................................................................
+
+void CP::TDbiVldSnapshot::FindTimeBoundaries(const CP::TVldContext& vc,
+                                             const TDbi::Task& task,
+                                             const CP::TDbiValidityRec& lowestPriorityVrec,
+                                             Bool_t resolveByCreationDate,
+                                             CP::TVldTimeStamp& start,
+                                             CP::TVldTimeStamp& end) const {
+//
+//
+//  Purpose: Find next time boundaries beyond standard time gate.
+//
+//  Arguments:   See TDbiDBProxy::FindTimeBoundaries.
+//
+//  Specification:-
+//  =============
+//
+//  o Apply the four boundary searches of TDbiDBProxy::FindTimeBoundaries
+//    to the snapshot in a single pass.
+//
+//  Program Notes:-
+//  =============
+//
+//  Rows outside the snapshot were never loaded so the boundaries are
+//  only meaningful within it; the caller must AND in the snapshot
+//  range.
+
+    start = CP::TVldTimeStamp(0,0);
+    end   = CP::TVldTimeStamp(0x7FFFFFFF,0);
+
+    const CP::TVldTimeStamp curVTS = vc.GetTimeStamp();
+    Int_t timeGate = TDbi::GetTimeGate(fTableName);
+    CP::TVldTimeStamp startGate(curVTS.GetSec() - timeGate,0);
+    CP::TVldTimeStamp endGate(curVTS.GetSec() + timeGate,0);
+
+    std::vector<CP::TDbiValidityRec>::const_iterator itr    = fVRecs.begin();
+    std::vector<CP::TDbiValidityRec>::const_iterator itrEnd = fVRecs.end();
+    for (; itr != itrEnd; ++itr) {
+        if (! this->Matches(*itr,vc,task)
+            || ! this->NotLowerPriority(*itr,lowestPriorityVrec,
+                                        resolveByCreationDate)) {
+            continue;
+        }
+        const CP::TVldRange& range = itr->GetVldRange();
+        const CP::TVldTimeStamp& ts = range.GetTimeStart();
+        const CP::TVldTimeStamp& te = range.GetTimeEnd();
+        if (ts > endGate   && ts < end)   end   = ts;
+        if (te > endGate   && te < end)   end   = te;
+        if (ts < startGate && ts > start) start = ts;
+        if (te < startGate && te > start) start = te;
+    }
+
+    DbiTrace("FindTimeBoundaries (snapshot) for table " << fTableName
+             << " found " << start << " .. " << end << "  ");
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiVldSnapshot::Matches(const CP::TDbiValidityRec& vrec,
+                                    const CP::TVldContext& vc,
+                                    const TDbi::Task& task) const {
+//
+//
+//  Purpose: Return true if vrec passes the detector, SimFlag and task
+//           selection of a validity query.
+
+    const CP::TVldRange& range = vrec.GetVldRange();
+    return (range.GetDetectorMask() & static_cast<unsigned int>(vc.GetDetector()))
+        && (range.GetSimMask()      & static_cast<unsigned int>(vc.GetSimFlag()))
+        && (task == TDbi::kAnyTask  || vrec.GetTask() == task);
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiVldSnapshot::NotLowerPriority(const CP::TDbiValidityRec& vrec,
+                                             const CP::TDbiValidityRec& lowestPriorityVrec,
+                                             Bool_t resolveByCreationDate) const {
+//
+//
+//  Purpose: Apply the (simplified) priority cut of
+//           TDbiDBProxy::FindTimeBoundaries.
+
+    if (resolveByCreationDate) {
+        return vrec.GetCreationDate() >= lowestPriorityVrec.GetCreationDate();
+    }
+    return vrec.GetEpoch() >= lowestPriorityVrec.GetEpoch();
+
+}
+
+//.....................................................................
+
+void CP::TDbiVldSnapshot::QueryValidity(const CP::TVldContext& vc,
+                                        const TDbi::Task& task,
+                                        std::vector<const CP::TDbiValidityRec*>& vrecs) const {
+//
+//
+//  Purpose:  Apply validity query to the snapshot.
+//
+//  Arguments:
+//    vc           in    The Validity Context for the query.
+//    task         in    The task of the query.
+//    vrecs        out   Matching rows in descending priority order.
+//
+//  Specification:-
+//  =============
+//
+//  o Select the rows that TDbiDBProxy::QueryValidity would: those that
+//    overlap the time gate round the context time and match its
+//    detector, SimFlag and task.
+//
+//  Program Notes:-
+//  =============
+//
+//  fByStart is searched for the last row that starts before the end of
+//  the gate and then scanned backwards until fMaxEnd shows that no
+//  earlier row can reach the start of the gate.
+
+    vrecs.clear();
+
+    const CP::TVldTimeStamp curVTS = vc.GetTimeStamp();
+    Int_t timeGate = TDbi::GetTimeGate(fTableName);
+    CP::TVldTimeStamp startGate(curVTS.GetSec() - timeGate,0);
+    CP::TVldTimeStamp endGate(curVTS.GetSec() + timeGate,0);
+
+//  Binary search for the first row that starts after the end of the gate.
+    UInt_t lo = 0;
+    UInt_t hi = fByStart.size();
+    while (lo < hi) {
+        UInt_t mid = (lo + hi)/2;
+        if (fVRecs[fByStart[mid]].GetVldRange().GetTimeStart() <= endGate) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    std::vector<UInt_t> selected;
+    for (UInt_t index = lo; index > 0 && fMaxEnd[index-1] > startGate; --index) {
+        UInt_t recNo = fByStart[index-1];
+        const CP::TDbiValidityRec& vrec = fVRecs[recNo];
+        if (vrec.GetVldRange().GetTimeEnd() > startGate
+            && this->Matches(vrec,vc,task)) {
+            selected.push_back(recNo);
+        }
+    }
+
+//  Restore priority order.
+    std::sort(selected.begin(),selected.end());
+    vrecs.reserve(selected.size());
+    for (std::vector<UInt_t>::const_iterator itr = selected.begin();
+         itr != selected.end();
+         ++itr) {
+        vrecs.push_back(&fVRecs[*itr]);
+    }
+
+    DbiTrace("Snapshot query for table " << fTableName
+             << " context " << vc << " selected " << vrecs.size()
+             << " of " << fVRecs.size() << " rows" << "  ");
+
+}
@@ -0,0 +1,140 @@
+#ifndef DBIVLDSNAPSHOT_H
+#define DBIVLDSNAPSHOT_H
+
+/**
+ *
+ * \class CP::TDbiVldSnapshot
+ *
+ *
+ * \brief
+ * <b>Concept</b> An in-memory copy of the rows of one *VLD table on one
+ *  cascade entry, restricted to a fixed time range.
+ *
+ * \brief
+ * <b>Purpose</b> To allow TDbiValidityRecBuilder to resolve context
+ *  queries locally, without sending time gated validity queries to the
+ *  server.  Intended for reprocessing passes over a fixed run range where
+ *  the validity tables are small and static.  Once loaded, the only
+ *  database traffic needed for a context query is the secondary
+ *  (TDbiDBProxy::QuerySeqNos) query for the data itself.
+ *
+ * \brief
+ * <b>Usage Notes</b> Snapshot mode is enabled through TDbiDatabaseManager
+ *  configuration:-
+ *
+ *   VldSnapshot       = 1     Enable snapshot mode
+ *   VldSnapshotStart  = "yyyy-mm-dd hh:mm:ss"  Optional start of range
+ *   VldSnapshotEnd    = "yyyy-mm-dd hh:mm:ss"  Optional end of range
+ *
+ *  Queries whose time lies outside the range fall back to the database
+ *  and results from the snapshot never extend beyond it.
+ *
+ */
+
+#include "TDbi.hxx"
+#include "TDbiValidityRec.hxx"
+#include "TVldContext.hxx"
+#include "TVldTimeStamp.hxx"
+
+#include <string>
+#include <vector>
+
+namespace CP {
+    class TDbiDBProxy;
+
+    class TDbiVldSnapshot {
+
+    public:
+
+// Constructors and destructors.
+        TDbiVldSnapshot(const TDbiDBProxy& proxy,
+                        UInt_t dbNo,
+                        const CP::TVldTimeStamp& start,
+                        const CP::TVldTimeStamp& end);
+/// Take over rows read elsewhere (see TDbiDatabaseManager::Prefetch).
+        TDbiVldSnapshot(const std::string& tableName,
+                        UInt_t dbNo,
+                        const CP::TVldTimeStamp& start,
+                        const CP::TVldTimeStamp& end,
+                        std::vector<TDbiValidityRec>& vrecs,
+                        Bool_t hasEpoch);
+        virtual ~TDbiVldSnapshot();
+
+// State testing member functions
+        Bool_t Covers(const CP::TVldTimeStamp& ts) const {
+            return ts >= fTimeStart && ts < fTimeEnd;
+        }
+        UInt_t GetDbNo() const {
+            return fDbNo;
+        }
+        UInt_t GetNumRows() const {
+            return fVRecs.size();
+        }
+        const CP::TVldTimeStamp& GetTimeEnd() const {
+            return fTimeEnd;
+        }
+        const CP::TVldTimeStamp& GetTimeStart() const {
+            return fTimeStart;
+        }
+
+/// Local equivalent of TDbiDBProxy::QueryValidity(vc,task,dbNo).
+/// Fills vrecs with the matching rows in descending priority order.
+        void QueryValidity(const CP::TVldContext& vc,
+                           const TDbi::Task& task,
+                           std::vector<const TDbiValidityRec*>& vrecs) const;
+
+/// Local equivalent of TDbiDBProxy::FindTimeBoundaries.  Rows outside
+/// the snapshot are unknown so callers must also limit to its range.
+        void FindTimeBoundaries(const CP::TVldContext& vc,
+                                const TDbi::Task& task,
+                                const TDbiValidityRec& lowestPriorityVrec,
+                                Bool_t resolveByCreationDate,
+                                CP::TVldTimeStamp& start,
+                                CP::TVldTimeStamp& end) const;
+
+    private:
+
+// Disabled (not implemented) copy constructor and asignment.
+
+        TDbiVldSnapshot(const TDbiVldSnapshot&);
+        CP::TDbiVldSnapshot& operator=(const CP::TDbiVldSnapshot&);
+
+        void BuildIndex();
+        Bool_t Matches(const TDbiValidityRec& vrec,
+                       const CP::TVldContext& vc,
+                       const TDbi::Task& task) const;
+        Bool_t NotLowerPriority(const TDbiValidityRec& vrec,
+                                const TDbiValidityRec& lowestPriorityVrec,
+                                Bool_t resolveByCreationDate) const;
+
+// Data members
+
+/// Cascade entry the snapshot was taken from.
+        UInt_t fDbNo;
+
+/// Table name (for diagnostics only).
+        std::string fTableName;
+
+/// Time range covered by the snapshot.
+        CP::TVldTimeStamp fTimeStart;
+        CP::TVldTimeStamp fTimeEnd;
+
+/// All VLD rows in descending priority order (i.e. the order in which
+/// TDbiDBProxy::QueryValidity would deliver them).
+        std::vector<TDbiValidityRec> fVRecs;
+
+/// Interval index: indices into fVRecs sorted by ascending TIMESTART ...
+        std::vector<UInt_t> fByStart;
+
+/// ... and, for each entry in fByStart, the maximum TIMEEND of it and of
+/// all its predecessors.  This bounds the backward scan of an overlap
+/// search.
+        std::vector<CP::TVldTimeStamp> fMaxEnd;
+
+        ClassDef(TDbiVldSnapshot,0)     // In-memory VLD table snapshot.
+
+    };
+};
+
+#endif  // DBIVLDSNAPSHOT_H
+
@@ -41,6 +41,7 @@ namespace CP {
     class TDbiSqlValPacket;
     class TDbiTableProxy;
     class TDbiValidityRec;
+    class TDbiWriterSession;
 }
 
 namespace CP {
@@ -76,6 +77,10 @@ namespace CP {
 // State testing member functions
 
         UInt_t GetEpoch() const;
+        /// Number of sets found identical to one already stored.
+        UInt_t GetNumDuplicates() const {
+            return fNumDuplicates;
+        }
         TDbiTableProxy& TableProxy() const;
 
 ///    Open and ready to receive data.
@@ -85,6 +90,14 @@ namespace CP {
 
 // State changing member functions
 
+        /// Before writing each set to the database look up its fingerprint
+        /// (see TDbiSqlValPacket::GetFingerprint) and report it if identical
+        /// to a set already stored, skipping it if skip.  The fingerprints
+        /// of sets written are recorded.
+        void SetCheckDuplicates(Bool_t skip = kTRUE) {
+            fCheckDuplicates = kTRUE;
+            fSkipDuplicates  = skip;
+        }
         void SetDbNo(UInt_t dbNo) {
             fDbNo = dbNo;
         }
@@ -98,6 +111,11 @@ namespace CP {
         void SetOverlayCreationDate() {
             fUseOverlayCreationDate = kTRUE;
         }
+        /// Hand closed sets to session for committing in a batch (0 to
+        /// write them on Close).  The session is not owned.
+        void SetSession(TDbiWriterSession* session) {
+            fSession = session;
+        }
 
 //  I/O functions
         void Abort() {
@@ -129,6 +147,7 @@ namespace CP {
 
 // State testing member functions
 
+        Bool_t IsDuplicate();
         Bool_t NeedsLogEntry() const;
         Bool_t WritingToMaster() const;
 
@@ -149,15 +168,27 @@ namespace CP {
 /// Aggregate noumber for set.
         Int_t fAggregateNo;
 
+/// Look up fingerprints of sets before writing them if true.
+        Bool_t fCheckDuplicates;
+
 ///Database number in cascade
         UInt_t fDbNo;
 
+/// Number of sets found to be duplicates.
+        UInt_t fNumDuplicates;
+
 /// The assembled record to be output. Never null.
         TDbiSqlValPacket* fPacket;
 
 /// Controls SEQNO type (see TDbiCascader::AllocateSeqNo)
         Int_t fRequireGlobalSeqno;
 
+/// Session committing closed sets or 0 if written on Close. Not owned.
+        TDbiWriterSession* fSession;
+
+/// Don't write sets found to be duplicates if true.
+        Bool_t fSkipDuplicates;
+
 /// Proxy to associated table.
         TDbiTableProxy* fTableProxy;
 
@@ -14,6 +14,8 @@
 #include "TDbiSqlValPacket.hxx"
 #include "TDbiTableProxy.hxx"
 #include "TDbiWriter.hxx"
+#include "TDbiWriterSession.hxx"
+#include "TSeqNoAllocator.hxx"
 #include <TDbiLog.hxx>
 #include <MsgFormat.hxx>
 
@@ -34,9 +36,13 @@ ClassImpT(CP::TDbiWriter,T)
 template<class T>
 CP::TDbiWriter<T>::TDbiWriter() :
 fAggregateNo(-2),
+    fCheckDuplicates(kFALSE),
     fDbNo(0),
+    fNumDuplicates(0),
     fPacket(new CP::TDbiSqlValPacket),
     fRequireGlobalSeqno(0),
+    fSession(0),
+    fSkipDuplicates(kFALSE),
     fTableProxy(&CP::TDbiWriter<T>::GetTableProxy()),
     fTableName(fTableProxy->GetTableName()),
     fUseOverlayCreationDate(kFALSE),
@@ -74,9 +80,13 @@ CP::TDbiWriter<T>::TDbiWriter(const CP::TVldRange& vr,
                               const std::string& logComment,
                               const std::string& tableName) :
     fAggregateNo(aggNo),
+    fCheckDuplicates(kFALSE),
     fDbNo(dbNo),
+    fNumDuplicates(0),
     fPacket(new CP::TDbiSqlValPacket),
     fRequireGlobalSeqno(0),
+    fSession(0),
+    fSkipDuplicates(kFALSE),
     fTableProxy(&CP::TDbiWriter<T>::GetTableProxy(tableName)),
     fTableName(fTableProxy->GetTableName()),
     fUseOverlayCreationDate(creationDate == CP::TVldTimeStamp(0,0)),
@@ -129,8 +139,12 @@ CP::TDbiWriter<T>::TDbiWriter(const CP::TVldRange& vr,
                               const std::string& logComment,
                               const std::string& tableName) :
     fAggregateNo(aggNo),
+    fCheckDuplicates(kFALSE),
+    fNumDuplicates(0),
     fPacket(new CP::TDbiSqlValPacket),
     fRequireGlobalSeqno(0),
+    fSession(0),
+    fSkipDuplicates(kFALSE),
     fTableProxy(&CP::TDbiWriter<T>::GetTableProxy(tableName)),
     fTableName(fTableProxy->GetTableName()),
     fUseOverlayCreationDate(creationDate == CP::TVldTimeStamp(0,0)),
@@ -179,9 +193,13 @@ CP::TDbiWriter<T>::TDbiWriter(const CP::TDbiValidityRec& vrec,
                               UInt_t dbNo,
                               const std::string& logComment) :
     fAggregateNo(0),
+    fCheckDuplicates(kFALSE),
     fDbNo(dbNo),
+    fNumDuplicates(0),
     fPacket(new CP::TDbiSqlValPacket),
     fRequireGlobalSeqno(0),
+    fSession(0),
+    fSkipDuplicates(kFALSE),
     fTableProxy(0),
     fUseOverlayCreationDate(kFALSE),
     fValidRec(new CP::TDbiValidityRec(vrec)),
@@ -228,9 +246,12 @@ CP::TDbiWriter<T>::TDbiWriter(const CP::TDbiValidityRec& vrec,
                               const std::string& dbName,
                               const std::string& logComment) :
     fAggregateNo(0),
-
+    fCheckDuplicates(kFALSE),
+    fNumDuplicates(0),
     fPacket(new CP::TDbiSqlValPacket),
     fRequireGlobalSeqno(0),
+    fSession(0),
+    fSkipDuplicates(kFALSE),
     fTableProxy(0),
     fUseOverlayCreationDate(kFALSE),
     fValidRec(new CP::TDbiValidityRec(vrec)),
@@ -406,6 +427,14 @@ Bool_t CP::TDbiWriter<T>::Close(const char* fileSpec) {
 //  =============
 //
 //  o Close current validity set and write it to the database.
+//
+//  o If the writer belongs to a TDbiWriterSession (and fileSpec is null)
+//    just hand the set over to the session, which allocates its SEQNO
+//    and writes it on TDbiWriterSession::Commit.
+//
+//  o If checking for duplicates (and fileSpec is null) look up the set's
+//    fingerprint and, if a set with the same content is already stored
+//    and duplicates are skipped, don't write it again.
 
 //  Program Notes:-
 //  =============
@@ -416,13 +445,36 @@ Bool_t CP::TDbiWriter<T>::Close(const char* fileSpec) {
 
     // Skip output unless good data to output.
 
-    if ( CanOutput() ) {
+    if ( CanOutput() && fCheckDuplicates && ! fileSpec
+         && this->IsDuplicate() && fSkipDuplicates ) {
+        ok = kTRUE;
+    }
+
+    else if ( CanOutput() && fSession && ! fileSpec ) {
+
+        //  Use overlay creation date if required, resolved by the session
+        //  so that sets of adjacent ranges share its cached records.
+        if ( fUseOverlayCreationDate &&  fValidRec) {
+            fPacket->SetCreationDate(
+                fSession->GetOverlayCreationDate(*fTableProxy,*fValidRec,fDbNo));
+        }
+
+        //  Pass the set, and its log entry if required, to the session.
+        Bool_t needsLog = this->WritingToMaster()
+                          && ( this->NeedsLogEntry() || fLogEntry.HasReason() );
+        ok = fSession->Add(fPacket,fDbNo,fRequireGlobalSeqno,
+                           needsLog ? &fLogEntry : 0,fCheckDuplicates);
+        fPacket = new CP::TDbiSqlValPacket;
+    }
+
+    else if ( CanOutput() ) {
 
         //  Find the next free sequence number.  It must be global if writing
         //  to a to a file, otherwise it can be local if DB isn't authorising.
+        //  The allocator may hand it out from a block already reserved.
         int seqNoType = fileSpec ? 1 : fRequireGlobalSeqno;
         Int_t seqNo
-            = fTableProxy->GetCascader().AllocateSeqNo(
+            = CP::TDbiDatabaseManager::Instance().GetSeqNoAllocator().GetSeqNo(
                 fTableName,seqNoType,fDbNo);
         if ( seqNo <= 0 ) {
             DbiSevere(  "Cannot get sequence number for table "
@@ -446,6 +498,10 @@ Bool_t CP::TDbiWriter<T>::Close(const char* fileSpec) {
             }
             else {
                 ok = fPacket->Store(fDbNo);
+                if ( ok && fCheckDuplicates ) {
+                    fTableProxy->GetDBProxy().StoreFingerprint(
+                        seqNo,fPacket->GetFingerprint(),fDbNo);
+                }
             }
 
             //  Record update if I/O successful and required.
@@ -565,6 +621,33 @@ CP::TDbiTableProxy& CP::TDbiWriter<T>::GetTableProxy(
 }
 //.....................................................................
 
+template<class T>
+Bool_t CP::TDbiWriter<T>::IsDuplicate() {
+//
+//
+//  Purpose:  Return true if a set identical to the current one is
+//            already stored (see SetCheckDuplicates).
+//
+//  Program Notes:-
+//  =============
+//
+//  Sets closed earlier into the same TDbiWriterSession are not yet
+//  stored so are not found.
+
+    UInt_t seqNo = fTableProxy->GetDBProxy()
+        .QueryFingerprint(fPacket->GetFingerprint(),fDbNo);
+    if ( ! seqNo ) return kFALSE;
+
+    ++fNumDuplicates;
+    DbiWarn( "Validity set for " << fTableName
+             << " is identical to SEQNO " << seqNo
+             << ( fSkipDuplicates ? "; not written again" : "; writing anyway" )
+             << "  ");
+    return kTRUE;
+}
+
+//.....................................................................
+
 template<class T>
 Bool_t CP::TDbiWriter<T>::IsOpen(Bool_t reportErrors) const {
 //
@@ -0,0 +1,490 @@
+
+#include <map>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+#include "TStopwatch.h"
+
+#include "TDbiCascader.hxx"
+#include "TDbiConfigSet.hxx"
+#include "TDbiDBProxy.hxx"
+#include "TDbiDatabaseManager.hxx"
+#include "TDbiLogEntry.hxx"
+#include "TDbiSqlValPacket.hxx"
+#include "TDbiStatement.hxx"
+#include "TDbiTableProxy.hxx"
+#include "TDbiWriterSession.hxx"
+#include "TSeqNoAllocator.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
+
+ClassImp(CP::TDbiWriterSession)
+
+//   Definition of static data members
+//   *********************************
+
+
+//    Definition of all member functions (static or otherwise)
+//    *******************************************************
+//
+//    -  ordered: ctors, dtor, operators then in alphabetical order.
+
+//.....................................................................
+
+CP::TDbiWriterSession::TDbiWriterSession(const std::string& logComment) :
+    fLogComment(logComment),
+    fNumCommitted(0),
+    fSetsPerSec(0.) {
+//
+//
+//  Purpose:  Constructor
+//
+//  Arguments:
+//    logComment   in    Reason for log entries of writers without one.
+
+    DbiTrace("Creating CP::TDbiWriterSession" << "  ");
+
+}
+
+//.....................................................................
+
+CP::TDbiWriterSession::~TDbiWriterSession() {
+//
+//
+//  Purpose: Destructor
+
+    DbiTrace("Destroying CP::TDbiWriterSession" << "  ");
+
+    if (! fPending.empty()) {
+        DbiWarn("Discarding " << fPending.size()
+                << " validity sets that were never committed" << "  ");
+    }
+    this->Abort();
+
+}
+
+//.....................................................................
+
+void CP::TDbiWriterSession::Abort() {
+//
+//
+//  Purpose:  Discard all sets not yet committed.
+//
+//  Program Notes:-
+//  =============
+//
+//  The overlay caches count the discarded sets as closed in the session
+//  so, as after a failed Commit, they are dropped too.
+
+    if (! fPending.empty()) {
+        fOverlayCaches.clear();
+    }
+    this->DiscardPending();
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiWriterSession::Add(CP::TDbiSqlValPacket* packet,
+                                  UInt_t dbNo,
+                                  Int_t requireGlobal,
+                                  const CP::TDbiLogEntry* logEntry,
+                                  Bool_t recordFingerprint) {
+//
+//
+//  Purpose:  Take ownership of a closed set.
+//
+//  Arguments:
+//    packet       in    The set, with all rows but no SEQNO.
+//    dbNo         in    Cascade entry to store it in.
+//    requireGlobal in   SEQNO type (see TDbiCascader::AllocateSeqNo).
+//    logEntry     in    Writer's log entry if the set must be logged,
+//                       otherwise 0.
+//    recordFingerprint in  Record the set's fingerprint once stored.
+//
+//  Return:    kTRUE if the set was accepted.
+
+    if (! packet) {
+        return kFALSE;
+    }
+    if (packet->GetNumErrors() || packet->GetNumSqlStmts() == 0) {
+        DbiSevere("Cannot add validity set for table "
+                  << packet->GetTableName() << " to session" << "  ");
+        delete packet;
+        return kFALSE;
+    }
+
+    Pending set;
+    set.fPacket        = packet;
+    set.fDbNo          = dbNo;
+    set.fRequireGlobal = requireGlobal;
+    set.fRecordFingerprint = recordFingerprint;
+    if (logEntry) {
+        set.fNeedsLog = kTRUE;
+        set.fReason   = logEntry->HasReason() ? logEntry->GetReason()
+                                              : fLogComment;
+        set.fDetMask  = logEntry->GetDetectorMask();
+        set.fSimMask  = logEntry->GetSimMask();
+        set.fTask     = logEntry->GetTask();
+    }
+    fPending.push_back(set);
+    return kTRUE;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiWriterSession::Commit() {
+//
+//
+//  Purpose:  Store all sets and return true if all succeeded.
+//
+//  Specification:-
+//  =============
+//
+//  o Commit the sets of each cascade entry independently (see
+//    CommitEntry) so that a failure in one does not prevent the others.
+//
+//  o Discard all sets, stored or not, so the session can be reused.
+
+    if (fPending.empty()) {
+        return kTRUE;
+    }
+
+    std::map<UInt_t,std::vector<UInt_t> > entrySets;
+    for (UInt_t set = 0; set < fPending.size(); ++set) {
+        entrySets[fPending[set].fDbNo].push_back(set);
+    }
+
+    TStopwatch timer;
+    Bool_t ok = kTRUE;
+    UInt_t numStored = 0;
+    for (std::map<UInt_t,std::vector<UInt_t> >::const_iterator itr
+             = entrySets.begin();
+         itr != entrySets.end();
+         ++itr) {
+        if (this->CommitEntry(itr->first,itr->second)) {
+            numStored += itr->second.size();
+            this->RecordFingerprints(itr->first,itr->second);
+            this->WriteLogEntries(itr->first,itr->second);
+        }
+        else {
+            ok = kFALSE;
+        }
+    }
+    timer.Stop();
+
+    fNumCommitted += numStored;
+    fSetsPerSec = timer.RealTime() > 0. ? numStored/timer.RealTime() : 0.;
+    if (! ok) {
+        // Overlay caches may hold sets that were not stored.
+        fOverlayCaches.clear();
+    }
+    DbiInfo("Committed " << numStored << " of " << fPending.size()
+            << " validity sets to " << entrySets.size()
+            << " cascade entries in " << timer.RealTime() << " secs ("
+            << fSetsPerSec << " sets/sec)" << "  ");
+
+    this->DiscardPending();
+    return ok;
+
+}
+
+//.....................................................................
+
+Bool_t CP::TDbiWriterSession::CommitEntry(UInt_t dbNo,
+                                          const std::vector<UInt_t>& sets) {
+//
+//
+//  Purpose:  Store the sets of a single cascade entry.
+//
+//  Arguments:
+//    dbNo         in    Cascade entry.
+//    sets         in    Indices into fPending of its sets.
+//
+//  Return:    kTRUE if all stored.
+//
+//  Specification:-
+//  =============
+//
+//  o Reserve one block of SEQNOs for each table and SEQNO type.
+//
+//  o Store all the sets in one transaction, rolled back, and the blocks
+//    returned, if any fails.
+
+    typedef std::pair<std::string,Int_t> Key;
+    std::map<Key,std::vector<UInt_t> > tableSets;
+    for (UInt_t index = 0; index < sets.size(); ++index) {
+        const Pending& set = fPending[sets[index]];
+        tableSets[Key(set.fPacket->GetTableName(),set.fRequireGlobal)]
+            .push_back(sets[index]);
+    }
+
+    CP::TDbiDatabaseManager& dbm = CP::TDbiDatabaseManager::Instance();
+    CP::TDbiCascader& cascader = dbm.GetCascader();
+
+    // Reserve and assign SEQNOs.
+    std::vector<std::pair<Key,Int_t> > blocks;
+    Bool_t ok = kTRUE;
+    for (std::map<Key,std::vector<UInt_t> >::const_iterator itr
+             = tableSets.begin();
+         ok && itr != tableSets.end();
+         ++itr) {
+        const std::vector<UInt_t>& tblSets = itr->second;
+        Int_t first = dbm.GetSeqNoAllocator()
+            .ReserveSeqNos(itr->first.first,tblSets.size(),
+                           itr->first.second,dbNo);
+        if (first <= 0) {
+            DbiSevere("Cannot get " << tblSets.size()
+                      << " sequence numbers for table "
+                      << itr->first.first << "  ");
+            ok = kFALSE;
+            break;
+        }
+        blocks.push_back(std::make_pair(itr->first,first));
+        for (UInt_t index = 0; index < tblSets.size(); ++index) {
+            fPending[tblSets[index]].fPacket->SetSeqNo(first+index);
+        }
+    }
+
+    // Store all sets in a single transaction.
+    std::unique_ptr<CP::TDbiStatement> stmtDb;
+    if (ok) {
+        stmtDb.reset(cascader.CreateStatement(dbNo));
+        if (! stmtDb.get()) {
+            DbiWarn("Attempting to write to non-existant cascade entry "
+                    << dbNo << "  ");
+            ok = kFALSE;
+        }
+    }
+    if (ok) {
+        stmtDb->StartTransaction();
+        ok = ! stmtDb->PrintExceptions();
+    }
+    for (UInt_t index = 0; ok && index < sets.size(); ++index) {
+        ok = fPending[sets[index]].fPacket->Store(*stmtDb);
+    }
+    if (ok) {
+        stmtDb->Commit();
+        ok = ! stmtDb->PrintExceptions();
+    }
+    else if (stmtDb.get()) {
+        stmtDb->Rollback();
+        stmtDb->PrintExceptions();
+    }
+    if (ok) {
+        return kTRUE;
+    }
+
+    DbiSevere("Failed to store " << sets.size()
+              << " validity sets in cascade entry " << dbNo
+              << "; rolled back" << "  ");
+    for (UInt_t block = 0; block < blocks.size(); ++block) {
+        const Key& key = blocks[block].first;
+        Int_t first = blocks[block].second;
+        Int_t last  = first + tableSets[key].size() - 1;
+        if (! cascader.ReleaseSeqNos(key.first,first,last,dbNo)) {
+            DbiWarn("SEQNOs " << first << ".." << last << " reserved for "
+                    << key.first << " were not used and cannot be returned"
+                    << "  ");
+        }
+    }
+    return kFALSE;
+
+}
+
+//.....................................................................
+
+void CP::TDbiWriterSession::DiscardPending() {
+//
+//
+//  Purpose:  Delete the sets waiting to be committed.
+
+    for (UInt_t set = 0; set < fPending.size(); ++set) {
+        delete fPending[set].fPacket;
+    }
+    fPending.clear();
+
+}
+
+//.....................................................................
+
+CP::TVldTimeStamp CP::TDbiWriterSession::GetOverlayCreationDate(CP::TDbiTableProxy& proxy,
+                                                                const CP::TDbiValidityRec& vrec,
+                                                                UInt_t dbNo) {
+//
+//
+//  Purpose:  Return the overlay creation date for a set being closed.
+//
+//  Arguments:
+//    proxy        in    Proxy of the set's table.
+//    vrec         in    Validity record of the set.
+//    dbNo         in    Cascade entry it is to be written to.
+//
+//  Specification:-
+//  =============
+//
+//  o Find the highest priority record covering the set's start time
+//    among those cached for its aggregate, loading them for a window from
+//    the start time if it lies outside the one already loaded, and those
+//    closed earlier in the session.
+//
+//  o Add the set, with its overlay creation date, to those closed.
+
+    const CP::TVldRange& vr(vrec.GetVldRange());
+    const CP::TVldTimeStamp& start(vr.GetTimeStart());
+
+    std::ostringstream key;
+    key << proxy.GetTableName() << ":" << dbNo << ":" << vrec.GetTask()
+        << ":" << vrec.GetAggregateNo() << ":" << vr.GetDetectorMask()
+        << ":" << vr.GetSimMask();
+    OverlayCache& cache = fOverlayCaches[key.str()];
+
+    if (! cache.fLoaded || start < cache.fStart || ! (start < cache.fEnd)) {
+        Int_t timeGate = TDbi::GetTimeGate(proxy.GetTableName());
+        cache.fLoaded = kTRUE;
+        cache.fStart = start;
+        cache.fEnd   = CP::TVldTimeStamp(start.GetSec() + timeGate,0);
+        proxy.QueryOverlayValidities(vrec,dbNo,cache.fStart,cache.fEnd,
+                                     kFALSE,cache.fVRecs);
+        DbiVerbose("Cached " << cache.fVRecs.size()
+                   << " overlay candidates for " << key.str() << " from "
+                   << cache.fStart.AsString("s") << "  ");
+    }
+
+    Bool_t resolveByCreationDate = ! proxy.GetDBProxy().HasEpoch();
+    const CP::TDbiValidityRec* best = 0;
+    for (Int_t list = 0; list < 2; ++list) {
+        const std::vector<CP::TDbiValidityRec>& vrecs
+            = list ? cache.fClosed : cache.fVRecs;
+        for (UInt_t index = 0; index < vrecs.size(); ++index) {
+            const CP::TDbiValidityRec& candidate = vrecs[index];
+            const CP::TVldRange& range = candidate.GetVldRange();
+            if (start < range.GetTimeStart() || ! (start < range.GetTimeEnd())) {
+                continue;
+            }
+            if (! best || candidate.IsHigherPriority(*best,resolveByCreationDate)) {
+                best = &candidate;
+            }
+        }
+    }
+    CP::TVldTimeStamp creationDate
+        = CP::TDbiTableProxy::MakeOverlayCreationDate(vrec,best);
+
+    CP::TDbiValidityRec closed(vr,vrec.GetTask(),vrec.GetAggregateNo(),0,
+                               dbNo,kFALSE,creationDate,vrec.GetEpoch());
+    closed.SetInsertDate(CP::TVldTimeStamp());
+    cache.fClosed.push_back(closed);
+
+    return creationDate;
+
+}
+
+//.....................................................................
+
+UInt_t CP::TDbiWriterSession::GetNumPending() const {
+//
+//
+//  Purpose:  Return the number of sets waiting to be committed.
+
+    return fPending.size();
+
+}
+
+//.....................................................................
+
+void CP::TDbiWriterSession::RecordFingerprints(UInt_t dbNo,
+                                               const std::vector<UInt_t>& sets) {
+//
+//
+//  Purpose:  Record the fingerprints of committed sets that need them.
+//
+//  Arguments:
+//    dbNo         in    Cascade entry.
+//    sets         in    Indices into fPending of its (committed) sets.
+
+    CP::TDbiDatabaseManager& dbm = CP::TDbiDatabaseManager::Instance();
+    for (UInt_t index = 0; index < sets.size(); ++index) {
+        const Pending& set = fPending[sets[index]];
+        if (! set.fRecordFingerprint) {
+            continue;
+        }
+        CP::TDbiConfigSet pet;
+        const CP::TDbiDBProxy& proxy
+            = dbm.GetTableProxy(set.fPacket->GetTableName(),&pet).GetDBProxy();
+        proxy.StoreFingerprint(set.fPacket->GetSeqNo(),
+                               set.fPacket->GetFingerprint(),dbNo);
+    }
+
+}
+
+//.....................................................................
+
+void CP::TDbiWriterSession::WriteLogEntries(UInt_t dbNo,
+                                            const std::vector<UInt_t>& sets) {
+//
+//
+//  Purpose:  Write one log entry for each table and SEQNO type (local
+//            or global) of committed sets that need one.
+//
+//  Arguments:
+//    dbNo         in    Cascade entry.
+//    sets         in    Indices into fPending of its (committed) sets.
+//
+//  Program Notes:-
+//  =============
+//
+//  Local and global SEQNOs are allocated from separate ranges so a
+//  single min..max range across both would span SEQNOs of other jobs.
+
+    typedef std::pair<std::string,Bool_t> TableSeqNoType;
+    std::map<TableSeqNoType,std::vector<UInt_t> > tableSets;
+    for (UInt_t index = 0; index < sets.size(); ++index) {
+        const Pending& set = fPending[sets[index]];
+        if (set.fNeedsLog) {
+            TableSeqNoType key(set.fPacket->GetTableName(),
+                               TDbi::NotGlobalSeqNo(set.fPacket->GetSeqNo()));
+            tableSets[key].push_back(sets[index]);
+        }
+    }
+
+    for (std::map<TableSeqNoType,std::vector<UInt_t> >::const_iterator itr
+             = tableSets.begin();
+         itr != tableSets.end();
+         ++itr) {
+        const std::vector<UInt_t>& tblSets = itr->second;
+        const Pending& firstSet = fPending[tblSets.front()];
+        Int_t seqNoMin = firstSet.fPacket->GetSeqNo();
+        Int_t seqNoMax = seqNoMin;
+        Int_t detMask  = 0;
+        Int_t simMask  = 0;
+        for (UInt_t index = 0; index < tblSets.size(); ++index) {
+            const Pending& set = fPending[tblSets[index]];
+            Int_t seqNo = set.fPacket->GetSeqNo();
+            if (seqNo < seqNoMin) {
+                seqNoMin = seqNo;
+            }
+            if (seqNo > seqNoMax) {
+                seqNoMax = seqNo;
+            }
+            detMask |= set.fDetMask;
+            simMask |= set.fSimMask;
+        }
+        const std::string& tableName = itr->first.first;
+        CP::TDbiLogEntry logEntry(tableName,
+                                  firstSet.fReason,
+                                  detMask,
+                                  simMask,
+                                  firstSet.fTask,
+                                  seqNoMin,
+                                  seqNoMax,
+                                  tblSets.size());
+        if (! logEntry.Write(dbNo)) {
+            DbiWarn("Failed to write log entry for " << tblSets.size()
+                    << " validity sets of " << tableName << "  ");
+        }
+    }
+
+}
+
@@ -0,0 +1,181 @@
+#ifndef DBIWRITERSESSION_H
+#define DBIWRITERSESSION_H
+
+/**
+ *
+ * \class CP::TDbiWriterSession
+ *
+ *
+ * \brief
+ * <b>Concept</b> A collection of validity sets closed by any number of
+ *  TDbiWriters, of any tables, that are committed together.
+ *
+ * \brief
+ * <b>Purpose</b> To let producers that fill many writers, typically one
+ *  per table, pay the per set costs of writing once per batch: one SEQNO
+ *  block per table, one transaction per cascade entry and one log entry
+ *  per table and SEQNO type.
+ *
+ * \brief
+ * <b>Usage Notes</b>
+ *
+ *  CP::TDbiWriterSession session("Calibration pass 3");
+ *  CP::TDbiWriter<MyRowA> writerA(...);
+ *  CP::TDbiWriter<MyRowB> writerB(...);
+ *  writerA.SetSession(&session);
+ *  writerB.SetSession(&session);
+ *  ... fill and Close writers as usual ...
+ *  if ( ! session.Commit() ) ...
+ *
+ *  Close then only hands the set over to the session, its SEQNO is
+ *  allocated by Commit.  For each cascade entry Commit reserves one block
+ *  of SEQNOs for each table (and SEQNO type) and stores all the sets in
+ *  one transaction; if any fails the transaction is rolled back and the
+ *  block returned where possible (see TDbiCascader::ReleaseSeqNos).  Once
+ *  committed, sets that need a log entry (see TDbiWriter::Close) are
+ *  recorded in one TDbiLogEntry per table and SEQNO type (local or
+ *  global) covering the range of their SEQNOs; the
+ *  reason is that of the first writer or, if it has none, that given to
+ *  the session.  Sets not committed are discarded by Abort and by the
+ *  destructor.
+ *
+ *  Commit logs the throughput in validity sets per second, also
+ *  available from GetSetsPerSec.
+ *
+ *  Writers using overlay creation dates get them from the session (see
+ *  GetOverlayCreationDate), which loads the validity records an aggregate
+ *  could overlay for a window of a time gate (see TDbi::GetTimeGate)
+ *  from the set's start and resolves later sets that start inside the
+ *  window, together with the sets already closed in the session, without
+ *  querying the database again.  This assumes no other client writes the
+ *  same aggregate during the session.
+ *
+ */
+
+#if !defined(__CINT__) || defined(__MAKECINT__)
+#include "Rtypes.h"
+#endif
+
+#include "TDbi.hxx"
+#include "TDbiValidityRec.hxx"
+#include "TVldTimeStamp.hxx"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace CP {
+    class TDbiLogEntry;
+    class TDbiSqlValPacket;
+    class TDbiTableProxy;
+}
+
+namespace CP {
+
+    class TDbiWriterSession {
+
+    public:
+
+// Constructors and destructors.
+        TDbiWriterSession(const std::string& logComment = "");
+        virtual ~TDbiWriterSession();
+
+// State testing member functions
+        UInt_t GetNumCommitted() const {
+            return fNumCommitted;
+        }
+        UInt_t GetNumPending() const;
+/// Validity sets per second achieved by the last Commit.
+        Double_t GetSetsPerSec() const {
+            return fSetsPerSec;
+        }
+
+// State changing member functions
+
+/// Discard all sets not yet committed, and the overlay caches that
+/// count them.
+        void Abort();
+/// Take ownership of a closed set to be stored in cascade entry dbNo.
+/// For requireGlobal see TDbiCascader::AllocateSeqNo.  If logEntry is
+/// not null the set is recorded in the table's log entry and if
+/// recordFingerprint its fingerprint is recorded once stored (see
+/// TDbiDBProxy::StoreFingerprint).
+        Bool_t Add(CP::TDbiSqlValPacket* packet,
+                   UInt_t dbNo,
+                   Int_t requireGlobal,
+                   const CP::TDbiLogEntry* logEntry = 0,
+                   Bool_t recordFingerprint = kFALSE);
+/// Store all sets and return true if all succeeded.
+        Bool_t Commit();
+/// Creation date for vrec to overlay data in cascade entry dbNo (see
+/// TDbiTableProxy::QueryOverlayCreationDate), counting sets already
+/// closed in the session.
+        CP::TVldTimeStamp GetOverlayCreationDate(CP::TDbiTableProxy& proxy,
+                                                 const CP::TDbiValidityRec& vrec,
+                                                 UInt_t dbNo);
+
+    private:
+
+// Disabled (not implemented) copy constructor and asignment.
+
+        TDbiWriterSession(const TDbiWriterSession&);
+        CP::TDbiWriterSession& operator=(const CP::TDbiWriterSession&);
+
+        Bool_t CommitEntry(UInt_t dbNo, const std::vector<UInt_t>& sets);
+        void DiscardPending();
+        void RecordFingerprints(UInt_t dbNo, const std::vector<UInt_t>& sets);
+        void WriteLogEntries(UInt_t dbNo, const std::vector<UInt_t>& sets);
+
+/// A set waiting to be committed.
+        struct Pending {
+            Pending() : fPacket(0), fDbNo(0), fRequireGlobal(0),
+                        fNeedsLog(kFALSE), fDetMask(0), fSimMask(0),
+                        fTask(0), fRecordFingerprint(kFALSE) {}
+            CP::TDbiSqlValPacket* fPacket;
+            UInt_t fDbNo;
+            Int_t fRequireGlobal;
+            Bool_t fNeedsLog;
+            std::string fReason;
+            Int_t fDetMask;
+            Int_t fSimMask;
+            TDbi::Task fTask;
+            Bool_t fRecordFingerprint;
+        };
+
+/// Validity records that sets of one aggregate could overlay.
+        struct OverlayCache {
+            OverlayCache() : fLoaded(kFALSE) {}
+            Bool_t fLoaded;
+            CP::TVldTimeStamp fStart;   // Window loaded from the database.
+            CP::TVldTimeStamp fEnd;
+            std::vector<CP::TDbiValidityRec> fVRecs;    // Loaded.
+            std::vector<CP::TDbiValidityRec> fClosed;   // Closed in session.
+        };
+
+// Data members
+
+/// Default reason for log entries.
+        std::string fLogComment;
+
+#ifndef __CINT__
+/// Sets waiting to be committed, in the order closed.  Owned.
+        std::vector<Pending> fPending;
+#endif
+
+#ifndef __CINT__
+/// Overlay caches keyed by table, cascade entry, task, aggregate and masks.
+        std::map<std::string,OverlayCache> fOverlayCaches;
+#endif
+
+/// Number of sets committed over the life of the session.
+        UInt_t fNumCommitted;
+
+/// Throughput of the last Commit.
+        Double_t fSetsPerSec;
+
+        ClassDef(TDbiWriterSession,0)   // Commit writers in batches.
+
+    };
+};
+
+#endif  // DBIWRITERSESSION_H
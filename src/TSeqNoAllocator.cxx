@@ -1,7 +1,16 @@
+#include <sstream>
+
 #include "TDbiDatabaseManager.hxx"
 #include "TDbiCascader.hxx"
+#include <TDbiLog.hxx>
+#include <MsgFormat.hxx>
 #include "TSeqNoAllocator.hxx"
 
+/// Return any unused SEQNOs.
+CP::TSeqNoAllocator::~TSeqNoAllocator() {
+    this->ReleaseUnused();
+}
+
 /// Provide a global sequence number for a table name.  The requireGlobal
 /// parameter is interpreted as the type of SEQNO to return: > 0 Must be
 /// global, = 0 Must be global if supplied dbNo is authorising and table isn't
@@ -11,10 +20,74 @@ Int_t CP::TSeqNoAllocator::GetSeqNo(const std::string& tableName,
                                     Int_t requireGlobal /* = 0 */,
                                     Int_t dbNo          /* = 0 */) const
 {
-    return CP::TDbiDatabaseManager::Instance()
-        .GetCascader()
-        .AllocateSeqNo(tableName,requireGlobal,dbNo);
+    if (fBlockSize <= 1) {
+        return this->ReserveSeqNos(tableName,1,requireGlobal,dbNo);
+    }
+
+    std::ostringstream key;
+    key << tableName << ":" << requireGlobal << ":" << dbNo;
+    std::lock_guard<std::mutex> lock(fMutex);
+    Block& block = fBlocks[key.str()];
+    if (block.fNext > block.fLast) {
+        Int_t first = this->ReserveSeqNos(tableName,fBlockSize,
+                                          requireGlobal,dbNo);
+        if (first <= 0) {
+            return 0;
+        }
+        block.fNext = first;
+        block.fLast = first + fBlockSize - 1;
+        block.fDbNo = dbNo;
+        DbiLog("Reserved SEQNOs " << block.fNext << ".." << block.fLast
+               << " for " << tableName << "  ");
+    }
+    return block.fNext++;
+
+}
+
+/// Return the unused SEQNOs of each block to its SEQNO table if no later
+/// ones have been reserved for the table, otherwise record them in the log
+/// as they will never be used.
+void CP::TSeqNoAllocator::ReleaseUnused()
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (! CP::TDbiDatabaseManager::IsActive()) {
+        fBlocks.clear();
+        return;
+    }
+    CP::TDbiCascader& cascader = CP::TDbiDatabaseManager::Instance()
+        .GetCascader();
+    for (std::map<std::string,Block>::const_iterator itr = fBlocks.begin();
+         itr != fBlocks.end();
+         ++itr) {
+        const Block& block = itr->second;
+        if (block.fNext > block.fLast) {
+            continue;
+        }
+        std::string tableName = itr->first.substr(0,itr->first.find(':'));
+        if (cascader.ReleaseSeqNos(tableName,block.fNext,block.fLast,
+                                   block.fDbNo)) {
+            DbiLog("Returned unused SEQNOs " << block.fNext << ".."
+                   << block.fLast << " of " << tableName << "  ");
+        }
+        else {
+            DbiWarn("SEQNOs " << block.fNext << ".." << block.fLast
+                    << " reserved for " << tableName
+                    << " were not used and cannot be returned" << "  ");
+        }
+    }
+    fBlocks.clear();
 
 }
 
+/// Reserve count consecutive SEQNOs, of the type selected by
+/// requireGlobal (see GetSeqNo), in a single update of the SEQNO table.
+Int_t CP::TSeqNoAllocator::ReserveSeqNos(const std::string& tableName,
+                                         UInt_t count,
+                                         Int_t requireGlobal /* = 0 */,
+                                         Int_t dbNo          /* = 0 */) const
+{
+    return CP::TDbiDatabaseManager::Instance()
+        .GetCascader()
+        .AllocateSeqNo(tableName,requireGlobal,dbNo,count);
 
+}
@@ -1,7 +1,11 @@
 #ifndef TSeqNoAllocator_hxx_seen
 #define TSeqNoAllocator_hxx_seen
 
+#include <map>
 #include <string>
+#ifndef __CINT__
+#include <mutex>
+#endif
 #include "Rtypes.h"
 
 namespace CP {
@@ -9,14 +13,62 @@ namespace CP {
 };
 
 /// This is the class can be used to supply local or global SEQNOs.
+///
+/// By default each SEQNO is reserved from the cascade as it is requested.
+/// With SetBlockSize(n), n > 1, SEQNOs are reserved n at a time for each
+/// table (see TDbiCascader::AllocateSeqNo) and handed out from the block,
+/// so the SEQNO table is only locked once per block.  ReleaseUnused
+/// returns the unused part of each block to the SEQNO table if it is
+/// still the last reserved, otherwise it logs the SEQNOs that will never
+/// be used; it is called by the destructor.
+///
+/// TDbiWriter uses the allocator owned by TDbiDatabaseManager, whose block
+/// size is set by the SeqNoBlockSize configuration request.
 class CP::TSeqNoAllocator {
 
 public:
-    TSeqNoAllocator() {}
-    virtual ~TSeqNoAllocator() {};
+    TSeqNoAllocator() : fBlockSize(1) {}
+    virtual ~TSeqNoAllocator();
     Int_t GetSeqNo(const std::string& tableName,
                    Int_t requireGlobal = 0,
                    Int_t dbNo = 0) const;
+    UInt_t GetBlockSize() const {
+        return fBlockSize;
+    }
+
+    /// Return unused SEQNOs of all blocks (see class description).
+    void ReleaseUnused();
+    /// Reserve count consecutive SEQNOs directly from the cascade and
+    /// return the first or 0 if failure.
+    Int_t ReserveSeqNos(const std::string& tableName,
+                        UInt_t count,
+                        Int_t requireGlobal = 0,
+                        Int_t dbNo = 0) const;
+    void SetBlockSize(UInt_t blockSize) {
+        fBlockSize = blockSize ? blockSize : 1;
+    }
+
+private:
+    TSeqNoAllocator(const TSeqNoAllocator&);  // Not implemented
+
+    /// The SEQNOs of a block not yet handed out.
+    struct Block {
+        Block() : fNext(0), fLast(-1), fDbNo(0) {}
+        Int_t fNext;
+        Int_t fLast;
+        Int_t fDbNo;
+    };
+
+    /// Number of SEQNOs to reserve at a time.
+    UInt_t fBlockSize;
+
+#ifndef __CINT__
+    /// Unused SEQNOs keyed by table name, SEQNO type and cascade entry.
+    mutable std::map<std::string,Block> fBlocks;
+
+    /// Serialises access to fBlocks.
+    mutable std::mutex fMutex;
+#endif
 };
 
 #endif